@@ -19,9 +19,11 @@
 
 #include <iostream>
 #include <fstream>
+#include <list>
 #include <time.h> 
 #include "ns3/core-module.h"
 #include "ns3/qbb-helper.h"
+#include "ns3/qbb-partitioner.h"
 #include "ns3/point-to-point-helper.h"
 #include "ns3/applications-module.h"
 #include "ns3/internet-module.h"
@@ -39,14 +41,329 @@ bool enable_qcn = true, use_dynamic_pfc_threshold = true, packet_level_ecmp = fa
 uint32_t packet_payload_size = 1000, l2_chunk_size = 0, l2_ack_interval = 0;
 double pause_time = 5, simulator_stop_time = 3.01, app_start_time = 1.0, app_stop_time = 9.0;
 std::string data_rate, link_delay, topology_file, flow_file, tcp_flow_file, trace_file, trace_output_file;
+std::string scheduler_type, fct_output_file, buffer_sample_file, switch_counters_file;
+double buffer_sample_interval = 10;
+bool buffer_sample_on_change = false;
+std::string ecmp_hash = "Xor";
+uint32_t ecmp_hash_seed = 0;
 bool used_port[65536] = { 0 };
 
 double cnp_interval = 50, alpha_resume_interval = 55, rp_timer, dctcp_gain = 1 / 16, np_sampling_interval = 0, pmax = 1;
 uint32_t byte_counter, fast_recovery_times = 5, kmax = 60, kmin = 60;
 std::string rate_ai, rate_hai;
+std::string congestion_control = "Dcqcn";
 
 bool clamp_target_rate = false, clamp_target_rate_after_timer = false, send_in_chunks = true, l2_wait_for_ack = false, l2_back_to_zero = false, l2_test_read = false;
 double error_rate_per_link = 0.0;
+bool binary_trace = false;
+uint32_t simulator_threads = 1;
+double flow_load_ahead = 0;
+
+struct FlowEntry
+{
+	uint32_t src, dst, pg, maxPacketCount;
+	double start_time, stop_time;
+};
+
+bool ReadFlow(std::ifstream &f, uint32_t &left, FlowEntry &flow)
+{
+	if (left == 0)
+		return false;
+	left--;
+	f >> flow.src >> flow.dst >> flow.pg >> flow.maxPacketCount >> flow.start_time >> flow.stop_time;
+	return true;
+}
+
+uint16_t DrawPort()
+{
+	uint32_t port;
+	while (used_port[port = int(UniformVariable(0, 1).GetValue() * 40000)])
+		continue;
+	used_port[port] = true;
+	return port;
+}
+
+//start and stop times of the applications are relative to now
+Time FromNow(double t)
+{
+	return Max(Seconds(t) - Simulator::Now(), Seconds(0));
+}
+
+//returns the server, then the client
+ApplicationContainer InstallUdpFlow(NodeContainer &n, const FlowEntry &flow, uint16_t port)
+{
+	NS_ASSERT(n.Get(flow.src)->GetNodeType() == 0 && n.Get(flow.dst)->GetNodeType() == 0);
+	Ptr<Ipv4> ipv4 = n.Get(flow.dst)->GetObject<Ipv4>();
+	Ipv4Address serverAddress = ipv4->GetAddress(1, 0).GetLocal(); //GetAddress(0,0) is the loopback 127.0.0.1
+	uint32_t packetSize = packet_payload_size;
+	Time interPacketInterval = Seconds(0.0000005 / 2);
+
+	ApplicationContainer apps;
+	if (send_in_chunks)
+	{
+		UdpEchoServerHelper server0(port, flow.pg); //Add Priority
+		ApplicationContainer apps0s = server0.Install(n.Get(flow.dst));
+		apps0s.Start(FromNow(app_start_time));
+		apps0s.Stop(FromNow(app_stop_time));
+		UdpEchoClientHelper client0(serverAddress, port, flow.pg); //Add Priority
+		client0.SetAttribute("MaxPackets", UintegerValue(flow.maxPacketCount));
+		client0.SetAttribute("Interval", TimeValue(interPacketInterval));
+		client0.SetAttribute("PacketSize", UintegerValue(packetSize));
+		ApplicationContainer apps0c = client0.Install(n.Get(flow.src));
+		apps0c.Start(FromNow(flow.start_time));
+		apps0c.Stop(FromNow(flow.stop_time));
+		apps.Add(apps0s);
+		apps.Add(apps0c);
+	}
+	else
+	{
+		UdpServerHelper server0(port);
+		ApplicationContainer apps0s = server0.Install(n.Get(flow.dst));
+		apps0s.Start(FromNow(app_start_time));
+		apps0s.Stop(FromNow(app_stop_time));
+		UdpClientHelper client0(serverAddress, port, flow.pg); //Add Priority
+		client0.SetAttribute("MaxPackets", UintegerValue(flow.maxPacketCount));
+		client0.SetAttribute("Interval", TimeValue(interPacketInterval));
+		client0.SetAttribute("PacketSize", UintegerValue(packetSize));
+		ApplicationContainer apps0c = client0.Install(n.Get(flow.src));
+		apps0c.Start(FromNow(flow.start_time));
+		apps0c.Stop(FromNow(flow.stop_time));
+		apps.Add(apps0s);
+		apps.Add(apps0c);
+	}
+	return apps;
+}
+
+//returns the sink, then the source
+ApplicationContainer InstallTcpFlow(NodeContainer &n, const FlowEntry &flow, uint16_t port)
+{
+	NS_ASSERT(n.Get(flow.src)->GetNodeType() == 0 && n.Get(flow.dst)->GetNodeType() == 0);
+	Ptr<Ipv4> ipv4 = n.Get(flow.dst)->GetObject<Ipv4>();
+	Ipv4Address serverAddress = ipv4->GetAddress(1, 0).GetLocal();
+
+	Address sinkLocalAddress(InetSocketAddress(Ipv4Address::GetAny(), port));
+	PacketSinkHelper sinkHelper("ns3::TcpSocketFactory", sinkLocalAddress);
+
+	ApplicationContainer sinkApp = sinkHelper.Install(n.Get(flow.dst));
+	sinkApp.Start(FromNow(app_start_time));
+	sinkApp.Stop(FromNow(app_stop_time));
+
+	BulkSendHelper source("ns3::TcpSocketFactory", InetSocketAddress(serverAddress, port));
+	// Set the amount of data to send in bytes.  Zero is unlimited.
+	source.SetAttribute("MaxBytes", UintegerValue(0));
+	ApplicationContainer sourceApps = source.Install(n.Get(flow.src));
+	sourceApps.Start(FromNow(flow.start_time));
+	sourceApps.Stop(FromNow(flow.stop_time));
+
+	ApplicationContainer apps;
+	apps.Add(sinkApp);
+	apps.Add(sourceApps);
+	return apps;
+}
+
+//Streams FLOW_FILE and TCP_FLOW_FILE, which must be sorted by start time, for traces of more flows than
+//fit in memory at once. Every FLOW_LOAD_AHEAD, the flows starting before the next load are created and
+//the flows complete since the previous load are torn down: the applications, sockets, ports and NIC state
+//alive are those of the flows in progress. A UDP flow is complete once its server has received all of
+//its bytes, a TCP flow once stopped and all of its data acknowledged; a flow that never completes is
+//kept until the end, as when created up front.
+class FlowLoader
+{
+public:
+	void Start(NodeContainer n, std::string udp_file, std::string tcp_file, Time ahead, int64_t stream);
+	void Load();
+
+private:
+	//a flow is torn down over two loads, so that the packets in flight arrive before the state they need is gone
+	enum Stage
+	{
+		RUNNING,
+		COMPLETE,	//at the previous load, so that the last echoes have arrived when it is stopped
+		STOPPED	//applications removed, so that the closing sockets are done when its NIC state is removed
+	};
+
+	struct Flow
+	{
+		ApplicationContainer apps;	//the server, then the client
+		uint64_t size;	//bytes (UdpEchoServer) or packets (UdpServer) received by a complete UDP flow, 0 for TCP
+		Time stop;
+		uint32_t src, dst;
+		uint16_t pg;	//of the flow on the NICs
+		uint16_t port;	//of the server
+		uint16_t sport;	//of the client, read when it is stopped
+		Stage stage;
+	};
+
+	void Create(const FlowEntry &entry, bool tcp);
+	bool IsComplete(const Flow &flow) const;
+	void TearDown(Flow &flow);
+	void RemoveNicState(const Flow &flow);
+
+	NodeContainer m_n;
+	Time m_ahead;
+	int64_t m_stream;	//of the next UdpClient
+	std::ifstream m_files[2];	//UDP, then TCP
+	uint32_t m_left[2];
+	FlowEntry m_next[2];
+	bool m_hasNext[2];
+	std::list<Flow> m_flows;
+	bool m_late;
+};
+
+void FlowLoader::Start(NodeContainer n, std::string udp_file, std::string tcp_file, Time ahead, int64_t stream)
+{
+	m_n = n;
+	m_ahead = ahead;
+	m_stream = stream;
+	m_late = false;
+	std::string files[2] = { udp_file, tcp_file };
+	for (int i = 0; i < 2; i++)
+	{
+		m_files[i].open(files[i].c_str());
+		m_left[i] = 0;
+		m_files[i] >> m_left[i];
+		m_hasNext[i] = ReadFlow(m_files[i], m_left[i], m_next[i]);
+	}
+	Simulator::Schedule(Seconds(0), &FlowLoader::Load, this);
+}
+
+void FlowLoader::Load()
+{
+	for (std::list<Flow>::iterator i = m_flows.begin(); i != m_flows.end();)
+	{
+		if (i->stage == STOPPED)
+		{
+			RemoveNicState(*i);
+			i = m_flows.erase(i);
+			continue;
+		}
+		if (i->stage == COMPLETE)
+			TearDown(*i);
+		else if (IsComplete(*i))
+			i->stage = COMPLETE;
+		i++;
+	}
+
+	Time horizon = Simulator::Now() + m_ahead;
+	while (true)
+	{
+		//the next flow of either file, UDP first at the same start time
+		int k = -1;
+		for (int i = 0; i < 2; i++)
+		{
+			if (m_hasNext[i] && (k < 0 || m_next[i].start_time < m_next[k].start_time))
+				k = i;
+		}
+		if (k < 0 || Seconds(m_next[k].start_time) >= horizon)
+			break;
+		if (!m_late && Seconds(m_next[k].start_time) < Simulator::Now())
+		{
+			std::cout << "Warning: flows not sorted by start time start late, e.g. at " << m_next[k].start_time << "s\n";
+			fflush(stdout);
+			m_late = true;
+		}
+		Create(m_next[k], k == 1);
+		m_hasNext[k] = ReadFlow(m_files[k], m_left[k], m_next[k]);
+	}
+
+	if (m_hasNext[0] || m_hasNext[1] || !m_flows.empty())
+		Simulator::Schedule(m_ahead, &FlowLoader::Load, this);
+}
+
+void FlowLoader::Create(const FlowEntry &entry, bool tcp)
+{
+	Flow flow;
+	flow.port = DrawPort();
+	flow.sport = 0;
+	flow.stop = Seconds(entry.stop_time);
+	flow.src = entry.src;
+	flow.dst = entry.dst;
+	flow.stage = RUNNING;
+	if (tcp)
+	{
+		flow.apps = InstallTcpFlow(m_n, entry, flow.port);
+		flow.size = 0;
+		flow.pg = 1; //the NICs send TCP in priority 1
+	}
+	else
+	{
+		flow.apps = InstallUdpFlow(m_n, entry, flow.port);
+		flow.pg = entry.pg;
+		flow.size = send_in_chunks ? (uint64_t)entry.maxPacketCount * packet_payload_size : entry.maxPacketCount;
+		Ptr<UdpClient> client = DynamicCast<UdpClient>(flow.apps.Get(1));
+		if (client != 0)
+			m_stream += client->AssignStreams(m_stream);
+		Ptr<UdpEchoClient> echoClient = DynamicCast<UdpEchoClient>(flow.apps.Get(1));
+		if (echoClient != 0)
+			m_stream += echoClient->AssignStreams(m_stream);
+	}
+	m_flows.push_back(flow);
+}
+
+bool FlowLoader::IsComplete(const Flow &flow) const
+{
+	if (flow.size == 0)
+	{
+		if (Simulator::Now() < flow.stop)
+			return false;
+		Ptr<Socket> socket = DynamicCast<BulkSendApplication>(flow.apps.Get(1))->GetSocket();
+		UintegerValue buffer;
+		if (socket != 0)
+			socket->GetAttribute("SndBufSize", buffer);
+		return socket == 0 || socket->GetTxAvailable() == buffer.Get();
+	}
+	Ptr<UdpEchoServer> echo = DynamicCast<UdpEchoServer>(flow.apps.Get(0));
+	if (echo != 0)
+		return echo->GetTotalRx() >= flow.size;
+	return DynamicCast<UdpServer>(flow.apps.Get(0))->GetReceived() >= flow.size;
+}
+
+void FlowLoader::TearDown(Flow &flow)
+{
+	Ptr<Application> client = flow.apps.Get(1);
+	if (flow.size == 0)
+	{
+		Ptr<Socket> socket = DynamicCast<BulkSendApplication>(client)->GetSocket();
+		Address name;
+		if (socket != 0 && socket->GetSockName(name) == 0 && InetSocketAddress::IsMatchingType(name))
+			flow.sport = InetSocketAddress::ConvertFrom(name).GetPort();
+	}
+	else if (DynamicCast<UdpEchoClient>(client) != 0)
+		flow.sport = DynamicCast<UdpEchoClient>(client)->GetLocalPort();
+	else
+		flow.sport = DynamicCast<UdpClient>(client)->GetLocalPort();
+	for (uint32_t i = 0; i < flow.apps.GetN(); i++)
+	{
+		Ptr<Application> app = flow.apps.Get(i);
+		app->GetNode()->RemoveApplication(app);
+	}
+	flow.apps = ApplicationContainer();
+	flow.stage = STOPPED;
+}
+
+//The NICs key the state of a flow by the address, port and priority of its sender, in both directions of
+//an echo or TCP flow: a later flow given the same ports would inherit it
+void FlowLoader::RemoveNicState(const Flow &flow)
+{
+	Ipv4Address client = m_n.Get(flow.src)->GetObject<Ipv4>()->GetAddress(1, 0).GetLocal();
+	Ipv4Address server = m_n.Get(flow.dst)->GetObject<Ipv4>()->GetAddress(1, 0).GetLocal();
+	uint32_t ends[2] = { flow.src, flow.dst };
+	for (int k = 0; k < 2; k++)
+	{
+		Ptr<Node> node = m_n.Get(ends[k]);
+		for (uint32_t j = 1; j < node->GetNDevices(); j++) //device 0 is the loopback
+		{
+			Ptr<QbbNetDevice> device = DynamicCast<QbbNetDevice>(node->GetDevice(j));
+			if (device == 0)
+				continue;
+			device->RemoveTxFlow(client, flow.sport, flow.pg);
+			device->RemoveRxFlow(client, flow.sport, flow.pg);
+			device->RemoveTxFlow(server, flow.port, flow.pg);
+			device->RemoveRxFlow(server, flow.port, flow.pg);
+		}
+	}
+	used_port[flow.port] = false;
+}
 
 
 
@@ -84,6 +401,13 @@ int main(int argc, char *argv[])
 				else
 					std::cout << "ENABLE_QCN\t\t\t" << "No" << "\n";
 			}
+			else if (key.compare("CONGESTION_CONTROL") == 0)
+			{
+				std::string v;
+				conf >> v;
+				congestion_control = v;
+				std::cout << "CONGESTION_CONTROL\t\t" << congestion_control << "\n";
+			}
 			else if (key.compare("USE_DYNAMIC_PFC_THRESHOLD") == 0)
 			{
 				uint32_t v;
@@ -134,6 +458,20 @@ int main(int argc, char *argv[])
 				else
 					std::cout << "FLOW_LEVEL_ECMP\t\t\t" << "No" << "\n";
 			}
+			else if (key.compare("ECMP_HASH") == 0)
+			{
+				std::string v;
+				conf >> v;
+				ecmp_hash = v;
+				std::cout << "ECMP_HASH\t\t\t" << ecmp_hash << "\n";
+			}
+			else if (key.compare("ECMP_HASH_SEED") == 0)
+			{
+				uint32_t v;
+				conf >> v;
+				ecmp_hash_seed = v;
+				std::cout << "ECMP_HASH_SEED\t\t\t" << ecmp_hash_seed << "\n";
+			}
 			else if (key.compare("PAUSE_TIME") == 0)
 			{
 				double v;
@@ -245,6 +583,56 @@ int main(int argc, char *argv[])
 				}
 				std::cout << "TRACE_OUTPUT_FILE\t\t" << trace_output_file << "\n";
 			}
+			else if (key.compare("FCT_OUTPUT_FILE") == 0)
+			{
+				std::string v;
+				conf >> v;
+				fct_output_file = v;
+				if (argc > 2)
+				{
+					fct_output_file = fct_output_file + std::string(argv[2]);
+				}
+				std::cout << "FCT_OUTPUT_FILE\t\t\t" << fct_output_file << "\n";
+			}
+			else if (key.compare("SWITCH_COUNTERS_FILE") == 0)
+			{
+				std::string v;
+				conf >> v;
+				switch_counters_file = v;
+				if (argc > 2)
+				{
+					switch_counters_file = switch_counters_file + std::string(argv[2]);
+				}
+				std::cout << "SWITCH_COUNTERS_FILE\t\t" << switch_counters_file << "\n";
+			}
+			else if (key.compare("BUFFER_SAMPLE_FILE") == 0)
+			{
+				std::string v;
+				conf >> v;
+				buffer_sample_file = v;
+				if (argc > 2)
+				{
+					buffer_sample_file = buffer_sample_file + std::string(argv[2]);
+				}
+				std::cout << "BUFFER_SAMPLE_FILE\t\t" << buffer_sample_file << "\n";
+			}
+			else if (key.compare("BUFFER_SAMPLE_INTERVAL") == 0)
+			{
+				double v;
+				conf >> v;
+				buffer_sample_interval = v;
+				std::cout << "BUFFER_SAMPLE_INTERVAL\t\t" << buffer_sample_interval << "\n";
+			}
+			else if (key.compare("BUFFER_SAMPLE_ON_CHANGE") == 0)
+			{
+				uint32_t v;
+				conf >> v;
+				buffer_sample_on_change = v;
+				if (buffer_sample_on_change)
+					std::cout << "BUFFER_SAMPLE_ON_CHANGE\t\t" << "Yes" << "\n";
+				else
+					std::cout << "BUFFER_SAMPLE_ON_CHANGE\t\t" << "No" << "\n";
+			}
 			else if (key.compare("APP_START_TIME") == 0)
 			{
 				double v;
@@ -370,6 +758,37 @@ int main(int argc, char *argv[])
 				error_rate_per_link = v;
 				std::cout << "ERROR_RATE_PER_LINK\t\t" << error_rate_per_link << "\n";
 			}
+			else if (key.compare("BINARY_TRACE") == 0)
+			{
+				uint32_t v;
+				conf >> v;
+				binary_trace = v;
+				if (binary_trace)
+					std::cout << "BINARY_TRACE\t\t\t" << "Yes" << "\n";
+				else
+					std::cout << "BINARY_TRACE\t\t\t" << "No" << "\n";
+			}
+			else if (key.compare("SCHEDULER_TYPE") == 0)
+			{
+				std::string v;
+				conf >> v;
+				scheduler_type = v;
+				std::cout << "SCHEDULER_TYPE\t\t\t" << scheduler_type << "\n";
+			}
+			else if (key.compare("SIMULATOR_THREADS") == 0)
+			{
+				uint32_t v;
+				conf >> v;
+				simulator_threads = v;
+				std::cout << "SIMULATOR_THREADS\t\t" << simulator_threads << "\n";
+			}
+			else if (key.compare("FLOW_LOAD_AHEAD") == 0)
+			{
+				double v;
+				conf >> v;
+				flow_load_ahead = v;
+				std::cout << "FLOW_LOAD_AHEAD\t\t\t" << flow_load_ahead << "\n";
+			}
 			fflush(stdout);
 		}
 		conf.close();
@@ -382,13 +801,33 @@ int main(int argc, char *argv[])
 	}
 
 
+	//e.g. ns3::TimingWheelScheduler; must be set before the simulator is first used
+	if (!scheduler_type.empty())
+		GlobalValue::Bind("SchedulerType", StringValue(scheduler_type));
+
+	//one thread per partition of the nodes, see MultithreadedSimulatorImpl
+	if (simulator_threads > 1)
+	{
+		if (!binary_trace)
+		{
+			//the ASCII trace sinks share a reference counted stream
+			std::cout << "Error: SIMULATOR_THREADS requires BINARY_TRACE 1\n";
+			fflush(stdout);
+			return 1;
+		}
+		GlobalValue::Bind("SimulatorImplementationType", StringValue("ns3::MultithreadedSimulatorImpl"));
+	}
+
 	bool dynamicth = use_dynamic_pfc_threshold;
 
 	NS_ASSERT(packet_level_ecmp + flow_level_ecmp < 2); //packet level ecmp and flow level ecmp are exclusive
 	Config::SetDefault("ns3::Ipv4GlobalRouting::RandomEcmpRouting", BooleanValue(packet_level_ecmp));
 	Config::SetDefault("ns3::Ipv4GlobalRouting::FlowEcmpRouting", BooleanValue(flow_level_ecmp));
+	Config::SetDefault("ns3::Ipv4GlobalRouting::EcmpHash", StringValue(ecmp_hash));
+	Config::SetDefault("ns3::Ipv4GlobalRouting::EcmpHashSeed", UintegerValue(ecmp_hash_seed));
 	Config::SetDefault("ns3::QbbNetDevice::PauseTime", UintegerValue(pause_time));
 	Config::SetDefault("ns3::QbbNetDevice::QcnEnabled", BooleanValue(enable_qcn));
+	Config::SetDefault("ns3::QbbNetDevice::CongestionControl", StringValue(congestion_control));
 	Config::SetDefault("ns3::QbbNetDevice::DynamicThreshold", BooleanValue(dynamicth));
 	Config::SetDefault("ns3::QbbNetDevice::ClampTargetRate", BooleanValue(clamp_target_rate));
 	Config::SetDefault("ns3::QbbNetDevice::ClampTargetRateAfterTimeInc", BooleanValue(clamp_target_rate_after_timer));
@@ -406,6 +845,9 @@ int main(int argc, char *argv[])
 	Config::SetDefault("ns3::QbbNetDevice::L2ChunkSize", UintegerValue(l2_chunk_size));
 	Config::SetDefault("ns3::QbbNetDevice::L2AckInterval", UintegerValue(l2_ack_interval));
 	Config::SetDefault("ns3::QbbNetDevice::L2WaitForAck", BooleanValue(l2_wait_for_ack));
+	//a closed TCP socket is freed after TIME_WAIT, 2 MSL: within two loads rather than after the run
+	if (flow_load_ahead > 0)
+		Config::SetDefault("ns3::TcpSocketBase::MaxSegLifetime", DoubleValue(flow_load_ahead / 1e6));
 
 	SeedManager::SetSeed(time(NULL));
 
@@ -421,8 +863,22 @@ int main(int argc, char *argv[])
 	tcpflowf >> tcp_flow_num;
 
 
+	//the system id is the partition of the node: few cut links, weighted by the flows, and balanced traffic
+	QbbPartitioner partitioner;
+	if (simulator_threads > 1)
+	{
+		partitioner.ReadTopology(topology_file);
+		partitioner.ReadFlows(flow_file);
+		partitioner.Partition(simulator_threads);
+		partitioner.Print(std::cout);
+		fflush(stdout);
+	}
+
 	NodeContainer n;
-	n.Create(node_num);
+	for (uint32_t i = 0; i < node_num; i++)
+	{
+		n.Create(1, simulator_threads > 1 ? partitioner.GetPartition(i) : 0);
+	}
 	for (uint32_t i = 0; i < switch_num; i++)
 	{
 		uint32_t sid;
@@ -494,87 +950,73 @@ int main(int argc, char *argv[])
 		tracef >> nid;
 		trace_nodes = NodeContainer(trace_nodes, n.Get(nid));
 	}
-	AsciiTraceHelper ascii;
-	qbb.EnableAscii(ascii.CreateFileStream(trace_output_file), trace_nodes);
+	if (binary_trace)
+	{
+		//convert with utils/qbb-trace-to-text
+		qbb.EnableBinaryTrace(trace_output_file, trace_nodes);
+	}
+	else
+	{
+		AsciiTraceHelper ascii;
+		qbb.EnableAscii(ascii.CreateFileStream(trace_output_file), trace_nodes);
+	}
+
+	Ptr<QbbFlowStats> flow_stats;
+	if (!fct_output_file.empty())
+	{
+		flow_stats = qbb.EnableFlowStats(n);
+	}
+	if (!buffer_sample_file.empty())
+	{
+		//switch buffers every BUFFER_SAMPLE_INTERVAL microseconds, see QbbBufferSampler for the format
+		qbb.EnableBufferSampler(buffer_sample_file, n, Seconds(app_start_time), NanoSeconds(buffer_sample_interval * 1000), buffer_sample_on_change);
+	}
 
 	Ipv4GlobalRoutingHelper::PopulateRoutingTables();
 
 	NS_LOG_INFO("Create Applications.");
 
-	uint32_t packetSize = packet_payload_size;
-	Time interPacketInterval = Seconds(0.0000005 / 2);
-
-	for (uint32_t i = 0; i < flow_num; i++)
+	//FLOW_LOAD_AHEAD microseconds: the flows are created while the simulation runs instead, see FlowLoader
+	if (flow_load_ahead == 0)
 	{
-		uint32_t src, dst, pg, maxPacketCount, port;
-		double start_time, stop_time;
-		while (used_port[port = int(UniformVariable(0, 1).GetValue() * 40000)])
-			continue;
-		used_port[port] = true;
-		flowf >> src >> dst >> pg >> maxPacketCount >> start_time >> stop_time;
-		NS_ASSERT(n.Get(src)->GetNodeType() == 0 && n.Get(dst)->GetNodeType() == 0);
-		Ptr<Ipv4> ipv4 = n.Get(dst)->GetObject<Ipv4>();
-		Ipv4Address serverAddress = ipv4->GetAddress(1, 0).GetLocal(); //GetAddress(0,0) is the loopback 127.0.0.1
-
-		if (send_in_chunks)
-		{
-			UdpEchoServerHelper server0(port, pg); //Add Priority
-			ApplicationContainer apps0s = server0.Install(n.Get(dst));
-			apps0s.Start(Seconds(app_start_time));
-			apps0s.Stop(Seconds(app_stop_time));
-			UdpEchoClientHelper client0(serverAddress, port, pg); //Add Priority
-			client0.SetAttribute("MaxPackets", UintegerValue(maxPacketCount));
-			client0.SetAttribute("Interval", TimeValue(interPacketInterval));
-			client0.SetAttribute("PacketSize", UintegerValue(packetSize));
-			ApplicationContainer apps0c = client0.Install(n.Get(src));
-			apps0c.Start(Seconds(start_time));
-			apps0c.Stop(Seconds(stop_time));
-		}
-		else
-		{
-			UdpServerHelper server0(port);
-			ApplicationContainer apps0s = server0.Install(n.Get(dst));
-			apps0s.Start(Seconds(app_start_time));
-			apps0s.Stop(Seconds(app_stop_time));
-			UdpClientHelper client0(serverAddress, port, pg); //Add Priority
-			client0.SetAttribute("MaxPackets", UintegerValue(maxPacketCount));
-			client0.SetAttribute("Interval", TimeValue(interPacketInterval));
-			client0.SetAttribute("PacketSize", UintegerValue(packetSize));
-			ApplicationContainer apps0c = client0.Install(n.Get(src));
-			apps0c.Start(Seconds(start_time));
-			apps0c.Stop(Seconds(stop_time));
-		}
-
+		FlowEntry flow;
+		while (ReadFlow(flowf, flow_num, flow))
+			InstallUdpFlow(n, flow, DrawPort());
+		while (ReadFlow(tcpflowf, tcp_flow_num, flow))
+			InstallTcpFlow(n, flow, DrawPort());
 	}
 
 
-	for (uint32_t i = 0; i < tcp_flow_num; i++)
+	if (simulator_threads > 1)
 	{
-		uint32_t src, dst, pg, maxPacketCount, port;
-		double start_time, stop_time;
-		while (used_port[port = int(UniformVariable(0, 1).GetValue() * 40000)])
-			continue;
-		used_port[port] = true;
-		tcpflowf >> src >> dst >> pg >> maxPacketCount >> start_time >> stop_time;
-		NS_ASSERT(n.Get(src)->GetNodeType() == 0 && n.Get(dst)->GetNodeType() == 0);
-		Ptr<Ipv4> ipv4 = n.Get(dst)->GetObject<Ipv4>();
-		Ipv4Address serverAddress = ipv4->GetAddress(1, 0).GetLocal();
-
-		Address sinkLocalAddress(InetSocketAddress(Ipv4Address::GetAny(), port));
-		PacketSinkHelper sinkHelper("ns3::TcpSocketFactory", sinkLocalAddress);
-
-		ApplicationContainer sinkApp = sinkHelper.Install(n.Get(dst));
-		sinkApp.Start(Seconds(app_start_time));
-		sinkApp.Stop(Seconds(app_stop_time));
-
-		BulkSendHelper source("ns3::TcpSocketFactory", InetSocketAddress(serverAddress, port));
-		// Set the amount of data to send in bytes.  Zero is unlimited.
-		source.SetAttribute("MaxBytes", UintegerValue(0));
-		ApplicationContainer sourceApps = source.Install(n.Get(src));
-		sourceApps.Start(Seconds(start_time));
-		sourceApps.Stop(Seconds(stop_time));
+		//the ends of a link may run in different threads, every device needs its own error model;
+		//created last, so that the ports drawn above are the same as in a sequential run
+		for (uint32_t i = 0; i < node_num; i++)
+		{
+			for (uint32_t j = 1; j < n.Get(i)->GetNDevices(); j++) //device 0 is the loopback
+			{
+				Ptr<NetDevice> device = n.Get(i)->GetDevice(j);
+				PointerValue shared;
+				device->GetAttribute("ReceiveErrorModel", shared);
+				Ptr<RateErrorModel> rem = CreateObject<RateErrorModel>();
+				Ptr<UniformRandomVariable> uv = CreateObject<UniformRandomVariable>();
+				rem->SetRandomVariable(uv);
+				uv->SetStream(50);
+				rem->SetAttribute("ErrorRate", DoubleValue(shared.Get<RateErrorModel>()->GetRate()));
+				rem->SetAttribute("ErrorUnit", StringValue("ERROR_UNIT_PACKET"));
+				device->SetAttribute("ReceiveErrorModel", PointerValue(rem));
+			}
+		}
 	}
 
+	//fixed streams, so that draws do not depend on the order objects are created in
+	int64_t stream = 1;
+	stream += qbb.AssignStreams(n, stream);
+	stream += UdpClientHelper().AssignStreams(n, stream);
+	stream += UdpEchoClientHelper().AssignStreams(n, stream);
+	FlowLoader loader;
+	if (flow_load_ahead > 0)
+		loader.Start(n, flow_file, tcp_flow_file, NanoSeconds(flow_load_ahead * 1000), stream);
 
 	topof.close();
 	flowf.close();
@@ -589,6 +1031,14 @@ int main(int argc, char *argv[])
 	NS_LOG_INFO("Run Simulation.");
 	Simulator::Stop(Seconds(simulator_stop_time));
 	Simulator::Run();
+	if (flow_stats != 0)
+	{
+		flow_stats->Write(fct_output_file);
+	}
+	if (!switch_counters_file.empty())
+	{
+		qbb.WriteSwitchCounters(switch_counters_file, n);
+	}
 	Simulator::Destroy();
 	NS_LOG_INFO("Done.");
 
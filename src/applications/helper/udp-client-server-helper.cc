@@ -118,6 +118,25 @@ UdpClientHelper::Install (NodeContainer c)
   return apps;
 }
 
+int64_t
+UdpClientHelper::AssignStreams (NodeContainer c, int64_t stream)
+{
+  int64_t currentStream = stream;
+  for (NodeContainer::Iterator i = c.Begin (); i != c.End (); ++i)
+    {
+      Ptr<Node> node = *i;
+      for (uint32_t j = 0; j < node->GetNApplications (); j++)
+        {
+          Ptr<UdpClient> client = DynamicCast<UdpClient> (node->GetApplication (j));
+          if (client)
+            {
+              currentStream += client->AssignStreams (currentStream);
+            }
+        }
+    }
+  return (currentStream - stream);
+}
+
 UdpTraceClientHelper::UdpTraceClientHelper ()
 {
 }
@@ -121,6 +121,19 @@ public:
      */
   ApplicationContainer Install (NodeContainer c);
 
+  /**
+   * Assign a fixed random variable stream number to the random variables
+   * used by the UdpClient applications of the nodes.  Return the number of
+   * streams (possibly zero) that have been assigned.  The Install() method
+   * should have previously been called by the user.
+   *
+   * \param c NodeContainer of the set of nodes whose UdpClient applications
+   *          should be modified to use a fixed stream
+   * \param stream first stream index to use
+   * \return the number of stream indices assigned by this helper
+   */
+  int64_t AssignStreams (NodeContainer c, int64_t stream);
+
 private:
   ObjectFactory m_factory;
 };
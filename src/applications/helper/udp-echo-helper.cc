@@ -81,6 +81,11 @@ UdpEchoServerHelper::InstallPriv (Ptr<Node> node) const
   return app;
 }
 
+UdpEchoClientHelper::UdpEchoClientHelper ()
+{
+  m_factory.SetTypeId (UdpEchoClient::GetTypeId ());
+}
+
 UdpEchoClientHelper::UdpEchoClientHelper (Address address, uint16_t port)
 {
   m_factory.SetTypeId (UdpEchoClient::GetTypeId ());
@@ -170,4 +175,23 @@ UdpEchoClientHelper::InstallPriv (Ptr<Node> node) const
   return app;
 }
 
+int64_t
+UdpEchoClientHelper::AssignStreams (NodeContainer c, int64_t stream)
+{
+  int64_t currentStream = stream;
+  for (NodeContainer::Iterator i = c.Begin (); i != c.End (); ++i)
+    {
+      Ptr<Node> node = *i;
+      for (uint32_t j = 0; j < node->GetNApplications (); j++)
+        {
+          Ptr<UdpEchoClient> client = DynamicCast<UdpEchoClient> (node->GetApplication (j));
+          if (client)
+            {
+              currentStream += client->AssignStreams (currentStream);
+            }
+        }
+    }
+  return (currentStream - stream);
+}
+
 } // namespace ns3
@@ -101,6 +101,12 @@ private:
 class UdpEchoClientHelper
 {
 public:
+  /**
+   * Create UdpEchoClientHelper without a remote server, e.g. to assign
+   * streams to echo clients that have already been installed.
+   */
+  UdpEchoClientHelper ();
+
   /**
    * Create UdpEchoClientHelper which will make life easier for people trying
    * to set up simulations with echos.
@@ -205,6 +211,19 @@ public:
    */
   ApplicationContainer Install (NodeContainer c) const;
 
+  /**
+   * Assign a fixed random variable stream number to the random variables
+   * used by the UdpEchoClient applications of the nodes.  Return the number
+   * of streams (possibly zero) that have been assigned.  The Install() method
+   * should have previously been called by the user.
+   *
+   * \param c NodeContainer of the set of nodes whose UdpEchoClient applications
+   *          should be modified to use a fixed stream
+   * \param stream first stream index to use
+   * \return the number of stream indices assigned by this helper
+   */
+  int64_t AssignStreams (NodeContainer c, int64_t stream);
+
 	
 private:
   Ptr<Application> InstallPriv (Ptr<Node> node) const;
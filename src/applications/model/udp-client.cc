@@ -28,7 +28,6 @@
 #include "ns3/socket-factory.h"
 #include "ns3/packet.h"
 #include "ns3/uinteger.h"
-#include "ns3/random-variable.h"
 #include "ns3/qbb-net-device.h"
 #include "ns3/ipv4-end-point.h"
 #include "udp-client.h"
@@ -74,6 +73,11 @@ UdpClient::GetTypeId (void)
                    UintegerValue (1024),
                    MakeUintegerAccessor (&UdpClient::m_size),
                    MakeUintegerChecker<uint32_t> (14,1500))
+    .AddAttribute ("Watermark",
+                   "On nodes with QbbNetDevices, post packets while less than this many bytes of the flow wait in the NIC.",
+                   UintegerValue (25000),
+                   MakeUintegerAccessor (&UdpClient::m_watermark),
+                   MakeUintegerChecker<uint32_t> ())
   ;
   return tid;
 }
@@ -84,6 +88,8 @@ UdpClient::UdpClient ()
   m_sent = 0;
   m_socket = 0;
   m_sendEvent = EventId ();
+  m_localPort = 0;
+  m_posting = false;
 }
 
 UdpClient::~UdpClient ()
@@ -112,10 +118,23 @@ UdpClient::SetRemote (Address ip, uint16_t port)
   m_peerPort = port;
 }
 
+uint32_t
+UdpClient::GetLocalPort (void) const
+{
+  return m_localPort;
+}
+
+int64_t
+UdpClient::AssignStreams (int64_t stream)
+{
+  return 0;
+}
+
 void
 UdpClient::DoDispose (void)
 {
   NS_LOG_FUNCTION_NOARGS ();
+  m_devices.clear ();
   Application::DoDispose ();
 }
 
@@ -141,6 +160,17 @@ UdpClient::StartApplication (void)
     }
 
   m_socket->SetRecvCallback (MakeCallback (&UdpClient::Reset, this));
+  m_localPort = m_socket->GetLocalPort ();
+  m_devices.clear ();
+  for (uint32_t i = 0; i < GetNode ()->GetNDevices (); i++)
+    {
+      Ptr<QbbNetDevice> device = DynamicCast<QbbNetDevice> (GetNode ()->GetDevice (i));
+      if (device != 0)
+        {
+          device->ConnectWithoutContext (MakeCallback (&UdpClient::TxAvailable, this));
+          m_devices.push_back (device);
+        }
+    }
   m_sendEvent = Simulator::Schedule (Seconds (0.0), &UdpClient::Send, this);
   m_allowed = m_count;
 }
@@ -150,83 +180,99 @@ UdpClient::StopApplication ()
 {
   NS_LOG_FUNCTION_NOARGS ();
   Simulator::Cancel (m_sendEvent);
+  for (uint32_t i = 0; i < m_devices.size (); i++)
+    {
+      m_devices[i]->DisconnectWithoutContext (MakeCallback (&UdpClient::TxAvailable, this));
+    }
+  m_devices.clear ();
+  if (m_socket != 0)
+    {
+      m_socket->Close ();
+      m_socket->SetRecvCallback (MakeNullCallback<void, Ptr<Socket> > ());
+      m_socket = 0;
+    }
 }
 
 void
 UdpClient::Send (void)
 {
   NS_LOG_FUNCTION_NOARGS ();
-  NS_ASSERT (m_sendEvent.IsExpired ());
-
-  //Yibo: optimize!!!
-  Ptr<Node> node = GetNode();
-  uint32_t dn = node->GetNDevices();
-  double next_avail=10;
-  bool found=false;
-
-  for (uint32_t i=0;i<dn;i++)
-  {
-	  Ptr<NetDevice> d = node->GetDevice(i);
-	  uint32_t localp=m_socket->GetLocalPort();
-	  
-	  //std::cout<<localp<<"\n";
-	  uint32_t buffer = d->GetUsedBuffer(localp,m_pg);
-	  double tmp = (buffer*8.0-1500*8.0)/40/1000000000*0.95; //0.95 is for conservative. assuming 40Gbps link.
-	  if (tmp<next_avail && tmp>0)
-	  {
-		  next_avail = tmp;
-		  found = true;
-	  }
-	      //std::cout<<tmp<<"\n";
-  }
-  if (!found)
-  {
-	  next_avail=0;
-  }
-  
-  next_avail = next_avail>m_interval.GetSeconds()?next_avail:m_interval.GetSeconds();
-  //next_avail = m_interval.GetSeconds();
-
-  if (next_avail < 0.000005)
-  {
-	  SeqTsHeader seqTs;
-	  seqTs.SetSeq (m_sent);
-	  seqTs.SetPG (m_pg);
-	  Ptr<Packet> p = Create<Packet> (m_size-14-10); // 14 : the size of the seqTs header, 10: the size of qbb header
-	  p->AddHeader (seqTs);
-
-	  std::stringstream peerAddressStringStream;
-	  if (Ipv4Address::IsMatchingType (m_peerAddress))
-	  {
-		  peerAddressStringStream << Ipv4Address::ConvertFrom (m_peerAddress);
-	  }
-	  else if (Ipv6Address::IsMatchingType (m_peerAddress))
-	  {
-		  peerAddressStringStream << Ipv6Address::ConvertFrom (m_peerAddress);
-	  }
-
-	  if ((m_socket->Send (p)) >= 0)
-	  {
-		  ++m_sent;
-		  NS_LOG_INFO ("TraceDelay TX " << m_size << " bytes to "
-			  << peerAddressStringStream.str () << " Uid: "
-			  << p->GetUid () << " Time: "
-			  << (Simulator::Now ()).GetSeconds ());
-
-	  }
-	  else
-	  {
-		  NS_LOG_INFO ("Error while sending " << m_size << " bytes to "
-			  << peerAddressStringStream.str ());
-	  }
-  }
-
-  //Yibo: add jitter here to avoid unfairness!!!!!
-  if (m_sent < m_allowed)
+
+  if (m_devices.empty ())
     {
-      m_sendEvent = Simulator::Schedule (Seconds(next_avail * UniformVariable(0.45,0.55).GetValue()), &UdpClient::Send, this);
+      NS_ASSERT (m_sendEvent.IsExpired ());
+      SendPacket ();
+      if (m_sent < m_allowed)
+        {
+          m_sendEvent = Simulator::Schedule (m_interval, &UdpClient::Send, this);
+        }
+      return;
     }
 
+  //Post packets until the NIC holds enough of the flow, TxAvailable resumes.
+  //Sending may put a packet on the wire and call TxAvailable right away,
+  //this loop takes care of that.
+  if (m_posting)
+    {
+      return;
+    }
+  m_posting = true;
+  while (m_sent < m_allowed && GetBacklog () < m_watermark)
+    {
+      if (!SendPacket ())
+        {
+          //with nothing of the flow left in the NIC, no TxAvailable would
+          //come to resume it
+          if (GetBacklog () == 0 && !m_sendEvent.IsRunning ())
+            {
+              m_sendEvent = Simulator::Schedule (m_interval, &UdpClient::Send, this);
+            }
+          break;
+        }
+    }
+  m_posting = false;
+}
+
+bool
+UdpClient::SendPacket (void)
+{
+  SeqTsHeader seqTs;
+  seqTs.SetSeq (m_sent);
+  seqTs.SetPG (m_pg);
+  Ptr<Packet> p = Create<Packet> (m_size-14-10); // 14 : the size of the seqTs header, 10: the size of qbb header
+  p->AddHeader (seqTs);
+
+  if ((m_socket->Send (p)) >= 0)
+    {
+      ++m_sent;
+      NS_LOG_INFO ("TraceDelay TX " << m_size << " bytes to "
+                                    << m_peerAddress << " Uid: "
+                                    << p->GetUid () << " Time: "
+                                    << (Simulator::Now ()).GetSeconds ());
+      return true;
+    }
+  NS_LOG_INFO ("Error while sending " << m_size << " bytes to " << m_peerAddress);
+  return false;
+}
+
+void
+UdpClient::TxAvailable (Ptr<NetDevice> device, uint32_t port)
+{
+  if (port == m_localPort && m_sent < m_allowed)
+    {
+      Send ();
+    }
+}
+
+uint32_t
+UdpClient::GetBacklog (void) const
+{
+  uint32_t backlog = 0;
+  for (uint32_t i = 0; i < m_devices.size (); i++)
+    {
+      backlog += m_devices[i]->GetUsedBuffer (m_localPort, m_pg);
+    }
+  return backlog;
 }
 
 void 
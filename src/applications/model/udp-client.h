@@ -27,11 +27,14 @@
 #include "ns3/event-id.h"
 #include "ns3/ptr.h"
 #include "ns3/ipv4-address.h"
+#include <vector>
 
 namespace ns3 {
 
 class Socket;
 class Packet;
+class NetDevice;
+class QbbNetDevice;
 
 /**
  * \ingroup udpclientserver
@@ -39,6 +42,10 @@ class Packet;
  * \brief A Udp client. Sends UDP packet carrying sequence number and time stamp
  *  in their payloads
  *
+ * On a node with QbbNetDevices the client is driven by the NIC instead of a
+ * timer: it posts packets while less than Watermark bytes of the flow wait
+ * in the NIC, and resumes when the NIC reports that a packet of the flow
+ * went on the wire. Interval is only used on nodes without QbbNetDevices.
  */
 class UdpClient : public Application
 {
@@ -60,6 +67,22 @@ public:
   void SetRemote (Address ip, uint16_t port);
   void SetPG (uint16_t pg);
 
+  /**
+   * \return the local port of the flow, 0 before the application starts;
+   * it is kept once the socket is closed
+   */
+  uint32_t GetLocalPort (void) const;
+
+  /**
+   * Assign a fixed random variable stream number to the random variables
+   * used by this model.  Return the number of streams (possibly zero) that
+   * have been assigned.
+   *
+   * \param stream first stream index to use
+   * \return the number of stream indices assigned by this model
+   */
+  int64_t AssignStreams (int64_t stream);
+
 protected:
   virtual void DoDispose (void);
 
@@ -70,7 +93,11 @@ private:
 
   void ScheduleTransmit (Time dt);
   void Send (void);
+  bool SendPacket (void);
   void Reset (Ptr<Socket> socket);
+  /// Tx buffer available callback of the QbbNetDevices
+  void TxAvailable (Ptr<NetDevice> device, uint32_t port);
+  uint32_t GetBacklog (void) const;
 
   uint32_t m_count;
   uint64_t m_allowed;
@@ -84,6 +111,10 @@ private:
   EventId m_sendEvent;
 
   uint16_t m_pg;
+  uint32_t m_watermark;
+  uint32_t m_localPort;
+  bool m_posting;
+  std::vector<Ptr<QbbNetDevice> > m_devices;
 
 };
 
@@ -27,7 +27,7 @@
 #include "ns3/packet.h"
 #include "ns3/uinteger.h"
 #include "ns3/trace-source-accessor.h"
-#include "ns3/random-variable.h"
+#include "ns3/random-variable-stream.h"
 #include "ns3/qbb-net-device.h"
 #include "ns3/ipv4-end-point.h"
 #include "udp-echo-client.h"
@@ -90,9 +90,11 @@ namespace ns3 {
 		m_sent = 0;
 		m_sentBytes = 0;
 		m_socket = 0;
+		m_localPort = 0;
 		m_sendEvent = EventId();
 		m_data = 0;
 		m_dataSize = 0;
+		m_jitter = CreateObject<UniformRandomVariable>();
 	}
 
 	UdpEchoClient::~UdpEchoClient()
@@ -126,6 +128,19 @@ namespace ns3 {
 		m_peerPort = port;
 	}
 
+	uint32_t
+		UdpEchoClient::GetLocalPort(void) const
+	{
+		return m_localPort;
+	}
+
+	int64_t
+		UdpEchoClient::AssignStreams(int64_t stream)
+	{
+		m_jitter->SetStream(stream);
+		return 1;
+	}
+
 	void
 		UdpEchoClient::DoDispose(void)
 	{
@@ -155,6 +170,7 @@ namespace ns3 {
 		}
 
 		m_socket->SetRecvCallback(MakeCallback(&UdpEchoClient::HandleRead, this));
+		m_localPort = m_socket->GetLocalPort();
 		m_allowed = m_chunk;
 		ScheduleTransmit(Seconds(0.));
 	}
@@ -357,7 +373,7 @@ namespace ns3 {
 		//add jitter here to avoid unfairness across different flows
 		if (m_sentBytes < m_allowed && m_sentBytes / m_size < m_count)
 		{
-			m_sendEvent = Simulator::Schedule(Seconds(next_avail * UniformVariable(0.45, 0.55).GetValue()), &UdpEchoClient::Send, this);
+			m_sendEvent = Simulator::Schedule(Seconds(next_avail * m_jitter->GetValue(0.45, 0.55)), &UdpEchoClient::Send, this);
 		}
 	}
 
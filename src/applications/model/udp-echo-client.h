@@ -24,6 +24,7 @@
 #include "ns3/ptr.h"
 #include "ns3/ipv4-address.h"
 #include "ns3/traced-callback.h"
+#include "ns3/random-variable-stream.h"
 
 namespace ns3 {
 
@@ -122,6 +123,22 @@ public:
    */
   void SetFill (uint8_t *fill, uint32_t fillSize, uint32_t dataSize);
 
+  /**
+   * \return the local port of the flow, 0 before the application starts;
+   * it is kept once the socket is closed
+   */
+  uint32_t GetLocalPort (void) const;
+
+  /**
+   * Assign a fixed random variable stream number to the random variables
+   * used by this model.  Return the number of streams (possibly zero) that
+   * have been assigned.
+   *
+   * \param stream first stream index to use
+   * \return the number of stream indices assigned by this model
+   */
+  int64_t AssignStreams (int64_t stream);
+
 protected:
   virtual void DoDispose (void);
 
@@ -148,6 +165,7 @@ private:
   uint32_t m_sent;
   uint64_t m_sentBytes;
   Ptr<Socket> m_socket;
+  uint32_t m_localPort;
   Address m_peerAddress;
   uint16_t m_peerPort;
   EventId m_sendEvent;
@@ -155,6 +173,7 @@ private:
   TracedCallback<Ptr<const Packet> > m_txTrace;
 
   uint16_t m_pg;
+  Ptr<UniformRandomVariable> m_jitter;
 };
 
 } // namespace ns3
@@ -64,6 +64,7 @@ UdpEchoServer::GetTypeId (void)
 UdpEchoServer::UdpEchoServer ()
 {
 	m_received = 0;
+	m_totalRx = 0;
   NS_LOG_FUNCTION_NOARGS ();
 }
 
@@ -74,6 +75,12 @@ UdpEchoServer::~UdpEchoServer()
   m_socket6 = 0;
 }
 
+uint64_t
+UdpEchoServer::GetTotalRx () const
+{
+  return m_totalRx;
+}
+
 void
 UdpEchoServer::DoDispose (void)
 {
@@ -166,6 +173,7 @@ UdpEchoServer::HandleRead (Ptr<Socket> socket)
 		  packet->RemoveAllByteTags ();
 
 		  m_received += packet->GetSize();
+		  m_totalRx += packet->GetSize();
 		  if (m_received>=m_chunk)
 		  {
 			  m_received = 0;
@@ -47,6 +47,11 @@ public:
   UdpEchoServer ();
   virtual ~UdpEchoServer ();
 
+  /**
+   * \return the total bytes received by this server
+   */
+  uint64_t GetTotalRx () const;
+
 protected:
   virtual void DoDispose (void);
 
@@ -65,6 +70,7 @@ private:
   uint16_t m_pg;
   uint32_t m_received;
   uint32_t m_chunk;
+  uint64_t m_totalRx;
 
 };
 
@@ -142,7 +142,15 @@ UdpServer::StopApplication ()
 
   if (m_socket != 0)
     {
+      m_socket->Close ();
       m_socket->SetRecvCallback (MakeNullCallback<void, Ptr<Socket> > ());
+      m_socket = 0;
+    }
+  if (m_socket6 != 0)
+    {
+      m_socket6->Close ();
+      m_socket6->SetRecvCallback (MakeNullCallback<void, Ptr<Socket> > ());
+      m_socket6 = 0;
     }
 }
 
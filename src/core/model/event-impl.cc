@@ -20,11 +20,150 @@
 
 #include "event-impl.h"
 #include "log.h"
+#include "thread-local.h"
+#include <new>
+#if defined (_MSC_VER)
+#include <intrin.h>
+#endif
 
 NS_LOG_COMPONENT_DEFINE ("EventImpl");
 
 namespace ns3 {
 
+namespace {
+
+// events up to EVENT_POOL_MAX_SIZE bytes come from the pool, in size
+// classes of EVENT_POOL_ALIGN bytes; bigger ones use the global allocator
+const std::size_t EVENT_POOL_ALIGN = 16;
+const std::size_t EVENT_POOL_MAX_SIZE = 256;
+const std::size_t EVENT_POOL_CLASSES = EVENT_POOL_MAX_SIZE / EVENT_POOL_ALIGN;
+const std::size_t EVENT_POOL_CHUNK_SIZE = 16384;
+
+struct EventPool;
+
+// header of EVENT_POOL_ALIGN bytes in front of every event of the pool
+struct EventPoolBlock
+{
+  EventPool *owner;
+  EventPoolBlock *next;
+};
+
+// chunks are never released, but they stay linked from their first bytes
+// so that leak checkers report them as still reachable
+struct EventPoolChunk
+{
+  EventPoolChunk *next;
+};
+
+// The free lists of one thread. Other threads do not touch them: a block
+// freed by another thread, e.g. the event of a packet sent to another
+// partition, is pushed on the returned stack of its owner, which takes
+// the whole stack back when its free list runs out. A pool outlives its
+// thread and is adopted by the next thread that allocates events, so
+// neither blocks nor chunks are lost when simulator threads come and go.
+struct EventPool
+{
+  EventPoolBlock *free[EVENT_POOL_CLASSES];
+  EventPoolBlock * volatile returned[EVENT_POOL_CLASSES];
+  EventPoolChunk *chunks;
+  EventPool *nextPool;
+  volatile long inUse;
+};
+
+EventPool * volatile g_eventPools = 0;
+NS_THREAD_LOCAL EventPool *g_eventPool;
+
+#if defined (_MSC_VER)
+bool
+EventPoolCas (void * volatile *p, void *expected, void *desired)
+{
+  return _InterlockedCompareExchangePointer (p, desired, expected) == expected;
+}
+void *
+EventPoolExchange (void * volatile *p, void *desired)
+{
+  return _InterlockedExchangePointer (p, desired);
+}
+bool
+EventPoolCas (volatile long *p, long expected, long desired)
+{
+  return _InterlockedCompareExchange (p, desired, expected) == expected;
+}
+#else
+bool
+EventPoolCas (void * volatile *p, void *expected, void *desired)
+{
+  return __sync_bool_compare_and_swap (p, expected, desired);
+}
+void *
+EventPoolExchange (void * volatile *p, void *desired)
+{
+  // a full barrier, unlike __sync_lock_test_and_set
+  void *old;
+  do
+    {
+      old = *p;
+    }
+  while (!__sync_bool_compare_and_swap (p, old, desired));
+  return old;
+}
+bool
+EventPoolCas (volatile long *p, long expected, long desired)
+{
+  return __sync_bool_compare_and_swap (p, expected, desired);
+}
+#endif
+
+EventPool *
+EventPoolAcquire (void)
+{
+  for (EventPool *pool = g_eventPools; pool != 0; pool = pool->nextPool)
+    {
+      if (pool->inUse == 0 && EventPoolCas (&pool->inUse, 0, 1))
+        {
+          return pool;
+        }
+    }
+  EventPool *pool = static_cast<EventPool *> (::operator new (sizeof (EventPool)));
+  for (std::size_t cls = 0; cls < EVENT_POOL_CLASSES; cls++)
+    {
+      pool->free[cls] = 0;
+      pool->returned[cls] = 0;
+    }
+  pool->chunks = 0;
+  pool->inUse = 1;
+  do
+    {
+      pool->nextPool = g_eventPools;
+    }
+  while (!EventPoolCas ((void * volatile *) &g_eventPools, pool->nextPool, pool));
+  return pool;
+}
+
+void
+EventPoolRefill (EventPool *pool, std::size_t cls)
+{
+  pool->free[cls] = static_cast<EventPoolBlock *> (EventPoolExchange ((void * volatile *) &pool->returned[cls], 0));
+  if (pool->free[cls] != 0)
+    {
+      return;
+    }
+  std::size_t size = (cls + 2) * EVENT_POOL_ALIGN;
+  char *chunk = static_cast<char *> (::operator new (EVENT_POOL_CHUNK_SIZE));
+  EventPoolChunk *header = reinterpret_cast<EventPoolChunk *> (chunk);
+  header->next = pool->chunks;
+  pool->chunks = header;
+  for (std::size_t offset = EVENT_POOL_ALIGN; offset + size <= EVENT_POOL_CHUNK_SIZE; offset += size)
+    {
+      EventPoolBlock *block = reinterpret_cast<EventPoolBlock *> (chunk + offset);
+      block->owner = pool;
+      block->next = pool->free[cls];
+      pool->free[cls] = block;
+    }
+}
+
+} // anonymous namespace
+
 EventImpl::~EventImpl ()
 {
   NS_LOG_FUNCTION (this);
@@ -60,4 +199,65 @@ EventImpl::IsCancelled (void)
   return m_cancel;
 }
 
+void *
+EventImpl::operator new (std::size_t size)
+{
+  if (size > EVENT_POOL_MAX_SIZE)
+    {
+      return ::operator new (size);
+    }
+  EventPool *pool = g_eventPool;
+  if (pool == 0)
+    {
+      pool = g_eventPool = EventPoolAcquire ();
+    }
+  std::size_t cls = (size - 1) / EVENT_POOL_ALIGN;
+  if (pool->free[cls] == 0)
+    {
+      EventPoolRefill (pool, cls);
+    }
+  EventPoolBlock *block = pool->free[cls];
+  pool->free[cls] = block->next;
+  return reinterpret_cast<char *> (block) + EVENT_POOL_ALIGN;
+}
+
+void
+EventImpl::operator delete (void *p, std::size_t size)
+{
+  if (p == 0)
+    {
+      return;
+    }
+  if (size > EVENT_POOL_MAX_SIZE)
+    {
+      ::operator delete (p);
+      return;
+    }
+  std::size_t cls = (size - 1) / EVENT_POOL_ALIGN;
+  EventPoolBlock *block = reinterpret_cast<EventPoolBlock *> (static_cast<char *> (p) - EVENT_POOL_ALIGN);
+  EventPool *owner = block->owner;
+  if (owner == g_eventPool)
+    {
+      block->next = owner->free[cls];
+      owner->free[cls] = block;
+      return;
+    }
+  do
+    {
+      block->next = owner->returned[cls];
+    }
+  while (!EventPoolCas ((void * volatile *) &owner->returned[cls], block->next, block));
+}
+
+void
+EventImpl::ReleaseThreadPool (void)
+{
+  EventPool *pool = g_eventPool;
+  if (pool != 0)
+    {
+      g_eventPool = 0;
+      EventPoolCas (&pool->inUse, 1, 0);
+    }
+}
+
 } // namespace ns3
@@ -21,6 +21,7 @@
 #define EVENT_IMPL_H
 
 #include <stdint.h>
+#include <cstddef>
 #include "simple-ref-count.h"
 
 namespace ns3 {
@@ -35,6 +36,14 @@ namespace ns3 {
  * obviously (there are Ref and Unref methods) reference-counted and
  * most subclasses are usually created by one of the many Simulator::Schedule
  * methods.
+ *
+ * Events are allocated and freed at a very high rate, so EventImpl and all
+ * its subclasses (including the ones generated by MakeEvent) are allocated
+ * from per-thread free lists of fixed size classes rather than with the
+ * global operator new. Memory is carved from larger chunks and recycled,
+ * so the steady state of a simulation does not call malloc for events.
+ * An event freed by another thread goes back to the thread that allocated
+ * it.
  */
 class EventImpl : public SimpleRefCount<EventImpl>
 {
@@ -58,6 +67,15 @@ public:
    */
   bool IsCancelled (void);
 
+  static void *operator new (std::size_t size);
+  static void operator delete (void *p, std::size_t size);
+  /**
+   * Hand the free lists of the calling thread over to the next thread that
+   * allocates events. To be called by a thread that allocated events
+   * before it exits.
+   */
+  static void ReleaseThreadPool (void);
+
 protected:
   virtual void Notify (void) = 0;
 
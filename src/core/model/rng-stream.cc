@@ -38,11 +38,6 @@ typedef double Matrix[3][3];
 
 const double m1   =       4294967087.0;
 const double m2   =       4294944443.0;
-const double norm =       1.0 / (m1 + 1.0);
-const double a12  =       1403580.0;
-const double a13n =       810728.0;
-const double a21  =       527612.0;
-const double a23n =       1370589.0;
 const double two17 =      131072.0;
 const double two53 =      9007199254740992.0;
 const double fact =       5.9604644775390625e-8;     /* 1 / 2^24  */
@@ -256,40 +251,6 @@ void PowerOfTwoMatrix (int n, Matrix a1p, Matrix a2p)
 
 
 namespace ns3 {
-//-------------------------------------------------------------------------
-// Generate the next random number.
-//
-double RngStream::RandU01 ()
-{
-  int32_t k;
-  double p1, p2, u;
-
-  /* Component 1 */
-  p1 = a12 * m_currentState[1] - a13n * m_currentState[0];
-  k = static_cast<int32_t> (p1 / m1);
-  p1 -= k * m1;
-  if (p1 < 0.0)
-    {
-      p1 += m1;
-    }
-  m_currentState[0] = m_currentState[1]; m_currentState[1] = m_currentState[2]; m_currentState[2] = p1;
-
-  /* Component 2 */
-  p2 = a21 * m_currentState[5] - a23n * m_currentState[3];
-  k = static_cast<int32_t> (p2 / m2);
-  p2 -= k * m2;
-  if (p2 < 0.0)
-    {
-      p2 += m2;
-    }
-  m_currentState[3] = m_currentState[4]; m_currentState[4] = m_currentState[5]; m_currentState[5] = p2;
-
-  /* Combination */
-  u = ((p1 > p2) ? (p1 - p2) * norm : (p1 - p2 + m1) * norm);
-
-  return u;
-}
-
 RngStream::RngStream (uint32_t seedNumber, uint64_t stream, uint64_t substream)
 {
   if (seedNumber >= m1 || seedNumber >= m2 || seedNumber == 0)
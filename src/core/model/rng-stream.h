@@ -43,8 +43,10 @@ public:
   /**
    * Generate the next random number for this stream.
    * Uniformly distributed between 0 and 1.
+   *
+   * Inlined, as it is drawn once per packet by some models.
    */
-  double RandU01 (void);
+  inline double RandU01 (void);
 
 private:
   void AdvanceNthBy (uint64_t nth, int by, double state[6]);
@@ -52,6 +54,45 @@ private:
   double m_currentState[6];
 };
 
+double
+RngStream::RandU01 (void)
+{
+  const double m1 = 4294967087.0;
+  const double m2 = 4294944443.0;
+  const double norm = 1.0 / (m1 + 1.0);
+  const double a12 = 1403580.0;
+  const double a13n = 810728.0;
+  const double a21 = 527612.0;
+  const double a23n = 1370589.0;
+  int32_t k;
+  double p1, p2, u;
+
+  /* Component 1 */
+  p1 = a12 * m_currentState[1] - a13n * m_currentState[0];
+  k = static_cast<int32_t> (p1 / m1);
+  p1 -= k * m1;
+  if (p1 < 0.0)
+    {
+      p1 += m1;
+    }
+  m_currentState[0] = m_currentState[1]; m_currentState[1] = m_currentState[2]; m_currentState[2] = p1;
+
+  /* Component 2 */
+  p2 = a21 * m_currentState[5] - a23n * m_currentState[3];
+  k = static_cast<int32_t> (p2 / m2);
+  p2 -= k * m2;
+  if (p2 < 0.0)
+    {
+      p2 += m2;
+    }
+  m_currentState[3] = m_currentState[4]; m_currentState[4] = m_currentState[5]; m_currentState[5] = p2;
+
+  /* Combination */
+  u = ((p1 > p2) ? (p1 - p2) * norm : (p1 - p2 + m1) * norm);
+
+  return u;
+}
+
 } // namespace ns3
 
 #endif
@@ -0,0 +1,34 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+#ifndef NS3_THREAD_LOCAL_H
+#define NS3_THREAD_LOCAL_H
+
+/**
+ * \ingroup core
+ *
+ * Storage class of variables that have one instance per thread, for the
+ * caches (free lists, counters) that the event and packet code keeps in
+ * globals and that must not be shared by the threads of a multithreaded
+ * simulator. Only plain types and pointers may be declared this way, and
+ * they are zero-initialized in every new thread.
+ */
+#if defined (_MSC_VER)
+#define NS_THREAD_LOCAL __declspec (thread)
+#else
+#define NS_THREAD_LOCAL __thread
+#endif
+
+#endif /* NS3_THREAD_LOCAL_H */
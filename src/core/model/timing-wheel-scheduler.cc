@@ -0,0 +1,271 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#include "timing-wheel-scheduler.h"
+#include "event-impl.h"
+#include "uinteger.h"
+#include "assert.h"
+#include "log.h"
+#include <algorithm>
+
+namespace ns3 {
+
+NS_LOG_COMPONENT_DEFINE ("TimingWheelScheduler");
+
+NS_OBJECT_ENSURE_REGISTERED (TimingWheelScheduler);
+
+namespace {
+
+// index of the lowest set bit of a non-zero word (de Bruijn multiplication,
+// so that we do not depend on compiler builtins)
+inline uint32_t
+LowestBit (uint64_t x)
+{
+  static const uint8_t table[64] = {
+    0, 1, 48, 2, 57, 49, 28, 3, 61, 58, 50, 42, 38, 29, 17, 4,
+    62, 55, 59, 36, 53, 51, 43, 22, 45, 39, 33, 30, 24, 18, 12, 5,
+    63, 47, 56, 27, 60, 41, 37, 16, 54, 35, 52, 21, 44, 32, 23, 11,
+    46, 26, 40, 15, 34, 20, 31, 10, 25, 14, 19, 9, 13, 8, 7, 6
+  };
+  return table[((x & (~x + 1)) * 0x03f79d71b4cb0a89ULL) >> 58];
+}
+
+} // anonymous namespace
+
+TypeId
+TimingWheelScheduler::GetTypeId (void)
+{
+  static TypeId tid = TypeId ("ns3::TimingWheelScheduler")
+    .SetParent<Scheduler> ()
+    .AddConstructor<TimingWheelScheduler> ()
+    .AddAttribute ("SlotWidth",
+                   "The time covered by one slot of the wheel. Rounded down to a power of two of the time resolution.",
+                   TimeValue (NanoSeconds (64)),
+                   MakeTimeAccessor (&TimingWheelScheduler::m_slotWidth),
+                   MakeTimeChecker ())
+    .AddAttribute ("Slots",
+                   "The number of slots of the wheel. Rounded up to a power of two, at least 64. "
+                   "Events further than Slots*SlotWidth in the future wait in an overflow heap.",
+                   UintegerValue (4096),
+                   MakeUintegerAccessor (&TimingWheelScheduler::m_nSlots),
+                   MakeUintegerChecker<uint32_t> (1))
+  ;
+  return tid;
+}
+
+TimingWheelScheduler::TimingWheelScheduler ()
+  : m_nSlots (0),
+    m_shift (0),
+    m_mask (0),
+    m_slots (0),
+    m_cur (0),
+    m_wheelSize (0)
+{
+  NS_LOG_FUNCTION (this);
+}
+TimingWheelScheduler::~TimingWheelScheduler ()
+{
+  NS_LOG_FUNCTION (this);
+  delete [] m_slots;
+  m_slots = 0;
+}
+
+void
+TimingWheelScheduler::Init (void)
+{
+  NS_LOG_FUNCTION (this);
+  uint64_t width = m_slotWidth.GetTimeStep () > 0 ? m_slotWidth.GetTimeStep () : 1;
+  m_shift = 0;
+  while ((width >> (m_shift + 1)) != 0)
+    {
+      m_shift++;
+    }
+  uint32_t n = 64;
+  while (n < m_nSlots)
+    {
+      n <<= 1;
+    }
+  m_nSlots = n;
+  m_mask = n - 1;
+  m_slots = new std::vector<Event> [n];
+  m_bitmap.assign (n / 64, 0);
+  NS_LOG_LOGIC ("slots=" << m_nSlots << ", width=" << (1ULL << m_shift));
+}
+
+uint64_t
+TimingWheelScheduler::GetAbsSlot (uint64_t ts) const
+{
+  uint64_t abs = ts >> m_shift;
+  // only possible if an event is scheduled before the last removed one
+  return abs < m_cur ? m_cur : abs;
+}
+
+void
+TimingWheelScheduler::WheelInsert (uint64_t abs, const Event &ev)
+{
+  uint32_t index = abs & m_mask;
+  std::vector<Event> &slot = m_slots[index];
+  slot.push_back (ev);
+  std::push_heap (slot.begin (), slot.end (), Later ());
+  m_bitmap[index >> 6] |= 1ULL << (index & 63);
+  m_wheelSize++;
+}
+
+uint32_t
+TimingWheelScheduler::FindNextSlot (void) const
+{
+  NS_ASSERT (m_wheelSize != 0);
+  uint32_t start = m_cur & m_mask;
+  uint32_t nWords = m_bitmap.size ();
+  uint32_t word = start >> 6;
+  uint64_t bits = m_bitmap[word] & (~0ULL << (start & 63));
+  // the wheel only holds [m_cur, m_cur + m_nSlots), so the first set bit
+  // at or after start, wrapping around, is the earliest slot
+  for (uint32_t i = 1; bits == 0; i++)
+    {
+      NS_ASSERT (i <= nWords);
+      word = (word + 1) & (nWords - 1);
+      bits = m_bitmap[word];
+    }
+  return (word << 6) + LowestBit (bits);
+}
+
+void
+TimingWheelScheduler::Advance (uint64_t abs)
+{
+  m_cur = abs;
+  uint64_t end = m_cur + m_nSlots;
+  while (!m_overflow.empty () && (m_overflow.front ().key.m_ts >> m_shift) < end)
+    {
+      std::pop_heap (m_overflow.begin (), m_overflow.end (), Later ());
+      Event ev = m_overflow.back ();
+      m_overflow.pop_back ();
+      WheelInsert (GetAbsSlot (ev.key.m_ts), ev);
+    }
+}
+
+void
+TimingWheelScheduler::Insert (const Event &ev)
+{
+  NS_LOG_FUNCTION (this << ev.impl << ev.key.m_ts << ev.key.m_uid);
+  if (m_slots == 0)
+    {
+      Init ();
+    }
+  uint64_t abs = GetAbsSlot (ev.key.m_ts);
+  if (abs - m_cur < m_nSlots)
+    {
+      WheelInsert (abs, ev);
+    }
+  else
+    {
+      m_overflow.push_back (ev);
+      std::push_heap (m_overflow.begin (), m_overflow.end (), Later ());
+    }
+}
+
+bool
+TimingWheelScheduler::IsEmpty (void) const
+{
+  return m_wheelSize == 0 && m_overflow.empty ();
+}
+
+Scheduler::Event
+TimingWheelScheduler::PeekNext (void) const
+{
+  NS_LOG_FUNCTION (this);
+  NS_ASSERT (!IsEmpty ());
+  if (m_wheelSize == 0)
+    {
+      return m_overflow.front ();
+    }
+  return m_slots[FindNextSlot ()].front ();
+}
+
+Scheduler::Event
+TimingWheelScheduler::RemoveNext (void)
+{
+  NS_LOG_FUNCTION (this);
+  NS_ASSERT (!IsEmpty ());
+  if (m_wheelSize == 0)
+    {
+      std::pop_heap (m_overflow.begin (), m_overflow.end (), Later ());
+      Event ev = m_overflow.back ();
+      m_overflow.pop_back ();
+      Advance (ev.key.m_ts >> m_shift);
+      return ev;
+    }
+  uint32_t index = FindNextSlot ();
+  std::vector<Event> &slot = m_slots[index];
+  std::pop_heap (slot.begin (), slot.end (), Later ());
+  Event ev = slot.back ();
+  slot.pop_back ();
+  if (slot.empty ())
+    {
+      m_bitmap[index >> 6] &= ~(1ULL << (index & 63));
+    }
+  m_wheelSize--;
+  uint64_t abs = m_cur + ((index - m_cur) & m_mask);
+  if (abs != m_cur)
+    {
+      Advance (abs);
+    }
+  return ev;
+}
+
+void
+TimingWheelScheduler::Remove (const Event &ev)
+{
+  NS_LOG_FUNCTION (this << ev.impl << ev.key.m_ts << ev.key.m_uid);
+  NS_ASSERT (!IsEmpty ());
+  uint64_t abs = GetAbsSlot (ev.key.m_ts);
+  if (abs - m_cur < m_nSlots)
+    {
+      uint32_t index = abs & m_mask;
+      std::vector<Event> &slot = m_slots[index];
+      for (std::vector<Event>::iterator i = slot.begin (); i != slot.end (); ++i)
+        {
+          if (i->key.m_uid == ev.key.m_uid)
+            {
+              NS_ASSERT (i->impl == ev.impl);
+              slot.erase (i);
+              std::make_heap (slot.begin (), slot.end (), Later ());
+              if (slot.empty ())
+                {
+                  m_bitmap[index >> 6] &= ~(1ULL << (index & 63));
+                }
+              m_wheelSize--;
+              return;
+            }
+        }
+    }
+  else
+    {
+      for (std::vector<Event>::iterator i = m_overflow.begin (); i != m_overflow.end (); ++i)
+        {
+          if (i->key.m_uid == ev.key.m_uid)
+            {
+              NS_ASSERT (i->impl == ev.impl);
+              m_overflow.erase (i);
+              std::make_heap (m_overflow.begin (), m_overflow.end (), Later ());
+              return;
+            }
+        }
+    }
+  NS_ASSERT (false);
+}
+
+} // namespace ns3
@@ -0,0 +1,96 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#ifndef TIMING_WHEEL_SCHEDULER_H
+#define TIMING_WHEEL_SCHEDULER_H
+
+#include "scheduler.h"
+#include "nstime.h"
+#include <stdint.h>
+#include <vector>
+
+namespace ns3 {
+
+/**
+ * \ingroup scheduler
+ * \brief a timing wheel event scheduler with an overflow heap
+ *
+ * Packet-level datacenter simulations schedule almost all of their events
+ * a few link delays or serialization times into the future. This scheduler
+ * keeps the events that fall within a fixed window after the last removed
+ * event in a wheel of SlotWidth-wide slots; each slot is a small binary heap
+ * ordered by (timestamp, uid) and an occupancy bitmap is used to find the
+ * next non-empty slot. Events beyond the window (timers, application
+ * start/stop) go to an overflow heap and are moved into the wheel as the
+ * window advances over them.
+ *
+ * The slots keep their storage once it has been allocated, so after the
+ * first round of the wheel the steady state does not touch the system
+ * allocator.
+ *
+ * The ordering is exactly the one of the other schedulers, so a simulation
+ * produces the same results whichever scheduler is used. The wheel is
+ * allocated on the first Insert, after the attributes have been set.
+ */
+class TimingWheelScheduler : public Scheduler
+{
+public:
+  static TypeId GetTypeId (void);
+
+  TimingWheelScheduler ();
+  virtual ~TimingWheelScheduler ();
+
+  virtual void Insert (const Event &ev);
+  virtual bool IsEmpty (void) const;
+  virtual Event PeekNext (void) const;
+  virtual Event RemoveNext (void);
+  virtual void Remove (const Event &ev);
+
+private:
+  // orders a heap so that the earliest event is at the front
+  struct Later
+  {
+    bool operator () (const Event &a, const Event &b) const
+    {
+      return b.key < a.key;
+    }
+  };
+
+  void Init (void);
+  void WheelInsert (uint64_t abs, const Event &ev);
+  uint32_t FindNextSlot (void) const;
+  void Advance (uint64_t abs);
+  inline uint64_t GetAbsSlot (uint64_t ts) const;
+
+  Time m_slotWidth;
+  uint32_t m_nSlots;
+
+  uint32_t m_shift;
+  uint32_t m_mask;
+  std::vector<Event> *m_slots;
+  // one bit per slot, set when the slot is not empty
+  std::vector<uint64_t> m_bitmap;
+  // absolute slot (ts >> m_shift) of the last removed event
+  uint64_t m_cur;
+  // number of events in the wheel, not counting the overflow heap
+  uint32_t m_wheelSize;
+  // events at or beyond m_cur + m_nSlots
+  std::vector<Event> m_overflow;
+};
+
+} // namespace ns3
+
+#endif /* TIMING_WHEEL_SCHEDULER_H */
@@ -23,6 +23,9 @@
 #include "ns3/heap-scheduler.h"
 #include "ns3/map-scheduler.h"
 #include "ns3/calendar-scheduler.h"
+#include "ns3/timing-wheel-scheduler.h"
+#include "ns3/nstime.h"
+#include "ns3/uinteger.h"
 
 namespace ns3 {
 
@@ -459,6 +462,31 @@ SimulatorTemplateTestCase::DoRun (void)
   Simulator::Destroy ();
 }
 
+class SimulatorEventPoolTestCase : public TestCase
+{
+public:
+  SimulatorEventPoolTestCase ();
+  virtual void DoRun (void);
+  void Foo (uint64_t a, uint64_t b) {}
+};
+
+SimulatorEventPoolTestCase::SimulatorEventPoolTestCase ()
+  : TestCase ("Check that the memory of freed events is reused")
+{
+}
+void
+SimulatorEventPoolTestCase::DoRun (void)
+{
+  EventImpl *a = MakeEvent (&SimulatorEventPoolTestCase::Foo, this, 1, 2);
+  a->Unref ();
+  EventImpl *b = MakeEvent (&SimulatorEventPoolTestCase::Foo, this, 3, 4);
+  NS_TEST_EXPECT_MSG_EQ (b, a, "event of the same size was not taken from the free list");
+  EventImpl *c = MakeEvent (&SimulatorEventPoolTestCase::Foo, this, 5, 6);
+  NS_TEST_EXPECT_MSG_NE (c, b, "live event handed out twice");
+  b->Unref ();
+  c->Unref ();
+}
+
 class SimulatorTestSuite : public TestSuite
 {
 public:
@@ -475,6 +503,13 @@ public:
     AddTestCase (new SimulatorEventsTestCase (factory));
     factory.SetTypeId (CalendarScheduler::GetTypeId ());
     AddTestCase (new SimulatorEventsTestCase (factory));
+    factory.SetTypeId (TimingWheelScheduler::GetTypeId ());
+    AddTestCase (new SimulatorEventsTestCase (factory));
+    // a tiny wheel, so that most events go through the overflow heap
+    factory.Set ("SlotWidth", TimeValue (MicroSeconds (1)));
+    factory.Set ("Slots", UintegerValue (64));
+    AddTestCase (new SimulatorEventsTestCase (factory));
+    AddTestCase (new SimulatorEventPoolTestCase ());
   }
 } g_simulatorTestSuite;
 
@@ -30,6 +30,7 @@
 #include <time.h>
 #include <list>
 #include <utility>
+#include <vector>
 
 namespace ns3 {
 
@@ -225,6 +226,58 @@ ThreadedSimulatorEventsTestCase::DoRun (void)
   NS_TEST_EXPECT_MSG_EQ (m_a, m_d, "Bad scheduling");
 }
 
+/*
+ * Events freed by another thread than the one that allocated them, as the
+ * events sent between the partitions of a MultithreadedSimulatorImpl are,
+ * go back to the pool of the thread that allocated them.
+ */
+class ThreadedEventPoolTestCase : public TestCase
+{
+public:
+  ThreadedEventPoolTestCase ();
+  virtual void DoRun (void);
+  void Foo (uint64_t a, uint64_t b) {}
+  void Free (void);
+
+private:
+  EventImpl *m_event;
+};
+
+ThreadedEventPoolTestCase::ThreadedEventPoolTestCase ()
+  : TestCase ("Check that an event freed by another thread returns to its owner")
+{
+}
+
+void
+ThreadedEventPoolTestCase::Free (void)
+{
+  m_event->Unref ();
+}
+
+void
+ThreadedEventPoolTestCase::DoRun (void)
+{
+  m_event = MakeEvent (&ThreadedEventPoolTestCase::Foo, this, 1, 2);
+  EventImpl *freed = m_event;
+  Ptr<SystemThread> thread = Create<SystemThread> (MakeCallback (&ThreadedEventPoolTestCase::Free, this));
+  thread->Start ();
+  thread->Join ();
+
+  // the free list of this thread runs out before the freed event comes back
+  std::vector<EventImpl *> events;
+  bool found = false;
+  while (!found && events.size () < 1000000)
+    {
+      events.push_back (MakeEvent (&ThreadedEventPoolTestCase::Foo, this, 3, 4));
+      found = events.back () == freed;
+    }
+  NS_TEST_EXPECT_MSG_EQ (found, true, "event freed by another thread was not reused by its owner");
+  for (uint32_t i = 0; i < events.size (); i++)
+    {
+      events[i]->Unref ();
+    }
+}
+
 class ThreadedSimulatorTestSuite : public TestSuite
 {
 public:
@@ -262,6 +315,7 @@ public:
               }
           }
       }
+    AddTestCase (new ThreadedEventPoolTestCase ());
   }
 } g_threadedSimulatorTestSuite;
 
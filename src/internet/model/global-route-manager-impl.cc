@@ -699,8 +699,9 @@ GlobalRouteManagerImpl::InitializeRoutes ()
       Ptr<GlobalRouter> rtr = 
         node->GetObject<GlobalRouter> ();
 
-      // Ignore nodes that are not assigned to our systemId (distributed sim)
-      if (node->GetSystemId () != MpiInterface::GetSystemId ()) 
+      // Ignore nodes that are not assigned to our systemId (distributed sim);
+      // without MPI, the system ids are the partitions of a multithreaded run
+      if (MpiInterface::IsEnabled () && node->GetSystemId () != MpiInterface::GetSystemId ())
         {
           continue;
         }
@@ -28,6 +28,9 @@
 #include "ns3/ipv4-route.h"
 #include "ns3/ipv4-routing-table-entry.h"
 #include "ns3/boolean.h"
+#include "ns3/enum.h"
+#include "ns3/uinteger.h"
+#include "ns3/node.h"
 #include "ns3/udp-header.h"
 #include "ns3/tcp-header.h"
 #include "ns3/seq-ts-header.h"
@@ -45,6 +48,57 @@ NS_OBJECT_ENSURE_REGISTERED (Ipv4GlobalRouting);
 const uint8_t TCP_PROT_NUMBER = 6;
 const uint8_t UDP_PROT_NUMBER = 17;
 
+namespace {
+
+struct Crc32Table
+{
+  Crc32Table ()
+  {
+    for (uint32_t i = 0; i < 256; i++)
+      {
+        uint32_t c = i;
+        for (int k = 0; k < 8; k++)
+          {
+            c = (c & 1) ? 0xEDB88320 ^ (c >> 1) : c >> 1;
+          }
+        entry[i] = c;
+      }
+  }
+  uint32_t entry[256];
+};
+
+// CRC-32 (IEEE 802.3, reflected), the usual basis of switch ECMP hashes
+uint32_t
+Crc32 (const char *buffer, const size_t size)
+{
+  // a local static is initialized once even if several simulation
+  // threads hash their first packet at the same time
+  static const Crc32Table table;
+  uint32_t crc = 0xffffffff;
+  for (size_t i = 0; i < size; i++)
+    {
+      crc = table.entry[(crc ^ (uint8_t)buffer[i]) & 0xff] ^ (crc >> 8);
+    }
+  return crc ^ 0xffffffff;
+}
+
+void
+WriteU32 (char *buf, uint32_t v)
+{
+  buf[0] = v >> 24;
+  buf[1] = v >> 16;
+  buf[2] = v >> 8;
+  buf[3] = v;
+}
+
+uint16_t
+ReadU16 (const uint8_t *buf)
+{
+  return (buf[0] << 8) | buf[1];
+}
+
+} // anonymous namespace
+
 TypeId 
 Ipv4GlobalRouting::GetTypeId (void)
 { 
@@ -60,6 +114,19 @@ Ipv4GlobalRouting::GetTypeId (void)
 					BooleanValue (false),
 					MakeBooleanAccessor (&Ipv4GlobalRouting::m_flowEcmpRouting),
 					MakeBooleanChecker ())
+    .AddAttribute ("EcmpHash",
+                   "The hash mapping flows to equal-cost routes when FlowEcmpRouting is set",
+                   EnumValue (ECMP_XOR),
+                   MakeEnumAccessor (&Ipv4GlobalRouting::m_ecmpHash),
+                   MakeEnumChecker (ECMP_XOR, "Xor",
+                                    ECMP_MURMUR3, "Murmur3",
+                                    ECMP_FNV1A, "Fnv1a",
+                                    ECMP_CRC32, "Crc32"))
+    .AddAttribute ("EcmpHashSeed",
+                   "Seed of the ECMP hash, combined with the node id; not used by the Xor hash",
+                   UintegerValue (0),
+                   MakeUintegerAccessor (&Ipv4GlobalRouting::m_ecmpSeed),
+                   MakeUintegerChecker<uint32_t> ())
     .AddAttribute ("RespondToInterfaceEvents",
                    "Set to true if you want to dynamically recompute the global routes upon Interface notification events (up/down, or add/remove address)",
                    BooleanValue (false),
@@ -72,7 +139,14 @@ Ipv4GlobalRouting::GetTypeId (void)
 Ipv4GlobalRouting::Ipv4GlobalRouting () 
   : m_randomEcmpRouting (false),
     m_flowEcmpRouting (false),
-    m_respondToInterfaceEvents (false)
+    m_respondToInterfaceEvents (false),
+    m_ecmpHash (ECMP_XOR),
+    m_ecmpSeed (0),
+    m_murmur3 (Create<Hash::Function::Murmur3> ()),
+    m_fnv1a (Create<Hash::Function::Fnv1a> ()),
+    m_crc32 (Create<Hash::Function::Hash32> (&Crc32)),
+    m_nodeId (0),
+    m_nodeIdValid (false)
 {
   NS_LOG_FUNCTION_NOARGS ();
 
@@ -93,6 +167,7 @@ Ipv4GlobalRouting::AddHostRouteTo (Ipv4Address dest,
   Ipv4RoutingTableEntry *route = new Ipv4RoutingTableEntry ();
   *route = Ipv4RoutingTableEntry::CreateHostRouteTo (dest, nextHop, interface);
   m_hostRoutes.push_back (route);
+  InvalidateFib ();
 }
 
 void 
@@ -103,6 +178,7 @@ Ipv4GlobalRouting::AddHostRouteTo (Ipv4Address dest,
   Ipv4RoutingTableEntry *route = new Ipv4RoutingTableEntry ();
   *route = Ipv4RoutingTableEntry::CreateHostRouteTo (dest, interface);
   m_hostRoutes.push_back (route);
+  InvalidateFib ();
 }
 
 void 
@@ -118,6 +194,7 @@ Ipv4GlobalRouting::AddNetworkRouteTo (Ipv4Address network,
                                                         nextHop,
                                                         interface);
   m_networkRoutes.push_back (route);
+  InvalidateFib ();
 }
 
 void 
@@ -131,6 +208,7 @@ Ipv4GlobalRouting::AddNetworkRouteTo (Ipv4Address network,
                                                         networkMask,
                                                         interface);
   m_networkRoutes.push_back (route);
+  InvalidateFib ();
 }
 
 void 
@@ -146,6 +224,7 @@ Ipv4GlobalRouting::AddASExternalRouteTo (Ipv4Address network,
                                                         nextHop,
                                                         interface);
   m_ASexternalRoutes.push_back (route);
+  InvalidateFib ();
 }
 
 
@@ -153,40 +232,42 @@ Ipv4GlobalRouting::AddASExternalRouteTo (Ipv4Address network,
 // cost paths, by calculating an integer based on the five-tuple in the headers
 //
 // It assumes that if a transport protocol value is specified in the header, 
-// that a transport header with port numbers is prepended to the ipPayload 
+// that a transport header with port numbers is prepended to the ipPayload.
+// The ports (and for UDP the PG of the SeqTsHeader that follows) are read
+// from the packet bytes, so the packet is neither copied nor deserialized.
 //
 uint32_t
 Ipv4GlobalRouting::GetTupleValue (const Ipv4Header &header, Ptr<const Packet> ipPayload)
 {
-	// We do not care if this value rolls over
-	uint32_t tupleValue = (header.GetSource ().Get ()*59) ^ header.GetDestination ().Get () ^ header.GetProtocol ();
+	uint16_t sport = 0, dport = 0, pg = 0;
 	switch (header.GetProtocol ())
 	{
 		case UDP_PROT_NUMBER:
 			{
-				UdpHeader udpHeader;
-				Ptr<Packet> p = ipPayload->Copy();
-				p->RemoveHeader(udpHeader);
-				SeqTsHeader seqh;
-				p->RemoveHeader(seqh);
-				//ipPayload->PeekHeader (udpHeader);
-				NS_LOG_DEBUG ("Found UDP proto and header: " << 
-					udpHeader.GetSourcePort () << ":" <<  
-					udpHeader.GetDestinationPort ());
-				tupleValue ^= (udpHeader.GetSourcePort ()<<16);
-				tupleValue ^= udpHeader.GetDestinationPort ();
-				tupleValue ^= seqh.GetPG();
+				// UdpHeader (8) + SeqTsHeader: seq (4), ts (8), pg (2)
+				uint8_t buf[8 + 14];
+				uint32_t len = ipPayload->CopyData (buf, sizeof (buf));
+				if (len >= 4)
+					{
+						sport = ReadU16 (buf);
+						dport = ReadU16 (buf + 2);
+					}
+				if (len >= 8 + 14)
+					{
+						pg = ReadU16 (buf + 8 + 12);
+					}
+				NS_LOG_DEBUG ("Found UDP proto and header: " << sport << ":" << dport);
 				break;
 			}
 		case TCP_PROT_NUMBER:
 			{
-				TcpHeader tcpHeader;
-				ipPayload->PeekHeader (tcpHeader);
-				NS_LOG_DEBUG ("Found TCP proto and header: " << 
-					tcpHeader.GetSourcePort () << ":" <<  
-					tcpHeader.GetDestinationPort ());
-				tupleValue ^= (tcpHeader.GetSourcePort ()<<16);
-				tupleValue ^= tcpHeader.GetDestinationPort ();
+				uint8_t buf[4];
+				if (ipPayload->CopyData (buf, sizeof (buf)) == sizeof (buf))
+					{
+						sport = ReadU16 (buf);
+						dport = ReadU16 (buf + 2);
+					}
+				NS_LOG_DEBUG ("Found TCP proto and header: " << sport << ":" << dport);
 				break;
 			}
 		default:
@@ -195,31 +276,65 @@ Ipv4GlobalRouting::GetTupleValue (const Ipv4Header &header, Ptr<const Packet> ip
 				break;
 			}
 	}
-	return tupleValue;
+	if (m_ecmpHash == ECMP_XOR)
+	{
+		// We do not care if this value rolls over
+		uint32_t tupleValue = (header.GetSource ().Get ()*59) ^ header.GetDestination ().Get () ^ header.GetProtocol ();
+		return tupleValue ^ (sport<<16) ^ dport ^ pg;
+	}
+	uint32_t seed = GetNodeSeed ();
+	char key[4 + 4 + 4 + 1 + 2 + 2 + 2];
+	WriteU32 (key, seed);
+	WriteU32 (key + 4, header.GetSource ().Get ());
+	WriteU32 (key + 8, header.GetDestination ().Get ());
+	key[12] = header.GetProtocol ();
+	key[13] = sport >> 8;
+	key[14] = sport;
+	key[15] = dport >> 8;
+	key[16] = dport;
+	key[17] = pg >> 8;
+	key[18] = pg;
+	switch (m_ecmpHash)
+	{
+		case ECMP_MURMUR3:
+			return m_murmur3.clear ().GetHash32 (key, sizeof (key));
+		case ECMP_FNV1A:
+			return m_fnv1a.clear ().GetHash32 (key, sizeof (key));
+		default:
+			{
+				// a CRC is linear, so a seed hashed along with the key would only
+				// XOR a constant into the result; like switch ASICs, select
+				// different result bits instead
+				uint32_t h = m_crc32.clear ().GetHash32 (key + 4, sizeof (key) - 4);
+				uint32_t r = seed % 32;
+				return r == 0 ? h : (h >> r) | (h << (32 - r));
+			}
+	}
 }
 
-Ptr<Ipv4Route>
-// - Ipv4GlobalRouting::LookupGlobal (Ipv4Address dest, Ptr<NetDevice> oif)
-Ipv4GlobalRouting::LookupGlobal (const Ipv4Header &header, Ptr<const Packet> ipPayload, Ptr<NetDevice> oif)
+uint32_t
+Ipv4GlobalRouting::GetNodeSeed (void)
 {
-  NS_LOG_FUNCTION_NOARGS ();
-  // - NS_LOG_LOGIC ("Looking for route for destination " << dest);
-  NS_ABORT_MSG_IF (m_randomEcmpRouting && m_flowEcmpRouting, "Ecmp mode selection");
-  NS_LOG_LOGIC ("Looking for route for destination " << header.GetDestination());
-  
-  Ptr<Ipv4Route> rtentry = 0;
-  // store all available routes that bring packets to their destination
-  typedef std::vector<Ipv4RoutingTableEntry*> RouteVec_t;
-  RouteVec_t allRoutes;
+  if (!m_nodeIdValid)
+    {
+      Ptr<Node> node = m_ipv4->GetObject<Node> ();
+      m_nodeId = node != 0 ? node->GetId () : 0;
+      m_nodeIdValid = true;
+    }
+  return m_ecmpSeed ^ (m_nodeId * 0x9e3779b9);
+}
 
+void
+Ipv4GlobalRouting::CollectRoutes (Ipv4Address dest, Ptr<NetDevice> oif, RouteVec &allRoutes) const
+{
+  NS_LOG_FUNCTION (this << dest << oif);
   NS_LOG_LOGIC ("Number of m_hostRoutes = " << m_hostRoutes.size ());
   for (HostRoutesCI i = m_hostRoutes.begin (); 
        i != m_hostRoutes.end (); 
        i++) 
     {
       NS_ASSERT ((*i)->IsHost ());
-      // - if ((*i)->GetDest ().IsEqual (dest)) 
-	  if ((*i)->GetDest ().IsEqual (header.GetDestination ()))
+      if ((*i)->GetDest ().IsEqual (dest))
         {
           if (oif != 0)
             {
@@ -236,14 +351,13 @@ Ipv4GlobalRouting::LookupGlobal (const Ipv4Header &header, Ptr<const Packet> ipP
   if (allRoutes.size () == 0) // if no host route is found
     {
       NS_LOG_LOGIC ("Number of m_networkRoutes" << m_networkRoutes.size ());
-      for (NetworkRoutesI j = m_networkRoutes.begin (); 
+      for (NetworkRoutesCI j = m_networkRoutes.begin (); 
            j != m_networkRoutes.end (); 
            j++) 
         {
           Ipv4Mask mask = (*j)->GetDestNetworkMask ();
           Ipv4Address entry = (*j)->GetDestNetwork ();
-          // - if (mask.IsMatch (dest, entry)) 
-		  if (mask.IsMatch (header.GetDestination (), entry))
+          if (mask.IsMatch (dest, entry))
             {
               if (oif != 0)
                 {
@@ -260,14 +374,13 @@ Ipv4GlobalRouting::LookupGlobal (const Ipv4Header &header, Ptr<const Packet> ipP
     }
   if (allRoutes.size () == 0)  // consider external if no host/network found
     {
-      for (ASExternalRoutesI k = m_ASexternalRoutes.begin ();
+      for (ASExternalRoutesCI k = m_ASexternalRoutes.begin ();
            k != m_ASexternalRoutes.end ();
            k++)
         {
           Ipv4Mask mask = (*k)->GetDestNetworkMask ();
           Ipv4Address entry = (*k)->GetDestNetwork ();
-          //if (mask.IsMatch (dest, entry))
-		  if (mask.IsMatch (header.GetDestination (), entry))
+          if (mask.IsMatch (dest, entry))
             {
               NS_LOG_LOGIC ("Found external route" << *k);
               if (oif != 0)
@@ -283,7 +396,97 @@ Ipv4GlobalRouting::LookupGlobal (const Ipv4Header &header, Ptr<const Packet> ipP
             }
         }
     }
-  if (allRoutes.size () > 0 ) // if route(s) is found
+}
+
+Ptr<Ipv4Route>
+Ipv4GlobalRouting::InternRoute (Ipv4RoutingTableEntry *route)
+{
+  std::map<Ipv4RoutingTableEntry *, Ptr<Ipv4Route> >::iterator it = m_fibRoutes.find (route);
+  if (it != m_fibRoutes.end ())
+    {
+      return it->second;
+    }
+  // create a Ipv4Route object from the routing table entry
+  Ptr<Ipv4Route> rtentry = Create<Ipv4Route> ();
+  rtentry->SetDestination (route->GetDest ());
+  // XXX handle multi-address case
+  rtentry->SetSource (m_ipv4->GetAddress (route->GetInterface (), 0).GetLocal ());
+  rtentry->SetGateway (route->GetGateway ());
+  uint32_t interfaceIdx = route->GetInterface ();
+  rtentry->SetOutputDevice (m_ipv4->GetNetDevice (interfaceIdx));
+  m_fibRoutes[route] = rtentry;
+  return rtentry;
+}
+
+uint32_t
+Ipv4GlobalRouting::LookupFib (Ipv4Address dest)
+{
+  FibCI it = m_fib.find (dest);
+  if (it != m_fib.end ())
+    {
+      return it->second;
+    }
+  RouteVec allRoutes;
+  CollectRoutes (dest, 0, allRoutes);
+  uint32_t group;
+  std::map<RouteVec, uint32_t>::const_iterator g = m_fibGroupIndex.find (allRoutes);
+  if (g != m_fibGroupIndex.end ())
+    {
+      group = g->second;
+    }
+  else
+    {
+      group = m_fibGroups.size ();
+      m_fibGroups.push_back (RouteGroup ());
+      for (uint32_t i = 0; i < allRoutes.size (); i++)
+        {
+          m_fibGroups.back ().push_back (InternRoute (allRoutes[i]));
+        }
+      m_fibGroupIndex[allRoutes] = group;
+    }
+  NS_LOG_LOGIC ("Compiled " << m_fibGroups[group].size () << " routes to " << dest);
+  m_fib[dest] = group;
+  return group;
+}
+
+void
+Ipv4GlobalRouting::InvalidateFib (void)
+{
+  m_fib.clear ();
+  m_fibGroups.clear ();
+  m_fibGroupIndex.clear ();
+  m_fibRoutes.clear ();
+}
+
+Ptr<Ipv4Route>
+// - Ipv4GlobalRouting::LookupGlobal (Ipv4Address dest, Ptr<NetDevice> oif)
+Ipv4GlobalRouting::LookupGlobal (const Ipv4Header &header, Ptr<const Packet> ipPayload, Ptr<NetDevice> oif)
+{
+  NS_LOG_FUNCTION_NOARGS ();
+  // - NS_LOG_LOGIC ("Looking for route for destination " << dest);
+  NS_ABORT_MSG_IF (m_randomEcmpRouting && m_flowEcmpRouting, "Ecmp mode selection");
+  NS_LOG_LOGIC ("Looking for route for destination " << header.GetDestination());
+
+  // forwarding never restricts the output device and goes through the
+  // compiled table; locally originated packets bound to a device walk the
+  // route lists
+  const RouteGroup *routes;
+  RouteGroup oifRoutes;
+  if (oif == 0)
+    {
+      routes = &m_fibGroups[LookupFib (header.GetDestination ())];
+    }
+  else
+    {
+      RouteVec allRoutes;
+      CollectRoutes (header.GetDestination (), oif, allRoutes);
+      for (uint32_t i = 0; i < allRoutes.size (); i++)
+        {
+          oifRoutes.push_back (InternRoute (allRoutes[i]));
+        }
+      routes = &oifRoutes;
+    }
+  if (routes->size () > 0 ) // if route(s) is found
     {
 		// select one of the routes uniformly at random if random
 		// ECMP routing is enabled, or map a flow consistently to a route
@@ -292,26 +495,17 @@ Ipv4GlobalRouting::LookupGlobal (const Ipv4Header &header, Ptr<const Packet> ipP
       uint32_t selectIndex;
       if (m_randomEcmpRouting)
         {
-          selectIndex = m_rand->GetInteger (0, allRoutes.size ()-1);
+          selectIndex = m_rand->GetInteger (0, routes->size ()-1);
         }
-	  else  if (m_flowEcmpRouting && (allRoutes.size () > 1))
+	  else  if (m_flowEcmpRouting && (routes->size () > 1))
 		{
-			selectIndex = GetTupleValue (header, ipPayload) % allRoutes.size ();
+			selectIndex = GetTupleValue (header, ipPayload) % routes->size ();
 		}
       else 
         {
           selectIndex = 0;
         }
-      Ipv4RoutingTableEntry* route = allRoutes.at (selectIndex); 
-      // create a Ipv4Route object from the selected routing table entry
-      rtentry = Create<Ipv4Route> ();
-      rtentry->SetDestination (route->GetDest ());
-      // XXX handle multi-address case
-      rtentry->SetSource (m_ipv4->GetAddress (route->GetInterface (), 0).GetLocal ());
-      rtentry->SetGateway (route->GetGateway ());
-      uint32_t interfaceIdx = route->GetInterface ();
-      rtentry->SetOutputDevice (m_ipv4->GetNetDevice (interfaceIdx));
-      return rtentry;
+      return routes->at (selectIndex);
     }
   else 
     {
@@ -383,6 +577,7 @@ void
 Ipv4GlobalRouting::RemoveRoute (uint32_t index)
 {
   NS_LOG_FUNCTION (index);
+  InvalidateFib ();
   if (index < m_hostRoutes.size ())
     {
       uint32_t tmp = 0;
@@ -448,6 +643,7 @@ void
 Ipv4GlobalRouting::DoDispose (void)
 {
   NS_LOG_FUNCTION_NOARGS ();
+  InvalidateFib ();
   for (HostRoutesI i = m_hostRoutes.begin (); 
        i != m_hostRoutes.end (); 
        i = m_hostRoutes.erase (i)) 
@@ -633,6 +829,7 @@ void
 Ipv4GlobalRouting::NotifyInterfaceUp (uint32_t i)
 {
   NS_LOG_FUNCTION (this << i);
+  InvalidateFib (); // the route sources depend on the addresses
   if (m_respondToInterfaceEvents && Simulator::Now ().GetSeconds () > 0)  // avoid startup events
     {
       GlobalRouteManager::DeleteGlobalRoutes ();
@@ -645,6 +842,7 @@ void
 Ipv4GlobalRouting::NotifyInterfaceDown (uint32_t i)
 {
   NS_LOG_FUNCTION (this << i);
+  InvalidateFib ();
   if (m_respondToInterfaceEvents && Simulator::Now ().GetSeconds () > 0)  // avoid startup events
     {
       GlobalRouteManager::DeleteGlobalRoutes ();
@@ -657,6 +855,7 @@ void
 Ipv4GlobalRouting::NotifyAddAddress (uint32_t interface, Ipv4InterfaceAddress address)
 {
   NS_LOG_FUNCTION (this << interface << address);
+  InvalidateFib ();
   if (m_respondToInterfaceEvents && Simulator::Now ().GetSeconds () > 0)  // avoid startup events
     {
       GlobalRouteManager::DeleteGlobalRoutes ();
@@ -669,6 +868,7 @@ void
 Ipv4GlobalRouting::NotifyRemoveAddress (uint32_t interface, Ipv4InterfaceAddress address)
 {
   NS_LOG_FUNCTION (this << interface << address);
+  InvalidateFib ();
   if (m_respondToInterfaceEvents && Simulator::Now ().GetSeconds () > 0)  // avoid startup events
     {
       GlobalRouteManager::DeleteGlobalRoutes ();
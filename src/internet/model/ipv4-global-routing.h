@@ -21,13 +21,17 @@
 #define IPV4_GLOBAL_ROUTING_H
 
 #include <list>
+#include <map>
+#include <vector>
 #include <stdint.h>
 #include "ns3/ipv4-address.h"
+#include "ns3/sgi-hashmap.h"
 #include "ns3/ipv4-header.h"
 #include "ns3/ptr.h"
 #include "ns3/ipv4.h"
 #include "ns3/ipv4-routing-protocol.h"
 #include "ns3/random-variable-stream.h"
+#include "ns3/hash.h"
 
 namespace ns3 {
 
@@ -70,6 +74,19 @@ class Ipv4GlobalRouting : public Ipv4RoutingProtocol
 {
 public:
   static TypeId GetTypeId (void);
+
+  /**
+   * The hash mapping a flow to one of its equal-cost routes when
+   * FlowEcmpRouting is set.
+   */
+  enum EcmpHash
+  {
+    ECMP_XOR,           //!< XOR of the addresses, protocol, ports and PG
+    ECMP_MURMUR3,       //!< Murmur3 of the seed and the same fields
+    ECMP_FNV1A,         //!< FNV-1a of the seed and the same fields
+    ECMP_CRC32          //!< CRC-32 of the fields, rotated by the seed like a switch hash offset
+  };
+
 /**
  * \brief Construct an empty Ipv4GlobalRouting routing protocol,
  *
@@ -233,6 +250,13 @@ private:
   bool m_respondToInterfaceEvents;
   /// A uniform random number generator for randomly routing packets among ECMP 
   Ptr<UniformRandomVariable> m_rand;
+  /// The hash used by flow ECMP routing
+  EcmpHash m_ecmpHash;
+  /// Seed of the flow hash, combined with the node id so that every switch hashes differently
+  uint32_t m_ecmpSeed;
+  Hasher m_murmur3;
+  Hasher m_fnv1a;
+  Hasher m_crc32;
 
   typedef std::list<Ipv4RoutingTableEntry *> HostRoutes;
   typedef std::list<Ipv4RoutingTableEntry *>::const_iterator HostRoutesCI;
@@ -244,16 +268,52 @@ private:
   typedef std::list<Ipv4RoutingTableEntry *>::const_iterator ASExternalRoutesCI;
   typedef std::list<Ipv4RoutingTableEntry *>::iterator ASExternalRoutesI;
 
+  typedef std::vector<Ipv4RoutingTableEntry *> RouteVec;
+  /// The routes to a destination, in the order LookupGlobal selects among them
+  typedef std::vector<Ptr<Ipv4Route> > RouteGroup;
+  typedef sgi::hash_map<Ipv4Address, uint32_t, Ipv4AddressHash> Fib;
+  typedef sgi::hash_map<Ipv4Address, uint32_t, Ipv4AddressHash>::const_iterator FibCI;
+
   // - Ptr<Ipv4Route> LookupGlobal (Ipv4Address dest, Ptr<NetDevice> oif = 0);
   uint32_t GetTupleValue (const Ipv4Header &header, Ptr<const Packet> ipPayload);
+  /// \return m_ecmpSeed combined with the id of the node
+  uint32_t GetNodeSeed (void);
   Ptr<Ipv4Route> LookupGlobal (const Ipv4Header &header, Ptr<const Packet> ipPayload, Ptr<NetDevice> oif = 0);
+  /**
+   * Collect the host routes to dest, or if there are none the network routes
+   * matching dest, or if there are none the first matching AS external route.
+   */
+  void CollectRoutes (Ipv4Address dest, Ptr<NetDevice> oif, RouteVec &routes) const;
+  /**
+   * \return the index in m_fibGroups of the routes to dest, compiled on the
+   * first lookup of dest
+   */
+  uint32_t LookupFib (Ipv4Address dest);
+  /// \return the Ipv4Route shared by all the lookups that select route
+  Ptr<Ipv4Route> InternRoute (Ipv4RoutingTableEntry *route);
+  /// Forget the compiled table; called whenever the routes or the addresses change
+  void InvalidateFib (void);
 
   HostRoutes m_hostRoutes;
   NetworkRoutes m_networkRoutes;
   ASExternalRoutes m_ASexternalRoutes; // External routes imported
+
+  /**
+   * Compiled forwarding table. Each destination is resolved once by
+   * CollectRoutes, which keeps the selection identical to walking the route
+   * lists, and is then answered with a single hash lookup. Destinations that
+   * resolve to the same routes share one ECMP group, and the groups hold
+   * interned Ipv4Route objects, so a lookup allocates nothing.
+   */
+  Fib m_fib;
+  std::vector<RouteGroup> m_fibGroups;
+  std::map<RouteVec, uint32_t> m_fibGroupIndex; //!< group index by routes
+  std::map<Ipv4RoutingTableEntry *, Ptr<Ipv4Route> > m_fibRoutes; //!< interned routes
   
   
   Ptr<Ipv4> m_ipv4;
+  uint32_t m_nodeId;
+  bool m_nodeIdValid;
 };
 
 } // Namespace ns3
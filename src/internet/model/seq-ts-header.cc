@@ -59,6 +59,11 @@ SeqTsHeader::GetPG (void) const
 }
 
 
+void
+SeqTsHeader::SetTs (Time ts)
+{
+  m_ts = ts.GetTimeStep ();
+}
 Time
 SeqTsHeader::GetTs (void) const
 {
@@ -45,6 +45,10 @@ public:
    * \return the sequence number
    */
   uint32_t GetSeq (void) const;
+  /**
+   * \param ts the time stamp, set to the creation time by the constructor
+   */
+  void SetTs (Time ts);
   /**
    * \return the time stamp
    */
@@ -18,6 +18,8 @@
  * Author: Mathieu Lacage <mathieu.lacage@sophia.inria.fr>
  */
 
+#include <algorithm>
+
 #include "ns3/log.h"
 #include "ns3/assert.h"
 #include "ns3/packet.h"
@@ -170,6 +172,18 @@ UdpL4Protocol::CreateSocket (void)
   return socket;
 }
 
+void
+UdpL4Protocol::RemoveSocket (Ptr<UdpSocketImpl> socket)
+{
+  NS_LOG_FUNCTION (this << socket);
+  std::vector<Ptr<UdpSocketImpl> >::iterator i =
+    std::find (m_sockets.begin (), m_sockets.end (), socket);
+  if (i != m_sockets.end ())
+    {
+      m_sockets.erase (i);
+    }
+}
+
 Ipv4EndPoint *
 UdpL4Protocol::Allocate (void)
 {
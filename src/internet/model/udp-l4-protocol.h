@@ -62,6 +62,10 @@ public:
    * of the UDP protocol
    */
   Ptr<Socket> CreateSocket (void);
+  /**
+   * \param socket a socket created by this instance, once closed
+   */
+  void RemoveSocket (Ptr<UdpSocketImpl> socket);
 
   Ipv4EndPoint *Allocate (void);
   Ipv4EndPoint *Allocate (Ipv4Address address);
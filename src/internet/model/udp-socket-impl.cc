@@ -20,6 +20,7 @@
 
 #include "ns3/log.h"
 #include "ns3/node.h"
+#include "ns3/simulator.h"
 #include "ns3/inet-socket-address.h"
 #include "ns3/inet6-socket-address.h"
 #include "ns3/ipv4-route.h"
@@ -305,9 +306,50 @@ UdpSocketImpl::Close (void)
     }
   m_shutdownRecv = true;
   m_shutdownSend = true;
+  DeallocateEndPoint ();
   return 0;
 }
 
+void
+UdpSocketImpl::DeallocateEndPoint (void)
+{
+  NS_LOG_FUNCTION_NOARGS ();
+  // Free the port of a closed socket. The endpoints and the socket refer
+  // to each other, and the protocol to the socket: none of them would be
+  // freed before the end of the simulation otherwise. The endpoints stop
+  // forwarding now, but are deleted after the packets they have already
+  // forwarded, by events of the current time that refer to them.
+  if (m_endPoint != 0)
+    {
+      m_endPoint->SetRxCallback (MakeNullCallback<void, Ptr<Packet>, Ipv4Header, uint16_t, Ptr<Ipv4Interface> > ());
+      m_endPoint->SetIcmpCallback (MakeNullCallback<void, Ipv4Address, uint8_t, uint8_t, uint8_t, uint32_t> ());
+    }
+  if (m_endPoint6 != 0)
+    {
+      m_endPoint6->SetRxCallback (MakeNullCallback<void, Ptr<Packet>, Ipv6Header, uint16_t> ());
+      m_endPoint6->SetIcmpCallback (MakeNullCallback<void, Ipv6Address, uint8_t, uint8_t, uint8_t, uint32_t> ());
+    }
+  Simulator::ScheduleNow (&UdpSocketImpl::DoDeallocateEndPoint, Ptr<UdpSocketImpl> (this));
+}
+
+void
+UdpSocketImpl::DoDeallocateEndPoint (void)
+{
+  NS_LOG_FUNCTION_NOARGS ();
+  // DeAllocate deletes the endpoint, whose destroy callback zeroes it
+  if (m_endPoint != 0)
+    {
+      m_udp->DeAllocate (m_endPoint);
+      NS_ASSERT (m_endPoint == 0);
+    }
+  if (m_endPoint6 != 0)
+    {
+      m_udp->DeAllocate (m_endPoint6);
+      NS_ASSERT (m_endPoint6 == 0);
+    }
+  m_udp->RemoveSocket (this);
+}
+
 int
 UdpSocketImpl::Connect (const Address & address)
 {
@@ -84,6 +84,7 @@ main (int argc, char *argv[])
   int32_t single = 0;
   int nBytes = 500000; // Bytes for each on/off app
   bool nix = true;
+  bool nullmsg = false;
 
   CommandLine cmd;
   cmd.AddValue ("CN", "Number of total CNs [2]", nCN);
@@ -91,8 +92,16 @@ main (int argc, char *argv[])
   cmd.AddValue ("single", "1 if use single flow", single);
   cmd.AddValue ("nBytes", "Number of bytes for each on/off app", nBytes);
   cmd.AddValue ("nix", "Toggle the use of nix-vector or global routing", nix);
+  cmd.AddValue ("nullmsg", "Enable the use of null messages instead of the all-to-all LBTS", nullmsg);
   cmd.Parse (argc,argv);
 
+  if (nullmsg)
+    {
+      // every campus only exchanges packets with the campuses next to it on the ring
+      Config::SetDefault ("ns3::DistributedSimulatorImpl::SynchronizationMode",
+                          StringValue ("NullMessage"));
+    }
+
   if (nCN < 2)
     {
       cout << "Number of total CNs (" << nCN << ") lower than minimum of 2"
@@ -26,10 +26,12 @@
 #include "ns3/node-container.h"
 #include "ns3/ptr.h"
 #include "ns3/pointer.h"
+#include "ns3/enum.h"
 #include "ns3/assert.h"
 #include "ns3/log.h"
 
 #include <math.h>
+#include <algorithm>
 
 #ifdef NS3_MPI
 #include <mpi.h>
@@ -76,6 +78,13 @@ DistributedSimulatorImpl::GetTypeId (void)
   static TypeId tid = TypeId ("ns3::DistributedSimulatorImpl")
     .SetParent<Object> ()
     .AddConstructor<DistributedSimulatorImpl> ()
+    .AddAttribute ("SynchronizationMode",
+                   "How the systems agree on the time up to which events can be processed: "
+                   "all-to-all with the smallest lookahead, or with null messages to the neighbours only.",
+                   EnumValue (SYNC_LBTS),
+                   MakeEnumAccessor (&DistributedSimulatorImpl::m_synchronizationMode),
+                   MakeEnumChecker (SYNC_LBTS, "Lbts",
+                                    SYNC_NULL_MESSAGE, "NullMessage"))
   ;
   return tid;
 }
@@ -94,6 +103,7 @@ DistributedSimulatorImpl::DistributedSimulatorImpl ()
 #endif
 
   m_stop = false;
+  m_synchronizationMode = SYNC_LBTS;
   // uids are allocated from 4.
   // uid 0 is "invalid" events
   // uid 1 is "now" events
@@ -146,6 +156,9 @@ void
 DistributedSimulatorImpl::CalculateLookAhead (void)
 {
 #ifdef NS3_MPI
+  m_neighbors.clear ();
+  m_neighborLookAhead.assign (m_systemCount, Seconds (0));
+  m_nullMessageBound.assign (m_systemCount, Seconds (0));
   if (MpiInterface::GetSize () <= 1)
     {
       DistributedSimulatorImpl::m_lookAhead = Seconds (0);
@@ -197,6 +210,16 @@ DistributedSimulatorImpl::CalculateLookAhead (void)
               // it the new lookAhead.
               TimeValue delay;
               channel->GetAttribute ("Delay", delay);
+              uint32_t remoteId = remoteNode->GetSystemId ();
+              if (std::find (m_neighbors.begin (), m_neighbors.end (), remoteId) == m_neighbors.end ())
+                {
+                  m_neighbors.push_back (remoteId);
+                  m_neighborLookAhead[remoteId] = delay.Get ();
+                }
+              if (delay.Get () < m_neighborLookAhead[remoteId])
+                {
+                  m_neighborLookAhead[remoteId] = delay.Get ();
+                }
               if (DistributedSimulatorImpl::m_lookAhead.IsZero ())
                 {
                   DistributedSimulatorImpl::m_lookAhead = delay.Get ();
@@ -267,6 +290,92 @@ DistributedSimulatorImpl::Next (void) const
   return TimeStep (NextTs ());
 }
 
+Time
+DistributedSimulatorImpl::ExchangeLbts (void)
+{
+#ifdef NS3_MPI
+  // First receive any pending messages
+  MpiInterface::ReceiveMessages ();
+  // reset next time
+  Time nextTime = Next ();
+  // Send the packets of the window, counted below
+  MpiInterface::SendMessages ();
+  // And check for send completes
+  MpiInterface::TestSendComplete ();
+  // Finally calculate the lbts
+  LbtsMessage lMsg (MpiInterface::GetRxCount (), MpiInterface::GetTxCount (), m_myId, nextTime);
+  m_pLBTS[m_myId] = lMsg;
+  MPI_Allgather (&lMsg, sizeof (LbtsMessage), MPI_BYTE, m_pLBTS,
+                 sizeof (LbtsMessage), MPI_BYTE, MPI_COMM_WORLD);
+  Time smallestTime = m_pLBTS[0].GetSmallestTime ();
+  // The totRx and totTx counts insure there are no transient
+  // messages;  If totRx != totTx, there are transients,
+  // so we don't update the granted time.
+  uint32_t totRx = m_pLBTS[0].GetRxCount ();
+  uint32_t totTx = m_pLBTS[0].GetTxCount ();
+
+  for (uint32_t i = 1; i < m_systemCount; ++i)
+    {
+      if (m_pLBTS[i].GetSmallestTime () < smallestTime)
+        {
+          smallestTime = m_pLBTS[i].GetSmallestTime ();
+        }
+      totRx += m_pLBTS[i].GetRxCount ();
+      totTx += m_pLBTS[i].GetTxCount ();
+
+    }
+  if (totRx == totTx)
+    {
+      m_grantedTime = smallestTime + DistributedSimulatorImpl::m_lookAhead;
+    }
+  return nextTime;
+#else
+  NS_FATAL_ERROR ("Can't use distributed simulator without MPI compiled in");
+#endif
+}
+
+Time
+DistributedSimulatorImpl::ExchangeNullMessages (void)
+{
+  // Only the neighbours can send packets to this system: the events up
+  // to the smallest of their bounds can be processed
+  MpiInterface::ReceiveMessages ();
+  Time nextTime = Next ();
+  Time inputTime = GetMaximumSimulationTime ();
+  for (std::vector<uint32_t>::const_iterator i = m_neighbors.begin (); i != m_neighbors.end (); ++i)
+    {
+      inputTime = Min (inputTime, MpiInterface::GetReceiveBound (*i));
+    }
+  // The bounds start at zero, after the lookahead granted at the start
+  m_grantedTime = Max (m_grantedTime, inputTime);
+
+  // No packet is sent before the next event, local or received
+  SendNullMessages (Min (nextTime, m_grantedTime));
+  // With the packets of the window ahead of the null messages counting them
+  MpiInterface::SendMessages ();
+  MpiInterface::TestSendComplete ();
+  return nextTime;
+}
+
+void
+DistributedSimulatorImpl::SendNullMessages (Time outputTime)
+{
+  for (std::vector<uint32_t>::const_iterator i = m_neighbors.begin (); i != m_neighbors.end (); ++i)
+    {
+      Time bound = outputTime;
+      if (bound < GetMaximumSimulationTime () - m_neighborLookAhead[*i])
+        {
+          bound += m_neighborLookAhead[*i];
+        }
+      // Only news are worth a message
+      if (bound > m_nullMessageBound[*i])
+        {
+          MpiInterface::SendNullMessage (*i, bound);
+          m_nullMessageBound[*i] = bound;
+        }
+    }
+}
+
 void
 DistributedSimulatorImpl::Run (void)
 {
@@ -278,37 +387,13 @@ DistributedSimulatorImpl::Run (void)
       Time nextTime = Next ();
       if (nextTime > m_grantedTime)
         { // Can't process, calculate a new LBTS
-          // First receive any pending messages
-          MpiInterface::ReceiveMessages ();
-          // reset next time
-          nextTime = Next ();
-          // And check for send completes
-          MpiInterface::TestSendComplete ();
-          // Finally calculate the lbts
-          LbtsMessage lMsg (MpiInterface::GetRxCount (), MpiInterface::GetTxCount (), m_myId, nextTime);
-          m_pLBTS[m_myId] = lMsg;
-          MPI_Allgather (&lMsg, sizeof (LbtsMessage), MPI_BYTE, m_pLBTS,
-                         sizeof (LbtsMessage), MPI_BYTE, MPI_COMM_WORLD);
-          Time smallestTime = m_pLBTS[0].GetSmallestTime ();
-          // The totRx and totTx counts insure there are no transient
-          // messages;  If totRx != totTx, there are transients,
-          // so we don't update the granted time.
-          uint32_t totRx = m_pLBTS[0].GetRxCount ();
-          uint32_t totTx = m_pLBTS[0].GetTxCount ();
-
-          for (uint32_t i = 1; i < m_systemCount; ++i)
+          if (m_synchronizationMode == SYNC_NULL_MESSAGE)
             {
-              if (m_pLBTS[i].GetSmallestTime () < smallestTime)
-                {
-                  smallestTime = m_pLBTS[i].GetSmallestTime ();
-                }
-              totRx += m_pLBTS[i].GetRxCount ();
-              totTx += m_pLBTS[i].GetTxCount ();
-
+              nextTime = ExchangeNullMessages ();
             }
-          if (totRx == totTx)
+          else
             {
-              m_grantedTime = smallestTime + DistributedSimulatorImpl::m_lookAhead;
+              nextTime = ExchangeLbts ();
             }
         }
       if (nextTime <= m_grantedTime)
@@ -317,6 +402,15 @@ DistributedSimulatorImpl::Run (void)
         }
     }
 
+  if (m_synchronizationMode == SYNC_NULL_MESSAGE)
+    {
+      // Let the neighbours reach the time this system stopped at; a
+      // system out of events leaves the simulation and sends no more packets
+      SendNullMessages (m_events->IsEmpty () ? GetMaximumSimulationTime () : Min (Next (), m_grantedTime));
+    }
+  // The packets sent since the last exchange
+  MpiInterface::SendMessages ();
+
   // If the simulator stopped naturally by lack of events, make a
   // consistency test to check that we didn't lose any events along the way.
   NS_ASSERT (!m_events->IsEmpty () || m_unscheduledEvents == 0);
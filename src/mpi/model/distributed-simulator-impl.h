@@ -25,6 +25,7 @@
 #include "ns3/ptr.h"
 
 #include <list>
+#include <vector>
 
 namespace ns3 {
 
@@ -93,6 +94,14 @@ class DistributedSimulatorImpl : public SimulatorImpl
 public:
   static TypeId GetTypeId (void);
 
+  /**
+   * How the systems agree on the time up to which events can be processed
+   */
+  enum SynchronizationMode {
+    SYNC_LBTS, /** All-to-all exchange of the next event times of every system, with the smallest lookahead */
+    SYNC_NULL_MESSAGE /** Null messages to the neighbours only, with the lookahead of the channels to each of them */
+  };
+
   DistributedSimulatorImpl ();
   ~DistributedSimulatorImpl ();
 
@@ -119,6 +128,9 @@ public:
 private:
   virtual void DoDispose (void);
   void CalculateLookAhead (void);
+  Time ExchangeLbts (void);
+  Time ExchangeNullMessages (void);
+  void SendNullMessages (Time outputTime);
 
   void ProcessOneEvent (void);
   uint64_t NextTs (void) const;
@@ -142,6 +154,10 @@ private:
   Time         m_grantedTime; // Last LBTS
   static Time  m_lookAhead;   // Lookahead value
 
+  SynchronizationMode   m_synchronizationMode;
+  std::vector<uint32_t> m_neighbors;         // Systems linked to this one by a channel
+  std::vector<Time>     m_neighborLookAhead; // Smallest delay of the channels to each system
+  std::vector<Time>     m_nullMessageBound;  // Last bound sent to each system
 };
 
 } // namespace ns3
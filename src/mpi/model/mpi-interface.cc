@@ -22,6 +22,7 @@
 #include <iostream>
 #include <iomanip>
 #include <list>
+#include <cstring>
 
 #include "mpi-interface.h"
 #include "mpi-receiver.h"
@@ -32,6 +33,7 @@
 #include "ns3/simulator.h"
 #include "ns3/simulator-impl.h"
 #include "ns3/nstime.h"
+#include "ns3/packet-metadata.h"
 
 #ifdef NS3_MPI
 #include <mpi.h>
@@ -41,25 +43,13 @@ namespace ns3 {
 
 SentBuffer::SentBuffer ()
 {
-  m_buffer = 0;
   m_request = 0;
 }
 
-SentBuffer::~SentBuffer ()
+std::vector<uint8_t>&
+SentBuffer::GetData ()
 {
-  delete [] m_buffer;
-}
-
-uint8_t*
-SentBuffer::GetBuffer ()
-{
-  return m_buffer;
-}
-
-void
-SentBuffer::SetBuffer (uint8_t* buffer)
-{
-  m_buffer = buffer;
+  return m_data;
 }
 
 #ifdef NS3_MPI
@@ -77,24 +67,55 @@ bool                  MpiInterface::m_enabled = false;
 uint32_t              MpiInterface::m_rxCount = 0;
 uint32_t              MpiInterface::m_txCount = 0;
 std::list<SentBuffer> MpiInterface::m_pendingTx;
-
-#ifdef NS3_MPI
-MPI_Request* MpiInterface::m_requests;
-char**       MpiInterface::m_pRxBuffers;
-#endif
+std::list<SentBuffer> MpiInterface::m_freeTx;
+std::vector<std::vector<uint8_t> > MpiInterface::m_txMessages;
+std::vector<uint8_t>  MpiInterface::m_rxBuffer;
+std::vector<uint32_t> MpiInterface::m_txCounts;
+std::vector<uint32_t> MpiInterface::m_rxCounts;
+std::vector<Time>     MpiInterface::m_receiveBounds;
+std::vector<Time>     MpiInterface::m_pendingBounds;
+std::vector<uint32_t> MpiInterface::m_pendingCounts;
+
+// destination node of a null message, which carries the number of
+// packets sent before it instead of a device
+static const uint32_t NULL_MESSAGE_NODE = 0xffffffff;
+
+// A message holds a record for every packet and null message, in the
+// order they were sent: the header, then the packet data padded to 8 bytes
+struct MessageRecord
+{
+  uint64_t time;        // receive time, or bound of a null message, in time steps
+  uint32_t node;        // destination node, or NULL_MESSAGE_NODE
+  uint32_t dev;         // destination device, or packet count of a null message
+  uint32_t size;        // bytes of packet data
+  uint32_t format;      // RAW_PACKET or SERIALIZED_PACKET
+};
+
+// Without metadata or a nix-vector to carry, which is the case of the qbb
+// packets whose headers are all in their bytes, the bytes alone are sent
+// instead of the whole serialized packet
+static const uint32_t RAW_PACKET = 0;
+static const uint32_t SERIALIZED_PACKET = 1;
+
+static uint32_t
+GetPaddedSize (uint32_t size)
+{
+  return (size + 7) & (~7);
+}
 
 void
 MpiInterface::Destroy ()
 {
 #ifdef NS3_MPI
-  for (uint32_t i = 0; i < GetSize (); ++i)
-    {
-      delete [] m_pRxBuffers[i];
-    }
-  delete [] m_pRxBuffers;
-  delete [] m_requests;
-
   m_pendingTx.clear ();
+  m_freeTx.clear ();
+  m_txMessages.clear ();
+  m_rxBuffer.clear ();
+  m_txCounts.clear ();
+  m_rxCounts.clear ();
+  m_receiveBounds.clear ();
+  m_pendingBounds.clear ();
+  m_pendingCounts.clear ();
 #endif
 }
 
@@ -154,108 +175,204 @@ MpiInterface::Enable (int* pargc, char*** pargv)
   MPI_Comm_size (MPI_COMM_WORLD, reinterpret_cast <int *> (&m_size));
   m_enabled = true;
   m_initialized = true;
-  // Post a non-blocking receive for all peers
-  m_pRxBuffers = new char*[m_size];
-  m_requests = new MPI_Request[m_size];
-  for (uint32_t i = 0; i < GetSize (); ++i)
-    {
-      m_pRxBuffers[i] = new char[MAX_MPI_MSG_SIZE];
-      MPI_Irecv (m_pRxBuffers[i], MAX_MPI_MSG_SIZE, MPI_CHAR, MPI_ANY_SOURCE, 0,
-                 MPI_COMM_WORLD, &m_requests[i]);
-    }
+  m_txCounts.assign (m_size, 0);
+  m_rxCounts.assign (m_size, 0);
+  m_receiveBounds.assign (m_size, Seconds (0));
+  m_pendingBounds.assign (m_size, Seconds (0));
+  m_pendingCounts.assign (m_size, 0);
+  m_txMessages.assign (m_size, std::vector<uint8_t> ());
 #else
   NS_FATAL_ERROR ("Can't use distributed simulator without MPI compiled in");
 #endif
 }
 
+uint8_t*
+MpiInterface::AddRecord (uint32_t rank, uint64_t time, uint32_t node, uint32_t dev,
+                         uint32_t size, uint32_t format)
+{
+  MessageRecord record;
+  record.time = time;
+  record.node = node;
+  record.dev = dev;
+  record.size = size;
+  record.format = format;
+
+  // The message keeps its storage from one send to the next
+  std::vector<uint8_t> &message = m_txMessages[rank];
+  uint32_t offset = message.size ();
+  message.resize (offset + sizeof (record) + GetPaddedSize (size));
+  std::memcpy (&message[offset], &record, sizeof (record));
+  return &message[offset + sizeof (record)];
+}
+
 void
 MpiInterface::SendPacket (Ptr<Packet> p, const Time& rxTime, uint32_t node, uint32_t dev)
 {
 #ifdef NS3_MPI
-  SentBuffer sendBuf;
-  m_pendingTx.push_back (sendBuf);
-  std::list<SentBuffer>::reverse_iterator i = m_pendingTx.rbegin (); // Points to the last element
-
-  uint32_t serializedSize = p->GetSerializedSize ();
-  uint8_t* buffer =  new uint8_t[serializedSize + 16];
-  i->SetBuffer (buffer);
-  // Add the time, dest node and dest device
-  uint64_t t = rxTime.GetNanoSeconds ();
-  uint64_t* pTime = reinterpret_cast <uint64_t *> (buffer);
-  *pTime++ = t;
-  uint32_t* pData = reinterpret_cast<uint32_t *> (pTime);
-  *pData++ = node;
-  *pData++ = dev;
-  // Serialize the packet
-  p->Serialize (reinterpret_cast<uint8_t *> (pData), serializedSize);
-
   // Find the system id for the destination node
   Ptr<Node> destNode = NodeList::GetNode (node);
   uint32_t nodeSysId = destNode->GetSystemId ();
 
-  MPI_Isend (reinterpret_cast<void *> (i->GetBuffer ()), serializedSize + 16, MPI_CHAR, nodeSysId,
-             0, MPI_COMM_WORLD, (i->GetRequest ()));
+  if (!PacketMetadata::IsEnabled () && !p->GetNixVector ())
+    {
+      uint32_t size = p->GetSize ();
+      uint8_t* data = AddRecord (nodeSysId, rxTime.GetTimeStep (), node, dev, size, RAW_PACKET);
+      p->CopyData (data, size);
+    }
+  else
+    {
+      uint32_t serializedSize = p->GetSerializedSize ();
+      uint8_t* data = AddRecord (nodeSysId, rxTime.GetTimeStep (), node, dev, serializedSize,
+                                 SERIALIZED_PACKET);
+      p->Serialize (data, serializedSize);
+    }
   m_txCount++;
+  m_txCounts[nodeSysId]++;
 #else
   NS_FATAL_ERROR ("Can't use distributed simulator without MPI compiled in");
 #endif
 }
 
+void
+MpiInterface::SendNullMessage (uint32_t rank, const Time& bound)
+{
+#ifdef NS3_MPI
+  // The bound in time steps, since it may be the largest time
+  AddRecord (rank, bound.GetTimeStep (), NULL_MESSAGE_NODE, m_txCounts[rank], 0, RAW_PACKET);
+#else
+  NS_FATAL_ERROR ("Can't use distributed simulator without MPI compiled in");
+#endif
+}
+
+void
+MpiInterface::SendMessages ()
+{
+#ifdef NS3_MPI
+  for (uint32_t rank = 0; rank < m_size; ++rank)
+    {
+      std::vector<uint8_t> &message = m_txMessages[rank];
+      if (message.empty ())
+        {
+          continue;
+        }
+      // Take the data of a completed send, if any, for the next message
+      if (m_freeTx.empty ())
+        {
+          m_pendingTx.push_back (SentBuffer ());
+        }
+      else
+        {
+          m_pendingTx.splice (m_pendingTx.end (), m_freeTx, m_freeTx.begin ());
+        }
+      SentBuffer &sent = m_pendingTx.back ();
+      sent.GetData ().swap (message);
+      message.clear ();
+
+      MPI_Isend (&sent.GetData ()[0], sent.GetData ().size (), MPI_BYTE, rank,
+                 0, MPI_COMM_WORLD, sent.GetRequest ());
+    }
+#else
+  NS_FATAL_ERROR ("Can't use distributed simulator without MPI compiled in");
+#endif
+}
+
+Time
+MpiInterface::GetReceiveBound (uint32_t rank)
+{
+  return m_receiveBounds[rank];
+}
+
+void
+MpiInterface::UpdateReceiveBound (uint32_t rank)
+{
+  if (m_rxCounts[rank] >= m_pendingCounts[rank]
+      && m_pendingBounds[rank] > m_receiveBounds[rank])
+    {
+      m_receiveBounds[rank] = m_pendingBounds[rank];
+    }
+}
+
 void
 MpiInterface::ReceiveMessages ()
-{ // Poll the non-block reads to see if data arrived
+{ // Poll to see if messages arrived
 #ifdef NS3_MPI
   while (true)
     {
       int flag = 0;
-      int index = 0;
       MPI_Status status;
 
-      MPI_Testany (GetSize (), m_requests, &index, &flag, &status);
+      MPI_Iprobe (MPI_ANY_SOURCE, 0, MPI_COMM_WORLD, &flag, &status);
       if (!flag)
         {
           break;        // No more messages
         }
       int count;
-      MPI_Get_count (&status, MPI_CHAR, &count);
-      m_rxCount++; // Count this receive
+      MPI_Get_count (&status, MPI_BYTE, &count);
+      uint32_t source = status.MPI_SOURCE;
+      if (m_rxBuffer.size () < static_cast<uint32_t> (count))
+        {
+          m_rxBuffer.resize (count);
+        }
+      MPI_Recv (&m_rxBuffer[0], count, MPI_BYTE, source, 0, MPI_COMM_WORLD, MPI_STATUS_IGNORE);
 
-      // Get the meta data first
-      uint64_t* pTime = reinterpret_cast<uint64_t *> (m_pRxBuffers[index]);
-      uint64_t nanoSeconds = *pTime++;
-      uint32_t* pData = reinterpret_cast<uint32_t *> (pTime);
-      uint32_t node = *pData++;
-      uint32_t dev  = *pData++;
+      uint32_t offset = 0;
+      while (offset < static_cast<uint32_t> (count))
+        {
+          MessageRecord record;
+          std::memcpy (&record, &m_rxBuffer[offset], sizeof (record));
+          const uint8_t* data = &m_rxBuffer[offset + sizeof (record)];
+          offset += sizeof (record) + GetPaddedSize (record.size);
 
-      Time rxTime = NanoSeconds (nanoSeconds);
+          if (record.node == NULL_MESSAGE_NODE)
+            {
+              // The bound holds once the packets sent before the null
+              // message have been received
+              Time bound = TimeStep (record.time);
+              if (bound > m_pendingBounds[source])
+                {
+                  m_pendingBounds[source] = bound;
+                  m_pendingCounts[source] = record.dev;
+                }
+              UpdateReceiveBound (source);
+              continue;
+            }
 
-      count -= sizeof (nanoSeconds) + sizeof (node) + sizeof (dev);
+          m_rxCount++; // Count this receive
+          m_rxCounts[source]++;
+          UpdateReceiveBound (source);
 
-      Ptr<Packet> p = Create<Packet> (reinterpret_cast<uint8_t *> (pData), count, true);
+          Time rxTime = TimeStep (record.time);
 
-      // Find the correct node/device to schedule receive event
-      Ptr<Node> pNode = NodeList::GetNode (node);
-      Ptr<MpiReceiver> pMpiRec = 0;
-      uint32_t nDevices = pNode->GetNDevices ();
-      for (uint32_t i = 0; i < nDevices; ++i)
-        {
-          Ptr<NetDevice> pThisDev = pNode->GetDevice (i);
-          if (pThisDev->GetIfIndex () == dev)
+          Ptr<Packet> p;
+          if (record.format == RAW_PACKET)
             {
-              pMpiRec = pThisDev->GetObject<MpiReceiver> ();
-              break;
+              p = Create<Packet> (data, record.size);
+            }
+          else
+            {
+              p = Create<Packet> (data, record.size, true);
             }
-        }
 
-      NS_ASSERT (pNode && pMpiRec);
+          // Find the correct node/device to schedule receive event
+          Ptr<Node> pNode = NodeList::GetNode (record.node);
+          Ptr<MpiReceiver> pMpiRec = 0;
+          uint32_t nDevices = pNode->GetNDevices ();
+          for (uint32_t i = 0; i < nDevices; ++i)
+            {
+              Ptr<NetDevice> pThisDev = pNode->GetDevice (i);
+              if (pThisDev->GetIfIndex () == record.dev)
+                {
+                  pMpiRec = pThisDev->GetObject<MpiReceiver> ();
+                  break;
+                }
+            }
 
-      // Schedule the rx event
-      Simulator::ScheduleWithContext (pNode->GetId (), rxTime - Simulator::Now (),
-                                      &MpiReceiver::Receive, pMpiRec, p);
+          NS_ASSERT (pNode && pMpiRec);
 
-      // Re-queue the next read
-      MPI_Irecv (m_pRxBuffers[index], MAX_MPI_MSG_SIZE, MPI_CHAR, MPI_ANY_SOURCE, 0,
-                 MPI_COMM_WORLD, &m_requests[index]);
+          // Schedule the rx event
+          Simulator::ScheduleWithContext (pNode->GetId (), rxTime - Simulator::Now (),
+                                          &MpiReceiver::Receive, pMpiRec, p);
+        }
     }
 #else
   NS_FATAL_ERROR ("Can't use distributed simulator without MPI compiled in");
@@ -275,8 +392,8 @@ MpiInterface::TestSendComplete ()
       std::list<SentBuffer>::iterator current = i; // Save current for erasing
       i++;                                    // Advance to next
       if (flag)
-        { // This message is complete
-          m_pendingTx.erase (current);
+        { // This message is complete, keep its data for a later one
+          m_freeTx.splice (m_freeTx.end (), m_pendingTx, current);
         }
     }
 #else
@@ -24,6 +24,7 @@
 
 #include <stdint.h>
 #include <list>
+#include <vector>
 
 #include "ns3/nstime.h"
 #include "ns3/buffer.h"
@@ -44,38 +45,30 @@ namespace ns3 {
  *
  */
 
-/**
- * maximum MPI message size for easy
- * buffer creation
- */
-const uint32_t MAX_MPI_MSG_SIZE = 2000;
-
 /**
  * \ingroup mpi
  *
  * Define a class for tracking the non-block sends
+ *
+ * The data of a completed send is kept, so that its storage is reused by
+ * a later message instead of being allocated again.
  */
 class SentBuffer
 {
 public:
   SentBuffer ();
-  ~SentBuffer ();
 
   /**
-   * \return pointer to sent buffer
-   */
-  uint8_t* GetBuffer ();
-  /**
-   * \param buffer pointer to sent buffer
+   * \return the data of the message
    */
-  void SetBuffer (uint8_t* buffer);
+  std::vector<uint8_t>& GetData ();
   /**
    * \return MPI request
    */
   MPI_Request* GetRequest ();
 
 private:
-  uint8_t* m_buffer;
+  std::vector<uint8_t> m_data;
   MPI_Request m_request;
 };
 
@@ -124,9 +117,32 @@ public:
    * \param node destination node
    * \param dev destination device
    *
-   * Serialize and send a packet to the specified node and net device
+   * Serialize a packet for the specified node and net device, into the
+   * message of the system of the node sent by the next SendMessages
    */
   static void SendPacket (Ptr<Packet> p, const Time &rxTime, uint32_t node, uint32_t dev);
+  /**
+   * \param rank destination system
+   * \param bound smallest receive time of the packets sent to rank from now on
+   *
+   * Send a null message, the promise of the Chandy-Misra-Bryant protocol
+   * that no packet received earlier than bound will follow. It carries the
+   * number of packets sent to rank before it, so that the promise is only
+   * kept by the receiver once all of them have been received. Like the
+   * packets, it is sent by the next SendMessages.
+   */
+  static void SendNullMessage (uint32_t rank, const Time &bound);
+  /**
+   * Send the packets and null messages of every system since the last
+   * call, in one message per system
+   */
+  static void SendMessages ();
+  /**
+   * \param rank source system
+   * \return the smallest receive time of the packets that rank may still
+   * send to this system, from its null messages; zero until the first one
+   */
+  static Time GetReceiveBound (uint32_t rank);
   /**
    * Check for received messages complete
    */
@@ -145,6 +161,25 @@ public:
   static uint32_t GetTxCount ();
 
 private:
+  /**
+   * \param rank source system
+   *
+   * Keep the bound of the last null message of rank once the packets
+   * sent before it have been received
+   */
+  static void UpdateReceiveBound (uint32_t rank);
+  /**
+   * \param rank destination system
+   * \param time receive time of the packet, or bound of the null message
+   * \param node destination node, or NULL_MESSAGE_NODE
+   * \param dev destination device, or packet count of the null message
+   * \param size bytes of packet data
+   * \param format how the packet data is written
+   * \return where to write the packet data in the message of rank
+   */
+  static uint8_t* AddRecord (uint32_t rank, uint64_t time, uint32_t node, uint32_t dev,
+                             uint32_t size, uint32_t format);
+
   static uint32_t m_sid;
   static uint32_t m_size;
 
@@ -153,17 +188,29 @@ private:
 
   // Total packets sent
   static uint32_t m_txCount;
+
+  // Packets sent to and received from every system, for the null messages
+  static std::vector<uint32_t> m_txCounts;
+  static std::vector<uint32_t> m_rxCounts;
+
+  // Receive bound of every system, and the bound of a null message that
+  // arrived before some of the packets sent ahead of it
+  static std::vector<Time>     m_receiveBounds;
+  static std::vector<Time>     m_pendingBounds;
+  static std::vector<uint32_t> m_pendingCounts;
   static bool     m_initialized;
   static bool     m_enabled;
 
-  // Pending non-blocking receives
-  static MPI_Request* m_requests;
+  // Packets and null messages of the next message to every system
+  static std::vector<std::vector<uint8_t> > m_txMessages;
 
-  // Data buffers for non-blocking reads
-  static char**   m_pRxBuffers;
+  // Data buffer for the received messages, grown to the largest one
+  static std::vector<uint8_t> m_rxBuffer;
 
-  // List of pending non-blocking sends
+  // List of pending non-blocking sends, and of the completed ones whose
+  // data is reused
   static std::list<SentBuffer> m_pendingTx;
+  static std::list<SentBuffer> m_freeTx;
 };
 
 } // namespace ns3
@@ -0,0 +1,778 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#include "multithreaded-simulator-impl.h"
+
+#include "ns3/simulator.h"
+#include "ns3/scheduler.h"
+#include "ns3/event-impl.h"
+#include "ns3/system-thread.h"
+#include "ns3/channel.h"
+#include "ns3/channel-list.h"
+#include "ns3/net-device.h"
+#include "ns3/node.h"
+#include "ns3/node-list.h"
+#include "ns3/nstime.h"
+#include "ns3/ptr.h"
+#include "ns3/assert.h"
+#include "ns3/log.h"
+
+#include <sched.h>
+#include <algorithm>
+
+// Note: like in DefaultSimulatorImpl, logging is avoided in the functions
+// called for every event, all the more since they run in several threads.
+
+NS_LOG_COMPONENT_DEFINE ("MultithreadedSimulatorImpl");
+
+namespace ns3 {
+
+NS_OBJECT_ENSURE_REGISTERED (MultithreadedSimulatorImpl);
+
+namespace {
+
+const uint64_t NO_EVENT = ~(uint64_t)0;
+// spins before a waiting thread starts yielding its core
+const uint32_t BARRIER_SPINS = 256;
+
+} // anonymous namespace
+
+SpinBarrier::SpinBarrier ()
+  : m_n (1),
+    m_arrived (0),
+    m_generation (0)
+{
+}
+
+void
+SpinBarrier::SetCount (uint32_t n)
+{
+  NS_ASSERT (n > 0 && m_arrived == 0);
+  m_n = n;
+}
+
+void
+SpinBarrier::Wait (void)
+{
+  uint32_t generation = m_generation;
+  if (__sync_add_and_fetch (&m_arrived, 1) == m_n)
+    {
+      m_arrived = 0;
+      __sync_synchronize ();
+      m_generation = generation + 1;
+      return;
+    }
+  uint32_t spins = 0;
+  while (m_generation == generation)
+    {
+      if (++spins > BARRIER_SPINS)
+        {
+          sched_yield ();
+        }
+    }
+  __sync_synchronize ();
+}
+
+/**
+ * State of one partition. Apart from the outboxes, it is only accessed
+ * by the thread of the partition, or by the main thread while that one
+ * waits at the barrier.
+ */
+struct MultithreadedSimulatorImpl::LogicalProcess
+{
+  LogicalProcess (MultithreadedSimulatorImpl *impl, uint32_t id, uint32_t n)
+    : impl (impl),
+      id (id),
+      uid (0),
+      currentUid (0),
+      currentTs (0),
+      currentContext (0xffffffff),
+      unscheduledEvents (0),
+      windowEnd (0),
+      nextTs (NO_EVENT),
+      outbox (n + 1)
+  {
+  }
+  void Run (void)
+  {
+    impl->RunPartition (this);
+    // the events allocated by this thread may still be in the queues, and
+    // the thread of the next run reuses its pool
+    EventImpl::ReleaseThreadPool ();
+  }
+
+  MultithreadedSimulatorImpl *impl;
+  uint32_t id;
+  Ptr<Scheduler> events;
+  uint32_t uid;
+  uint32_t currentUid;
+  uint64_t currentTs;
+  uint32_t currentContext;
+  int unscheduledEvents;
+  // events earlier than this are processed in the current round
+  uint64_t windowEnd;
+  // earliest event after the messages are received, published to the
+  // other threads at the barrier
+  uint64_t nextTs;
+  // events scheduled in other partitions during the round, indexed by
+  // partition, plus one last mailbox for the global queue. Each mailbox is
+  // written by this thread during the round and emptied by its reader after
+  // the barrier.
+  std::vector<std::vector<Scheduler::Event> > outbox;
+  Ptr<SystemThread> thread;
+};
+
+NS_THREAD_LOCAL MultithreadedSimulatorImpl::LogicalProcess *MultithreadedSimulatorImpl::m_currentLp = 0;
+
+TypeId
+MultithreadedSimulatorImpl::GetTypeId (void)
+{
+  static TypeId tid = TypeId ("ns3::MultithreadedSimulatorImpl")
+    .SetParent<SimulatorImpl> ()
+    .AddConstructor<MultithreadedSimulatorImpl> ()
+  ;
+  return tid;
+}
+
+MultithreadedSimulatorImpl::MultithreadedSimulatorImpl ()
+{
+  NS_LOG_FUNCTION (this);
+  m_stop = false;
+  // uids are allocated from 4.
+  // uid 0 is "invalid" events
+  // uid 1 is "now" events
+  // uid 2 is "destroy" events
+  m_uid = 4;
+  // before ::Run is entered, the m_currentUid will be zero
+  m_currentUid = 0;
+  m_currentTs = 0;
+  m_currentContext = 0xffffffff;
+  m_unscheduledEvents = 0;
+  m_events = 0;
+  m_running = false;
+  m_uidStride = 1;
+  m_lookAhead = NO_EVENT;
+  m_globalNextTs = NO_EVENT;
+}
+
+MultithreadedSimulatorImpl::~MultithreadedSimulatorImpl ()
+{
+  NS_LOG_FUNCTION (this);
+}
+
+void
+MultithreadedSimulatorImpl::DoDispose (void)
+{
+  NS_LOG_FUNCTION (this);
+  while (!m_events->IsEmpty ())
+    {
+      Scheduler::Event next = m_events->RemoveNext ();
+      next.impl->Unref ();
+    }
+  m_events = 0;
+  m_roundCallbacks.clear ();
+  SimulatorImpl::DoDispose ();
+}
+
+void
+MultithreadedSimulatorImpl::Destroy ()
+{
+  NS_LOG_FUNCTION (this);
+  while (!m_destroyEvents.empty ())
+    {
+      Ptr<EventImpl> ev = m_destroyEvents.front ().PeekEventImpl ();
+      m_destroyEvents.pop_front ();
+      NS_LOG_LOGIC ("handle destroy " << ev);
+      if (!ev->IsCancelled ())
+        {
+          ev->Invoke ();
+        }
+    }
+}
+
+void
+MultithreadedSimulatorImpl::SetScheduler (ObjectFactory schedulerFactory)
+{
+  NS_LOG_FUNCTION (this << schedulerFactory);
+  NS_ASSERT (!m_running);
+  Ptr<Scheduler> scheduler = schedulerFactory.Create<Scheduler> ();
+
+  if (m_events != 0)
+    {
+      while (!m_events->IsEmpty ())
+        {
+          Scheduler::Event next = m_events->RemoveNext ();
+          scheduler->Insert (next);
+        }
+    }
+  m_events = scheduler;
+  m_schedulerFactory = schedulerFactory;
+}
+
+MultithreadedSimulatorImpl::LogicalProcess *
+MultithreadedSimulatorImpl::GetOwner (uint32_t context) const
+{
+  // nodes created during the run, like the events without a node context,
+  // are handled by the global queue
+  if (context < m_partitionOfNode.size ())
+    {
+      return m_lps[m_partitionOfNode[context]];
+    }
+  return 0;
+}
+
+void
+MultithreadedSimulatorImpl::Partition (void)
+{
+  NS_LOG_FUNCTION (this);
+  uint32_t n = 1;
+  m_partitionOfNode.resize (NodeList::GetNNodes ());
+  for (uint32_t i = 0; i < NodeList::GetNNodes (); ++i)
+    {
+      m_partitionOfNode[i] = NodeList::GetNode (i)->GetSystemId ();
+      n = std::max (n, m_partitionOfNode[i] + 1);
+    }
+
+  // every partition and the global queue take their uids in turn, so that
+  // the uids stay unique once the queues are merged back
+  m_uidStride = n + 1;
+  for (uint32_t k = 0; k < n; ++k)
+    {
+      LogicalProcess *lp = new LogicalProcess (this, k, n);
+      lp->events = m_schedulerFactory.Create<Scheduler> ();
+      lp->uid = m_uid + k;
+      lp->currentUid = m_currentUid;
+      lp->currentTs = m_currentTs;
+      m_lps.push_back (lp);
+    }
+  m_uid += n;
+
+  Ptr<Scheduler> global = m_schedulerFactory.Create<Scheduler> ();
+  while (!m_events->IsEmpty ())
+    {
+      Scheduler::Event ev = m_events->RemoveNext ();
+      LogicalProcess *lp = GetOwner (ev.key.m_context);
+      if (lp == 0)
+        {
+          global->Insert (ev);
+        }
+      else
+        {
+          lp->events->Insert (ev);
+          lp->unscheduledEvents++;
+          m_unscheduledEvents--;
+        }
+    }
+  m_events = global;
+  m_barrier.SetCount (n);
+  NS_LOG_INFO (n << " partitions for " << m_partitionOfNode.size () << " nodes");
+}
+
+void
+MultithreadedSimulatorImpl::CalculateLookAhead (void)
+{
+  NS_LOG_FUNCTION (this);
+  m_lookAhead = NO_EVENT;
+  for (uint32_t i = 0; i < ChannelList::GetNChannels (); ++i)
+    {
+      Ptr<Channel> channel = ChannelList::GetChannel (i);
+      bool crosses = false;
+      uint32_t partition = 0;
+      bool first = true;
+      for (uint32_t j = 0; j < channel->GetNDevices (); ++j)
+        {
+          Ptr<Node> node = channel->GetDevice (j)->GetNode ();
+          if (node == 0 || node->GetId () >= m_partitionOfNode.size ())
+            {
+              continue;
+            }
+          if (first)
+            {
+              partition = m_partitionOfNode[node->GetId ()];
+              first = false;
+            }
+          else if (m_partitionOfNode[node->GetId ()] != partition)
+            {
+              crosses = true;
+            }
+        }
+      if (!crosses)
+        {
+          continue;
+        }
+      TimeValue delay;
+      if (!channel->GetAttributeFailSafe ("Delay", delay) || !delay.Get ().IsStrictlyPositive ())
+        {
+          NS_FATAL_ERROR ("MultithreadedSimulatorImpl: channel " << channel->GetId ()
+                          << " links two partitions but has no positive Delay attribute");
+        }
+      m_lookAhead = std::min (m_lookAhead, static_cast<uint64_t> (delay.Get ().GetTimeStep ()));
+    }
+  NS_LOG_INFO ("lookahead " << GetLookAhead ());
+}
+
+void
+MultithreadedSimulatorImpl::Merge (void)
+{
+  NS_LOG_FUNCTION (this);
+  uint64_t lpTs = 0;
+  uint32_t uid = m_uid;
+  for (uint32_t k = 0; k < m_lps.size (); ++k)
+    {
+      LogicalProcess *lp = m_lps[k];
+      while (!lp->events->IsEmpty ())
+        {
+          m_events->Insert (lp->events->RemoveNext ());
+        }
+      m_unscheduledEvents += lp->unscheduledEvents;
+      lpTs = std::max (lpTs, lp->currentTs);
+      uid = std::max (uid, lp->uid);
+      delete lp;
+    }
+  m_lps.clear ();
+  m_partitionOfNode.clear ();
+  m_uid = uid;
+  m_uidStride = 1;
+  // Every round ends at the same time in all partitions, so the events
+  // left are later than any event processed by a partition; they all keep
+  // a uid below m_uid.
+  if (lpTs > m_currentTs)
+    {
+      m_currentTs = lpTs;
+      m_currentUid = m_uid - 1;
+    }
+}
+
+void
+MultithreadedSimulatorImpl::Insert (LogicalProcess *lp, Scheduler::Event &ev)
+{
+  if (lp == 0)
+    {
+      ev.key.m_uid = m_uid;
+      m_uid += m_uidStride;
+      m_unscheduledEvents++;
+      m_events->Insert (ev);
+    }
+  else
+    {
+      ev.key.m_uid = lp->uid;
+      lp->uid += m_uidStride;
+      lp->unscheduledEvents++;
+      lp->events->Insert (ev);
+    }
+}
+
+void
+MultithreadedSimulatorImpl::ProcessOneEvent (LogicalProcess *lp)
+{
+  Scheduler::Event next = lp->events->RemoveNext ();
+
+  NS_ASSERT (next.key.m_ts >= lp->currentTs);
+  lp->unscheduledEvents--;
+
+  lp->currentTs = next.key.m_ts;
+  lp->currentContext = next.key.m_context;
+  lp->currentUid = next.key.m_uid;
+  next.impl->Invoke ();
+  next.impl->Unref ();
+}
+
+void
+MultithreadedSimulatorImpl::ProcessGlobalEvents (uint64_t ts)
+{
+  while (!m_events->IsEmpty () && !m_stop
+         && m_events->PeekNext ().key.m_ts == ts)
+    {
+      Scheduler::Event next = m_events->RemoveNext ();
+      NS_ASSERT (next.key.m_ts >= m_currentTs);
+      m_unscheduledEvents--;
+
+      m_currentTs = next.key.m_ts;
+      m_currentContext = next.key.m_context;
+      m_currentUid = next.key.m_uid;
+      next.impl->Invoke ();
+      next.impl->Unref ();
+    }
+}
+
+void
+MultithreadedSimulatorImpl::ReceiveMessages (LogicalProcess *lp)
+{
+  uint32_t n = m_lps.size ();
+  // in the order of the sources, for reproducible uids
+  for (uint32_t src = 0; src < n; ++src)
+    {
+      std::vector<Scheduler::Event> &box = m_lps[src]->outbox[lp->id];
+      for (std::vector<Scheduler::Event>::iterator i = box.begin (); i != box.end (); ++i)
+        {
+          Insert (lp, *i);
+        }
+      box.clear ();
+    }
+  if (lp->id == 0)
+    {
+      for (uint32_t src = 0; src < n; ++src)
+        {
+          std::vector<Scheduler::Event> &box = m_lps[src]->outbox[n];
+          for (std::vector<Scheduler::Event>::iterator i = box.begin (); i != box.end (); ++i)
+            {
+              Insert (0, *i);
+            }
+          box.clear ();
+        }
+      m_globalNextTs = m_events->IsEmpty () ? NO_EVENT : m_events->PeekNext ().key.m_ts;
+    }
+}
+
+void
+MultithreadedSimulatorImpl::RunPartition (LogicalProcess *lp)
+{
+  m_currentLp = lp;
+  while (true)
+    {
+      ReceiveMessages (lp);
+      lp->nextTs = lp->events->IsEmpty () ? NO_EVENT : lp->events->PeekNext ().key.m_ts;
+      // m_stop is only written while events are processed, which may
+      // already be the case for the main thread after the barrier
+      bool stop = m_stop;
+      m_barrier.Wait ();
+
+      // every thread takes the same decision from the published values,
+      // which are not written again before the next barrier
+      uint64_t next = NO_EVENT;
+      for (uint32_t k = 0; k < m_lps.size (); ++k)
+        {
+          next = std::min (next, m_lps[k]->nextTs);
+        }
+      uint64_t global = m_globalNextTs;
+      if (stop || (next == NO_EVENT && global == NO_EVENT))
+        {
+          break;
+        }
+
+      if (global <= next)
+        {
+          if (lp->id == 0)
+            {
+              m_currentLp = 0;
+              ProcessGlobalEvents (global);
+              m_currentLp = lp;
+            }
+          m_barrier.Wait ();
+          EndRound (lp, global);
+          continue;
+        }
+
+      lp->windowEnd = next > NO_EVENT - m_lookAhead ? NO_EVENT : next + m_lookAhead;
+      lp->windowEnd = std::min (lp->windowEnd, global);
+      while (!lp->events->IsEmpty ()
+             && lp->events->PeekNext ().key.m_ts < lp->windowEnd)
+        {
+          ProcessOneEvent (lp);
+        }
+      m_barrier.Wait ();
+      EndRound (lp, lp->windowEnd);
+    }
+  m_currentLp = 0;
+}
+
+void
+MultithreadedSimulatorImpl::EndRound (LogicalProcess *lp, uint64_t ts)
+{
+  // the other threads only receive their messages before the next
+  // barrier, they do not run events meanwhile
+  if (lp->id == 0 && ts != NO_EVENT)
+    {
+      for (uint32_t i = 0; i < m_roundCallbacks.size (); ++i)
+        {
+          m_roundCallbacks[i] (TimeStep (ts));
+        }
+    }
+}
+
+void
+MultithreadedSimulatorImpl::AddRoundCallback (Callback<void, Time> cb)
+{
+  NS_LOG_FUNCTION (this);
+  NS_ASSERT (!m_running);
+  m_roundCallbacks.push_back (cb);
+}
+
+void
+MultithreadedSimulatorImpl::Run (void)
+{
+  NS_LOG_FUNCTION (this);
+  NS_ASSERT (!m_running);
+  m_stop = false;
+  Partition ();
+  CalculateLookAhead ();
+
+  m_running = true;
+  for (uint32_t k = 1; k < m_lps.size (); ++k)
+    {
+      m_lps[k]->thread = Create<SystemThread> (MakeCallback (&LogicalProcess::Run, m_lps[k]));
+      m_lps[k]->thread->Start ();
+    }
+  RunPartition (m_lps[0]);
+  for (uint32_t k = 1; k < m_lps.size (); ++k)
+    {
+      m_lps[k]->thread->Join ();
+      m_lps[k]->thread = 0;
+    }
+  m_running = false;
+  Merge ();
+
+  // If the simulator stopped naturally by lack of events, make a
+  // consistency test to check that we didn't lose any events along the way.
+  NS_ASSERT (!m_events->IsEmpty () || m_unscheduledEvents == 0);
+}
+
+bool
+MultithreadedSimulatorImpl::IsFinished (void) const
+{
+  return m_events->IsEmpty () || m_stop;
+}
+
+uint32_t
+MultithreadedSimulatorImpl::GetSystemId (void) const
+{
+  LogicalProcess *lp = m_currentLp;
+  return lp == 0 ? 0 : lp->id;
+}
+
+void
+MultithreadedSimulatorImpl::Stop (void)
+{
+  m_stop = true;
+}
+
+void
+MultithreadedSimulatorImpl::Stop (Time const &time)
+{
+  Simulator::Schedule (time, &Simulator::Stop);
+}
+
+//
+// Schedule an event for a _relative_ time in the future.
+//
+EventId
+MultithreadedSimulatorImpl::Schedule (Time const &time, EventImpl *event)
+{
+  LogicalProcess *lp = m_currentLp;
+  uint64_t now = lp == 0 ? m_currentTs : lp->currentTs;
+  Time tAbsolute = time + TimeStep (now);
+
+  NS_ASSERT (tAbsolute.IsPositive ());
+  NS_ASSERT (tAbsolute >= TimeStep (now));
+  Scheduler::Event ev;
+  ev.impl = event;
+  ev.key.m_ts = static_cast<uint64_t> (tAbsolute.GetTimeStep ());
+  ev.key.m_context = GetContext ();
+  Insert (lp, ev);
+  return EventId (event, ev.key.m_ts, ev.key.m_context, ev.key.m_uid);
+}
+
+void
+MultithreadedSimulatorImpl::ScheduleWithContext (uint32_t context, Time const &time, EventImpl *event)
+{
+  LogicalProcess *lp = m_currentLp;
+  Scheduler::Event ev;
+  ev.impl = event;
+  ev.key.m_context = context;
+  if (lp == 0)
+    {
+      // before the run, or from a global event while the partitions wait
+      ev.key.m_ts = m_currentTs + time.GetTimeStep ();
+      Insert (m_running ? GetOwner (context) : 0, ev);
+      return;
+    }
+
+  ev.key.m_ts = lp->currentTs + time.GetTimeStep ();
+  LogicalProcess *owner = GetOwner (context);
+  if (owner == lp)
+    {
+      Insert (lp, ev);
+      return;
+    }
+  if (ev.key.m_ts < lp->windowEnd)
+    {
+      NS_FATAL_ERROR ("MultithreadedSimulatorImpl: event for context " << context
+                      << " scheduled " << time << " ahead by context " << lp->currentContext
+                      << ", less than the lookahead " << GetLookAhead ());
+    }
+  // the uid is given by the receiver
+  lp->outbox[owner == 0 ? m_lps.size () : owner->id].push_back (ev);
+}
+
+EventId
+MultithreadedSimulatorImpl::ScheduleNow (EventImpl *event)
+{
+  LogicalProcess *lp = m_currentLp;
+  Scheduler::Event ev;
+  ev.impl = event;
+  ev.key.m_ts = lp == 0 ? m_currentTs : lp->currentTs;
+  ev.key.m_context = GetContext ();
+  Insert (lp, ev);
+  return EventId (event, ev.key.m_ts, ev.key.m_context, ev.key.m_uid);
+}
+
+EventId
+MultithreadedSimulatorImpl::ScheduleDestroy (EventImpl *event)
+{
+  EventId id (Ptr<EventImpl> (event, false), Now ().GetTimeStep (), 0xffffffff, 2);
+  CriticalSection cs (m_destroyEventsMutex);
+  m_destroyEvents.push_back (id);
+  return id;
+}
+
+Time
+MultithreadedSimulatorImpl::Now (void) const
+{
+  LogicalProcess *lp = m_currentLp;
+  return TimeStep (lp == 0 ? m_currentTs : lp->currentTs);
+}
+
+Time
+MultithreadedSimulatorImpl::GetDelayLeft (const EventId &id) const
+{
+  if (IsExpired (id))
+    {
+      return TimeStep (0);
+    }
+  else
+    {
+      return TimeStep (id.GetTs ()) - Now ();
+    }
+}
+
+void
+MultithreadedSimulatorImpl::Remove (const EventId &id)
+{
+  if (id.GetUid () == 2)
+    {
+      // destroy events.
+      CriticalSection cs (m_destroyEventsMutex);
+      for (DestroyEvents::iterator i = m_destroyEvents.begin (); i != m_destroyEvents.end (); i++)
+        {
+          if (*i == id)
+            {
+              m_destroyEvents.erase (i);
+              break;
+            }
+        }
+      return;
+    }
+  if (IsExpired (id))
+    {
+      return;
+    }
+  LogicalProcess *lp = m_running ? GetOwner (id.GetContext ()) : 0;
+  NS_ASSERT_MSG (m_currentLp == 0 || m_currentLp == lp,
+                 "MultithreadedSimulatorImpl: cannot remove an event of another partition");
+  Scheduler::Event event;
+  event.impl = id.PeekEventImpl ();
+  event.key.m_ts = id.GetTs ();
+  event.key.m_context = id.GetContext ();
+  event.key.m_uid = id.GetUid ();
+  if (lp == 0)
+    {
+      m_events->Remove (event);
+      m_unscheduledEvents--;
+    }
+  else
+    {
+      lp->events->Remove (event);
+      lp->unscheduledEvents--;
+    }
+  event.impl->Cancel ();
+  // whenever we remove an event from the event list, we have to unref it.
+  event.impl->Unref ();
+}
+
+void
+MultithreadedSimulatorImpl::Cancel (const EventId &id)
+{
+  if (!IsExpired (id))
+    {
+      id.PeekEventImpl ()->Cancel ();
+    }
+}
+
+bool
+MultithreadedSimulatorImpl::IsExpired (const EventId &ev) const
+{
+  if (ev.GetUid () == 2)
+    {
+      if (ev.PeekEventImpl () == 0
+          || ev.PeekEventImpl ()->IsCancelled ())
+        {
+          return true;
+        }
+      // destroy events.
+      CriticalSection cs (const_cast<SystemMutex &> (m_destroyEventsMutex));
+      for (DestroyEvents::const_iterator i = m_destroyEvents.begin (); i != m_destroyEvents.end (); i++)
+        {
+          if (*i == ev)
+            {
+              return false;
+            }
+        }
+      return true;
+    }
+  // compare with the clock of the partition that owns the event
+  LogicalProcess *lp = m_running ? GetOwner (ev.GetContext ()) : 0;
+  uint64_t currentTs = lp == 0 ? m_currentTs : lp->currentTs;
+  uint32_t currentUid = lp == 0 ? m_currentUid : lp->currentUid;
+  if (ev.PeekEventImpl () == 0
+      || ev.GetTs () < currentTs
+      || (ev.GetTs () == currentTs
+          && ev.GetUid () <= currentUid)
+      || ev.PeekEventImpl ()->IsCancelled ())
+    {
+      return true;
+    }
+  else
+    {
+      return false;
+    }
+}
+
+Time
+MultithreadedSimulatorImpl::GetMaximumSimulationTime (void) const
+{
+  // XXX: I am fairly certain other compilers use other non-standard
+  // post-fixes to indicate 64 bit constants.
+  return TimeStep (0x7fffffffffffffffLL);
+}
+
+uint32_t
+MultithreadedSimulatorImpl::GetContext (void) const
+{
+  LogicalProcess *lp = m_currentLp;
+  return lp == 0 ? m_currentContext : lp->currentContext;
+}
+
+Time
+MultithreadedSimulatorImpl::GetLookAhead (void) const
+{
+  if (m_lookAhead == NO_EVENT)
+    {
+      return GetMaximumSimulationTime ();
+    }
+  return TimeStep (m_lookAhead);
+}
+
+} // namespace ns3
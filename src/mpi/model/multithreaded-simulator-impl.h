@@ -0,0 +1,185 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#ifndef MULTITHREADED_SIMULATOR_IMPL_H
+#define MULTITHREADED_SIMULATOR_IMPL_H
+
+#include "ns3/simulator-impl.h"
+#include "ns3/scheduler.h"
+#include "ns3/event-impl.h"
+#include "ns3/object-factory.h"
+#include "ns3/callback.h"
+#include "ns3/nstime.h"
+#include "ns3/system-mutex.h"
+#include "ns3/thread-local.h"
+#include "ns3/ptr.h"
+
+#include <list>
+#include <vector>
+
+namespace ns3 {
+
+/**
+ * \ingroup mpi
+ *
+ * \brief Barrier between the threads of a MultithreadedSimulatorImpl.
+ *
+ * Threads spin for a while and then yield, since the rounds of a
+ * simulation are usually much shorter than a sleep on a condition.
+ */
+class SpinBarrier
+{
+public:
+  SpinBarrier ();
+  /**
+   * \param n number of threads that call Wait in every round
+   */
+  void SetCount (uint32_t n);
+  /**
+   * Block until the n threads have called Wait. Memory written by any
+   * thread before the call is visible to all of them after it.
+   */
+  void Wait (void);
+
+private:
+  uint32_t m_n;
+  volatile uint32_t m_arrived;
+  volatile uint32_t m_generation;
+};
+
+/**
+ * \ingroup mpi
+ *
+ * \brief Conservative parallel simulator running one thread per partition
+ *
+ * The nodes are partitioned by their system id, as for
+ * DistributedSimulatorImpl, but the partitions (logical processes) are the
+ * threads of a single process and share the topology: no MPI and no remote
+ * channels are needed. Every event scheduled with a node context belongs
+ * to the partition of that node and has its own event queue; the events
+ * without a node context (e.g. Simulator::Stop, samplers scheduled by the
+ * main program) form a global queue.
+ *
+ * The threads advance in rounds separated by barriers. A round processes
+ * the events of every partition that are earlier than the earliest pending
+ * event plus the lookahead, the smallest delay of the channels linking two
+ * partitions. An event scheduled in another partition is at least one
+ * lookahead away, so it is handed over at the end of the round through a
+ * per-pair mailbox, without locks. Global events are processed by the main
+ * thread alone, while the other threads wait; they may touch any node.
+ *
+ * The code run by the nodes must not share mutable state between
+ * partitions: the packet caches and uids are kept per thread for this
+ * purpose, and the reference counts of packets handed to another partition
+ * must not be touched by the sender afterwards.
+ *
+ * A run is deterministic for a given partition, but events of different
+ * partitions with the same timestamp may be ordered differently from a
+ * sequential run. Simulator::Stop called by a node event takes effect at
+ * the end of the current round.
+ */
+class MultithreadedSimulatorImpl : public SimulatorImpl
+{
+public:
+  static TypeId GetTypeId (void);
+
+  MultithreadedSimulatorImpl ();
+  ~MultithreadedSimulatorImpl ();
+
+  // virtual from SimulatorImpl
+  virtual void Destroy ();
+  virtual bool IsFinished (void) const;
+  virtual void Stop (void);
+  virtual void Stop (Time const &time);
+  virtual EventId Schedule (Time const &time, EventImpl *event);
+  virtual void ScheduleWithContext (uint32_t context, Time const &time, EventImpl *event);
+  virtual EventId ScheduleNow (EventImpl *event);
+  virtual EventId ScheduleDestroy (EventImpl *event);
+  virtual void Remove (const EventId &ev);
+  virtual void Cancel (const EventId &ev);
+  virtual bool IsExpired (const EventId &ev) const;
+  virtual void Run (void);
+  virtual Time Now (void) const;
+  virtual Time GetDelayLeft (const EventId &id) const;
+  virtual Time GetMaximumSimulationTime (void) const;
+  virtual void SetScheduler (ObjectFactory schedulerFactory);
+  virtual uint32_t GetSystemId (void) const;
+  virtual uint32_t GetContext (void) const;
+
+  /**
+   * \return the lookahead of the last run, the smallest delay of the
+   * channels between two partitions
+   */
+  Time GetLookAhead (void) const;
+
+  /**
+   * Call cb on the main thread between two rounds, while the other threads
+   * wait, with the time before which every event has been processed. For
+   * the output that is buffered per thread and written in time order, see
+   * QbbTraceWriter.
+   */
+  void AddRoundCallback (Callback<void, Time> cb);
+
+private:
+  struct LogicalProcess;
+  friend struct LogicalProcess;
+
+  virtual void DoDispose (void);
+  void Partition (void);
+  void CalculateLookAhead (void);
+  void Merge (void);
+  void RunPartition (LogicalProcess *lp);
+  void ReceiveMessages (LogicalProcess *lp);
+  void EndRound (LogicalProcess *lp, uint64_t ts);
+  void ProcessGlobalEvents (uint64_t ts);
+  void ProcessOneEvent (LogicalProcess *lp);
+  void Insert (LogicalProcess *lp, Scheduler::Event &ev);
+  LogicalProcess *GetOwner (uint32_t context) const;
+
+  typedef std::list<EventId> DestroyEvents;
+
+  DestroyEvents m_destroyEvents;
+  SystemMutex m_destroyEventsMutex;
+  volatile bool m_stop;
+  ObjectFactory m_schedulerFactory;
+  // the global events, and all the events between two runs
+  Ptr<Scheduler> m_events;
+  uint32_t m_uid;
+  uint32_t m_currentUid;
+  uint64_t m_currentTs;
+  uint32_t m_currentContext;
+  // number of events that have been inserted but not yet scheduled,
+  // not counting the "destroy" events; this is used for validation
+  int m_unscheduledEvents;
+
+  // only valid while Run is active
+  bool m_running;
+  std::vector<LogicalProcess *> m_lps;
+  std::vector<uint32_t> m_partitionOfNode;
+  uint32_t m_uidStride;
+  uint64_t m_lookAhead;
+  uint64_t m_globalNextTs;
+  SpinBarrier m_barrier;
+  std::vector<Callback<void, Time> > m_roundCallbacks;
+
+  // the partition run by the calling thread, 0 outside of Run and while
+  // the main thread processes global events
+  static NS_THREAD_LOCAL LogicalProcess *m_currentLp;
+};
+
+} // namespace ns3
+
+#endif /* MULTITHREADED_SIMULATOR_IMPL_H */
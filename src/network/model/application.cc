@@ -53,6 +53,7 @@ Application::GetTypeId (void)
 
 // \brief Application Constructor
 Application::Application()
+  : m_running (false)
 {
 }
 
@@ -85,14 +86,38 @@ Application::DoDispose (void)
 void
 Application::DoStart (void)
 {
-  m_startEvent = Simulator::Schedule (m_startTime, &Application::StartApplication, this);
+  m_startEvent = Simulator::Schedule (m_startTime, &Application::DoStartApplication, this);
   if (m_stopTime != TimeStep (0))
     {
-      m_stopEvent = Simulator::Schedule (m_stopTime, &Application::StopApplication, this);
+      m_stopEvent = Simulator::Schedule (m_stopTime, &Application::DoStopApplication, this);
     }
   Object::DoStart ();
 }
 
+void
+Application::StopNow (void)
+{
+  if (m_running)
+    {
+      m_stopEvent.Cancel ();
+      DoStopApplication ();
+    }
+}
+
+void
+Application::DoStartApplication (void)
+{
+  m_running = true;
+  StartApplication ();
+}
+
+void
+Application::DoStopApplication (void)
+{
+  m_running = false;
+  StopApplication ();
+}
+
 Ptr<Node> Application::GetNode () const
 {
   return m_node;
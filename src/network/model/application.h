@@ -91,6 +91,15 @@ public:
    */
   void SetStopTime (Time stop);
 
+  /**
+   * \brief Stop the application now, if it has started and not stopped yet
+   *
+   * The StopApplication method is called as at the stop time, which is
+   * cancelled. Used to tear an application down while the simulation
+   * runs, see Node::RemoveApplication.
+   */
+  void StopNow (void);
+
   /**
    * \returns the Node to which this Application object is attached.
    */
@@ -119,6 +128,11 @@ private:
    * subclasses.
    */
   virtual void StopApplication (void);
+
+  void DoStartApplication (void);
+  void DoStopApplication (void);
+
+  bool m_running;       // between StartApplication and StopApplication
 protected:
   virtual void DoDispose (void);
   virtual void DoStart (void);
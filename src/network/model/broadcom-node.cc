@@ -32,8 +32,9 @@
 #include "ns3/global-value.h"
 #include "ns3/boolean.h"
 #include "ns3/simulator.h"
+#include "ns3/nstime.h"
+#include "ns3/trace-source-accessor.h"
 #include "ns3/broadcom-node.h"
-#include "ns3/random-variable.h"
 
 NS_LOG_COMPONENT_DEFINE("BroadcomNode");
 
@@ -46,7 +47,18 @@ namespace ns3 {
 	{
 		static TypeId tid = TypeId("ns3::BroadcomNode")
 			.SetParent<Object>()
-			.AddConstructor<BroadcomNode>();
+			.AddConstructor<BroadcomNode>()
+			.AddAttribute("DropLogInterval",
+				"Minimum time between two WARNING lines about admission drops, which report the drops since the previous one. Zero disables them.",
+				TimeValue(MilliSeconds(1)),
+				MakeTimeAccessor(&BroadcomNode::m_dropLogInterval),
+				MakeTimeChecker())
+			.AddTraceSource("AdmissionDrop", "A packet of an ingress PG failed admission control (port, PG, DropReason).",
+				MakeTraceSourceAccessor(&BroadcomNode::m_dropTrace))
+			.AddTraceSource("EcnMark", "A packet of an egress queue was marked CE (port, queue).",
+				MakeTraceSourceAccessor(&BroadcomNode::m_ecnMarkTrace))
+			.AddTraceSource("PfcFrame", "A PFC frame was sent for an ingress PG or received for an egress queue (port, PG, sent, PAUSE).",
+				MakeTraceSourceAccessor(&BroadcomNode::m_pfcTrace));
 		return tid;
 	}
 
@@ -60,6 +72,7 @@ namespace ns3 {
 		{
 			m_usedIngressPortBytes[i] = 0;
 			m_usedEgressPortBytes[i] = 0;
+			m_pausedPGs[i] = 0;
 			for (uint32_t j = 0; j < qCnt; j++)
 			{
 				m_usedIngressPGBytes[i][j] = 0;
@@ -67,6 +80,7 @@ namespace ns3 {
 				m_usedEgressQMinBytes[i][j] = 0;
 				m_usedEgressQSharedBytes[i][j] = 0;
 				m_pause_remote[i][j] = false;
+				m_counters[i][j] = Counters();
 			}
 		}
 		for (int i = 0; i < 4; i++)
@@ -109,17 +123,29 @@ namespace ns3 {
 		m_log_end = 2.2;
 		m_log_step = 0.00001;
 
+		m_dropReason = DROP_BUFFER_FULL;
+		m_nextDropLog = Seconds(0);
+		m_dropsSinceLog = 0;
+
+		m_uniform = CreateObject<UniformRandomVariable>();
 	}
 
 	BroadcomNode::~BroadcomNode()
 	{}
 
+	int64_t
+		BroadcomNode::AssignStreams(int64_t stream)
+	{
+		m_uniform->SetStream(stream);
+		return 1;
+	}
+
 	bool
 		BroadcomNode::CheckIngressAdmission(uint32_t port, uint32_t qIndex, uint32_t psize)
 	{
 		if (m_usedTotalBytes + psize > m_maxBufferBytes)  //buffer full, usually should not reach here.
 		{
-			std::cout << "WARNING: Drop because ingress buffer full\n";
+			m_dropReason = DROP_BUFFER_FULL;
 			return false;
 		}
 		if (m_usedIngressPGBytes[port][qIndex] + psize > m_pg_min_cell && m_usedIngressPortBytes[port] + psize > m_port_min_cell) // exceed guaranteed, use share buffer
@@ -128,7 +154,7 @@ namespace ns3 {
 			{
 				if (m_usedIngressPGHeadroomBytes[port][qIndex] + psize > m_pg_hdrm_limit) // exceed headroom space
 				{
-					std::cout << "WARNING: Drop because ingress headroom full:" << m_usedIngressPGHeadroomBytes[port][qIndex] << "\t" << m_pg_hdrm_limit << "\n";
+					m_dropReason = DROP_HEADROOM_FULL;
 					return false;
 				}
 			}
@@ -144,17 +170,17 @@ namespace ns3 {
 	{
 		if (m_usedEgressSPBytes[GetEgressSP(port, qIndex)] + psize > m_op_buffer_shared_limit_cell)  //exceed the sp limit
 		{
-			std::cout << "WARNING: Drop because egress SP buffer full\n";
+			m_dropReason = DROP_EGRESS_SP_FULL;
 			return false;
 		}
 		if (m_usedEgressPortBytes[port] + psize > m_op_uc_port_config_cell)	//exceed the port limit
 		{
-			std::cout << "WARNING: Drop because egress Port buffer full\n";
+			m_dropReason = DROP_EGRESS_PORT_FULL;
 			return false;
 		}
 		if (m_usedEgressQSharedBytes[port][qIndex] + psize > m_op_uc_port_config1_cell) //exceed the queue limit
 		{
-			std::cout << "WARNING: Drop because egress Q buffer full\n";
+			m_dropReason = DROP_EGRESS_QUEUE_FULL;
 			return false;
 		}
 		return true;
@@ -172,6 +198,20 @@ namespace ns3 {
 		{
 			m_usedIngressPGHeadroomBytes[port][qIndex] += psize;
 		}
+		if (!m_pfcCallback[port].IsNull())
+		{
+			bool pClasses[qCnt] = { 0 };
+			GetPauseClasses(port, qIndex, pClasses);
+			for (uint32_t i = 0; i < qCnt; i++)
+			{
+				if (pClasses[i] && !m_pause_remote[port][i])	//XOFF
+				{
+					m_pause_remote[port][i] = true;
+					m_pausedPGs[port]++;
+					m_pfcCallback[port](i, true);
+				}
+			}
+		}
 		return;
 	}
 
@@ -212,6 +252,16 @@ namespace ns3 {
 			m_usedIngressPGHeadroomBytes[port][qIndex] -= psize;
 		else
 			m_usedIngressPGHeadroomBytes[port][qIndex] = 0;
+		if (m_pausedPGs[port] > 0)
+		{
+			for (uint32_t i = 0; i < qCnt; i++)
+			{
+				if (m_pause_remote[port][i] && GetResumeClasses(port, i))	//XON
+				{
+					Resume(port, i);
+				}
+			}
+		}
 		return;
 	}
 
@@ -310,6 +360,30 @@ namespace ns3 {
 		return false;
 	}
 
+	void
+		BroadcomNode::SetPfcCallback(uint32_t port, Callback<void, uint32_t, bool> cb)
+	{
+		m_pfcCallback[port] = cb;
+	}
+
+	bool
+		BroadcomNode::RefreshPause(uint32_t port, uint32_t pg)
+	{
+		if (m_pause_remote[port][pg] && GetResumeClasses(port, pg))
+		{
+			Resume(port, pg);
+		}
+		return m_pause_remote[port][pg];
+	}
+
+	void
+		BroadcomNode::Resume(uint32_t port, uint32_t pg)
+	{
+		m_pause_remote[port][pg] = false;
+		m_pausedPGs[port]--;
+		m_pfcCallback[port](pg, false);
+	}
+
 	uint32_t
 		BroadcomNode::GetIngressSP(uint32_t port, uint32_t pgIndex)
 	{
@@ -344,7 +418,7 @@ namespace ns3 {
 				if (m_usedEgressQSharedBytes[ifindex][qIndex] > m_dctcp_threshold && m_dctcp_threshold != m_dctcp_threshold_max)
 				{
 					double p = 1.0 * (m_usedEgressQSharedBytes[ifindex][qIndex] - m_dctcp_threshold) / (m_dctcp_threshold_max - m_dctcp_threshold);
-					if (UniformVariable(0, 1).GetValue() < p)
+					if (m_uniform->GetValue() < p)
 						return true;
 				}
 			}
@@ -359,7 +433,7 @@ namespace ns3 {
 			else if (m_usedEgressQSharedBytes[ifindex][qIndex] > m_pg_qcn_threshold && m_pg_qcn_threshold != m_pg_qcn_threshold_max)
 			{
 				double p = 1.0 * (m_usedEgressQSharedBytes[ifindex][qIndex] - m_pg_qcn_threshold) / (m_pg_qcn_threshold_max - m_pg_qcn_threshold) * m_pg_qcn_maxp;
-				if (UniformVariable(0, 1).GetValue() < p)
+				if (m_uniform->GetValue() < p)
 					return true;
 			}
 			return false;
@@ -408,6 +482,124 @@ namespace ns3 {
 		return m_usedTotalBytes;
 	}
 
+	uint32_t
+		BroadcomNode::GetUsedIngressPGBytes(uint32_t port, uint32_t pg) const
+	{
+		return m_usedIngressPGBytes[port][pg];
+	}
+
+	uint32_t
+		BroadcomNode::GetUsedIngressPGHeadroomBytes(uint32_t port, uint32_t pg) const
+	{
+		return m_usedIngressPGHeadroomBytes[port][pg];
+	}
+
+	uint32_t
+		BroadcomNode::GetUsedEgressQBytes(uint32_t port, uint32_t qIndex) const
+	{
+		return m_usedEgressQMinBytes[port][qIndex] + m_usedEgressQSharedBytes[port][qIndex];
+	}
+
+	bool
+		BroadcomNode::IsPauseSent(uint32_t port, uint32_t pg) const
+	{
+		return m_pause_remote[port][pg];
+	}
+
+	const char*
+		BroadcomNode::GetDropReasonName(uint32_t reason)
+	{
+		static const char* names[DROP_REASONS] = {
+			"ingress buffer full",
+			"ingress headroom full",
+			"egress SP buffer full",
+			"egress Port buffer full",
+			"egress Q buffer full"
+		};
+		return reason < DROP_REASONS ? names[reason] : "unknown";
+	}
+
+	void
+		BroadcomNode::RecordDrop(uint32_t port, uint32_t pg)
+	{
+		m_counters[port][pg].drops[m_dropReason]++;
+		m_dropTrace(port, pg, m_dropReason);
+		if (m_dropLogInterval.IsZero())
+			return;
+		m_dropsSinceLog++;
+		if (Simulator::Now() >= m_nextDropLog)
+		{
+			std::cout << "WARNING: Drop because " << GetDropReasonName(m_dropReason) << " at port " << port << " PG " << pg
+				<< " (" << m_dropsSinceLog << " drops since the last warning)\n";
+			m_dropsSinceLog = 0;
+			m_nextDropLog = Simulator::Now() + m_dropLogInterval;
+		}
+	}
+
+	uint32_t
+		BroadcomNode::GetDroppedPackets(uint32_t port, uint32_t pg) const
+	{
+		uint32_t n = 0;
+		for (uint32_t r = 0; r < DROP_REASONS; r++)
+			n += m_counters[port][pg].drops[r];
+		return n;
+	}
+
+	void
+		BroadcomNode::RecordEcnMark(uint32_t port, uint32_t qIndex)
+	{
+		m_counters[port][qIndex].ecnMarks++;
+		m_ecnMarkTrace(port, qIndex);
+	}
+
+	void
+		BroadcomNode::RecordPfcSent(uint32_t port, uint32_t pg, bool pause)
+	{
+		if (pause)
+			m_counters[port][pg].pauseSent++;
+		else
+			m_counters[port][pg].resumeSent++;
+		m_pfcTrace(port, pg, true, pause);
+	}
+
+	void
+		BroadcomNode::RecordPfcReceived(uint32_t port, uint32_t qIndex, bool pause)
+	{
+		if (pause)
+			m_counters[port][qIndex].pauseReceived++;
+		else
+			m_counters[port][qIndex].resumeReceived++;
+		m_pfcTrace(port, qIndex, false, pause);
+	}
+
+	const BroadcomNode::Counters&
+		BroadcomNode::GetCounters(uint32_t port, uint32_t pg) const
+	{
+		return m_counters[port][pg];
+	}
+
+	void
+		BroadcomNode::PrintCounters(std::ostream &os, uint32_t nodeId) const
+	{
+		for (uint32_t i = 0; i < pCnt; i++)
+		{
+			for (uint32_t j = 0; j < qCnt; j++)
+			{
+				const Counters &c = m_counters[i][j];
+				bool any = c.ecnMarks || c.pauseSent || c.resumeSent || c.pauseReceived || c.resumeReceived;
+				for (uint32_t r = 0; r < DROP_REASONS; r++)
+					any = any || c.drops[r];
+				if (!any)
+					continue;
+				os << nodeId << " " << i << " " << j;
+				for (uint32_t r = 0; r < DROP_REASONS; r++)
+					os << " " << c.drops[r];
+				os << " " << c.ecnMarks << " " << c.pauseSent << " " << c.resumeSent
+					<< " " << c.pauseReceived << " " << c.resumeReceived << "\n";
+			}
+		}
+	}
+
 	void
 		BroadcomNode::SetDynamicThreshold()
 	{
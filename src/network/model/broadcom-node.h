@@ -21,11 +21,15 @@
 #define BROADCOM_NODE_H
 
 #include <vector>
+#include <ostream>
 
 #include "ns3/object.h"
 #include "ns3/callback.h"
 #include "ns3/ptr.h"
 #include "ns3/net-device.h"
+#include "ns3/random-variable-stream.h"
+#include "ns3/nstime.h"
+#include "ns3/traced-callback.h"
 
 namespace ns3 {
 
@@ -58,6 +62,33 @@ namespace ns3 {
 		static const unsigned qCnt = 8;	// Number of queues/priorities used
 		static const unsigned pCnt = 64;	// Number of ports used
 
+		/// Admission check that dropped a packet
+		enum DropReason
+		{
+			DROP_BUFFER_FULL,
+			DROP_HEADROOM_FULL,
+			DROP_EGRESS_SP_FULL,
+			DROP_EGRESS_PORT_FULL,
+			DROP_EGRESS_QUEUE_FULL,
+			DROP_REASONS
+		};
+		static const char* GetDropReasonName(uint32_t reason);
+
+		/**
+		 * Cumulative event counters of a port and priority: the ingress PG
+		 * for drops and PFC frames sent, the egress queue for ECN marks and
+		 * PFC frames received.
+		 */
+		struct Counters
+		{
+			uint32_t drops[DROP_REASONS];
+			uint32_t ecnMarks;
+			uint32_t pauseSent;
+			uint32_t resumeSent;
+			uint32_t pauseReceived;
+			uint32_t resumeReceived;
+		};
+
 		static TypeId GetTypeId(void);
 
 		BroadcomNode();
@@ -80,6 +111,22 @@ namespace ns3 {
 		void GetPauseClasses(uint32_t port, uint32_t qIndex, bool pClasses[]);
 		bool GetResumeClasses(uint32_t port, uint32_t qIndex);
 
+		/**
+		 * PFC state machine of the ingress PGs. UpdateIngressAdmission and
+		 * RemoveFromIngressAdmission call cb(pg, true) when a PG of the port
+		 * crosses its PAUSE threshold and cb(pg, false) when it falls below
+		 * its resume threshold, once per crossing.
+		 */
+		void SetPfcCallback(uint32_t port, Callback<void, uint32_t, bool> cb);
+		/**
+		 * Called when the PAUSE sent for a PG expires at the upstream device.
+		 * Resumes the PG if its resume threshold was crossed in the meantime
+		 * without a packet of the port leaving, e.g. because the shared
+		 * buffer drained under the dynamic threshold.
+		 * \return true if the PG is still paused and the PAUSE must be renewed
+		 */
+		bool RefreshPause(uint32_t port, uint32_t pg);
+
 		void SetBroadcomParams(
 			uint32_t buffer_cell_limit_sp, //ingress sp buffer threshold p.120
 			uint32_t buffer_cell_limit_sp_shared, //ingress sp buffer shared threshold, nonshare -> share
@@ -101,19 +148,71 @@ namespace ns3 {
 		void SetMarkingThreshold(uint32_t kmin, uint32_t kmax, double pmax);
 		void SetTCPMarkingThreshold(uint32_t kmin, uint32_t kmax);
 
-		bool m_pause_remote[pCnt][qCnt];
-
 		bool ShouldSendCN(uint32_t indev, uint32_t ifindex, uint32_t qIndex);
 
 		uint32_t GetUsedBufferTotal();
 
+		/**
+		 * Occupancy of an ingress PG, including the headroom it uses, and of
+		 * the headroom alone, in bytes.
+		 */
+		uint32_t GetUsedIngressPGBytes(uint32_t port, uint32_t pg) const;
+		uint32_t GetUsedIngressPGHeadroomBytes(uint32_t port, uint32_t pg) const;
+		/// Occupancy of an egress queue, guaranteed and shared, in bytes
+		uint32_t GetUsedEgressQBytes(uint32_t port, uint32_t qIndex) const;
+		/// Whether the ingress PG has sent XOFF upstream and not XON yet
+		bool IsPauseSent(uint32_t port, uint32_t pg) const;
+
+		/**
+		 * Count a packet of the ingress PG that failed admission control,
+		 * for the reason given by the check that failed.
+		 */
+		void RecordDrop(uint32_t port, uint32_t pg);
+		/// Drops of the ingress PG, all reasons together
+		uint32_t GetDroppedPackets(uint32_t port, uint32_t pg) const;
+		void RecordEcnMark(uint32_t port, uint32_t qIndex);
+		void RecordPfcSent(uint32_t port, uint32_t pg, bool pause);
+		void RecordPfcReceived(uint32_t port, uint32_t qIndex, bool pause);
+		const Counters& GetCounters(uint32_t port, uint32_t pg) const;
+		/**
+		 * One line per port and priority with a non-zero counter:
+		 * node port pg, the drops by reason, ecn_marks, pause_sent,
+		 * resume_sent, pause_received and resume_received.
+		 */
+		void PrintCounters(std::ostream &os, uint32_t nodeId) const;
+
 		void SetDynamicThreshold();
 
+		/**
+		 * Assign a fixed random variable stream number to the random variables
+		 * used by this model.  Return the number of streams (possibly zero) that
+		 * have been assigned.
+		 *
+		 * \param stream first stream index to use
+		 * \return the number of stream indices assigned by this model
+		 */
+		int64_t AssignStreams(int64_t stream);
+
 	protected:
 		uint32_t GetIngressSP(uint32_t port, uint32_t pgIndex);
 		uint32_t GetEgressSP(uint32_t port, uint32_t qIndex);
 
 	private:
+		void Resume(uint32_t port, uint32_t pg);
+
+		bool m_pause_remote[pCnt][qCnt];	//< XOFF sent for the ingress PG
+		uint32_t m_pausedPGs[pCnt];
+		Counters m_counters[pCnt][qCnt];
+		DropReason m_dropReason;	//< Of the last failed admission check
+		/* Drops print a WARNING at most once per m_dropLogInterval, with the
+		 * number of drops since the previous one. */
+		Time m_dropLogInterval;
+		Time m_nextDropLog;
+		uint32_t m_dropsSinceLog;
+		TracedCallback<uint32_t, uint32_t, uint32_t> m_dropTrace;	//< port, PG, DropReason
+		TracedCallback<uint32_t, uint32_t> m_ecnMarkTrace;	//< port, queue
+		TracedCallback<uint32_t, uint32_t, bool, bool> m_pfcTrace;	//< port, PG, sent, PAUSE (or RESUME)
+		Callback<void, uint32_t, bool> m_pfcCallback[pCnt];
 
 		uint32_t m_maxBufferBytes;
 		uint32_t m_usedTotalBytes;
@@ -171,6 +270,8 @@ namespace ns3 {
 		uint32_t m_dctcp_threshold;
 		uint32_t m_dctcp_threshold_max;
 		bool m_enable_pfc_on_dctcp;
+
+		Ptr<UniformRandomVariable> m_uniform;	//< ECN marking decisions
 	};
 
 } // namespace ns3
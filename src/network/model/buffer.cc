@@ -46,7 +46,7 @@ static struct Zeroes
 namespace ns3 {
 
 
-uint32_t Buffer::g_recommendedStart = 0;
+NS_THREAD_LOCAL uint32_t Buffer::g_recommendedStart = 0;
 #ifdef BUFFER_FREE_LIST
 /* The following macros are pretty evil but they are needed to allow us to
  * keep track of 3 possible states for the g_freeList variable:
@@ -24,6 +24,7 @@
 #include <vector>
 #include <ostream>
 #include "ns3/assert.h"
+#include "ns3/thread-local.h"
 
 #define noBUFFER_FREE_LIST 1
 
@@ -592,9 +593,9 @@ private:
   /**
    * location in a newly-allocated buffer where you should start
    * writing data. i.e., m_start should be initialized to this 
-   * value.
+   * value. Kept per thread, like the other packet caches.
    */
-  static uint32_t g_recommendedStart;
+  static NS_THREAD_LOCAL uint32_t g_recommendedStart;
 
   /* offset to the start of the virtual zero area from the start 
    * of m_data->m_data
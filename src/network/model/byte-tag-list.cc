@@ -19,6 +19,7 @@
  */
 #include "byte-tag-list.h"
 #include "ns3/log.h"
+#include "ns3/thread-local.h"
 #include <vector>
 #include <string.h>
 
@@ -38,21 +39,21 @@ struct ByteTagListData {
 };
 
 #ifdef USE_FREE_LIST
-static class ByteTagListDataFreeList : public std::vector<struct ByteTagListData *>
-{
-public:
-  ~ByteTagListDataFreeList ();
-} g_freeList;
-static uint32_t g_maxSize = 0;
+typedef std::vector<struct ByteTagListData *> ByteTagListDataFreeList;
+
+// one free list per thread, so that the threads of a multithreaded
+// simulator do not share it; created on first use and never released
+static NS_THREAD_LOCAL ByteTagListDataFreeList *g_freeList = 0;
+static NS_THREAD_LOCAL uint32_t g_maxSize = 0;
 
-ByteTagListDataFreeList::~ByteTagListDataFreeList ()
+static ByteTagListDataFreeList &
+GetFreeList (void)
 {
-  for (ByteTagListDataFreeList::iterator i = begin ();
-       i != end (); i++)
+  if (g_freeList == 0)
     {
-      uint8_t *buffer = (uint8_t *)(*i);
-      delete [] buffer;
+      g_freeList = new ByteTagListDataFreeList ();
     }
+  return *g_freeList;
 }
 #endif /* USE_FREE_LIST */
 
@@ -339,10 +340,11 @@ struct ByteTagListData *
 ByteTagList::Allocate (uint32_t size)
 {
   NS_LOG_FUNCTION (this << size);
-  while (!g_freeList.empty ())
+  ByteTagListDataFreeList &freeList = GetFreeList ();
+  while (!freeList.empty ())
     {
-      struct ByteTagListData *data = g_freeList.back ();
-      g_freeList.pop_back ();
+      struct ByteTagListData *data = freeList.back ();
+      freeList.pop_back ();
       NS_ASSERT (data != 0);
       if (data->size >= size)
         {
@@ -373,7 +375,8 @@ ByteTagList::Deallocate (struct ByteTagListData *data)
   data->count--;
   if (data->count == 0)
     {
-      if (g_freeList.size () > FREE_LIST_SIZE ||
+      ByteTagListDataFreeList &freeList = GetFreeList ();
+      if (freeList.size () > FREE_LIST_SIZE ||
           data->size < g_maxSize)
         {
           uint8_t *buffer = (uint8_t *)data;
@@ -381,7 +384,7 @@ ByteTagList::Deallocate (struct ByteTagListData *data)
         }
       else
         {
-          g_freeList.push_back (data);
+          freeList.push_back (data);
         }
     }
 }
@@ -19,6 +19,7 @@
  *          Mathieu Lacage <mathieu.lacage@sophia.inria.fr>
  */
 #include <iostream>
+#include <algorithm>
 #include "node.h"
 #include "node-list.h"
 #include "net-device.h"
@@ -244,6 +245,16 @@ Node::AddApplication (Ptr<Application> application)
                                   &Application::Start, application);
   return index;
 }
+void
+Node::RemoveApplication (Ptr<Application> application)
+{
+  std::vector<Ptr<Application> >::iterator i =
+    std::find (m_applications.begin (), m_applications.end (), application);
+  NS_ASSERT_MSG (i != m_applications.end (), "Application is not associated to node " << GetId ());
+  m_applications.erase (i);
+  application->StopNow ();
+  application->Dispose ();
+}
 Ptr<Application> 
 Node::GetApplication (uint32_t index) const
 {
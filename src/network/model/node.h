@@ -110,6 +110,14 @@ public:
    * Associated this Application to this Node. 
    */
   uint32_t AddApplication (Ptr<Application> application);
+  /**
+   * \param application Application associated to this node.
+   *
+   * Stop the Application if it is running, dispose of it and remove it
+   * from this Node, e.g. once it is done in a long simulation. The
+   * indexes of the following applications decrease by one.
+   */
+  void RemoveApplication (Ptr<Application> application);
   /**
    * \param index
    * \returns the application associated to this requested index
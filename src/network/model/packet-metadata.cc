@@ -34,19 +34,9 @@ namespace ns3 {
 bool PacketMetadata::m_enable = false;
 bool PacketMetadata::m_enableChecking = false;
 bool PacketMetadata::m_metadataSkipped = false;
-uint32_t PacketMetadata::m_maxSize = 0;
+NS_THREAD_LOCAL uint32_t PacketMetadata::m_maxSize = 0;
 uint16_t PacketMetadata::m_chunkUid = 0;
-PacketMetadata::DataFreeList PacketMetadata::m_freeList;
-
-PacketMetadata::DataFreeList::~DataFreeList ()
-{
-  NS_LOG_FUNCTION (this);
-  for (iterator i = begin (); i != end (); i++)
-    {
-      PacketMetadata::Deallocate (*i);
-    }
-  PacketMetadata::m_enable = false;
-}
+NS_THREAD_LOCAL PacketMetadata::DataFreeList *PacketMetadata::m_freeList = 0;
 
 void
 PacketMetadata::Enable (void)
@@ -593,10 +583,11 @@ PacketMetadata::Create (uint32_t size)
     {
       m_maxSize = size;
     }
-  while (!m_freeList.empty ())
+  DataFreeList &freeList = GetFreeList ();
+  while (!freeList.empty ())
     {
-      struct PacketMetadata::Data *data = m_freeList.back ();
-      m_freeList.pop_back ();
+      struct PacketMetadata::Data *data = freeList.back ();
+      freeList.pop_back ();
       if (data->m_size >= size)
         {
           NS_LOG_LOGIC ("create found size="<<data->m_size);
@@ -619,17 +610,32 @@ PacketMetadata::Recycle (struct PacketMetadata::Data *data)
       PacketMetadata::Deallocate (data);
       return;
     }
-  NS_LOG_LOGIC ("recycle size="<<data->m_size<<", list="<<m_freeList.size ());
+  DataFreeList &freeList = GetFreeList ();
+  NS_LOG_LOGIC ("recycle size="<<data->m_size<<", list="<<freeList.size ());
   NS_ASSERT (data->m_count == 0);
-  if (m_freeList.size () > 1000 ||
+  if (freeList.size () > 1000 ||
       data->m_size < m_maxSize)
     {
       PacketMetadata::Deallocate (data);
     }
   else
     {
-      m_freeList.push_back (data);
+      freeList.push_back (data);
+    }
+}
+
+PacketMetadata::DataFreeList &
+PacketMetadata::GetFreeList (void)
+{
+  // the packets of a multithreaded simulation are created and freed by
+  // several threads, each recycles into its own list. The lists are never
+  // released, so packets destroyed during static destruction are still
+  // recycled safely.
+  if (m_freeList == 0)
+    {
+      m_freeList = new DataFreeList ();
     }
+  return *m_freeList;
 }
 
 struct PacketMetadata::Data *
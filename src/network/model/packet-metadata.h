@@ -26,6 +26,7 @@
 #include "ns3/callback.h"
 #include "ns3/assert.h"
 #include "ns3/type-id.h"
+#include "ns3/thread-local.h"
 #include "buffer.h"
 
 #ifdef WIN32
@@ -298,13 +299,8 @@ private:
     uint64_t packetUid;
   };
 
-  class DataFreeList : public std::vector<struct Data *>
-  {
-public:
-    ~DataFreeList ();
-  };
+  typedef std::vector<struct Data *> DataFreeList;
 
-  friend DataFreeList::~DataFreeList ();
   friend class ItemIterator;
 
   PacketMetadata ();
@@ -340,8 +336,10 @@ public:
   static void Recycle (struct PacketMetadata::Data *data);
   static struct PacketMetadata::Data *Allocate (uint32_t n);
   static void Deallocate (struct PacketMetadata::Data *data);
+  static DataFreeList &GetFreeList (void);
 
-  static DataFreeList m_freeList;
+  // one free list per thread, see GetFreeList
+  static NS_THREAD_LOCAL DataFreeList *m_freeList;
   static bool m_enable;
   static bool m_enableChecking;
 
@@ -350,7 +348,7 @@ public:
   // middle of a simulation, which isn't allowed.
   static bool m_metadataSkipped;
 
-  static uint32_t m_maxSize;
+  static NS_THREAD_LOCAL uint32_t m_maxSize;
   static uint16_t m_chunkUid;
 
   struct Data *m_data;
@@ -28,7 +28,7 @@ NS_LOG_COMPONENT_DEFINE ("Packet");
 
 namespace ns3 {
 
-uint32_t Packet::m_globalUid = 0;
+NS_THREAD_LOCAL uint32_t Packet::m_globalUid = 0;
 
 TypeId 
 ByteTagIterator::Item::GetTypeId (void) const
@@ -34,6 +34,7 @@
 #include "ns3/assert.h"
 #include "ns3/ptr.h"
 #include "ns3/deprecated.h"
+#include "ns3/thread-local.h"
 
 namespace ns3 {
 
@@ -586,7 +587,9 @@ private:
   /* Please see comments above about nix-vector */
   Ptr<NixVector> m_nixVector;
 
-  static uint32_t m_globalUid;
+  // one counter per thread: the uid is qualified by Simulator::GetSystemId,
+  // which is the partition of the calling thread in a multithreaded run
+  static NS_THREAD_LOCAL uint32_t m_globalUid;
 };
 
 std::ostream& operator<< (std::ostream& os, const Packet &packet);
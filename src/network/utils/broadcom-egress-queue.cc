@@ -27,10 +27,32 @@
 #include "drop-tail-queue.h"
 #include "broadcom-egress-queue.h"
 
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+
 NS_LOG_COMPONENT_DEFINE("BEgressQueue");
 
 namespace ns3 {
 
+	namespace {
+
+		const uint32_t NO_FLOW = 0xffffffff;
+
+		inline uint32_t
+			LowestBit(uint64_t bits)
+		{
+#ifdef _MSC_VER
+			unsigned long i;
+			_BitScanForward64(&i, bits);
+			return i;
+#else
+			return __builtin_ctzll(bits);
+#endif
+		}
+
+	} // anonymous namespace
+
 	NS_OBJECT_ENSURE_REGISTERED(BEgressQueue);
 
 	TypeId BEgressQueue::GetTypeId(void)
@@ -55,12 +77,12 @@ namespace ns3 {
 		m_bytesInQueueTotal = 0;
 		m_shareused = 0;
 		m_rrlast = 0;
-		for (uint32_t i = 0; i < fCnt; i++)
-		{
-			m_bytesInQueue[i] = 0;
-			m_queues.push_back(CreateObject<DropTailQueue>());
-		}
+		AddQueues(qCnt);
 		m_fcount = 1; //reserved for highest priority
+		m_flowScheduler = false;
+		m_flowPriority.resize(1, 0);
+		m_nextAvail.resize(1, Time(0));
+		m_nReady = 0;
 		for (uint32_t i = 0; i < qCnt; i++)
 		{
 			m_bwsatisfied[i] = Time(0);
@@ -74,16 +96,34 @@ namespace ns3 {
 		NS_LOG_FUNCTION_NOARGS();
 	}
 
+	void
+		BEgressQueue::AddQueues(uint32_t n)
+	{
+		while (m_queues.size() < n)
+		{
+			m_bytesInQueue.push_back(0);
+			m_queues.push_back(CreateObject<DropTailQueue>());
+		}
+	}
+
 	bool
 		BEgressQueue::DoEnqueue(Ptr<Packet> p, uint32_t qIndex)
 	{
 		NS_LOG_FUNCTION(this << p);
+		if (qIndex >= m_queues.size()) //first packet of a new flow on a QCN NIC
+		{
+			AddQueues(qIndex + 1);
+		}
 
 		if (m_bytesInQueueTotal + p->GetSize() < m_maxBytes)  //infinite queue
 		{
 			m_queues[qIndex]->Enqueue(p);
 			m_bytesInQueueTotal += p->GetSize();
 			m_bytesInQueue[qIndex] += p->GetSize();
+			if (m_queues[qIndex]->GetNPackets() == 1)
+			{
+				UpdateFlow(qIndex);
+			}
 		}
 		else
 		{
@@ -229,7 +269,7 @@ namespace ns3 {
 	}
 
 	Ptr<Packet>
-		BEgressQueue::DoDequeueQCN(bool paused[], Time avail[], uint32_t m_findex_qindex_map[])
+		BEgressQueue::DoDequeueQCN(bool paused[])
 	{
 		NS_LOG_FUNCTION(this);
 		if (m_bytesInQueueTotal == 0)
@@ -246,17 +286,14 @@ namespace ns3 {
 		}
 		else
 		{
-			for (qIndex = 1; qIndex <= m_fcount; qIndex++)
+			if (!m_flowScheduler)
 			{
-				if (!paused[m_findex_qindex_map[(qIndex + m_rrlast) % m_fcount]] && m_queues[(qIndex + m_rrlast) % m_fcount]->GetNPackets() > 0)
-				{
-					if (avail[(qIndex + m_rrlast) % m_fcount].GetTimeStep() > Simulator::Now().GetTimeStep()) //not available now
-						continue;
-					found = true;
-					break;
-				}
+				InitFlowScheduler();
 			}
-			qIndex = (qIndex + m_rrlast) % m_fcount;
+			WakeFlows();
+			//round robin over the flows that are not empty, not paused and available now
+			qIndex = FindReady(paused, (m_rrlast + 1) % m_fcount);
+			found = qIndex != NO_FLOW;
 		}
 		if (found)
 		{
@@ -266,6 +303,10 @@ namespace ns3 {
 			if (qIndex != 0)
 			{
 				m_rrlast = qIndex;
+				if (m_queues[qIndex]->GetNPackets() == 0)
+				{
+					UpdateFlow(qIndex);
+				}
 			}
 			m_qlast = qIndex;
 			NS_LOG_LOGIC("Popped " << p);
@@ -276,6 +317,175 @@ namespace ns3 {
 		return 0;
 	}
 
+	uint32_t
+		BEgressQueue::AddFlow(uint32_t priority)
+	{
+		NS_ASSERT(priority < qCnt);
+		if (!m_freeFlows.empty())
+		{
+			uint32_t qIndex = m_freeFlows.back();
+			m_freeFlows.pop_back();
+			m_flowPriority[qIndex] = priority;
+			return qIndex;
+		}
+		uint32_t qIndex = m_fcount++;
+		AddQueues(m_fcount);
+		m_flowPriority.resize(m_fcount, 0);
+		m_flowPriority[qIndex] = priority;
+		if (m_nextAvail.size() < m_fcount)
+		{
+			m_nextAvail.resize(m_fcount, Time(0));
+		}
+		for (uint32_t i = 0; i < qCnt; i++)
+		{
+			m_ready[i].resize((m_fcount + 63) / 64, 0);
+		}
+		return qIndex;
+	}
+
+	void
+		BEgressQueue::RemoveFlow(uint32_t qIndex)
+	{
+		NS_ASSERT(qIndex > 0 && qIndex < m_fcount);
+		//not ready once empty; zero never matches the time of an entry left in m_waiting
+		m_nextAvail[qIndex] = Time(0);
+		UpdateFlow(qIndex);
+		m_freeFlows.push_back(qIndex);
+	}
+
+	void
+		BEgressQueue::SetNextAvail(uint32_t qIndex, Time t)
+	{
+		if (qIndex >= m_nextAvail.size()) //a priority queue of a NIC without QCN
+		{
+			m_nextAvail.resize(qIndex + 1, Time(0));
+		}
+		m_nextAvail[qIndex] = t;
+		UpdateFlow(qIndex);
+	}
+
+	Time
+		BEgressQueue::GetNextAvail(uint32_t qIndex) const
+	{
+		if (qIndex >= m_nextAvail.size())
+			return Time(0);
+		return m_nextAvail[qIndex];
+	}
+
+	Time
+		BEgressQueue::GetEarliestAvail()
+	{
+		if (!m_flowScheduler)
+		{
+			InitFlowScheduler();
+		}
+		WakeFlows();
+		if (m_nReady > 0)
+		{
+			return Simulator::Now();
+		}
+		//the top of the heap is stale if the flow was emptied or rescheduled since
+		while (!m_waiting.empty())
+		{
+			uint32_t qIndex = m_waiting.top().second;
+			if (m_nextAvail[qIndex].GetTimeStep() == m_waiting.top().first && m_queues[qIndex]->GetNPackets() > 0)
+			{
+				return TimeStep(m_waiting.top().first);
+			}
+			m_waiting.pop();
+		}
+		return Simulator::GetMaximumSimulationTime();
+	}
+
+	void
+		BEgressQueue::InitFlowScheduler()
+	{
+		m_flowScheduler = true;
+		for (uint32_t i = 1; i < m_fcount; i++)
+		{
+			UpdateFlow(i);
+		}
+	}
+
+	void
+		BEgressQueue::UpdateFlow(uint32_t qIndex)
+	{
+		if (!m_flowScheduler || qIndex == 0 || qIndex >= m_fcount)
+		{
+			return;
+		}
+		if (m_queues[qIndex]->GetNPackets() == 0)
+		{
+			SetReady(qIndex, false);
+		}
+		else if (m_nextAvail[qIndex].GetTimeStep() <= Simulator::Now().GetTimeStep())
+		{
+			SetReady(qIndex, true);
+		}
+		else
+		{
+			SetReady(qIndex, false);
+			m_waiting.push(WaitingFlow(m_nextAvail[qIndex].GetTimeStep(), qIndex));
+		}
+	}
+
+	void
+		BEgressQueue::WakeFlows()
+	{
+		int64_t now = Simulator::Now().GetTimeStep();
+		while (!m_waiting.empty() && m_waiting.top().first <= now)
+		{
+			uint32_t qIndex = m_waiting.top().second;
+			if (m_nextAvail[qIndex].GetTimeStep() == m_waiting.top().first && m_queues[qIndex]->GetNPackets() > 0)
+			{
+				SetReady(qIndex, true);
+			}
+			m_waiting.pop();
+		}
+	}
+
+	void
+		BEgressQueue::SetReady(uint32_t qIndex, bool ready)
+	{
+		uint64_t &word = m_ready[m_flowPriority[qIndex]][qIndex / 64];
+		uint64_t bit = (uint64_t)1 << (qIndex % 64);
+		if (ready && !(word & bit))
+		{
+			word |= bit;
+			m_nReady++;
+		}
+		else if (!ready && (word & bit))
+		{
+			word &= ~bit;
+			m_nReady--;
+		}
+	}
+
+	uint32_t
+		BEgressQueue::FindReady(bool paused[], uint32_t start) const
+	{
+		uint32_t nWords = (m_fcount + 63) / 64;
+		uint32_t w = start / 64;
+		uint64_t mask = ~(uint64_t)0 << (start % 64);
+		for (uint32_t k = 0; k <= nWords; k++)	//the first word is visited again for the bits before start
+		{
+			uint64_t bits = 0;
+			for (uint32_t i = 0; i < qCnt; i++)
+			{
+				if (!paused[i])
+					bits |= m_ready[i][w];
+			}
+			bits &= mask;
+			if (bits != 0)
+			{
+				return w * 64 + LowestBit(bits);
+			}
+			mask = ~(uint64_t)0;
+			w = (w + 1 == nWords) ? 0 : w + 1;
+		}
+		return NO_FLOW;
+	}
+
 
 	bool
 		BEgressQueue::Enqueue(Ptr<Packet> p, uint32_t qIndex)
@@ -353,10 +563,10 @@ namespace ns3 {
 	}
 
 	Ptr<Packet>
-		BEgressQueue::DequeueQCN(bool paused[], Time avail[], uint32_t m_findex_qindex_map[])  //do all DequeueNIC does, plus QCN
+		BEgressQueue::DequeueQCN(bool paused[])  //do all DequeueNIC does, plus QCN
 	{
 		NS_LOG_FUNCTION(this);
-		Ptr<Packet> packet = DoDequeueQCN(paused, avail, m_findex_qindex_map);
+		Ptr<Packet> packet = DoDequeueQCN(paused);
 		if (packet != 0)
 		{
 			NS_ASSERT(m_nBytes >= packet->GetSize());
@@ -409,12 +619,13 @@ namespace ns3 {
 		uint32_t qIndex;
 		for (qIndex = 1; qIndex <= qCnt; qIndex++)
 		{
-			if (paused[(qIndex + m_rrlast) % qCnt] == 0 && m_queues[qIndex]->GetNPackets() > 0)
+			if (paused[(qIndex + m_rrlast) % qCnt] == 0 && m_queues[qIndex % qCnt]->GetNPackets() > 0)
 			{
 				found = true;
 				break;
 			}
 		}
+		qIndex = qIndex % qCnt;
 		if (found)
 		{
 			Ptr<Packet> p = m_queues[qIndex]->Dequeue();
@@ -441,13 +652,15 @@ namespace ns3 {
 			return 0;
 		}
 		NS_LOG_LOGIC("Number packets " << m_packets.size());
-		NS_LOG_LOGIC("Number bytes " << m_bytesInQueue);
+		NS_LOG_LOGIC("Number bytes " << m_bytesInQueueTotal);
 		return m_queues[0]->Peek();
 	}
 
 	uint32_t
 		BEgressQueue::GetNBytes(uint32_t qIndex) const
 	{
+		if (qIndex >= m_bytesInQueue.size())
+			return 0;
 		return m_bytesInQueue[qIndex];
 	}
 
@@ -465,32 +678,31 @@ namespace ns3 {
 	}
 
 	void
-		BEgressQueue::RecoverQueue(Ptr<DropTailQueue> buffer, uint32_t i)
+		BEgressQueue::ClearQueue(uint32_t i)
 	{
-		Ptr<Packet> packet;
-		Ptr<DropTailQueue> tmp = CreateObject<DropTailQueue>();
-		//clear orignial queue
 		while (!m_queues[i]->IsEmpty())
 		{
-			packet = m_queues[i]->Dequeue();
+			Ptr<Packet> packet = m_queues[i]->Dequeue();
 			m_bytesInQueue[i] -= packet->GetSize();
 			m_bytesInQueueTotal -= packet->GetSize();
+			m_nBytes -= packet->GetSize();
+			m_nPackets--;
 		}
-		//recover queue and preserve buffer
-		while (!buffer->IsEmpty())
-		{
-			packet = buffer->Dequeue();
-			tmp->Enqueue(packet->Copy());
-			m_queues[i]->Enqueue(packet->Copy());
-			m_bytesInQueue[i] += packet->GetSize();
-			m_bytesInQueueTotal += packet->GetSize();
-		}
-		//restore buffer
-		while (!tmp->IsEmpty())
+		UpdateFlow(i);
+	}
+
+	void
+		BEgressQueue::RecoverPacket(Ptr<Packet> p, uint32_t i)
+	{
+		m_queues[i]->Enqueue(p);
+		m_bytesInQueue[i] += p->GetSize();
+		m_bytesInQueueTotal += p->GetSize();
+		m_nBytes += p->GetSize();
+		m_nPackets++;
+		if (m_queues[i]->GetNPackets() == 1)
 		{
-			buffer->Enqueue(tmp->Dequeue()->Copy());
+			UpdateFlow(i);
 		}
-
 	}
 
 
@@ -22,6 +22,9 @@
 #define BROADCOM_EGRESS_H
 
 #include <queue>
+#include <vector>
+#include <functional>
+#include <utility>
 #include "ns3/packet.h"
 #include "queue.h"
 #include "drop-tail-queue.h"
@@ -35,27 +38,54 @@ namespace ns3 {
 	class BEgressQueue : public Queue {
 	public:
 		static TypeId GetTypeId(void);
-		static const unsigned fCnt = 128; //max number of queues, 128 for NICs
-		static const unsigned qCnt = 8; //max number of queues, 8 for switches
+		static const unsigned qCnt = 8; //number of priority queues; a QCN NIC adds one queue per flow on top
 		BEgressQueue();
 		virtual ~BEgressQueue();
 		bool Enqueue(Ptr<Packet> p, uint32_t qIndex);
 		Ptr<Packet> Dequeue(bool paused[]);
 		Ptr<Packet> DequeueRR(bool paused[]);
 		Ptr<Packet> DequeueNIC(bool paused[]);//QCN disable NIC
-		Ptr<Packet> DequeueQCN(bool paused[], Time avail[], uint32_t m_findex_qindex_map[]);//QCN enable NIC
+		Ptr<Packet> DequeueQCN(bool paused[]);//QCN enable NIC
 		uint32_t GetNBytes(uint32_t qIndex) const;
 		uint32_t GetNBytesTotal() const;
 		uint32_t GetLastQueue();
 		uint32_t m_fcount;
-		void RecoverQueue(Ptr<DropTailQueue> buffer, uint32_t i);
+		/**
+		 * Go-back-N recovery: drop the packets of queue i and put the ones to
+		 * resend back with RecoverPacket. Neither is traced as a dequeue, an
+		 * enqueue or a drop.
+		 */
+		void ClearQueue(uint32_t i);
+		void RecoverPacket(Ptr<Packet> p, uint32_t i);
+
+		/**
+		 * Add a flow queue, paused together with the given priority.
+		 * \return the queue index of the flow
+		 */
+		uint32_t AddFlow(uint32_t priority);
+		/**
+		 * Give the index of flow qIndex, whose queue is empty, to a later
+		 * AddFlow.
+		 */
+		void RemoveFlow(uint32_t qIndex);
+		/**
+		 * Rate limiting of QCN NICs: DequeueQCN skips flow qIndex until t.
+		 */
+		void SetNextAvail(uint32_t qIndex, Time t);
+		Time GetNextAvail(uint32_t qIndex) const;
+		/**
+		 * \return the earliest next available time of the non-empty flow
+		 * queues, no later than now if one of them is available already, or
+		 * the maximum simulation time if they are all empty
+		 */
+		Time GetEarliestAvail();
 
 	private:
 		bool DoEnqueue(Ptr<Packet> p, uint32_t qIndex);
 		Ptr<Packet> DoDequeue(bool paused[]);
 		Ptr<Packet> DoDequeueNIC(bool paused[]);
 		Ptr<Packet> DoDequeueRR(bool paused[]);
-		Ptr<Packet> DoDequeueQCN(bool paused[], Time avail[], uint32_t m_findex_qindex_map[]);
+		Ptr<Packet> DoDequeueQCN(bool paused[]);
 		//for compatibility
 		virtual bool DoEnqueue(Ptr<Packet> p);
 		virtual Ptr<Packet> DoDequeue(void);
@@ -66,7 +96,8 @@ namespace ns3 {
 		uint32_t m_qmincell; //guaranteed see page 126
 		uint32_t m_queuelimit; //limit for each queue
 		uint32_t m_shareused; //used bytes by sharing
-		uint32_t m_bytesInQueue[fCnt];
+		void AddQueues(uint32_t n);
+		std::vector<uint32_t> m_bytesInQueue;
 		uint32_t m_bytesInQueueTotal;
 		uint32_t m_rrlast;
 		uint32_t m_qlast;
@@ -75,6 +106,24 @@ namespace ns3 {
 		//For strict priority
 		Time m_bwsatisfied[qCnt];
 		DataRate m_minBW[qCnt];
+
+		//Eligible flows of DoDequeueQCN. Flows that are not empty and
+		//available now have their bit set in the bitmap of their priority;
+		//those waiting for their next available time are in a heap. Built on
+		//the first DequeueQCN, so other queues don't keep it up to date.
+		typedef std::pair<int64_t, uint32_t> WaitingFlow; //next available time step, queue index
+		void InitFlowScheduler();
+		void UpdateFlow(uint32_t qIndex); //after the backlog or the next available time of qIndex changed
+		void WakeFlows(); //move the flows whose time has come from the heap to the bitmaps
+		void SetReady(uint32_t qIndex, bool ready);
+		uint32_t FindReady(bool paused[], uint32_t start) const;
+		bool m_flowScheduler;
+		std::vector<uint32_t> m_flowPriority;
+		std::vector<Time> m_nextAvail;
+		std::vector<uint32_t> m_freeFlows; //removed flows, reused by AddFlow before m_fcount grows
+		std::vector<uint64_t> m_ready[qCnt];
+		uint32_t m_nReady;
+		std::priority_queue<WaitingFlow, std::vector<WaitingFlow>, std::greater<WaitingFlow> > m_waiting;
 	};
 
 } // namespace ns3
@@ -0,0 +1,196 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#include <string.h>
+#include <algorithm>
+#include "ns3/abort.h"
+#include "ns3/log.h"
+#include "ns3/simulator.h"
+#include "ns3/broadcom-node.h"
+#include "ns3/qbb-net-device.h"
+#include "qbb-buffer-sampler.h"
+
+NS_LOG_COMPONENT_DEFINE ("QbbBufferSampler");
+
+namespace ns3 {
+
+namespace {
+
+const uint32_t FILE_HEADER_SIZE = 12;
+
+inline void
+WriteU16 (uint8_t *&b, uint16_t v)
+{
+  b[0] = v & 0xff;
+  b[1] = (v >> 8) & 0xff;
+  b += 2;
+}
+
+inline void
+WriteU32 (uint8_t *&b, uint32_t v)
+{
+  WriteU16 (b, v & 0xffff);
+  WriteU16 (b, v >> 16);
+}
+
+inline void
+WriteU64 (uint8_t *&b, uint64_t v)
+{
+  WriteU32 (b, v & 0xffffffff);
+  WriteU32 (b, v >> 32);
+}
+
+} // anonymous namespace
+
+const uint16_t QbbBufferSampler::VERSION;
+const uint32_t QbbBufferSampler::RECORD_SIZE;
+
+QbbBufferSampler::QbbBufferSampler (std::string filename, Time interval, bool onChange, uint32_t bufferSize)
+  : m_buffer (std::max (bufferSize, RECORD_SIZE)),
+    m_used (0),
+    m_interval (interval),
+    m_onChange (onChange)
+{
+  NS_LOG_FUNCTION (this << filename << interval << onChange << bufferSize);
+  NS_ABORT_MSG_IF (!interval.IsStrictlyPositive (), "QbbBufferSampler: the interval must be positive");
+  m_file = fopen (filename.c_str (), "wb");
+  NS_ABORT_MSG_IF (m_file == 0, "QbbBufferSampler: cannot open " << filename);
+  uint8_t header[FILE_HEADER_SIZE];
+  uint8_t *b = header;
+  memcpy (b, "QBBS", 4);
+  b += 4;
+  WriteU16 (b, VERSION);
+  WriteU16 (b, RECORD_SIZE);
+  WriteU32 (b, Time::GetResolution ());
+  fwrite (header, 1, FILE_HEADER_SIZE, m_file);
+  WriteSchema (filename + ".schema");
+}
+
+QbbBufferSampler::~QbbBufferSampler ()
+{
+  NS_LOG_FUNCTION (this);
+  Flush ();
+  fclose (m_file);
+  m_file = 0;
+}
+
+void
+QbbBufferSampler::WriteSchema (std::string filename)
+{
+  FILE *f = fopen (filename.c_str (), "w");
+  NS_ABORT_MSG_IF (f == 0, "QbbBufferSampler: cannot open " << filename);
+  fprintf (f, "# QbbBufferSampler version %u: %u-byte header, then %u-byte little-endian records\n",
+           VERSION, FILE_HEADER_SIZE, RECORD_SIZE);
+  fprintf (f, "# time unit %u (ns3::Time::Unit), %s\n", (uint32_t)Time::GetResolution (),
+           m_onChange ? "changed records only" : "every record at every sample");
+  fprintf (f, "time u64 0\n"
+           "node u32 8\n"
+           "port u16 12\n"
+           "pg u8 14\n"
+           "paused u8 15\n"
+           "ingress u32 16\n"
+           "headroom u32 20\n"
+           "egress u32 24\n"
+           "drops u32 28\n");
+  fclose (f);
+}
+
+void
+QbbBufferSampler::Add (Ptr<Node> node)
+{
+  NS_LOG_FUNCTION (this << node);
+  NS_ABORT_MSG_IF (node->m_broadcom == 0, "QbbBufferSampler: node " << node->GetId () << " is not a switch");
+  m_nodes.push_back (node);
+  for (uint32_t j = 0; j < node->GetNDevices (); ++j)
+    {
+      if (node->GetDevice (j)->GetObject<QbbNetDevice> () == 0)
+        {
+          continue;
+        }
+      for (uint32_t pg = 0; pg < QbbNetDevice::qCnt - 1; ++pg)	// the last queue holds PAUSE and CNP frames
+        {
+          Row row;
+          memset (&row, 0, sizeof (row));
+          row.mmu = PeekPointer (node->m_broadcom);
+          row.node = node->GetId ();
+          row.port = j;
+          row.pg = pg;
+          m_rows.push_back (row);
+        }
+    }
+}
+
+void
+QbbBufferSampler::Start (Time start)
+{
+  NS_LOG_FUNCTION (this << start);
+  Simulator::Schedule (start - Simulator::Now (), &QbbBufferSampler::Sample, Ptr<QbbBufferSampler> (this));
+}
+
+void
+QbbBufferSampler::Sample (void)
+{
+  uint64_t now = Simulator::Now ().GetTimeStep ();
+  for (std::vector<Row>::iterator r = m_rows.begin (); r != m_rows.end (); ++r)
+    {
+      uint8_t paused = r->mmu->IsPauseSent (r->port, r->pg);
+      uint32_t ingress = r->mmu->GetUsedIngressPGBytes (r->port, r->pg);
+      uint32_t headroom = r->mmu->GetUsedIngressPGHeadroomBytes (r->port, r->pg);
+      uint32_t egress = r->mmu->GetUsedEgressQBytes (r->port, r->pg);
+      uint32_t drops = r->mmu->GetDroppedPackets (r->port, r->pg);
+      if (m_onChange && paused == r->paused && ingress == r->ingress && headroom == r->headroom
+          && egress == r->egress && drops == r->drops)
+        {
+          continue;
+        }
+      r->paused = paused;
+      r->ingress = ingress;
+      r->headroom = headroom;
+      r->egress = egress;
+      r->drops = drops;
+
+      if (m_used + RECORD_SIZE > m_buffer.size ())
+        {
+          Flush ();
+        }
+      uint8_t *b = &m_buffer[m_used];
+      WriteU64 (b, now);
+      WriteU32 (b, r->node);
+      WriteU16 (b, r->port);
+      *b++ = r->pg;
+      *b++ = r->paused;
+      WriteU32 (b, r->ingress);
+      WriteU32 (b, r->headroom);
+      WriteU32 (b, r->egress);
+      WriteU32 (b, r->drops);
+      m_used += RECORD_SIZE;
+    }
+  Simulator::Schedule (m_interval, &QbbBufferSampler::Sample, Ptr<QbbBufferSampler> (this));
+}
+
+void
+QbbBufferSampler::Flush (void)
+{
+  NS_LOG_FUNCTION (this);
+  if (m_used != 0)
+    {
+      fwrite (&m_buffer[0], 1, m_used, m_file);
+      m_used = 0;
+    }
+  fflush (m_file);
+}
+
+} // namespace ns3
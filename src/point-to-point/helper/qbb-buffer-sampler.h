@@ -0,0 +1,118 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#ifndef QBB_BUFFER_SAMPLER_H
+#define QBB_BUFFER_SAMPLER_H
+
+#include <stdint.h>
+#include <stdio.h>
+#include <string>
+#include <vector>
+#include "ns3/simple-ref-count.h"
+#include "ns3/nstime.h"
+#include "ns3/ptr.h"
+#include "ns3/node.h"
+
+namespace ns3 {
+
+class BroadcomNode;
+
+/**
+ * \brief Periodic samples of the shared buffer of switches.
+ *
+ * Every interval, reads the MMU counters of BroadcomNode for each port and
+ * data PG of the switches added, and writes one fixed-size little-endian
+ * record per (port, PG):
+ *
+ * \verbatim
+   time      u64  simulator time steps
+   node      u32
+   port      u16  interface index
+   pg        u8
+   paused    u8   1 while the PG has XOFF outstanding upstream
+   ingress   u32  bytes held by the ingress PG, headroom included
+   headroom  u32  bytes of the ingress PG in the headroom
+   egress    u32  bytes held by the egress queue of the same index
+   drops     u32  packets of the ingress PG dropped by admission control
+   \endverbatim
+ *
+ * With onChange, a record is written only when one of the last five fields
+ * differs from the previous record of the same (node, port, PG), all of
+ * them being zero before the first; nothing is written for idle ports.
+ *
+ * The file starts with a 12-byte header like the one of QbbTraceWriter,
+ * with the magic "QBBS". A sidecar file, filename + ".schema", lists the
+ * columns as "name type offset" lines, so that the samples can be loaded
+ * directly, e.g. with numpy.fromfile.
+ */
+class QbbBufferSampler : public SimpleRefCount<QbbBufferSampler>
+{
+public:
+  static const uint16_t VERSION = 1;
+  static const uint32_t RECORD_SIZE = 32;
+
+  /**
+   * \param filename the file to create
+   * \param interval time between two samples
+   * \param onChange write only the records that changed
+   * \param bufferSize bytes buffered before each write to the file
+   */
+  QbbBufferSampler (std::string filename, Time interval, bool onChange, uint32_t bufferSize = 1 << 20);
+  ~QbbBufferSampler ();
+
+  /**
+   * Sample the switch node, which must have a BroadcomNode.
+   */
+  void Add (Ptr<Node> node);
+  /**
+   * Take the first sample at time start, and one every interval after
+   * that until the simulation ends.
+   */
+  void Start (Time start);
+  void Flush (void);
+
+private:
+  QbbBufferSampler (const QbbBufferSampler &);
+  QbbBufferSampler &operator = (const QbbBufferSampler &);
+
+  struct Row
+  {
+    BroadcomNode *mmu;
+    uint32_t node;
+    uint16_t port;
+    uint8_t pg;
+    uint8_t paused;
+    uint32_t ingress;
+    uint32_t headroom;
+    uint32_t egress;
+    uint32_t drops;
+  };
+
+  void Sample (void);
+  void WriteSchema (std::string filename);
+
+  FILE *m_file;
+  std::vector<uint8_t> m_buffer;
+  uint32_t m_used;
+  Time m_interval;
+  bool m_onChange;
+  std::vector<Ptr<Node> > m_nodes;
+  std::vector<Row> m_rows;	//< last record of each (node, port, PG), in sampling order
+};
+
+} // namespace ns3
+
+#endif /* QBB_BUFFER_SAMPLER_H */
@@ -0,0 +1,141 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#include <fstream>
+#include <map>
+#include "ns3/log.h"
+#include "ns3/abort.h"
+#include "ns3/qbb-net-device.h"
+#include "qbb-flow-stats.h"
+
+NS_LOG_COMPONENT_DEFINE ("QbbFlowStats");
+
+namespace ns3 {
+
+namespace {
+
+// key shared by the TX flow of the sender and the RX flow of the receiver
+uint64_t
+FlowKey (Ipv4Address src, uint16_t sport, uint16_t pg)
+{
+  return ((uint64_t)src.Get () << 32) | ((uint64_t)sport << 16) | pg;
+}
+
+// the Ipv4Address operator<< only prints part of the address
+void
+PrintAddress (std::ostream &os, Ipv4Address a)
+{
+  uint32_t v = a.Get ();
+  os << (v >> 24) << "." << ((v >> 16) & 0xff) << "." << ((v >> 8) & 0xff) << "." << (v & 0xff);
+}
+
+// the RX flows of a key by the time step of their first packet: flows
+// removed from the NICs leave their key, and so their ports, to later ones
+typedef std::multimap<int64_t, const QbbNetDevice::RxFlowStats *> Arrivals;
+
+void
+AddReceived (std::map<uint64_t, Arrivals> &received,
+             const std::vector<QbbNetDevice::RxFlowStats> &rx)
+{
+  for (uint32_t i = 0; i < rx.size (); i++)
+    {
+      received[FlowKey (rx[i].src, rx[i].sport, rx[i].pg)].insert (
+        std::make_pair (rx[i].start.GetTimeStep (), &rx[i]));
+    }
+}
+
+void
+WriteFlows (std::ostream &os, const std::vector<QbbNetDevice::TxFlowStats> &tx,
+            const std::map<uint64_t, Arrivals> &received)
+{
+  for (uint32_t i = 0; i < tx.size (); i++)
+    {
+      const QbbNetDevice::TxFlowStats &s = tx[i];
+      if (!s.udp)
+        {
+          continue;
+        }
+      // the first RX flow of the key to start after this one did
+      const QbbNetDevice::RxFlowStats *r = 0;
+      std::map<uint64_t, Arrivals>::const_iterator k = received.find (FlowKey (s.src, s.sport, s.pg));
+      if (k != received.end ())
+        {
+          Arrivals::const_iterator a = k->second.lower_bound (s.start.GetTimeStep ());
+          if (a != k->second.end ())
+            {
+              r = a->second;
+            }
+        }
+      int64_t start = s.start.GetNanoSeconds ();
+      int64_t finish = -1;
+      int64_t fct = -1;
+      uint64_t bytes = 0;
+      double goodput = 0;
+      if (r != 0 && r->nextSeq > 0)
+        {
+          finish = r->finish.GetNanoSeconds ();
+          fct = finish - start;
+          bytes = r->bytes;
+          goodput = fct > 0 ? bytes * 8.0 / fct : 0;
+        }
+      PrintAddress (os, s.src);
+      os << " ";
+      PrintAddress (os, s.dst);
+      os << " " << s.sport << " " << s.dport << " " << s.pg
+         << " " << start << " " << finish << " " << fct
+         << " " << s.bytes << " " << bytes << " " << goodput
+         << " " << s.retransmits << " " << s.cnps
+         << " " << (s.pauseAtLastTx - s.pauseAtStart).GetNanoSeconds () << "\n";
+    }
+}
+
+} // anonymous namespace
+
+void
+QbbFlowStats::Add (Ptr<QbbNetDevice> device)
+{
+  m_devices.push_back (device);
+}
+
+void
+QbbFlowStats::Write (std::ostream &os) const
+{
+  NS_LOG_FUNCTION (this);
+  std::map<uint64_t, Arrivals> received;
+  for (uint32_t d = 0; d < m_devices.size (); d++)
+    {
+      AddReceived (received, m_devices[d]->GetRemovedRxFlowStats ());
+      AddReceived (received, m_devices[d]->GetRxFlowStats ());
+    }
+
+  os << "# src dst sport dport pg start_ns finish_ns fct_ns sent_bytes bytes goodput_gbps retransmits cnps pause_ns\n";
+  for (uint32_t d = 0; d < m_devices.size (); d++)
+    {
+      WriteFlows (os, m_devices[d]->GetRemovedTxFlowStats (), received);
+      WriteFlows (os, m_devices[d]->GetTxFlowStats (), received);
+    }
+}
+
+void
+QbbFlowStats::Write (std::string filename) const
+{
+  NS_LOG_FUNCTION (this << filename);
+  std::ofstream os (filename.c_str ());
+  NS_ABORT_MSG_UNLESS (os.is_open (), "QbbFlowStats::Write(): Unable to open " << filename);
+  Write (os);
+}
+
+} // namespace ns3
@@ -0,0 +1,74 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#ifndef QBB_FLOW_STATS_H
+#define QBB_FLOW_STATS_H
+
+#include <ostream>
+#include <string>
+#include <vector>
+#include "ns3/simple-ref-count.h"
+#include "ns3/ptr.h"
+#include "ns3/qbb-net-device.h"
+
+namespace ns3 {
+
+/**
+ * \brief Per-flow completion time and goodput of the UDP flows of qbb NICs.
+ *
+ * The NICs keep a few counters per flow as a side effect of the sequence
+ * and flow tables they maintain anyway (see QbbNetDevice::TxFlowStats and
+ * QbbNetDevice::RxFlowStats); nothing is recorded per packet here. Write
+ * joins the sender and receiver counters of every flow into one row:
+ *
+ * \verbatim
+   src dst sport dport pg start_ns finish_ns fct_ns sent_bytes bytes goodput_gbps retransmits cnps pause_ns
+   \endverbatim
+ *
+ * - start: the first packet of the flow is handed to the sender NIC.
+ * - finish: the last packet received in order by the receiver NIC, -1 (and
+ *   fct -1) if nothing has been received yet.
+ * - sent_bytes, bytes: UDP payload sent for the first time, and received in
+ *   order; the flow is complete when they are equal.
+ * - retransmits: packets sent again by go-back-N recovery.
+ * - cnps: congestion notifications received by the sender.
+ * - pause: time the flow's priority was paused by PFC at the sender NIC
+ *   between start and the last transmission of the flow.
+ *
+ * The flows removed from their NICs before the end, see
+ * QbbNetDevice::RemoveTxFlow, come first for each NIC. Their ports may have
+ * been taken by later flows, so a sender row is joined with the first
+ * receiver counters of its key that start after it.
+ */
+class QbbFlowStats : public SimpleRefCount<QbbFlowStats>
+{
+public:
+  void Add (Ptr<QbbNetDevice> device);
+
+  /**
+   * Write one row per flow, preceded by a '#' header line. Call after
+   * Simulator::Run and before Simulator::Destroy.
+   */
+  void Write (std::ostream &os) const;
+  void Write (std::string filename) const;
+
+private:
+  std::vector<Ptr<QbbNetDevice> > m_devices;
+};
+
+} // namespace ns3
+
+#endif /* QBB_FLOW_STATS_H */
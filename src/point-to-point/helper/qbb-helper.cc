@@ -19,6 +19,7 @@
  */
 
 #include <iostream>
+#include <fstream>
 
 #include "ns3/abort.h"
 #include "ns3/log.h"
@@ -223,6 +224,103 @@ QbbHelper::EnableAsciiInternal (
   Config::Connect (oss.str (), MakeBoundCallback (&AsciiTraceHelper::DefaultDropSinkWithContext, stream));
 }
 
+Ptr<QbbTraceWriter>
+QbbHelper::EnableBinaryTrace (std::string filename, NodeContainer n, bool queueEvents)
+{
+  NS_LOG_FUNCTION (this << filename << queueEvents);
+  Ptr<QbbTraceWriter> writer = Create<QbbTraceWriter> (filename);
+  for (NodeContainer::Iterator i = n.Begin (); i != n.End (); ++i)
+    {
+      Ptr<Node> node = *i;
+      for (uint32_t j = 0; j < node->GetNDevices (); ++j)
+        {
+          Ptr<QbbNetDevice> device = node->GetDevice (j)->GetObject<QbbNetDevice> ();
+          if (device != 0)
+            {
+              writer->Hook (device, queueEvents);
+            }
+        }
+    }
+  Simulator::ScheduleDestroy (&QbbTraceWriter::Flush, writer);
+  return writer;
+}
+
+Ptr<QbbFlowStats>
+QbbHelper::EnableFlowStats (NodeContainer n)
+{
+  NS_LOG_FUNCTION (this);
+  Ptr<QbbFlowStats> stats = Create<QbbFlowStats> ();
+  for (NodeContainer::Iterator i = n.Begin (); i != n.End (); ++i)
+    {
+      Ptr<Node> node = *i;
+      for (uint32_t j = 0; j < node->GetNDevices (); ++j)
+        {
+          Ptr<QbbNetDevice> device = node->GetDevice (j)->GetObject<QbbNetDevice> ();
+          if (device != 0)
+            {
+              stats->Add (device);
+            }
+        }
+    }
+  return stats;
+}
+
+Ptr<QbbBufferSampler>
+QbbHelper::EnableBufferSampler (std::string filename, NodeContainer n, Time start, Time interval, bool onChange)
+{
+  NS_LOG_FUNCTION (this << filename << start << interval << onChange);
+  Ptr<QbbBufferSampler> sampler = Create<QbbBufferSampler> (filename, interval, onChange);
+  for (NodeContainer::Iterator i = n.Begin (); i != n.End (); ++i)
+    {
+      if ((*i)->m_broadcom != 0)
+        {
+          sampler->Add (*i);
+        }
+    }
+  sampler->Start (start);
+  return sampler;
+}
+
+void
+QbbHelper::WriteSwitchCounters (std::string filename, NodeContainer n) const
+{
+  NS_LOG_FUNCTION (this << filename);
+  std::ofstream os (filename.c_str ());
+  NS_ABORT_MSG_UNLESS (os.is_open (), "QbbHelper::WriteSwitchCounters(): Unable to open " << filename);
+  os << "# node port pg drop_buffer drop_headroom drop_egress_sp drop_egress_port drop_egress_queue"
+     << " ecn_marks pause_sent resume_sent pause_received resume_received\n";
+  for (NodeContainer::Iterator i = n.Begin (); i != n.End (); ++i)
+    {
+      if ((*i)->m_broadcom != 0)
+        {
+          (*i)->m_broadcom->PrintCounters (os, (*i)->GetId ());
+        }
+    }
+}
+
+int64_t
+QbbHelper::AssignStreams (NodeContainer c, int64_t stream)
+{
+  int64_t currentStream = stream;
+  for (NodeContainer::Iterator i = c.Begin (); i != c.End (); ++i)
+    {
+      Ptr<Node> node = *i;
+      if (node->m_broadcom != 0)
+        {
+          currentStream += node->m_broadcom->AssignStreams (currentStream);
+        }
+      for (uint32_t j = 0; j < node->GetNDevices (); ++j)
+        {
+          Ptr<QbbNetDevice> device = node->GetDevice (j)->GetObject<QbbNetDevice> ();
+          if (device != 0)
+            {
+              currentStream += device->AssignStreams (currentStream);
+            }
+        }
+    }
+  return (currentStream - stream);
+}
+
 NetDeviceContainer 
 QbbHelper::Install (NodeContainer c)
 {
@@ -27,6 +27,9 @@
 #include "ns3/node-container.h"
 #include "ns3/deprecated.h"
 #include "ns3/trace-helper.h"
+#include "qbb-trace-writer.h"
+#include "qbb-flow-stats.h"
+#include "qbb-buffer-sampler.h"
 
 namespace ns3 {
 
@@ -145,6 +148,65 @@ public:
    */
   NetDeviceContainer Install (std::string aNode, std::string bNode);
 
+  /**
+   * \brief Enable binary trace output on all the qbb devices of the nodes.
+   *
+   * Records the same receive and drop events as EnableAscii, in the compact
+   * format of QbbTraceWriter, through a single buffered writer. Use
+   * utils/qbb-trace-to-text to get the ASCII trace back.
+   *
+   * \param filename the trace file
+   * \param n the nodes whose devices are traced
+   * \param queueEvents also record enqueue, dequeue and drop events of the
+   *        device queues
+   * \returns the writer, flushed when the simulator is destroyed
+   */
+  Ptr<QbbTraceWriter> EnableBinaryTrace (std::string filename, NodeContainer n, bool queueEvents = false);
+
+  /**
+   * \brief Collect per-flow completion time and goodput on all the qbb
+   * devices of the nodes.
+   *
+   * \param n the nodes whose devices are collected, normally all of them
+   *        so that both ends of every flow are included
+   * \returns the collector; call QbbFlowStats::Write after Simulator::Run
+   */
+  Ptr<QbbFlowStats> EnableFlowStats (NodeContainer n);
+
+  /**
+   * \brief Sample the shared buffer occupancy, PFC state and admission
+   * drops of the switches among the nodes.
+   *
+   * \param filename the sample file, see QbbBufferSampler
+   * \param n the nodes to sample; those without a BroadcomNode are skipped
+   * \param start time of the first sample
+   * \param interval time between two samples
+   * \param onChange write only the (port, PG) records that changed
+   * \returns the sampler, flushed when the simulator is destroyed
+   */
+  Ptr<QbbBufferSampler> EnableBufferSampler (std::string filename, NodeContainer n, Time start, Time interval, bool onChange = false);
+
+  /**
+   * \brief Write the admission drop, ECN marking and PFC frame counters of
+   * the switches among the nodes, one line per port and priority with a
+   * non-zero counter (see BroadcomNode::PrintCounters), after a '#' header
+   * line. Call after Simulator::Run, or schedule it to dump them
+   * periodically.
+   */
+  void WriteSwitchCounters (std::string filename, NodeContainer n) const;
+
+  /**
+   * Assign a fixed random variable stream number to the random variables
+   * used by the qbb devices and the switch buffer models of the nodes.
+   * Return the number of streams (possibly zero) that have been assigned.
+   * The Install() method should have previously been called by the user.
+   *
+   * \param c NodeContainer of the set of nodes to be modified
+   * \param stream first stream index to use
+   * \return the number of stream indices assigned by this helper
+   */
+  int64_t AssignStreams (NodeContainer c, int64_t stream);
+
 private:
   /**
    * \brief Enable pcap output the indicated net device.
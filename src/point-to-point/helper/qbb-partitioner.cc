@@ -0,0 +1,537 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#include <algorithm>
+#include <fstream>
+#include <set>
+#include "ns3/log.h"
+#include "ns3/abort.h"
+#include "ns3/assert.h"
+#include "qbb-partitioner.h"
+
+NS_LOG_COMPONENT_DEFINE ("QbbPartitioner");
+
+namespace ns3 {
+
+namespace {
+
+const uint32_t NO_PART = 0xffffffff;
+// passes over all the nodes in Refine, which usually settles in a few
+const uint32_t MAX_PASSES = 50;
+const double EPSILON = 1e-9;
+
+bool
+FlowSourceLess (const std::pair<uint32_t, uint32_t> &a, const std::pair<uint32_t, uint32_t> &b)
+{
+  return a.first < b.first;
+}
+
+} // anonymous namespace
+
+QbbPartitioner::QbbPartitioner ()
+  : m_nParts (0),
+    m_maxPartWeight (0)
+{
+}
+
+void
+QbbPartitioner::ReadTopology (std::string filename)
+{
+  NS_LOG_FUNCTION (this << filename);
+  std::ifstream f (filename.c_str ());
+  NS_ABORT_MSG_UNLESS (f.is_open (), "QbbPartitioner: cannot open " << filename);
+  uint32_t nodes, switches, links;
+  f >> nodes >> switches >> links;
+  SetNNodes (nodes);
+  for (uint32_t i = 0; i < switches; i++)
+    {
+      uint32_t id;
+      f >> id;
+    }
+  for (uint32_t i = 0; i < links; i++)
+    {
+      uint32_t src, dst;
+      std::string rate, delay;
+      double errorRate;
+      f >> src >> dst >> rate >> delay >> errorRate;
+      AddLink (src, dst, Time (delay));
+    }
+  NS_ABORT_MSG_IF (f.fail (), "QbbPartitioner: cannot read the links of " << filename);
+}
+
+void
+QbbPartitioner::ReadFlows (std::string filename)
+{
+  NS_LOG_FUNCTION (this << filename);
+  std::ifstream f (filename.c_str ());
+  NS_ABORT_MSG_UNLESS (f.is_open (), "QbbPartitioner: cannot open " << filename);
+  uint32_t flows;
+  f >> flows;
+  for (uint32_t i = 0; i < flows; i++)
+    {
+      uint32_t src, dst, pg;
+      uint64_t packets;
+      double start, stop;
+      f >> src >> dst >> pg >> packets >> start >> stop;
+      AddFlow (src, dst, packets);
+    }
+  NS_ABORT_MSG_IF (f.fail (), "QbbPartitioner: cannot read the flows of " << filename);
+}
+
+void
+QbbPartitioner::SetNNodes (uint32_t nodes)
+{
+  m_adjacency.resize (nodes);
+}
+
+void
+QbbPartitioner::AddLink (uint32_t a, uint32_t b, Time delay)
+{
+  NS_ABORT_MSG_IF (a >= m_adjacency.size () || b >= m_adjacency.size (), "QbbPartitioner: link " << a << "-" << b << " to an unknown node");
+  Link link;
+  link.a = a;
+  link.b = b;
+  link.delay = delay;
+  link.packets = 0;
+  m_adjacency[a].push_back (m_links.size ());
+  m_adjacency[b].push_back (m_links.size ());
+  m_links.push_back (link);
+}
+
+void
+QbbPartitioner::AddFlow (uint32_t src, uint32_t dst, uint64_t packets)
+{
+  NS_ABORT_MSG_IF (src >= m_adjacency.size () || dst >= m_adjacency.size (), "QbbPartitioner: flow " << src << "-" << dst << " of an unknown node");
+  Flow flow;
+  flow.src = src;
+  flow.dst = dst;
+  flow.packets = packets;
+  m_flows.push_back (flow);
+}
+
+void
+QbbPartitioner::Partition (uint32_t parts, double imbalance)
+{
+  NS_LOG_FUNCTION (this << parts << imbalance);
+  uint32_t n = m_adjacency.size ();
+  NS_ABORT_MSG_IF (parts == 0 || parts > n, "QbbPartitioner: cannot split " << n << " nodes in " << parts << " parts");
+  m_nParts = parts;
+  Weigh ();
+
+  double total = 0, heaviest = 0;
+  for (uint32_t v = 0; v < n; v++)
+    {
+      total += m_nodeWeight[v];
+      heaviest = std::max (heaviest, m_nodeWeight[v]);
+    }
+  m_maxPartWeight = std::max ((1 + imbalance) * total / parts, heaviest);
+
+  Grow ();
+  Refine ();
+}
+
+void
+QbbPartitioner::Weigh (void)
+{
+  uint32_t n = m_adjacency.size ();
+  m_nodeWeight.assign (n, 1);
+  for (uint32_t l = 0; l < m_links.size (); l++)
+    {
+      m_links[l].packets = 0;
+    }
+
+  // the flows of a source are spread over the shortest paths in one pass,
+  // as for the dependencies of the betweenness centrality
+  std::vector<std::pair<uint32_t, uint32_t> > bySource;
+  for (uint32_t i = 0; i < m_flows.size (); i++)
+    {
+      if (m_flows[i].src != m_flows[i].dst)
+        {
+          bySource.push_back (std::make_pair (m_flows[i].src, i));
+        }
+    }
+  std::stable_sort (bySource.begin (), bySource.end (), FlowSourceLess);
+
+  std::vector<int32_t> dist (n);
+  std::vector<double> paths (n);
+  std::vector<double> demand (n, 0);
+  std::vector<double> through (n);
+  std::vector<uint32_t> order;
+  order.reserve (n);
+  for (uint32_t first = 0; first < bySource.size (); )
+    {
+      uint32_t s = bySource[first].first;
+      uint32_t last = first;
+      for (; last < bySource.size () && bySource[last].first == s; last++)
+        {
+          const Flow &flow = m_flows[bySource[last].second];
+          demand[flow.dst] += flow.packets;
+        }
+
+      std::fill (dist.begin (), dist.end (), -1);
+      std::fill (paths.begin (), paths.end (), 0);
+      order.clear ();
+      dist[s] = 0;
+      paths[s] = 1;
+      order.push_back (s);
+      for (uint32_t k = 0; k < order.size (); k++)
+        {
+          uint32_t u = order[k];
+          for (uint32_t j = 0; j < m_adjacency[u].size (); j++)
+            {
+              const Link &link = m_links[m_adjacency[u][j]];
+              uint32_t v = link.a == u ? link.b : link.a;
+              if (dist[v] < 0)
+                {
+                  dist[v] = dist[u] + 1;
+                  order.push_back (v);
+                }
+              if (dist[v] == dist[u] + 1)
+                {
+                  paths[v] += paths[u];
+                }
+            }
+        }
+
+      // from the farthest nodes back to the source, the packets ending at
+      // or going through a node are split among the links it is reached by
+      std::fill (through.begin (), through.end (), 0);
+      for (uint32_t k = order.size (); k-- > 0; )
+        {
+          uint32_t w = order[k];
+          double packets = demand[w] + through[w];
+          m_nodeWeight[w] += packets;
+          for (uint32_t j = 0; j < m_adjacency[w].size (); j++)
+            {
+              Link &link = m_links[m_adjacency[w][j]];
+              uint32_t v = link.a == w ? link.b : link.a;
+              if (dist[v] == dist[w] - 1)
+                {
+                  double share = packets * paths[v] / paths[w];
+                  link.packets += share;
+                  through[v] += share;
+                }
+            }
+        }
+
+      for (uint32_t k = first; k < last; k++)
+        {
+          demand[m_flows[bySource[k].second].dst] = 0;
+        }
+      first = last;
+    }
+}
+
+double
+QbbPartitioner::GetWeight (uint32_t link) const
+{
+  return 1 + m_links[link].packets;
+}
+
+void
+QbbPartitioner::Move (uint32_t node, uint32_t part)
+{
+  if (m_part[node] != NO_PART)
+    {
+      m_partWeight[m_part[node]] -= m_nodeWeight[node];
+      m_partSize[m_part[node]]--;
+    }
+  m_part[node] = part;
+  m_partWeight[part] += m_nodeWeight[node];
+  m_partSize[part]++;
+}
+
+void
+QbbPartitioner::Grow (void)
+{
+  uint32_t n = m_adjacency.size ();
+  m_part.assign (n, NO_PART);
+  m_partWeight.assign (m_nParts, 0);
+  m_partSize.assign (m_nParts, 0);
+  double total = 0;
+  for (uint32_t v = 0; v < n; v++)
+    {
+      total += m_nodeWeight[v];
+    }
+
+  // seeds in breadth first order, so that a part starts next to the last
+  std::vector<uint32_t> seeds;
+  std::vector<bool> seen (n, false);
+  for (uint32_t root = 0; root < n; root++)
+    {
+      if (seen[root])
+        {
+          continue;
+        }
+      seen[root] = true;
+      seeds.push_back (root);
+      for (uint32_t k = seeds.size () - 1; k < seeds.size (); k++)
+        {
+          uint32_t u = seeds[k];
+          for (uint32_t j = 0; j < m_adjacency[u].size (); j++)
+            {
+              const Link &link = m_links[m_adjacency[u][j]];
+              uint32_t v = link.a == u ? link.b : link.a;
+              if (!seen[v])
+                {
+                  seen[v] = true;
+                  seeds.push_back (v);
+                }
+            }
+        }
+    }
+
+  // every part but the last grows from a seed, taking the unassigned node
+  // that lowers the cut the most until it has its share; the last part
+  // takes what is left
+  std::vector<double> gain (n, 0);
+  std::vector<bool> queued (n, false);
+  uint32_t nextSeed = 0;
+  for (uint32_t p = 0; p + 1 < m_nParts; p++)
+    {
+      double target = total * (p + 1) / m_nParts;
+      for (uint32_t q = 0; q < p; q++)
+        {
+          target -= m_partWeight[q];
+        }
+      std::set<std::pair<double, uint32_t> > frontier;	//< (-gain, node)
+      std::vector<uint32_t> touched;
+      while (m_partSize[p] == 0 || m_partWeight[p] < target)
+        {
+          uint32_t v;
+          if (frontier.empty ())
+            {
+              while (nextSeed < n && m_part[seeds[nextSeed]] != NO_PART)
+                {
+                  nextSeed++;
+                }
+              if (nextSeed == n)
+                {
+                  break;
+                }
+              v = seeds[nextSeed];
+            }
+          else
+            {
+              v = frontier.begin ()->second;
+              frontier.erase (frontier.begin ());
+            }
+          if (m_partSize[p] > 0 && m_partWeight[p] + m_nodeWeight[v] / 2 > target)
+            {
+              break;
+            }
+          Move (v, p);
+          for (uint32_t j = 0; j < m_adjacency[v].size (); j++)
+            {
+              uint32_t l = m_adjacency[v][j];
+              uint32_t w = m_links[l].a == v ? m_links[l].b : m_links[l].a;
+              if (m_part[w] != NO_PART)
+                {
+                  continue;
+                }
+              if (queued[w])
+                {
+                  // the link leaves the cut instead of joining it
+                  frontier.erase (std::make_pair (-gain[w], w));
+                  gain[w] += 2 * GetWeight (l);
+                }
+              else
+                {
+                  // the links to the part leave the cut, the links to the
+                  // unassigned nodes join it
+                  queued[w] = true;
+                  touched.push_back (w);
+                  for (uint32_t k = 0; k < m_adjacency[w].size (); k++)
+                    {
+                      uint32_t l2 = m_adjacency[w][k];
+                      uint32_t u = m_links[l2].a == w ? m_links[l2].b : m_links[l2].a;
+                      if (m_part[u] == p)
+                        {
+                          gain[w] += GetWeight (l2);
+                        }
+                      else if (m_part[u] == NO_PART)
+                        {
+                          gain[w] -= GetWeight (l2);
+                        }
+                    }
+                }
+              frontier.insert (std::make_pair (-gain[w], w));
+            }
+        }
+      for (uint32_t k = 0; k < touched.size (); k++)
+        {
+          gain[touched[k]] = 0;
+          queued[touched[k]] = false;
+        }
+    }
+  for (uint32_t v = 0; v < n; v++)
+    {
+      if (m_part[v] == NO_PART)
+        {
+          Move (v, m_nParts - 1);
+        }
+    }
+}
+
+void
+QbbPartitioner::Refine (void)
+{
+  uint32_t n = m_adjacency.size ();
+  std::vector<double> connection (m_nParts, 0);
+  std::vector<uint32_t> parts;
+  for (uint32_t pass = 0; pass < MAX_PASSES; pass++)
+    {
+      bool moved = false;
+      for (uint32_t v = 0; v < n; v++)
+        {
+          uint32_t own = m_part[v];
+          if (m_partSize[own] == 1)
+            {
+              continue;
+            }
+          parts.clear ();
+          for (uint32_t j = 0; j < m_adjacency[v].size (); j++)
+            {
+              uint32_t l = m_adjacency[v][j];
+              uint32_t w = m_links[l].a == v ? m_links[l].b : m_links[l].a;
+              uint32_t q = m_part[w];
+              if (connection[q] == 0)
+                {
+                  parts.push_back (q);
+                }
+              connection[q] += GetWeight (l);
+            }
+
+          // the best neighbour part that can take the node
+          uint32_t best = NO_PART;
+          double bestGain = 0;
+          for (uint32_t k = 0; k < parts.size (); k++)
+            {
+              uint32_t q = parts[k];
+              if (q == own || m_partWeight[q] + m_nodeWeight[v] > m_maxPartWeight)
+                {
+                  continue;
+                }
+              double gain = connection[q] - connection[own];
+              if (best == NO_PART || gain > bestGain + EPSILON
+                  || (gain > bestGain - EPSILON && m_partWeight[q] < m_partWeight[best]))
+                {
+                  best = q;
+                  bestGain = gain;
+                }
+            }
+          for (uint32_t k = 0; k < parts.size (); k++)
+            {
+              connection[parts[k]] = 0;
+            }
+
+          // a smaller cut, the same cut with closer weights, or any cut to
+          // bring an overweight part back under the limit
+          if (best != NO_PART
+              && (bestGain > EPSILON
+                  || (bestGain > -EPSILON && m_partWeight[best] + m_nodeWeight[v] < m_partWeight[own] - EPSILON)
+                  || m_partWeight[own] > m_maxPartWeight))
+            {
+              Move (v, best);
+              moved = true;
+            }
+        }
+      if (!moved)
+        {
+          break;
+        }
+    }
+}
+
+uint32_t
+QbbPartitioner::GetPartition (uint32_t node) const
+{
+  NS_ASSERT (node < m_part.size ());
+  return m_part[node];
+}
+
+uint32_t
+QbbPartitioner::GetNCutLinks (void) const
+{
+  uint32_t cut = 0;
+  for (uint32_t l = 0; l < m_links.size (); l++)
+    {
+      if (m_part[m_links[l].a] != m_part[m_links[l].b])
+        {
+          cut++;
+        }
+    }
+  return cut;
+}
+
+double
+QbbPartitioner::GetCutTraffic (void) const
+{
+  double cut = 0, total = 0;
+  for (uint32_t l = 0; l < m_links.size (); l++)
+    {
+      total += m_links[l].packets;
+      if (m_part[m_links[l].a] != m_part[m_links[l].b])
+        {
+          cut += m_links[l].packets;
+        }
+    }
+  return total > 0 ? cut / total : 0;
+}
+
+double
+QbbPartitioner::GetImbalance (void) const
+{
+  double total = 0, largest = 0;
+  for (uint32_t p = 0; p < m_nParts; p++)
+    {
+      total += m_partWeight[p];
+      largest = std::max (largest, m_partWeight[p]);
+    }
+  return total > 0 ? largest * m_nParts / total : 0;
+}
+
+Time
+QbbPartitioner::GetLookAhead (void) const
+{
+  Time lookAhead;
+  bool cut = false;
+  for (uint32_t l = 0; l < m_links.size (); l++)
+    {
+      if (m_part[m_links[l].a] != m_part[m_links[l].b] && (!cut || m_links[l].delay < lookAhead))
+        {
+          lookAhead = m_links[l].delay;
+          cut = true;
+        }
+    }
+  return lookAhead;
+}
+
+void
+QbbPartitioner::Print (std::ostream &os) const
+{
+  os << "Partitions\t\t\t" << m_nParts << "\n";
+  os << "Cut links\t\t\t" << GetNCutLinks () << " of " << m_links.size () << "\n";
+  os << "Cut traffic\t\t\t" << GetCutTraffic () * 100 << "% of the packet hops\n";
+  os << "Imbalance\t\t\t" << GetImbalance () << " (largest part over the average)\n";
+  os << "Lookahead\t\t\t" << GetLookAhead ().GetNanoSeconds () << "ns\n";
+  for (uint32_t p = 0; p < m_nParts; p++)
+    {
+      os << "Partition " << p << "\t\t\t" << m_partSize[p] << " nodes, weight " << m_partWeight[p] << "\n";
+    }
+}
+
+} // namespace ns3
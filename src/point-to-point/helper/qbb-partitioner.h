@@ -0,0 +1,125 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#ifndef QBB_PARTITIONER_H
+#define QBB_PARTITIONER_H
+
+#include <stdint.h>
+#include <ostream>
+#include <string>
+#include <vector>
+#include "ns3/nstime.h"
+
+namespace ns3 {
+
+/**
+ * \brief Balanced k-way partition of a topology, for the system ids of the
+ * nodes of a parallel run.
+ *
+ * Nodes and links are weighted by the packets of the flows, spread evenly
+ * over the shortest paths like ECMP routing does, plus one so that idle
+ * nodes are balanced too. Partition grows the parts one after the other
+ * from the topology, each up to its share of the node weight, and then
+ * moves boundary nodes while this lowers the weight of the cut links
+ * without unbalancing the parts by more than the imbalance allowed.
+ *
+ * The lookahead of the partition, the smallest delay of the cut links, is
+ * what a conservative parallel simulator can process in every window:
+ * cutting slow links only is not attempted, the links of a data center
+ * topology having the same delay in most cases.
+ */
+class QbbPartitioner
+{
+public:
+  QbbPartitioner ();
+
+  /**
+   * Read the nodes and links of a TOPOLOGY_FILE of third.cc: the numbers
+   * of nodes, switches and links, the switch ids, and a
+   * "src dst rate delay error_rate" line per link.
+   */
+  void ReadTopology (std::string filename);
+  /**
+   * Read the flows of a FLOW_FILE of third.cc: the number of flows, and a
+   * "src dst pg packets start stop" line per flow.
+   */
+  void ReadFlows (std::string filename);
+
+  void SetNNodes (uint32_t nodes);
+  void AddLink (uint32_t a, uint32_t b, Time delay);
+  void AddFlow (uint32_t src, uint32_t dst, uint64_t packets);
+
+  /**
+   * \param parts number of parts, the system ids being 0 to parts - 1
+   * \param imbalance largest part weight allowed over the average, e.g.
+   * 0.05 for 5% more, or the weight of the heaviest node if larger
+   */
+  void Partition (uint32_t parts, double imbalance = 0.05);
+
+  uint32_t GetPartition (uint32_t node) const;
+  uint32_t GetNCutLinks (void) const;
+  /**
+   * \return the fraction of the packet hops that cross the cut
+   */
+  double GetCutTraffic (void) const;
+  /**
+   * \return the largest part weight over the average weight
+   */
+  double GetImbalance (void) const;
+  /**
+   * \return the smallest delay of the cut links, zero if none is cut
+   */
+  Time GetLookAhead (void) const;
+  /**
+   * Write the cut quality and the lookahead, a few lines for a log.
+   */
+  void Print (std::ostream &os) const;
+
+private:
+  struct Link
+  {
+    uint32_t a;
+    uint32_t b;
+    Time delay;
+    double packets;
+  };
+  struct Flow
+  {
+    uint32_t src;
+    uint32_t dst;
+    double packets;
+  };
+
+  void Weigh (void);
+  void Grow (void);
+  void Refine (void);
+  void Move (uint32_t node, uint32_t part);
+  double GetWeight (uint32_t link) const;
+
+  std::vector<Link> m_links;
+  std::vector<Flow> m_flows;
+  std::vector<std::vector<uint32_t> > m_adjacency;	//< links of every node
+  std::vector<double> m_nodeWeight;
+  uint32_t m_nParts;
+  double m_maxPartWeight;
+  std::vector<uint32_t> m_part;
+  std::vector<double> m_partWeight;
+  std::vector<uint32_t> m_partSize;
+};
+
+} // namespace ns3
+
+#endif /* QBB_PARTITIONER_H */
@@ -0,0 +1,496 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#include <string.h>
+#include <algorithm>
+#include "ns3/core-config.h"
+#include "ns3/abort.h"
+#include "ns3/log.h"
+#include "ns3/simulator.h"
+#include "ns3/node.h"
+#include "ns3/qbb-net-device.h"
+#include "ns3/broadcom-egress-queue.h"
+#ifdef HAVE_PTHREAD_H
+#include "ns3/multithreaded-simulator-impl.h"
+#endif
+#include "qbb-trace-writer.h"
+
+NS_LOG_COMPONENT_DEFINE ("QbbTraceWriter");
+
+namespace ns3 {
+
+namespace {
+
+const uint32_t FILE_HEADER_SIZE = 12;
+
+inline void
+WriteU16 (uint8_t *&b, uint16_t v)
+{
+  b[0] = v & 0xff;
+  b[1] = (v >> 8) & 0xff;
+  b += 2;
+}
+
+inline void
+WriteU32 (uint8_t *&b, uint32_t v)
+{
+  WriteU16 (b, v & 0xffff);
+  WriteU16 (b, v >> 16);
+}
+
+inline uint16_t
+ReadU16 (const uint8_t *&b)
+{
+  uint16_t v = b[0] | (b[1] << 8);
+  b += 2;
+  return v;
+}
+
+inline uint32_t
+ReadU32 (const uint8_t *&b)
+{
+  uint32_t lo = ReadU16 (b);
+  return lo | ((uint32_t)ReadU16 (b) << 16);
+}
+
+// network byte order, for the packet contents
+inline uint16_t
+NetU16 (const uint8_t *b)
+{
+  return (uint16_t)((b[0] << 8) | b[1]);
+}
+
+inline uint32_t
+NetU32 (const uint8_t *b)
+{
+  return ((uint32_t)b[0] << 24) | ((uint32_t)b[1] << 16) | ((uint32_t)b[2] << 8) | b[3];
+}
+
+// the order of the records of a multithreaded run, the records of one
+// node keeping the order they were written in
+inline bool
+RecordBefore (const QbbTraceRecord &a, const QbbTraceRecord &b)
+{
+  return a.time < b.time || (a.time == b.time && a.node < b.node);
+}
+
+/*
+ * Binds the node and interface of one device to the trace sources, since
+ * MakeBoundCallback binds a single argument.
+ */
+class QbbTraceSink : public SimpleRefCount<QbbTraceSink>
+{
+public:
+  QbbTraceSink (Ptr<QbbTraceWriter> writer, uint32_t node, uint32_t ifIndex)
+    : m_writer (writer),
+      m_node (node),
+      m_ifIndex (ifIndex)
+  {
+  }
+  void MacRx (Ptr<const Packet> p)
+  {
+    m_writer->Write ('r', m_node, m_ifIndex, p, 0);
+  }
+  void PhyRxDrop (Ptr<const Packet> p)
+  {
+    m_writer->Write ('d', m_node, m_ifIndex, p, QbbTraceRecord::PPP);
+  }
+  void Enqueue (Ptr<const Packet> p)
+  {
+    m_writer->Write ('+', m_node, m_ifIndex, p, QbbTraceRecord::PPP | QbbTraceRecord::QUEUE);
+  }
+  void Dequeue (Ptr<const Packet> p)
+  {
+    m_writer->Write ('-', m_node, m_ifIndex, p, QbbTraceRecord::PPP | QbbTraceRecord::QUEUE);
+  }
+  void Drop (Ptr<const Packet> p)
+  {
+    m_writer->Write ('d', m_node, m_ifIndex, p, QbbTraceRecord::PPP | QbbTraceRecord::QUEUE);
+  }
+
+private:
+  Ptr<QbbTraceWriter> m_writer;
+  uint32_t m_node;
+  uint32_t m_ifIndex;
+};
+
+} // anonymous namespace
+
+const uint32_t QbbTraceRecord::SERIALIZED_SIZE;
+const uint16_t QbbTraceWriter::VERSION;
+
+QbbTraceRecord::QbbTraceRecord ()
+{
+  memset (this, 0, sizeof (*this));
+}
+
+void
+QbbTraceRecord::Parse (Ptr<const Packet> p, bool withPpp)
+{
+  // PPP (2) + IPv4 with options (60) + UDP and SeqTsHeader (22), the
+  // longest of the headers we look at
+  uint8_t buf[2 + 60 + 8 + 14];
+  uint32_t len = p->CopyData (buf, sizeof (buf));
+  uint32_t o = 0;
+  size = p->GetSize ();
+  flags = withPpp ? PPP : 0;
+  protocol = ecn = 0;
+  src = dst = 0;
+  sport = dport = pg = 0;
+  seq = aux0 = aux1 = 0;
+  if (withPpp)
+    {
+      if (len < 2 || NetU16 (buf) != 0x0021)
+        {
+          return;
+        }
+      o = 2;
+    }
+  if (len < o + 20)
+    {
+      return;
+    }
+  flags |= IPV4;
+  uint32_t ihl = (buf[o] & 0x0f) * 4;
+  ecn = buf[o + 1] & 0x03;
+  protocol = buf[o + 9];
+  src = NetU32 (buf + o + 12);
+  dst = NetU32 (buf + o + 16);
+  o += ihl;
+  uint32_t headers = o;
+  const uint8_t *h = buf + o;
+  switch (protocol)
+    {
+    case 17:    // UdpHeader + SeqTsHeader
+      if (len >= o + 8)
+        {
+          sport = NetU16 (h);
+          dport = NetU16 (h + 2);
+          headers += 8;
+        }
+      if (len >= o + 8 + 14)
+        {
+          seq = NetU32 (h + 8);
+          pg = NetU16 (h + 8 + 12);
+          headers += 14;
+        }
+      break;
+    case 6:     // TcpHeader
+      if (len >= o + 20)
+        {
+          sport = NetU16 (h);
+          dport = NetU16 (h + 2);
+          seq = NetU32 (h + 4);
+          headers += (h[12] >> 4) * 4;
+        }
+      break;
+    case 0xFC:  // qbbHeader, little-endian like the other qbb headers
+    case 0xFD:
+      if (len >= o + 8)
+        {
+          pg = ReadU16 (h);
+          seq = ReadU32 (h);
+          aux0 = ReadU16 (h);
+          headers += 8;
+        }
+      break;
+    case 0xFE:  // PauseHeader
+      if (len >= o + 9)
+        {
+          aux0 = ReadU32 (h);
+          aux1 = ReadU32 (h);
+          pg = h[0];
+          headers += 9;
+        }
+      break;
+    case 0xFF:  // CnHeader
+      if (len >= o + 8)
+        {
+          pg = *h++;
+          seq = ReadU16 (h) << 8;
+          seq |= *h++;
+          aux0 = ReadU16 (h);
+          aux1 = ReadU16 (h);
+          headers += 8;
+        }
+      break;
+    default:
+      break;
+    }
+  if (size > headers)
+    {
+      flags |= PAYLOAD;
+    }
+}
+
+void
+QbbTraceRecord::Serialize (uint8_t *buf) const
+{
+  uint8_t *b = buf;
+  WriteU32 (b, time & 0xffffffff);
+  WriteU32 (b, time >> 32);
+  WriteU32 (b, node);
+  WriteU16 (b, ifIndex);
+  *b++ = type;
+  *b++ = flags;
+  WriteU32 (b, src);
+  WriteU32 (b, dst);
+  WriteU16 (b, sport);
+  WriteU16 (b, dport);
+  *b++ = protocol;
+  *b++ = ecn;
+  WriteU16 (b, pg);
+  WriteU32 (b, seq);
+  WriteU32 (b, size);
+  WriteU32 (b, aux0);
+  WriteU32 (b, aux1);
+  NS_ASSERT (b - buf == SERIALIZED_SIZE);
+}
+
+void
+QbbTraceRecord::Deserialize (const uint8_t *buf)
+{
+  const uint8_t *b = buf;
+  time = ReadU32 (b);
+  time |= (uint64_t)ReadU32 (b) << 32;
+  node = ReadU32 (b);
+  ifIndex = ReadU16 (b);
+  type = *b++;
+  flags = *b++;
+  src = ReadU32 (b);
+  dst = ReadU32 (b);
+  sport = ReadU16 (b);
+  dport = ReadU16 (b);
+  protocol = *b++;
+  ecn = *b++;
+  pg = ReadU16 (b);
+  seq = ReadU32 (b);
+  size = ReadU32 (b);
+  aux0 = ReadU32 (b);
+  aux1 = ReadU32 (b);
+}
+
+QbbTraceWriter::QbbTraceWriter (std::string filename, uint32_t bufferSize)
+  : m_buffer (std::max (bufferSize, QbbTraceRecord::SERIALIZED_SIZE)),
+    m_used (0)
+{
+  NS_LOG_FUNCTION (this << filename << bufferSize);
+  m_file = fopen (filename.c_str (), "wb");
+  NS_ABORT_MSG_IF (m_file == 0, "QbbTraceWriter: cannot open " << filename);
+  uint8_t header[FILE_HEADER_SIZE];
+  uint8_t *b = header;
+  memcpy (b, "QBBT", 4);
+  b += 4;
+  WriteU16 (b, VERSION);
+  WriteU16 (b, QbbTraceRecord::SERIALIZED_SIZE);
+  WriteU32 (b, Time::GetResolution ());
+  fwrite (header, 1, FILE_HEADER_SIZE, m_file);
+
+#ifdef HAVE_PTHREAD_H
+  Ptr<MultithreadedSimulatorImpl> impl = DynamicCast<MultithreadedSimulatorImpl> (Simulator::GetImplementation ());
+  if (impl != 0)
+    {
+      // the global events write with system id 0
+      m_threads.resize (1);
+      impl->AddRoundCallback (MakeCallback (&QbbTraceWriter::EndRound, Ptr<QbbTraceWriter> (this)));
+    }
+#endif
+}
+
+QbbTraceWriter::~QbbTraceWriter ()
+{
+  NS_LOG_FUNCTION (this);
+  Flush ();
+  fclose (m_file);
+  m_file = 0;
+}
+
+void
+QbbTraceWriter::Hook (Ptr<QbbNetDevice> device, bool queueEvents)
+{
+  NS_LOG_FUNCTION (this << device << queueEvents);
+  Ptr<Node> node = device->GetNode ();
+  if (!m_threads.empty () && node->GetSystemId () >= m_threads.size ())
+    {
+      m_threads.resize (node->GetSystemId () + 1);
+    }
+  Ptr<QbbTraceSink> sink = Create<QbbTraceSink> (this, node->GetId (), device->GetIfIndex ());
+  device->TraceConnectWithoutContext ("MacRx", MakeCallback (&QbbTraceSink::MacRx, sink));
+  device->TraceConnectWithoutContext ("PhyRxDrop", MakeCallback (&QbbTraceSink::PhyRxDrop, sink));
+  if (queueEvents)
+    {
+      Ptr<BEgressQueue> queue = device->GetQueue ();
+      queue->TraceConnectWithoutContext ("Enqueue", MakeCallback (&QbbTraceSink::Enqueue, sink));
+      queue->TraceConnectWithoutContext ("Dequeue", MakeCallback (&QbbTraceSink::Dequeue, sink));
+      queue->TraceConnectWithoutContext ("Drop", MakeCallback (&QbbTraceSink::Drop, sink));
+    }
+}
+
+void
+QbbTraceWriter::Write (const QbbTraceRecord &record)
+{
+  if (m_threads.empty ())
+    {
+      Append (record);
+      return;
+    }
+  uint32_t thread = Simulator::GetSystemId ();
+  NS_ASSERT_MSG (thread < m_threads.size (), "QbbTraceWriter: write from partition " << thread << " without a hooked device");
+  m_threads[thread].push_back (record);
+}
+
+void
+QbbTraceWriter::Write (uint8_t type, uint32_t node, uint32_t ifIndex, Ptr<const Packet> p, uint8_t flags)
+{
+  QbbTraceRecord record;
+  record.Parse (p, flags & QbbTraceRecord::PPP);
+  record.time = Simulator::Now ().GetTimeStep ();
+  record.node = node;
+  record.ifIndex = ifIndex;
+  record.type = type;
+  record.flags |= flags;
+  Write (record);
+}
+
+void
+QbbTraceWriter::Flush (void)
+{
+  NS_LOG_FUNCTION (this);
+  Merge (~(uint64_t)0);
+  DoFlush ();
+}
+
+void
+QbbTraceWriter::EndRound (Time until)
+{
+  // in batches of a buffer at least; the file does not depend on the batches
+  std::size_t n = 0;
+  for (uint32_t i = 0; i < m_threads.size (); i++)
+    {
+      n += m_threads[i].size ();
+    }
+  if (n * QbbTraceRecord::SERIALIZED_SIZE >= m_buffer.size ())
+    {
+      Merge (until.GetTimeStep ());
+    }
+}
+
+void
+QbbTraceWriter::Merge (uint64_t until)
+{
+  m_merged.clear ();
+  for (uint32_t i = 0; i < m_threads.size (); i++)
+    {
+      // the records of a thread are in time order
+      std::vector<QbbTraceRecord> &records = m_threads[i];
+      std::size_t k = 0;
+      while (k < records.size () && records[k].time < until)
+        {
+          k++;
+        }
+      m_merged.insert (m_merged.end (), records.begin (), records.begin () + k);
+      records.erase (records.begin (), records.begin () + k);
+    }
+  std::stable_sort (m_merged.begin (), m_merged.end (), RecordBefore);
+  for (std::size_t i = 0; i < m_merged.size (); i++)
+    {
+      Append (m_merged[i]);
+    }
+  m_merged.clear ();
+}
+
+void
+QbbTraceWriter::Append (const QbbTraceRecord &record)
+{
+  if (m_used + QbbTraceRecord::SERIALIZED_SIZE > m_buffer.size ())
+    {
+      DoFlush ();
+    }
+  record.Serialize (&m_buffer[m_used]);
+  m_used += QbbTraceRecord::SERIALIZED_SIZE;
+}
+
+void
+QbbTraceWriter::DoFlush (void)
+{
+  if (m_used != 0)
+    {
+      fwrite (&m_buffer[0], 1, m_used, m_file);
+      m_used = 0;
+    }
+  fflush (m_file);
+}
+
+QbbTraceReader::QbbTraceReader ()
+  : m_file (0),
+    m_recordSize (0),
+    m_resolution (0)
+{
+}
+
+QbbTraceReader::~QbbTraceReader ()
+{
+  if (m_file != 0)
+    {
+      fclose (m_file);
+    }
+}
+
+bool
+QbbTraceReader::Open (std::string filename)
+{
+  m_file = fopen (filename.c_str (), "rb");
+  if (m_file == 0)
+    {
+      return false;
+    }
+  uint8_t header[FILE_HEADER_SIZE];
+  if (fread (header, 1, FILE_HEADER_SIZE, m_file) != FILE_HEADER_SIZE
+      || memcmp (header, "QBBT", 4) != 0)
+    {
+      return false;
+    }
+  const uint8_t *b = header + 4;
+  uint16_t version = ReadU16 (b);
+  m_recordSize = ReadU16 (b);
+  m_resolution = ReadU32 (b);
+  // later versions may only append fields to the record
+  if (version == 0 || m_recordSize < QbbTraceRecord::SERIALIZED_SIZE)
+    {
+      return false;
+    }
+  m_record.resize (m_recordSize);
+  return true;
+}
+
+bool
+QbbTraceReader::Read (QbbTraceRecord &record)
+{
+  if (fread (&m_record[0], 1, m_recordSize, m_file) != m_recordSize)
+    {
+      return false;
+    }
+  record.Deserialize (&m_record[0]);
+  return true;
+}
+
+uint32_t
+QbbTraceReader::GetResolution (void) const
+{
+  return m_resolution;
+}
+
+} // namespace ns3
@@ -0,0 +1,181 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#ifndef QBB_TRACE_WRITER_H
+#define QBB_TRACE_WRITER_H
+
+#include <stdint.h>
+#include <stdio.h>
+#include <string>
+#include <vector>
+#include "ns3/simple-ref-count.h"
+#include "ns3/packet.h"
+#include "ns3/ptr.h"
+#include "ns3/nstime.h"
+
+namespace ns3 {
+
+class QbbNetDevice;
+
+/**
+ * \brief One event of a binary qbb trace.
+ *
+ * Records are stored as fixed-size little-endian structures, see
+ * QbbTraceRecord::Serialize. Fields that do not apply to the packet are 0.
+ * The meaning of seq, pg, aux0 and aux1 depends on the protocol:
+ *
+ * - UDP (17): SeqTsHeader seq and pg.
+ * - TCP (6): TCP sequence number.
+ * - ACK (0xFC) / NACK (0xFD): qbbHeader seq and pg, aux0 = port.
+ * - PFC (0xFE): pg = paused queue, aux0 = pause time, aux1 = qlen.
+ * - CNP (0xFF): pg = queue, seq = (fid << 8) | ECN bits, aux0 = qfb,
+ *   aux1 = total.
+ */
+struct QbbTraceRecord
+{
+  enum Flags
+  {
+    PPP = 1,            //!< the packet started with a PPP header
+    PAYLOAD = 2,        //!< the packet carried payload after its headers
+    QUEUE = 4,          //!< the event comes from the device queue
+    IPV4 = 8            //!< the packet is IPv4, the address fields are valid
+  };
+
+  uint64_t time;        //!< simulator time steps
+  uint32_t node;
+  uint16_t ifIndex;
+  uint8_t type;         //!< 'r', 'd', '+' or '-'
+  uint8_t flags;
+  uint32_t src;
+  uint32_t dst;
+  uint16_t sport;
+  uint16_t dport;
+  uint8_t protocol;     //!< IPv4 protocol number, 0 if not IPv4
+  uint8_t ecn;          //!< IPv4 ECN bits
+  uint16_t pg;
+  uint32_t seq;
+  uint32_t size;        //!< packet size in bytes as seen by the trace source
+  uint32_t aux0;
+  uint32_t aux1;
+
+  static const uint32_t SERIALIZED_SIZE = 48;
+
+  QbbTraceRecord ();
+  /**
+   * Fill the packet fields from the packet bytes, without modifying or
+   * copying the packet.
+   */
+  void Parse (Ptr<const Packet> p, bool withPpp);
+  void Serialize (uint8_t *buf) const;
+  void Deserialize (const uint8_t *buf);
+};
+
+/**
+ * \brief Buffered writer of binary qbb traces.
+ *
+ * Replaces the per-line, flushed ASCII trace of QbbHelper::EnableAscii:
+ * every event costs one fixed-size record appended to a large buffer, which
+ * is written out only when full. utils/qbb-trace-to-text converts a binary
+ * trace back to the ASCII format.
+ *
+ * The file starts with a 12-byte header: the magic "QBBT", the format
+ * version (u16), the record size (u16) and the Time::Unit the timestamps are
+ * expressed in (u32), followed by the records.
+ *
+ * A writer may be shared by the partitions of a MultithreadedSimulatorImpl:
+ * every thread then appends to its own buffer without locks, and the main
+ * thread merges the records by time and node between two rounds. The file
+ * only depends on the partitioning, not on the timing of the threads.
+ */
+class QbbTraceWriter : public SimpleRefCount<QbbTraceWriter>
+{
+public:
+  static const uint16_t VERSION = 1;
+
+  /**
+   * \param filename the file to create
+   * \param bufferSize bytes buffered before each write to the file
+   */
+  QbbTraceWriter (std::string filename, uint32_t bufferSize = 4 << 20);
+  ~QbbTraceWriter ();
+
+  /**
+   * Connect the trace sources of the device to this writer: MacRx ('r') and
+   * PhyRxDrop ('d'), plus the Enqueue ('+'), Dequeue ('-') and Drop ('d')
+   * sources of its queue if queueEvents is set.
+   */
+  void Hook (Ptr<QbbNetDevice> device, bool queueEvents);
+
+  void Write (const QbbTraceRecord &record);
+  /**
+   * \param flags PPP if p starts with a PPP header, QUEUE for queue events
+   */
+  void Write (uint8_t type, uint32_t node, uint32_t ifIndex, Ptr<const Packet> p, uint8_t flags);
+  void Flush (void);
+
+private:
+  QbbTraceWriter (const QbbTraceWriter &);
+  QbbTraceWriter &operator = (const QbbTraceWriter &);
+
+  void EndRound (Time until);
+  /**
+   * Write the buffered records of the threads earlier than until.
+   */
+  void Merge (uint64_t until);
+  void Append (const QbbTraceRecord &record);
+  void DoFlush (void);
+
+  FILE *m_file;
+  std::vector<uint8_t> m_buffer;
+  uint32_t m_used;
+  // records of every thread of a multithreaded run, by system id; empty
+  // otherwise, the records being appended to m_buffer right away
+  std::vector<std::vector<QbbTraceRecord> > m_threads;
+  std::vector<QbbTraceRecord> m_merged;
+};
+
+/**
+ * \brief Sequential reader of binary qbb traces.
+ */
+class QbbTraceReader
+{
+public:
+  QbbTraceReader ();
+  ~QbbTraceReader ();
+
+  /**
+   * \return false if the file cannot be opened or is not a qbb trace
+   */
+  bool Open (std::string filename);
+  /**
+   * \return false at the end of the file
+   */
+  bool Read (QbbTraceRecord &record);
+  /**
+   * \return the Time::Unit of the timestamps
+   */
+  uint32_t GetResolution (void) const;
+
+private:
+  FILE *m_file;
+  uint32_t m_recordSize;
+  uint32_t m_resolution;
+  std::vector<uint8_t> m_record;
+};
+
+} // namespace ns3
+
+#endif /* QBB_TRACE_WRITER_H */
@@ -78,6 +78,8 @@ QbbChannel::Attach (Ptr<QbbNetDevice> device)
     {
       m_link[0].m_dst = m_link[1].m_src;
       m_link[1].m_dst = m_link[0].m_src;
+      m_link[0].m_dstContext = m_link[0].m_dst->GetNode ()->GetId ();
+      m_link[1].m_dstContext = m_link[1].m_dst->GetNode ()->GetId ();
       m_link[0].m_state = IDLE;
       m_link[1].m_state = IDLE;
     }
@@ -99,12 +101,18 @@ QbbChannel::TransmitStart (
 
   uint32_t wire = src == m_link[0].m_src ? 0 : 1;
 
-  Simulator::ScheduleWithContext (m_link[wire].m_dst->GetNode ()->GetId (),
+  // The receiver may run in another thread of a multithreaded simulation,
+  // so neither the event nor this function may copy a Ptr to it: reference
+  // counts are not atomic.
+  Simulator::ScheduleWithContext (m_link[wire].m_dstContext,
                                   txTime + m_delay, &QbbNetDevice::Receive,
-                                  m_link[wire].m_dst, p);
+                                  PeekPointer (m_link[wire].m_dst), p);
 
   // Call the tx anim callback on the net device
-  m_txrxQbb (p, src, m_link[wire].m_dst, txTime, txTime + m_delay);
+  if (!m_txrxQbb.IsEmpty ())
+    {
+      m_txrxQbb (p, src, m_link[wire].m_dst, txTime, txTime + m_delay);
+    }
   return true;
 }
 
@@ -135,6 +143,14 @@ QbbChannel::GetDevice (uint32_t i) const
   return GetQbbDevice (i);
 }
 
+Address
+QbbChannel::GetRemoteAddress (Ptr<const QbbNetDevice> device) const
+{
+  NS_ASSERT (m_nDevices == N_DEVICES);
+  uint32_t wire = PeekPointer (device) == PeekPointer (m_link[0].m_src) ? 0 : 1;
+  return m_link[wire].m_dst->GetAddress ();
+}
+
 Time
 QbbChannel::GetDelay (void) const
 {
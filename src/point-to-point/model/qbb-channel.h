@@ -23,6 +23,7 @@
 #include "ns3/channel.h"
 #include "ns3/point-to-point-channel.h"
 #include "ns3/ptr.h"
+#include "ns3/address.h"
 #include "ns3/nstime.h"
 #include "ns3/data-rate.h"
 #include "ns3/traced-callback.h"
@@ -93,6 +94,16 @@ public:
    */
   virtual Ptr<NetDevice> GetDevice (uint32_t i) const;
 
+  /**
+   * \brief Get the address of the device at the other end of the channel
+   * \param device one of the two devices of this channel
+   * \returns the address of the other device
+   *
+   * Unlike GetDevice, this does not take a reference to the other device,
+   * which may belong to another partition of a multithreaded simulation.
+   */
+  Address GetRemoteAddress (Ptr<const QbbNetDevice> device) const;
+
 protected:
   /*
    * \brief Get the delay associated with this channel
@@ -156,10 +167,11 @@ private:
   class Link
   {
 public:
-    Link() : m_state (INITIALIZING), m_src (0), m_dst (0) {}
+    Link() : m_state (INITIALIZING), m_src (0), m_dst (0), m_dstContext (0) {}
     WireState                  m_state;
     Ptr<QbbNetDevice> m_src;
     Ptr<QbbNetDevice> m_dst;
+    uint32_t          m_dstContext; // node id of m_dst, the receive events' context
   };
 
   Link    m_link[N_DEVICES];
@@ -0,0 +1,287 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+* This program is free software; you can redistribute it and/or modify
+* it under the terms of the GNU General Public License version 2 as
+* published by the Free Software Foundation;
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program; if not, write to the Free Software
+* Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+*/
+#include <algorithm>
+#include "ns3/assert.h"
+#include "qbb-dcqcn-rp.h"
+
+namespace ns3 {
+
+	QbbDcqcnRp::QbbDcqcnRp()
+		: m_params(0),
+		m_txBytes(0),
+		m_rpByteStage(0),
+		m_rpTimeStage(0),
+		m_rpStage(0), //not in any qcn stage
+		m_nextTimer(Time::Max()),
+		m_alpha(0.5),
+		m_nextAlpha(Time::Max())
+	{
+	}
+
+	void
+		QbbDcqcnRp::Start(const Params *params)
+	{
+		m_params = params;
+		m_rateAll = params->lineRate;
+		m_targetRate = params->lineRate;	//targetrate remembers the last rate
+		m_txBytes = params->bc;
+	}
+
+	bool
+		QbbDcqcnRp::IsStarted() const
+	{
+		return m_params != 0;
+	}
+
+	Time
+		QbbDcqcnRp::GetNextTimer() const
+	{
+		return m_nextTimer;
+	}
+
+	void
+		QbbDcqcnRp::FireTimer()
+	{
+		NS_ASSERT(m_rpStage > 0);
+		Time now = m_nextTimer;
+		m_rpTimeStage++;
+		if (m_rpStage == 1)
+		{
+			m_nextTimer = now + m_params->timer;
+			if (m_rpTimeStage < m_params->threshold)
+			{
+				AdjustRates(DataRate("0bps"));
+				m_rpStage = 1;
+			}
+			else
+			{
+				ActiveSelect();
+			}
+		}
+		else if (m_rpStage == 2)
+		{
+			m_nextTimer = now + m_params->timer;
+			ActiveSelect();
+		}
+		else
+		{
+			m_nextTimer = now + m_params->hyperTimer;
+			HyperIncrease();
+		}
+	}
+
+	void
+		QbbDcqcnRp::Advance(Time now)
+	{
+		while (m_nextTimer <= now)
+		{
+			if (SkipHyperTimers(now) || SkipActiveTimers(now))
+			{
+				return;
+			}
+			FireTimer();
+		}
+	}
+
+	void
+		QbbDcqcnRp::Transmitted(uint32_t size)
+	{
+		if (m_rpStage > 0)
+			m_txBytes -= size;
+		else
+			m_txBytes = m_params->bc;
+		if (m_txBytes >= 0)
+			return;
+		m_rpByteStage++;
+		if (m_rpStage == 1)
+		{
+			m_txBytes = m_params->bc;
+			if (m_rpByteStage < m_params->threshold)
+			{
+				AdjustRates(DataRate("0bps"));
+				m_rpStage = 1;
+			}
+			else
+			{
+				ActiveSelect();
+			}
+		}
+		else if (m_rpStage == 2)
+		{
+			m_txBytes = m_params->bc;
+			ActiveIncrease();
+		}
+		else
+		{
+			m_txBytes = m_params->bc / 2;
+			HyperIncrease();
+		}
+	}
+
+	void
+		QbbDcqcnRp::ReceiveCnp(Time now)
+	{
+		NS_ASSERT(m_nextTimer > now);
+		while (m_nextAlpha <= now)
+		{
+			if (m_alpha == 0)
+			{
+				int64_t step = m_params->alphaInterval.GetTimeStep();
+				m_nextAlpha = m_nextAlpha + TimeStep(((now - m_nextAlpha).GetTimeStep() / step + 1) * step);
+				break;
+			}
+			m_alpha = (1 - m_params->g)*m_alpha;
+			m_nextAlpha = m_nextAlpha + m_params->alphaInterval;
+		}
+
+		if (!m_params->clampTgtRateAfterTimeInc && !m_params->clampTgtRate)
+		{
+			if (m_rpByteStage != 0)
+			{
+				m_targetRate = m_rateAll;
+				m_txBytes = m_params->bc;
+			}
+		}
+		else if (m_params->clampTgtRate)
+		{
+			m_targetRate = m_rateAll;
+			m_txBytes = m_params->bc; //for fluid model, QCN standard doesn't have this.
+		}
+		else
+		{
+			if (m_rpByteStage != 0 || m_rpTimeStage != 0)
+			{
+				m_targetRate = m_rateAll;
+				m_txBytes = m_params->bc;
+			}
+		}
+		m_rpByteStage = 0;
+		m_rpTimeStage = 0;
+		m_alpha = (1 - m_params->g)*m_alpha + m_params->g; 	//binary feedback
+		m_rateAll = std::max(m_params->minRate, m_rateAll * (1 - m_alpha / 2));
+		m_nextAlpha = now + m_params->alphaInterval;
+		m_nextTimer = now + m_params->timer;
+		m_rpStage = 1;
+	}
+
+	DataRate
+		QbbDcqcnRp::GetRate() const
+	{
+		return m_rateAll;
+	}
+
+	DataRate
+		QbbDcqcnRp::GetTargetRate() const
+	{
+		return m_targetRate;
+	}
+
+	uint32_t
+		QbbDcqcnRp::GetStage() const
+	{
+		return m_rpStage;
+	}
+
+	void
+		QbbDcqcnRp::AdjustRates(DataRate increase)
+	{
+		if (((m_rpByteStage == 1) || (m_rpTimeStage == 1)) && (m_targetRate > 10 * m_rateAll))
+			m_targetRate /= 8;
+		else
+			m_targetRate += increase;
+
+		m_rateAll = (m_rateAll / 2) + (m_targetRate / 2);
+
+		if (m_rateAll > m_params->lineRate)
+			m_rateAll = m_params->lineRate;
+	}
+
+	void
+		QbbDcqcnRp::ActiveSelect()
+	{
+		if (m_rpByteStage < m_params->threshold || m_rpTimeStage < m_params->threshold)
+			ActiveIncrease();
+		else
+			HyperIncrease();
+	}
+
+	void
+		QbbDcqcnRp::ActiveIncrease()
+	{
+		AdjustRates(m_params->rai);
+		m_rpStage = 2;
+	}
+
+	void
+		QbbDcqcnRp::HyperIncrease()
+	{
+		AdjustRates(m_params->rhai*(std::min(m_rpByteStage, m_rpTimeStage) - m_params->threshold + 1));
+		m_rpStage = 3;
+	}
+
+	bool
+		QbbDcqcnRp::AtLineRate() const
+	{
+		//AdjustRates can only raise the target rate, the rate then stays capped
+		return m_rateAll == m_params->lineRate && (m_rateAll / 2) + (m_targetRate / 2) >= m_params->lineRate;
+	}
+
+	bool
+		QbbDcqcnRp::SkipHyperTimers(Time now)
+	{
+		//every expiry adds rhai*(min(byte stage, time stage) - threshold + 1) to the
+		//target rate, as long as AdjustRates does not divide it
+		if (m_rpStage != 3 || m_params->threshold == 0 || m_rpByteStage == 1 || m_rpTimeStage == 0 || !AtLineRate())
+			return false;
+		int64_t step = m_params->hyperTimer.GetTimeStep();
+		uint64_t k = (now - m_nextTimer).GetTimeStep() / step + 1;
+		uint64_t t0 = m_rpTimeStage;
+		uint64_t b = m_rpByteStage;
+		uint64_t base = m_params->threshold - 1;	//x = min(b, t) - base
+		if (t0 + k >= 0x80000000ULL)
+			return false;
+		uint64_t xMax = std::min(b, t0 + k) - base;
+		double rhai = m_params->rhai.GetBitRate();
+		if (rhai * xMax >= 9007199254740992.0 //2^53, rhai*x is exact below
+			|| m_targetRate.GetBitRate() + rhai * xMax * k >= 9223372036854775808.0) //2^63
+			return false;
+		//the time stage first catches up with the byte stage, then x stays put
+		uint64_t n1 = b > t0 ? std::min(k, b - t0 - 1) : 0;
+		uint64_t sum = n1 * (t0 - base) + n1 * (n1 + 1) / 2 + (k - n1) * (b - base);
+		m_targetRate += DataRate(m_params->rhai.GetBitRate() * sum);
+		m_rpTimeStage += k;
+		m_nextTimer = m_nextTimer + TimeStep(k * step);
+		return true;
+	}
+
+	bool
+		QbbDcqcnRp::SkipActiveTimers(Time now)
+	{
+		//below the fast recovery times of transmissions, every expiry adds rai
+		if (m_rpStage != 2 || m_rpByteStage >= m_params->threshold || m_rpByteStage == 1 || m_rpTimeStage == 0 || !AtLineRate())
+			return false;
+		int64_t step = m_params->timer.GetTimeStep();
+		uint64_t k = (now - m_nextTimer).GetTimeStep() / step + 1;
+		if (m_rpTimeStage + k >= 0x80000000ULL
+			|| m_targetRate.GetBitRate() + (double)m_params->rai.GetBitRate() * k >= 9223372036854775808.0)
+			return false;
+		m_targetRate += DataRate(m_params->rai.GetBitRate() * k);
+		m_rpTimeStage += k;
+		m_nextTimer = m_nextTimer + TimeStep(k * step);
+		return true;
+	}
+
+} // namespace ns3
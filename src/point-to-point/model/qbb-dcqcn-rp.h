@@ -0,0 +1,119 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+* This program is free software; you can redistribute it and/or modify
+* it under the terms of the GNU General Public License version 2 as
+* published by the Free Software Foundation;
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program; if not, write to the Free Software
+* Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+*/
+#ifndef QBB_DCQCN_RP_H
+#define QBB_DCQCN_RP_H
+
+#include <stdint.h>
+#include "ns3/nstime.h"
+#include "ns3/data-rate.h"
+
+namespace ns3 {
+
+/**
+ * \class QbbDcqcnRp
+ * \brief DCQCN reaction point of one flow (and hop) of a qbb NIC.
+ *
+ * The rate increase timer and the alpha timer are not simulator events: the
+ * state keeps the time of their next expiry and catches up when the flow is
+ * next looked at. Alpha is only read when a CNP arrives, so its decay is
+ * applied then. The rate increase timer changes the rate, so its owner calls
+ * FireTimer for every expiry that matters to it, or Advance to apply all the
+ * expiries up to now at once; once the rate has climbed back to the line rate
+ * and the stage no longer changes, Advance adds up the remaining target rate
+ * increases in closed form. Both give, bit for bit, the rates the timer
+ * events used to.
+ */
+class QbbDcqcnRp
+{
+public:
+	/**
+	 * Parameters shared by the flows of a NIC.
+	 */
+	struct Params
+	{
+		DataRate lineRate;
+		DataRate minRate;	//< Min sending rate
+		DataRate rai;		//< Rate of additive increase
+		DataRate rhai;		//< Rate of hyper-additive increase
+		uint32_t bc;		//< Tx byte counter timeout threshold
+		uint32_t threshold;	//< Fast recovery times
+		double g;
+		Time timer;			//< Rate increase timer
+		Time hyperTimer;	//< Rate increase timer in hyper increase
+		Time alphaInterval;
+		bool clampTgtRate;
+		bool clampTgtRateAfterTimeInc;
+	};
+
+	QbbDcqcnRp();
+
+	/**
+	 * Start at the line rate, before the first packet or CNP of the flow.
+	 */
+	void Start(const Params *params);
+	bool IsStarted() const;
+
+	/**
+	 * \return the time of the next rate increase timer expiry, or
+	 * Time::Max() when the timer is not running
+	 */
+	Time GetNextTimer() const;
+	/**
+	 * Handle the timer expiry at GetNextTimer().
+	 */
+	void FireTimer();
+	/**
+	 * Handle all the timer expiries up to now.
+	 */
+	void Advance(Time now);
+
+	/**
+	 * Count a transmitted packet against the byte counter.
+	 */
+	void Transmitted(uint32_t size);
+	/**
+	 * A CNP arrived; the timer must not be behind now.
+	 */
+	void ReceiveCnp(Time now);
+
+	DataRate GetRate() const;
+	DataRate GetTargetRate() const;
+	uint32_t GetStage() const;
+
+private:
+	void AdjustRates(DataRate increase);
+	void ActiveSelect();
+	void ActiveIncrease();
+	void HyperIncrease();
+	bool SkipHyperTimers(Time now);
+	bool SkipActiveTimers(Time now);
+	bool AtLineRate() const;
+
+	const Params *m_params;
+	DataRate m_rateAll;
+	DataRate m_targetRate;	//< Target rate
+	int64_t m_txBytes;		//< Tx byte counter
+	uint32_t m_rpByteStage;	//< Count of Tx-based rate increments
+	uint32_t m_rpTimeStage;	//< Count of timer-based rate increments
+	uint32_t m_rpStage;		//1: fr; 2: ai; 3: hi
+	Time m_nextTimer;
+	double m_alpha;			//< Alpha, up to m_nextAlpha
+	Time m_nextAlpha;
+};
+
+} // namespace ns3
+
+#endif /* QBB_DCQCN_RP_H */
@@ -0,0 +1,104 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+* This program is free software; you can redistribute it and/or modify
+* it under the terms of the GNU General Public License version 2 as
+* published by the Free Software Foundation;
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program; if not, write to the Free Software
+* Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+*/
+#include <algorithm>
+#include "qbb-dcqcn.h"
+
+namespace ns3 {
+
+	void
+		QbbDcqcn::SetParams(const Params &params)
+	{
+		m_params = params;
+	}
+
+	void
+		QbbDcqcn::AddFlows(uint32_t n)
+	{
+		if (m_rp.size() < n * maxHop)
+			m_rp.resize(n * maxHop);
+	}
+
+	void
+		QbbDcqcn::Start(uint32_t fIndex)
+	{
+		for (uint32_t j = 0; j < maxHop; j++)
+		{
+			Rp(fIndex, j).Start(&m_params);
+		}
+	}
+
+	void
+		QbbDcqcn::RemoveFlow(uint32_t fIndex)
+	{
+		for (uint32_t j = 0; j < maxHop; j++)
+		{
+			Rp(fIndex, j) = QbbDcqcnRp();
+		}
+	}
+
+	DataRate
+		QbbDcqcn::GetRate(uint32_t fIndex) const
+	{
+		DataRate rate = m_params.lineRate;
+		for (uint32_t j = 0; j < maxHop; j++)
+			rate = std::min(rate, Rp(fIndex, j).GetRate());
+		return rate;
+	}
+
+	Time
+		QbbDcqcn::GetNextTimer(uint32_t fIndex) const
+	{
+		Time next = Time::Max();
+		for (uint32_t j = 0; j < maxHop; j++)
+			next = std::min(next, Rp(fIndex, j).GetNextTimer());
+		return next;
+	}
+
+	void
+		QbbDcqcn::FireTimer(uint32_t fIndex)
+	{
+		uint32_t hop = 0;
+		for (uint32_t j = 1; j < maxHop; j++)
+		{
+			if (Rp(fIndex, j).GetNextTimer() < Rp(fIndex, hop).GetNextTimer())
+				hop = j;
+		}
+		Rp(fIndex, hop).FireTimer();
+	}
+
+	void
+		QbbDcqcn::Advance(uint32_t fIndex, Time now)
+	{
+		for (uint32_t j = 0; j < maxHop; j++)
+			Rp(fIndex, j).Advance(now);
+	}
+
+	void
+		QbbDcqcn::Transmitted(uint32_t fIndex, uint32_t size)
+	{
+		for (uint32_t i = 0; i < 1; i++)
+		{
+			Rp(fIndex, i).Transmitted(size);
+		}
+	}
+
+	void
+		QbbDcqcn::ReceiveCnp(uint32_t fIndex, Time now)
+	{
+		Rp(fIndex, 0).ReceiveCnp(now);
+	}
+
+} // namespace ns3
@@ -0,0 +1,95 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+* This program is free software; you can redistribute it and/or modify
+* it under the terms of the GNU General Public License version 2 as
+* published by the Free Software Foundation;
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program; if not, write to the Free Software
+* Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+*/
+#ifndef QBB_DCQCN_H
+#define QBB_DCQCN_H
+
+#include <stdint.h>
+#include <vector>
+#include "ns3/nstime.h"
+#include "ns3/data-rate.h"
+#include "ns3/qbb-dcqcn-rp.h"
+
+namespace ns3 {
+
+/**
+ * \class QbbDcqcn
+ * \brief DCQCN congestion control of the flows of a qbb NIC.
+ *
+ * Each flow has one QbbDcqcnRp per hop and sends at the lowest of their
+ * rates. The flows are identified by their index in m_txFlows of the
+ * QbbNetDevice, which grows them with AddFlows.
+ *
+ * Like QbbTimely, this class is a congestion control policy of
+ * QbbNetDevice: the device calls it through templates, so the calls made
+ * for every transmitted packet are bound at compile time. A policy has the
+ * same non-virtual members as this class:
+ *  - rate timers: GetNextTimer, FireTimer and Advance, which the device
+ *    applies before the credits of the flow move on, and
+ *  - feedback: Transmitted for every packet put on the wire, ReceiveCnp
+ *    for every CNP, and ReceiveAck for every ACK when NeedsRtt() is true.
+ */
+class QbbDcqcn
+{
+public:
+	static const uint32_t maxHop = 1; // Max hop count in the network. should not exceed 16
+	typedef QbbDcqcnRp::Params Params;
+
+	void SetParams(const Params &params);
+	void AddFlows(uint32_t n);
+
+	/**
+	 * Start flow fIndex at the line rate.
+	 */
+	void Start(uint32_t fIndex);
+	/**
+	 * Forget flow fIndex, whose index may be taken by a new flow.
+	 */
+	void RemoveFlow(uint32_t fIndex);
+	/**
+	 * \return the sending rate of flow fIndex
+	 */
+	DataRate GetRate(uint32_t fIndex) const;
+
+	/**
+	 * \return the time of the next rate timer expiry of flow fIndex, or
+	 * Time::Max() when none is running
+	 */
+	Time GetNextTimer(uint32_t fIndex) const;
+	/**
+	 * Handle the timer expiry of flow fIndex at GetNextTimer(fIndex).
+	 */
+	void FireTimer(uint32_t fIndex);
+	/**
+	 * Handle all the timer expiries of flow fIndex up to now.
+	 */
+	void Advance(uint32_t fIndex, Time now);
+
+	void Transmitted(uint32_t fIndex, uint32_t size);
+	void ReceiveCnp(uint32_t fIndex, Time now);
+	void ReceiveAck(uint32_t fIndex, Time rtt) {}
+	static bool NeedsRtt() { return false; }
+
+private:
+	QbbDcqcnRp &Rp(uint32_t fIndex, uint32_t hop) { return m_rp[fIndex * maxHop + hop]; }
+	const QbbDcqcnRp &Rp(uint32_t fIndex, uint32_t hop) const { return m_rp[fIndex * maxHop + hop]; }
+
+	Params m_params;
+	std::vector<QbbDcqcnRp> m_rp;	//< Reaction points, maxHop per flow
+};
+
+} // namespace ns3
+
+#endif /* QBB_DCQCN_H */
@@ -0,0 +1,144 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+* This program is free software; you can redistribute it and/or modify
+* it under the terms of the GNU General Public License version 2 as
+* published by the Free Software Foundation;
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program; if not, write to the Free Software
+* Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+*/
+#include "ns3/assert.h"
+#include "qbb-flow-table.h"
+
+namespace ns3 {
+
+	const uint32_t QbbFlowTable::NOT_FOUND;
+
+	QbbFlowTable::QbbFlowTable()
+		: m_mask(0),
+		m_size(0)
+	{
+		Resize(16);
+	}
+
+	uint64_t
+		QbbFlowTable::MakeKey(Ipv4Address src, uint16_t port, uint16_t pg)
+	{
+		return ((uint64_t)src.Get() << 32) | ((uint64_t)port << 16) | pg;
+	}
+
+	uint32_t
+		QbbFlowTable::Hash(uint64_t key)
+	{
+		//64-bit finalizer of murmur3, spreads port/PG bits over the whole word
+		key ^= key >> 33;
+		key *= 0xff51afd7ed558ccdULL;
+		key ^= key >> 33;
+		key *= 0xc4ceb9fe1a85ec53ULL;
+		key ^= key >> 33;
+		return (uint32_t)key;
+	}
+
+	uint32_t
+		QbbFlowTable::Find(uint64_t key) const
+	{
+		uint32_t i = Hash(key) & m_mask;
+		while (m_slots[i].index != NOT_FOUND)
+		{
+			if (m_slots[i].key == key)
+				return i;
+			i = (i + 1) & m_mask;
+		}
+		return i;
+	}
+
+	uint32_t
+		QbbFlowTable::Lookup(Ipv4Address src, uint16_t port, uint16_t pg) const
+	{
+		return m_slots[Find(MakeKey(src, port, pg))].index;
+	}
+
+	void
+		QbbFlowTable::Insert(Ipv4Address src, uint16_t port, uint16_t pg, uint32_t index)
+	{
+		NS_ASSERT(index != NOT_FOUND);
+		if ((m_size + 1) * 2 > m_slots.size())	//keep load factor under 1/2
+		{
+			Resize(m_slots.size() * 2);
+		}
+		uint64_t key = MakeKey(src, port, pg);
+		uint32_t i = Find(key);
+		if (m_slots[i].index == NOT_FOUND)
+		{
+			m_size++;
+		}
+		m_slots[i].key = key;
+		m_slots[i].index = index;
+	}
+
+	bool
+		QbbFlowTable::Remove(Ipv4Address src, uint16_t port, uint16_t pg)
+	{
+		uint32_t i = Find(MakeKey(src, port, pg));
+		if (m_slots[i].index == NOT_FOUND)
+			return false;
+		//backward-shift the rest of the cluster so that probing never needs tombstones
+		uint32_t j = i;
+		while (true)
+		{
+			j = (j + 1) & m_mask;
+			if (m_slots[j].index == NOT_FOUND)
+				break;
+			uint32_t home = Hash(m_slots[j].key) & m_mask;
+			if (((j - home) & m_mask) >= ((j - i) & m_mask))
+			{
+				m_slots[i] = m_slots[j];
+				i = j;
+			}
+		}
+		m_slots[i].index = NOT_FOUND;
+		m_size--;
+		return true;
+	}
+
+	uint32_t
+		QbbFlowTable::GetSize() const
+	{
+		return m_size;
+	}
+
+	void
+		QbbFlowTable::Clear()
+	{
+		for (uint32_t i = 0; i < m_slots.size(); i++)
+		{
+			m_slots[i].index = NOT_FOUND;
+		}
+		m_size = 0;
+	}
+
+	void
+		QbbFlowTable::Resize(uint32_t capacity)
+	{
+		std::vector<Entry> old;
+		old.swap(m_slots);
+		Entry empty;
+		empty.key = 0;
+		empty.index = NOT_FOUND;
+		m_slots.assign(capacity, empty);
+		m_mask = capacity - 1;
+		for (uint32_t i = 0; i < old.size(); i++)
+		{
+			if (old[i].index == NOT_FOUND)
+				continue;
+			m_slots[Find(old[i].key)] = old[i];
+		}
+	}
+
+} // namespace ns3
@@ -0,0 +1,78 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+* This program is free software; you can redistribute it and/or modify
+* it under the terms of the GNU General Public License version 2 as
+* published by the Free Software Foundation;
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program; if not, write to the Free Software
+* Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+*/
+#ifndef QBB_FLOW_TABLE_H
+#define QBB_FLOW_TABLE_H
+
+#include <stdint.h>
+#include <vector>
+#include "ns3/ipv4-address.h"
+
+namespace ns3 {
+
+/**
+ * \class QbbFlowTable
+ * \brief Per-NIC map from (source IP, UDP port, PG) to a dense flow index.
+ *
+ * Open addressing with linear probing over a power-of-two slot array, so a
+ * lookup is a hash and (usually) a single probe no matter how many flows the
+ * NIC carries. Removal uses backward-shift deletion, so no tombstones are
+ * left behind.
+ */
+class QbbFlowTable
+{
+public:
+	static const uint32_t NOT_FOUND = 0xffffffff;
+
+	QbbFlowTable();
+
+	/**
+	 * \return the flow index stored for the key, or NOT_FOUND
+	 */
+	uint32_t Lookup(Ipv4Address src, uint16_t port, uint16_t pg) const;
+
+	/**
+	 * Map the key to index. An existing entry for the key is overwritten.
+	 */
+	void Insert(Ipv4Address src, uint16_t port, uint16_t pg, uint32_t index);
+
+	/**
+	 * \return true if the key was present
+	 */
+	bool Remove(Ipv4Address src, uint16_t port, uint16_t pg);
+
+	uint32_t GetSize() const;
+	void Clear();
+
+private:
+	struct Entry
+	{
+		uint64_t key;
+		uint32_t index;	//< NOT_FOUND marks an empty slot
+	};
+
+	static uint64_t MakeKey(Ipv4Address src, uint16_t port, uint16_t pg);
+	static uint32_t Hash(uint64_t key);
+	uint32_t Find(uint64_t key) const;
+	void Resize(uint32_t capacity);
+
+	std::vector<Entry> m_slots;
+	uint32_t m_mask;
+	uint32_t m_size;
+};
+
+} // namespace ns3
+
+#endif /* QBB_FLOW_TABLE_H */
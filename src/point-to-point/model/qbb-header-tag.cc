@@ -0,0 +1,191 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+* This program is free software; you can redistribute it and/or modify
+* it under the terms of the GNU General Public License version 2 as
+* published by the Free Software Foundation;
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program; if not, write to the Free Software
+* Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+*/
+#include "qbb-header-tag.h"
+
+namespace ns3 {
+
+	NS_OBJECT_ENSURE_REGISTERED(QbbHeaderTag);
+
+	TypeId
+		QbbHeaderTag::GetTypeId(void)
+	{
+		static TypeId tid = TypeId("ns3::QbbHeaderTag")
+			.SetParent<Tag>()
+			.AddConstructor<QbbHeaderTag>()
+			;
+		return tid;
+	}
+
+	TypeId
+		QbbHeaderTag::GetInstanceTypeId(void) const
+	{
+		return GetTypeId();
+	}
+
+	uint32_t
+		QbbHeaderTag::GetSerializedSize(void) const
+	{
+		return 1 + 1 + 4 + 4 + 2 + 2 + 2 + 4;
+	}
+
+	void
+		QbbHeaderTag::Serialize(TagBuffer buf) const
+	{
+		buf.WriteU8(m_protocol);
+		buf.WriteU8(m_ecn);
+		buf.WriteU32(m_src.Get());
+		buf.WriteU32(m_dst.Get());
+		buf.WriteU16(m_sport);
+		buf.WriteU16(m_dport);
+		buf.WriteU16(m_pg);
+		buf.WriteU32(m_seq);
+	}
+
+	void
+		QbbHeaderTag::Deserialize(TagBuffer buf)
+	{
+		m_protocol = buf.ReadU8();
+		m_ecn = buf.ReadU8();
+		m_src.Set(buf.ReadU32());
+		m_dst.Set(buf.ReadU32());
+		m_sport = buf.ReadU16();
+		m_dport = buf.ReadU16();
+		m_pg = buf.ReadU16();
+		m_seq = buf.ReadU32();
+	}
+
+	void
+		QbbHeaderTag::Print(std::ostream &os) const
+	{
+		os << "proto=" << (uint32_t)m_protocol << " ecn=" << (uint32_t)m_ecn
+			<< " " << m_src << ":" << m_sport << " > " << m_dst << ":" << m_dport
+			<< " pg=" << m_pg << " seq=" << m_seq;
+	}
+
+	QbbHeaderTag::QbbHeaderTag()
+		: m_protocol(0),
+		m_ecn(0),
+		m_sport(0),
+		m_dport(0),
+		m_pg(0),
+		m_seq(0)
+	{
+	}
+
+	static inline uint16_t
+		ReadU16(const uint8_t *b)
+	{
+		return (uint16_t)((b[0] << 8) | b[1]);
+	}
+
+	static inline uint32_t
+		ReadU32(const uint8_t *b)
+	{
+		return ((uint32_t)b[0] << 24) | ((uint32_t)b[1] << 16) | ((uint32_t)b[2] << 8) | b[3];
+	}
+
+	bool
+		QbbHeaderTag::Parse(Ptr<const Packet> p, bool withPpp)
+	{
+		//PPP (2) + IPv4 with options (60) + UDP (8) + SeqTsHeader (14)
+		uint8_t buf[2 + 60 + 8 + 14];
+		uint32_t len = p->CopyData(buf, sizeof(buf));
+		uint32_t o = 0;
+		if (withPpp)
+		{
+			if (len < 2 || ReadU16(buf) != 0x0021)	//not IPv4
+				return false;
+			o = 2;
+		}
+		if (len < o + 20)
+			return false;
+		uint32_t ihl = (buf[o] & 0x0f) * 4;
+		m_ecn = buf[o + 1] & 0x03;
+		m_protocol = buf[o + 9];
+		m_src.Set(ReadU32(buf + o + 12));
+		m_dst.Set(ReadU32(buf + o + 16));
+		m_sport = m_dport = m_pg = 0;
+		m_seq = 0;
+		o += ihl;
+		if (m_protocol == 17 && len >= o + 8)
+		{
+			m_sport = ReadU16(buf + o);
+			m_dport = ReadU16(buf + o + 2);
+			o += 8;
+			if (len >= o + 14)
+			{
+				m_seq = ReadU32(buf + o);
+				m_pg = ReadU16(buf + o + 12);
+			}
+		}
+		return true;
+	}
+
+	uint8_t
+		QbbHeaderTag::GetProtocol(void) const
+	{
+		return m_protocol;
+	}
+
+	uint8_t
+		QbbHeaderTag::GetEcn(void) const
+	{
+		return m_ecn;
+	}
+
+	void
+		QbbHeaderTag::SetEcn(uint8_t ecn)
+	{
+		m_ecn = ecn;
+	}
+
+	Ipv4Address
+		QbbHeaderTag::GetSource(void) const
+	{
+		return m_src;
+	}
+
+	Ipv4Address
+		QbbHeaderTag::GetDestination(void) const
+	{
+		return m_dst;
+	}
+
+	uint16_t
+		QbbHeaderTag::GetSourcePort(void) const
+	{
+		return m_sport;
+	}
+
+	uint16_t
+		QbbHeaderTag::GetDestinationPort(void) const
+	{
+		return m_dport;
+	}
+
+	uint16_t
+		QbbHeaderTag::GetPG(void) const
+	{
+		return m_pg;
+	}
+
+	uint32_t
+		QbbHeaderTag::GetSeq(void) const
+	{
+		return m_seq;
+	}
+
+} // namespace ns3
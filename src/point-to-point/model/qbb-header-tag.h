@@ -0,0 +1,84 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+* This program is free software; you can redistribute it and/or modify
+* it under the terms of the GNU General Public License version 2 as
+* published by the Free Software Foundation;
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program; if not, write to the Free Software
+* Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+*/
+#ifndef QBB_HEADER_TAG_H
+#define QBB_HEADER_TAG_H
+
+#include <stdint.h>
+#include "ns3/tag.h"
+#include "ns3/packet.h"
+#include "ns3/ipv4-address.h"
+
+namespace ns3 {
+
+/**
+ * \class QbbHeaderTag
+ * \brief Parsed copy of the IPv4/UDP/SeqTs fields the qbb devices look at.
+ *
+ * The header fields are read once, straight from the packet bytes, when the
+ * packet enters a QbbNetDevice and are then carried along as a packet tag,
+ * so later hops can classify the packet without copying it and removing
+ * headers. Whoever rewrites one of the cached fields in the real header
+ * (e.g. ECN marking) has to update the tag too.
+ *
+ * The serialized form is exactly PACKET_TAG_MAX_SIZE bytes, so there is no
+ * room for more fields.
+ */
+class QbbHeaderTag : public Tag
+{
+public:
+	static TypeId GetTypeId(void);
+	virtual TypeId GetInstanceTypeId(void) const;
+	virtual uint32_t GetSerializedSize(void) const;
+	virtual void Serialize(TagBuffer buf) const;
+	virtual void Deserialize(TagBuffer buf);
+	virtual void Print(std::ostream &os) const;
+
+	QbbHeaderTag();
+
+	/**
+	 * Fill the tag from the packet bytes without modifying the packet.
+	 *
+	 * \param p the packet
+	 * \param withPpp true if p starts with a PPP header, false if it
+	 *        starts with the IPv4 header
+	 * \return false if p does not carry IPv4
+	 */
+	bool Parse(Ptr<const Packet> p, bool withPpp);
+
+	uint8_t GetProtocol(void) const;
+	uint8_t GetEcn(void) const;
+	void SetEcn(uint8_t ecn);
+	Ipv4Address GetSource(void) const;
+	Ipv4Address GetDestination(void) const;
+	uint16_t GetSourcePort(void) const;
+	uint16_t GetDestinationPort(void) const;
+	uint16_t GetPG(void) const;
+	uint32_t GetSeq(void) const;
+
+private:
+	uint8_t m_protocol;
+	uint8_t m_ecn;
+	Ipv4Address m_src;
+	Ipv4Address m_dst;
+	uint16_t m_sport;	//< UDP only
+	uint16_t m_dport;	//< UDP only
+	uint16_t m_pg;		//< SeqTsHeader, UDP only
+	uint32_t m_seq;		//< SeqTsHeader, UDP only
+};
+
+} // namespace ns3
+
+#endif /* QBB_HEADER_TAG_H */
@@ -25,6 +25,7 @@
 #include "ns3/log.h"
 #include "ns3/boolean.h"
 #include "ns3/uinteger.h"
+#include "ns3/enum.h"
 #include "ns3/double.h"
 #include "ns3/data-rate.h"
 #include "ns3/object-vector.h"
@@ -36,7 +37,7 @@
 #include "ns3/simulator.h"
 #include "ns3/point-to-point-channel.h"
 #include "ns3/qbb-channel.h"
-#include "ns3/random-variable.h"
+#include "ns3/random-variable-stream.h"
 #include "ns3/flow-id-tag.h"
 #include "ns3/qbb-header.h"
 #include "ns3/error-model.h"
@@ -174,6 +175,42 @@ namespace ns3 {
 				DoubleValue(500.0),
 				MakeDoubleAccessor(&QbbNetDevice::m_waitAckTimer),
 				MakeDoubleChecker<double>())
+			.AddAttribute("CongestionControl",
+				"Congestion control of the flows sent by the NIC. Timely needs L2AckInterval.",
+				EnumValue(CC_DCQCN),
+				MakeEnumAccessor(&QbbNetDevice::m_ccMode),
+				MakeEnumChecker(CC_DCQCN, "Dcqcn",
+					CC_TIMELY, "Timely"))
+			.AddAttribute("TimelyTLow",
+				"RTT below which TIMELY always increases the rate, in microseconds",
+				DoubleValue(50.0),
+				MakeDoubleAccessor(&QbbNetDevice::m_tmlyTLow),
+				MakeDoubleChecker<double>())
+			.AddAttribute("TimelyTHigh",
+				"RTT above which TIMELY always decreases the rate, in microseconds",
+				DoubleValue(500.0),
+				MakeDoubleAccessor(&QbbNetDevice::m_tmlyTHigh),
+				MakeDoubleChecker<double>())
+			.AddAttribute("TimelyMinRtt",
+				"Minimum RTT normalizing the TIMELY gradient, in microseconds",
+				DoubleValue(20.0),
+				MakeDoubleAccessor(&QbbNetDevice::m_tmlyMinRtt),
+				MakeDoubleChecker<double>())
+			.AddAttribute("TimelyAlpha",
+				"EWMA weight of a new RTT difference in TIMELY",
+				DoubleValue(0.875),
+				MakeDoubleAccessor(&QbbNetDevice::m_tmlyAlpha),
+				MakeDoubleChecker<double>(0, 1))
+			.AddAttribute("TimelyBeta",
+				"Multiplicative decrease factor of TIMELY",
+				DoubleValue(0.8),
+				MakeDoubleAccessor(&QbbNetDevice::m_tmlyBeta),
+				MakeDoubleChecker<double>(0, 1))
+			.AddAttribute("TimelyDelta",
+				"Rate increment unit of TIMELY",
+				DataRateValue(DataRate("10Mb/s")),
+				MakeDataRateAccessor(&QbbNetDevice::m_tmlyDelta),
+				MakeDataRateChecker())
 			;
 
 		return tid;
@@ -188,23 +225,11 @@ namespace ns3 {
 			m_paused[i] = false;
 		}
 		m_qcn_np_sampling = 0;
-		for (uint32_t i = 0; i < fCnt; i++)
-		{
-			m_credits[i] = 0;
-			m_nextAvail[i] = Time(0);
-			m_findex_udpport_map[i] = 0;
-			m_findex_qindex_map[i] = 0;
-			m_waitingAck[i] = false;
-			for (uint32_t j = 0; j < maxHop; j++)
-			{
-				m_txBytes[i][j] = m_bc;				//we don't need this at the beginning, so it doesn't matter what value it has
-				m_rpWhile[i][j] = m_rpgTimeReset;	//we don't need this at the beginning, so it doesn't matter what value it has
-				m_rpByteStage[i][j] = 0;
-				m_rpTimeStage[i][j] = 0;
-				m_alpha[i][j] = 0.5;
-				m_rpStage[i][j] = 0; //not in any qcn stage
-			}
-		}
+		//Without QCN the NIC sends from one queue per priority, so keep those slots around
+		AddTxFlow(qCnt - 1);
+		m_creditClock = 0;
+		m_creditAccrue[0] = true;
+		m_uniform = CreateObject<UniformRandomVariable>();
 		for (uint32_t i = 0; i < pCnt; i++)
 		{
 			m_ECNState[i] = 0;
@@ -218,6 +243,17 @@ namespace ns3 {
 		NS_LOG_FUNCTION(this);
 	}
 
+	void
+		QbbNetDevice::DoInitialize()
+	{
+		NS_LOG_FUNCTION(this);
+		if (m_node->GetNodeType() == 1)
+		{
+			m_node->m_broadcom->SetPfcCallback(m_ifIndex, MakeCallback(&QbbNetDevice::PfcStateChanged, this));
+		}
+		PointToPointNetDevice::DoInitialize();
+	}
+
 	void
 		QbbNetDevice::DoDispose()
 	{
@@ -226,19 +262,75 @@ namespace ns3 {
 		for (uint32_t i = 0; i < qCnt; i++)
 		{
 			Simulator::Cancel(m_resumeEvt[i]);
+			Simulator::Cancel(m_pfcRefreshEvt[i]);
 		}
+		Simulator::Cancel(m_cnpTimer);
 
-		for (uint32_t i = 0; i < fCnt; i++)
+		for (uint32_t i = 0; i < m_rateIncrease.size(); i++)
 		{
 			Simulator::Cancel(m_rateIncrease[i]);
 		}
-
-		for (uint32_t i = 0; i < pCnt; i++)
-			for (uint32_t j = 0; j < qCnt; j++)
-				Simulator::Cancel(m_recheckEvt[i][j]);
 		PointToPointNetDevice::DoDispose();
 	}
 
+	void
+		QbbNetDevice::AddTxFlow(uint32_t fIndex)
+	{
+		uint32_t n = m_rate.size();
+		if (fIndex < n)
+			return;
+		m_dcqcn.AddFlows(fIndex + 1);
+		m_timely.AddFlows(fIndex + 1);
+		m_rate.resize(fIndex + 1);
+		m_rpWakeAt.resize(fIndex + 1, -1);
+		m_credits.resize(fIndex + 1, 0);
+		m_creditBase.resize(fIndex + 1, 0);
+		m_creditAccrue.resize(fIndex + 1, false);
+		m_rateIncrease.resize(fIndex + 1);
+		m_sendingBuffer.resize(fIndex + 1);
+		m_milestone_tx.resize(fIndex + 1, 0);
+		m_retransmit.resize(fIndex + 1);
+		m_waitingAck.resize(fIndex + 1, false);
+		m_txStats.resize(fIndex + 1, TxFlowStats());
+		m_txBacklog.resize(fIndex + 1, 0);
+	}
+
+	void
+		QbbNetDevice::UpdateCredits(uint32_t fIndex)
+	{
+		if (m_creditAccrue[fIndex])
+		{
+			m_credits[fIndex] += m_rate[fIndex] / m_bps*(m_creditClock - m_creditBase[fIndex]);
+			m_creditBase[fIndex] = m_creditClock;
+		}
+	}
+
+	void
+		QbbNetDevice::SetNextAvail(uint32_t fIndex, Time t)
+	{
+		UpdateCc(fIndex);
+		UpdateCredits(fIndex);
+		m_queue->SetNextAvail(fIndex, t);
+		if (fIndex >= m_queue->m_fcount)	//a priority queue without flows yet, when QCN is off
+		{
+			m_creditAccrue[fIndex] = false;
+		}
+		else if (t.GetTimeStep() <= Simulator::Now().GetTimeStep())
+		{
+			if (!m_creditAccrue[fIndex])
+			{
+				m_creditAccrue[fIndex] = true;
+				m_creditBase[fIndex] = m_creditClock;
+				ScheduleCc(fIndex);
+			}
+		}
+		else
+		{
+			m_creditAccrue[fIndex] = false;
+			m_creditWake.push(CreditWake(t.GetTimeStep(), fIndex));
+		}
+	}
+
 	void
 		QbbNetDevice::TransmitComplete(void)
 	{
@@ -259,7 +351,7 @@ namespace ns3 {
 		Ptr<Packet> p;
 		if (m_node->GetNodeType() == 0 && m_qcnEnabled) //QCN enable NIC    
 		{
-			p = m_queue->DequeueQCN(m_paused, m_nextAvail, m_findex_qindex_map);
+			p = m_queue->DequeueQCN(m_paused);
 		}
 		else if (m_node->GetNodeType() == 0) //QCN disable NIC
 		{
@@ -274,67 +366,28 @@ namespace ns3 {
 		{
 			m_snifferTrace(p);
 			m_promiscSnifferTrace(p);
-			Ipv4Header h;
-			Ptr<Packet> packet = p->Copy();
-			uint16_t protocol = 0;
-			ProcessHeader(packet, protocol);
-			packet->RemoveHeader(h);
 			FlowIdTag t;
 			if (m_node->GetNodeType() == 0) //I am a NIC, do QCN
 			{
 				uint32_t fIndex = m_queue->GetLastQueue();
-				if (m_rate[fIndex] == 0)			//late initialization	
-				{
-					m_rate[fIndex] = m_bps;
-					for (uint32_t j = 0; j < maxHop; j++)
-					{
-						m_rateAll[fIndex][j] = m_bps;
-						m_targetRate[fIndex][j] = m_bps;
-					}
-				}
-				double creditsDue = std::max(0.0, m_bps / m_rate[fIndex] * (p->GetSize() - m_credits[fIndex]));
-				Time nextSend = m_tInterframeGap + Seconds(m_bps.CalculateTxTime(creditsDue));
-				m_nextAvail[fIndex] = Simulator::Now() + nextSend;
-				for (uint32_t i = 0; i < m_queue->m_fcount; i++)	//distribute credits
+				if (m_ccMode == CC_TIMELY)
+					RateLimit(m_timely, fIndex, p);
+				else
+					RateLimit(m_dcqcn, fIndex, p);
+				QbbHeaderTag ht;
+				bool udp = p->PeekPacketTag(ht) && ht.GetProtocol() == 17;
+				if (udp)
 				{
-					if (m_nextAvail[i].GetTimeStep() <= Simulator::Now().GetTimeStep())
-						m_credits[i] += m_rate[i] / m_bps*creditsDue;
+					UpdateTxStats(ht, p->GetSize());
 				}
-				m_credits[fIndex] = 0;	//reset credits
-				for (uint32_t i = 0; i < 1; i++)
+				if (m_waitAck && udp) //if it's udp, check wait_for_ack
 				{
-					if (m_rpStage[fIndex][i] > 0)
-						m_txBytes[fIndex][i] -= p->GetSize();
-					else
-						m_txBytes[fIndex][i] = m_bc;
-					if (m_txBytes[fIndex][i] < 0)
+					if (ht.GetSeq() + 1 >= (uint32_t)m_milestone_tx[fIndex])
 					{
-						if (m_rpStage[fIndex][i] == 1)
-						{
-							rpr_fast_byte(fIndex, i);
-						}
-						else if (m_rpStage[fIndex][i] == 2)
-						{
-							rpr_active_byte(fIndex, i);
-						}
-						else if (m_rpStage[fIndex][i] == 3)
-						{
-							rpr_hyper_byte(fIndex, i);
-						}
-					}
-				}
-				if (h.GetProtocol() == 17 && m_waitAck) //if it's udp, check wait_for_ack
-				{
-					UdpHeader udph;
-					packet->RemoveHeader(udph);
-					SeqTsHeader sth;
-					packet->RemoveHeader(sth);
-					if (sth.GetSeq() >= m_milestone_tx[fIndex] - 1)
-					{
-						m_nextAvail[fIndex] = Simulator::Now() + Seconds(32767); //stop sending this flow until acked
+						SetNextAvail(fIndex, Simulator::Now() + Seconds(32767)); //stop sending this flow until acked
 						if (!m_waitingAck[fIndex])
 						{
-							//std::cout << "Waiting the ACK of the message of flow " << fIndex << " " << sth.GetSeq() << ".\n";
+							//std::cout << "Waiting the ACK of the message of flow " << fIndex << " " << ht.GetSeq() << ".\n";
 							//fflush(stdout);
 							m_retransmit[fIndex] = Simulator::Schedule(MicroSeconds(m_waitAckTimer), &QbbNetDevice::Retransmit, this, fIndex);
 							m_waitingAck[fIndex] = true;
@@ -343,11 +396,16 @@ namespace ns3 {
 				}
 				p->RemovePacketTag(t);
 				TransmitStart(p);
+				if (udp)
+				{
+					m_sendCb(this, ht.GetSourcePort());	//the flow has room for more
+				}
 			}
 			else //I am a switch, do ECN if this is not a pause
 			{
 				if (m_queue->GetLastQueue() == qCnt - 1)//this is a pause or cnp, send it immediately!
 				{
+					p->RemovePacketTag(t);
 					TransmitStart(p);
 				}
 				else
@@ -359,16 +417,24 @@ namespace ns3 {
 					m_node->m_broadcom->RemoveFromEgressAdmission(m_ifIndex, m_queue->GetLastQueue(), p->GetSize());
 					if (m_qcnEnabled)
 					{
-						PppHeader ppp;
-						p->RemoveHeader(ppp);
-						p->RemoveHeader(h);
 						bool egressCongested = ShouldSendCN(inDev, m_ifIndex, m_queue->GetLastQueue());
 						if (egressCongested)
 						{
+							m_node->m_broadcom->RecordEcnMark(m_ifIndex, m_queue->GetLastQueue());
+							PppHeader ppp;
+							Ipv4Header h;
+							p->RemoveHeader(ppp);
+							p->RemoveHeader(h);
 							h.SetEcn((Ipv4Header::EcnType)0x03);
+							p->AddHeader(h);
+							p->AddHeader(ppp);
+							QbbHeaderTag ht;
+							if (p->RemovePacketTag(ht))	//keep the cached ECN bits in sync
+							{
+								ht.SetEcn(0x03);
+								p->AddPacketTag(ht);
+							}
 						}
-						p->AddHeader(h);
-						p->AddHeader(ppp);
 					}
 					p->RemovePacketTag(t);
 					TransmitStart(p);
@@ -381,13 +447,7 @@ namespace ns3 {
 			NS_LOG_INFO("PAUSE prohibits send at node " << m_node->GetId());
 			if (m_node->GetNodeType() == 0 && m_qcnEnabled) //nothing to send, possibly due to qcn flow control, if so reschedule sending
 			{
-				Time t = Simulator::GetMaximumSimulationTime();
-				for (uint32_t i = 0; i < m_queue->m_fcount; i++)
-				{
-					if (m_queue->GetNBytes(i) == 0)
-						continue;
-					t = Min(m_nextAvail[i], t);
-				}
+				Time t = m_queue->GetEarliestAvail();
 				if (m_nextSend.IsExpired() &&
 					t < Simulator::GetMaximumSimulationTime() &&
 					t.GetTimeStep() > Simulator::Now().GetTimeStep())
@@ -406,12 +466,23 @@ namespace ns3 {
 	{
 		std::cout << "Resending the message of flow " << findex << ".\n";
 		fflush(stdout);
-		m_queue->RecoverQueue(m_sendingBuffer[findex], findex);
-		m_nextAvail[findex] = Simulator::Now();
+		GoBackN(findex);
+		SetNextAvail(findex, Simulator::Now());
 		m_waitingAck[findex] = false;
 		DequeueAndTransmit();
 	}
 
+	void
+		QbbNetDevice::GoBackN(uint32_t findex)
+	{
+		const QbbSendBuffer &buffer = m_sendingBuffer[findex];
+		m_queue->ClearQueue(findex);
+		for (uint32_t k = 0; k < buffer.GetSize(); k++)
+		{
+			m_queue->RecoverPacket(buffer.Get(k), findex);
+		}
+	}
+
 
 	void
 		QbbNetDevice::Resume(unsigned qIndex)
@@ -419,6 +490,7 @@ namespace ns3 {
 		NS_LOG_FUNCTION(this << qIndex);
 		NS_ASSERT_MSG(m_paused[qIndex], "Must be PAUSEd");
 		m_paused[qIndex] = false;
+		m_pausedTime[qIndex] += Simulator::Now() - m_pauseBegin[qIndex];
 		NS_LOG_INFO("Node " << m_node->GetId() << " dev " << m_ifIndex << " queue " << qIndex <<
 			" resumed at " << Simulator::Now().GetSeconds());
 		DequeueAndTransmit();
@@ -446,57 +518,48 @@ namespace ns3 {
 			return;
 		}
 
-		uint16_t protocol = 0;
-
-		Ptr<Packet> p = packet->Copy();
-		ProcessHeader(p, protocol);
-
-		Ipv4Header ipv4h;
-		p->RemoveHeader(ipv4h);
+		QbbHeaderTag ht;
+		if (!packet->PeekPacketTag(ht))	//parse the headers once, later hops read the tag
+		{
+			ht.Parse(packet, true);
+			packet->AddPacketTag(ht);
+		}
 
-		if ((ipv4h.GetProtocol() != 0xFF && ipv4h.GetProtocol() != 0xFD && ipv4h.GetProtocol() != 0xFC) || m_node->GetNodeType() > 0)
+		if ((ht.GetProtocol() != 0xFF && ht.GetProtocol() != 0xFD && ht.GetProtocol() != 0xFC) || m_node->GetNodeType() > 0)
 		{ //This is not QCN feedback, not NACK, or I am a switch so I don't care
-			if (ipv4h.GetProtocol() != 0xFE) //not PFC
+			if (ht.GetProtocol() != 0xFE) //not PFC
 			{
 				packet->AddPacketTag(FlowIdTag(m_ifIndex));
 				if (m_node->GetNodeType() == 0) //NIC
 				{
-					if (ipv4h.GetProtocol() == 17)	//look at udp only
+					if (ht.GetProtocol() == 17)	//look at udp only
 					{
-						uint16_t ecnbits = ipv4h.GetEcn();
+						uint16_t ecnbits = ht.GetEcn();
 
-						UdpHeader udph;
-						p->RemoveHeader(udph);
-						SeqTsHeader sth;
-						p->PeekHeader(sth);
-
-						p->AddHeader(udph);
-
-						bool found = false;
-						uint32_t i, key = 0;
-
-						for (i = 0; i < m_ecn_source->size(); ++i)
+						uint32_t key = m_rxFlows.Lookup(ht.GetSource(), ht.GetSourcePort(), ht.GetPG());
+						if (key != QbbFlowTable::NOT_FOUND)
 						{
-							if ((*m_ecn_source)[i].source == ipv4h.GetSource() && (*m_ecn_source)[i].qIndex == GetPriority(p->Copy()) && (*m_ecn_source)[i].port == udph.GetSourcePort())
+							UpdateCnpClock(key);
+							ECNAccount &info = (*m_ecn_source)[key];
+							if (ecnbits != 0 && Simulator::Now().GetMicroSeconds() > m_qcn_np_sampling)
 							{
-								found = true;
-								if (ecnbits != 0 && Simulator::Now().GetMicroSeconds() > m_qcn_np_sampling)
-								{
-									(*m_ecn_source)[i].ecnbits |= ecnbits;
-									(*m_ecn_source)[i].qfb++;
-								}
-								(*m_ecn_source)[i].total++;
-								key = i;
+								info.ecnbits |= ecnbits;
+								info.qfb++;
+							}
+							info.total++;
+							if (info.ecnbits == 0x03)
+							{
+								ArmCnp(key);
 							}
 						}
-						if (!found)
+						else
 						{
 							ECNAccount tmp;
-							tmp.qIndex = GetPriority(p->Copy());
-							tmp.source = ipv4h.GetSource();
+							tmp.qIndex = ht.GetPG();
+							tmp.source = ht.GetSource();
 							if (ecnbits != 0 && Simulator::Now().GetMicroSeconds() > m_qcn_np_sampling && tmp.qIndex != 1) //dctcp
 							{
-								tmp.ecnbits |= ecnbits;
+								tmp.ecnbits = ecnbits;
 								tmp.qfb = 1;
 							}
 							else
@@ -505,33 +568,66 @@ namespace ns3 {
 								tmp.qfb = 0;
 							}
 							tmp.total = 1;
-							tmp.port = udph.GetSourcePort();
-							ReceiverNextExpectedSeq[m_ecn_source->size()] = 0;
-							m_nackTimer[m_ecn_source->size()] = Time(0);
-							m_milestone_rx[m_ecn_source->size()] = m_ack_interval;
-							m_lastNACK[m_ecn_source->size()] = -1;
-							key = m_ecn_source->size();
-							m_ecn_source->push_back(tmp);
-							CheckandSendQCN(tmp.source, tmp.qIndex, tmp.port);
+							tmp.port = ht.GetSourcePort();
+							tmp.nextCnp = 0;
+							tmp.cnpArmed = false;
+							RxFlowStats stats = RxFlowStats();
+							stats.src = tmp.source;
+							stats.sport = tmp.port;
+							stats.pg = tmp.qIndex;
+							stats.start = Simulator::Now();
+							if (m_rxFree.empty())
+							{
+								key = m_ecn_source->size();
+								m_ecn_source->resize(key + 1);
+								ReceiverNextExpectedSeq.resize(key + 1);
+								m_nackTimer.resize(key + 1);
+								m_milestone_rx.resize(key + 1);
+								m_lastNACK.resize(key + 1);
+								m_rxStats.resize(key + 1);
+							}
+							else	//the index of a removed flow
+							{
+								key = m_rxFree.back();
+								m_rxFree.pop_back();
+							}
+							(*m_ecn_source)[key] = tmp;
+							ReceiverNextExpectedSeq[key] = 0;
+							m_nackTimer[key] = Time(0);
+							m_milestone_rx[key] = m_ack_interval;
+							m_lastNACK[key] = -1;
+							m_rxStats[key] = stats;
+							m_rxFlows.Insert(tmp.source, tmp.port, tmp.qIndex, key);
+							if (m_qcnEnabled)	//first CNP opportunity on the first packet
+							{
+								CheckandSendQCN(key);
+								(*m_ecn_source)[key].nextCnp = Simulator::Now().GetTimeStep() + MicroSeconds(m_qcn_interval).GetTimeStep();
+							}
 						}
 
-						int x = ReceiverCheckSeq(sth.GetSeq(), key);
+						int x = ReceiverCheckSeq(ht.GetSeq(), key);
+						if ((x == 1 || x == 5) && ht.GetSeq() >= m_rxStats[key].nextSeq) //in order and not seen before going back
+						{
+							m_rxStats[key].nextSeq = ht.GetSeq() + 1;
+							m_rxStats[key].bytes += packet->GetSize() - 2 - 20 - 8; //PPP, IPv4 and UDP headers
+							m_rxStats[key].finish = Simulator::Now();
+						}
 						if (x == 2) //generate NACK
 						{
 							Ptr<Packet> newp = Create<Packet>(0);
 							qbbHeader seqh;
 							seqh.SetSeq(ReceiverNextExpectedSeq[key]);
-							seqh.SetPG(GetPriority(p->Copy()));
-							seqh.SetPort(udph.GetSourcePort());
+							seqh.SetPG(ht.GetPG());
+							seqh.SetPort(ht.GetSourcePort());
 							newp->AddHeader(seqh);
 							Ipv4Header head;	// Prepare IPv4 header
-							head.SetDestination(ipv4h.GetSource());
+							head.SetDestination(ht.GetSource());
 							Ipv4Address myAddr = m_node->GetObject<Ipv4>()->GetAddress(m_ifIndex, 0).GetLocal();
 							head.SetSource(myAddr);
 							head.SetProtocol(0xFD); //nack=0xFD
 							head.SetTtl(64);
 							head.SetPayloadSize(newp->GetSize());
-							head.SetIdentification(UniformVariable(0, 65536).GetValue());
+							head.SetIdentification(m_uniform->GetValue(0, 65536));
 							newp->AddHeader(head);
 							uint32_t protocolNumber = 2048;
 							AddHeader(newp, protocolNumber);	// Attach PPP header
@@ -546,17 +642,17 @@ namespace ns3 {
 							Ptr<Packet> newp = Create<Packet>(0);
 							qbbHeader seqh;
 							seqh.SetSeq(ReceiverNextExpectedSeq[key]);
-							seqh.SetPG(GetPriority(p->Copy()));
-							seqh.SetPort(udph.GetSourcePort());
+							seqh.SetPG(ht.GetPG());
+							seqh.SetPort(ht.GetSourcePort());
 							newp->AddHeader(seqh);
 							Ipv4Header head;	// Prepare IPv4 header
-							head.SetDestination(ipv4h.GetSource());
+							head.SetDestination(ht.GetSource());
 							Ipv4Address myAddr = m_node->GetObject<Ipv4>()->GetAddress(m_ifIndex, 0).GetLocal();
 							head.SetSource(myAddr);
 							head.SetProtocol(0xFC); //ack=0xFC
 							head.SetTtl(64);
 							head.SetPayloadSize(newp->GetSize());
-							head.SetIdentification(UniformVariable(0, 65536).GetValue());
+							head.SetIdentification(m_uniform->GetValue(0, 65536));
 							newp->AddHeader(head);
 							uint32_t protocolNumber = 2048;
 							AddHeader(newp, protocolNumber);	// Attach PPP header
@@ -573,9 +669,18 @@ namespace ns3 {
 			else // If this is a Pause, stop the corresponding queue
 			{
 				if (!m_qbbEnabled) return;
+				Ptr<Packet> p = StripHeaders(packet);
 				PauseHeader pauseh;
 				p->RemoveHeader(pauseh);
 				unsigned qIndex = pauseh.GetQIndex();
+				if (m_node->GetNodeType() == 1)
+				{
+					m_node->m_broadcom->RecordPfcReceived(m_ifIndex, qIndex, pauseh.GetTime() > 0);
+				}
+				if (!m_paused[qIndex])
+				{
+					m_pauseBegin[qIndex] = Simulator::Now();
+				}
 				m_paused[qIndex] = true;
 				if (pauseh.GetTime() > 0)
 				{
@@ -589,12 +694,13 @@ namespace ns3 {
 				}
 			}
 		}
-		else if (ipv4h.GetProtocol() == 0xFF)
+		else if (ht.GetProtocol() == 0xFF)
 		{
 			// QCN on NIC
 			// This is a Congestion signal
 			// Then, extract data from the congestion packet.
 			// We assume, without verify, the packet is destinated to me
+			Ptr<Packet> p = StripHeaders(packet);
 			CnHeader cnHead;
 			p->RemoveHeader(cnHead);
 			uint32_t qIndex = cnHead.GetQindex();
@@ -606,95 +712,55 @@ namespace ns3 {
 			uint32_t udpport = cnHead.GetFlow();
 			uint16_t ecnbits = cnHead.GetECNBits();
 			uint16_t qfb = cnHead.GetQfb();
-			uint16_t total = cnHead.GetTotal();
 
-			uint32_t i;
-			for (i = 1; i < m_queue->m_fcount; i++)
+			uint32_t i = m_txFlows.Lookup(ht.GetDestination(), udpport, qIndex);
+			if (i == QbbFlowTable::NOT_FOUND)
 			{
-				if (m_findex_udpport_map[i] == udpport && m_findex_qindex_map[i] == qIndex)
-					break;
-			}
-			if (i == m_queue->m_fcount)
 				std::cout << "ERROR: QCN NIC cannot find the flow\n";
+				return;
+			}
+			m_txStats[i].cnps++;
 
 			if (qfb == 0)
 			{
 				std::cout << "ERROR: Unuseful QCN\n";
 				return;	// Unuseful CN
 			}
-			if (m_rate[i] == 0)			//lazy initialization	
-			{
-				m_rate[i] = m_bps;
-				for (uint32_t j = 0; j < maxHop; j++)
-				{
-					m_rateAll[i][j] = m_bps;
-					m_targetRate[i][j] = m_bps;	//targetrate remembers the last rate
-				}
-			}
-			if (ecnbits == 0x03)
-			{
-				rpr_cnm_received(i, 0, qfb*1.0 / (total + 1));
-			}
-			m_rate[i] = m_bps;
-			for (uint32_t j = 0; j < maxHop; j++)
-				m_rate[i] = std::min(m_rate[i], m_rateAll[i][j]);
+			if (m_ccMode == CC_TIMELY)
+				ReceiveCnp(m_timely, i, ecnbits == 0x03);
+			else
+				ReceiveCnp(m_dcqcn, i, ecnbits == 0x03);
 			PointToPointReceive(packet);
 		}
 
-		else if (ipv4h.GetProtocol() == 0xFD)//NACK on NIC
+		else if (ht.GetProtocol() == 0xFD)//NACK on NIC
 		{
 			qbbHeader qbbh;
-			p->Copy()->RemoveHeader(qbbh);
+			StripHeaders(packet)->RemoveHeader(qbbh);
 
 			int qIndex = qbbh.GetPG();
 			int seq = qbbh.GetSeq();
 			int port = qbbh.GetPort();
-			int i;
-			for (i = 1; i < m_queue->m_fcount; i++)
-			{
-				if (m_findex_udpport_map[i] == port && m_findex_qindex_map[i] == qIndex)
-				{
-					break;
-				}
-			}
-			if (i == m_queue->m_fcount)
+			uint32_t i = m_txFlows.Lookup(ht.GetDestination(), port, qIndex);
+			if (i == QbbFlowTable::NOT_FOUND)
 			{
 				std::cout << "ERROR: NACK NIC cannot find the flow\n";
+				return;
 			}
 
-			uint32_t buffer_seq = GetSeq(m_sendingBuffer[i]->Peek()->Copy());
-			if (!m_backto0)
-			{
-				if (buffer_seq > seq)
-				{
-					std::cout << "ERROR: Sendingbuffer miss!\n";
-				}
-				while (seq > buffer_seq)
-				{
-					m_sendingBuffer[i]->Dequeue();
-					buffer_seq = GetSeq(m_sendingBuffer[i]->Peek()->Copy());
-				}
-			}
-			else
+			QbbSendBuffer &buffer = m_sendingBuffer[i];
+			uint32_t goback_seq = m_backto0 ? seq / m_chunk*m_chunk : seq;
+			if (buffer.IsEmpty() || buffer.GetFrontSeq() > goback_seq)
 			{
-				uint32_t goback_seq = seq / m_chunk*m_chunk;
-				if (buffer_seq > goback_seq)
-				{
-					std::cout << "ERROR: Sendingbuffer miss!\n";
-				}
-				while (goback_seq > buffer_seq)
-				{
-					m_sendingBuffer[i]->Dequeue();
-					buffer_seq = GetSeq(m_sendingBuffer[i]->Peek()->Copy());
-				}
-
+				std::cout << "ERROR: Sendingbuffer miss!\n";
 			}
+			buffer.Trim(goback_seq);
 
-			m_queue->RecoverQueue(m_sendingBuffer[i], i);
+			GoBackN(i);
 
 			if (m_waitAck && m_waitingAck[i])
 			{
-				m_nextAvail[i] = Simulator::Now();
+				SetNextAvail(i, Simulator::Now());
 				Simulator::Cancel(m_retransmit[i]);
 				m_waitingAck[i] = false;
 				DequeueAndTransmit();
@@ -702,66 +768,38 @@ namespace ns3 {
 
 			PointToPointReceive(packet);
 		}
-		else if (ipv4h.GetProtocol() == 0xFC)//ACK on NIC
+		else if (ht.GetProtocol() == 0xFC)//ACK on NIC
 		{
 			qbbHeader qbbh;
-			p->Copy()->RemoveHeader(qbbh);
+			StripHeaders(packet)->RemoveHeader(qbbh);
 
 			int qIndex = qbbh.GetPG();
 			int seq = qbbh.GetSeq();
 			int port = qbbh.GetPort();
-			int i;
-			for (i = 1; i < m_queue->m_fcount; i++)
-			{
-				if (m_findex_udpport_map[i] == port && m_findex_qindex_map[i] == qIndex)
-				{
-					break;
-				}
-			}
-			if (i == m_queue->m_fcount)
+			uint32_t i = m_txFlows.Lookup(ht.GetDestination(), port, qIndex);
+			if (i == QbbFlowTable::NOT_FOUND)
 			{
 				std::cout << "ERROR: ACK NIC cannot find the flow\n";
+				return;
 			}
 
-			uint32_t buffer_seq = GetSeq(m_sendingBuffer[i]->Peek()->Copy());
-
 			if (m_ack_interval == 0)
 			{
 				std::cout << "ERROR: shouldn't receive ack\n";
 			}
 			else
 			{
-				if (!m_backto0)
-				{
-					while (seq > buffer_seq)
-					{
-						m_sendingBuffer[i]->Dequeue();
-						if (m_sendingBuffer[i]->IsEmpty())
-						{
-							break;
-						}
-						buffer_seq = GetSeq(m_sendingBuffer[i]->Peek()->Copy());
-					}
-				}
+				if (m_ccMode == CC_TIMELY)
+					ReceiveAck(m_timely, i, seq);
 				else
-				{
-					uint32_t goback_seq = seq / m_chunk*m_chunk;
-					while (goback_seq > buffer_seq)
-					{
-						m_sendingBuffer[i]->Dequeue();
-						if (m_sendingBuffer[i]->IsEmpty())
-						{
-							break;
-						}
-						buffer_seq = GetSeq(m_sendingBuffer[i]->Peek()->Copy());
-					}
-				}
+					ReceiveAck(m_dcqcn, i, seq);
+				m_sendingBuffer[i].Trim(m_backto0 ? seq / m_chunk*m_chunk : seq);
 			}
 
 			if (m_waitAck && seq >= m_milestone_tx[i])
 			{
 				//Got ACK, resume sending
-				m_nextAvail[i] = Simulator::Now();
+				SetNextAvail(i, Simulator::Now());
 				Simulator::Cancel(m_retransmit[i]);
 				m_waitingAck[i] = false;
 				m_milestone_tx[i] += m_chunk;
@@ -816,28 +854,40 @@ namespace ns3 {
 		}
 	}
 
-	uint32_t
-		QbbNetDevice::GetPriority(Ptr<Packet> p) //Pay attention this function modifies the packet!!! Copy the packet before passing in.
+	void
+		QbbNetDevice::PeekHeaderTag(Ptr<const Packet> p, QbbHeaderTag &tag)
 	{
-		UdpHeader udph;
-		p->RemoveHeader(udph);
-		SeqTsHeader seqh;
-		p->RemoveHeader(seqh);
-		return seqh.GetPG();
+		if (!p->PeekPacketTag(tag))
+		{
+			tag.Parse(p, true);
+		}
 	}
 
-	uint32_t
-		QbbNetDevice::GetSeq(Ptr<Packet> p) //Pay attention this function modifies the packet!!! Copy the packet before passing in.
+	Ptr<Packet>
+		QbbNetDevice::StripHeaders(Ptr<const Packet> packet)
 	{
+		Ptr<Packet> p = packet->Copy();
 		uint16_t protocol;
 		ProcessHeader(p, protocol);
 		Ipv4Header ipv4h;
 		p->RemoveHeader(ipv4h);
-		UdpHeader udph;
-		p->RemoveHeader(udph);
-		SeqTsHeader seqh;
-		p->RemoveHeader(seqh);
-		return seqh.GetSeq();
+		return p;
+	}
+
+	uint32_t
+		QbbNetDevice::GetPriority(Ptr<const Packet> p)
+	{
+		QbbHeaderTag ht;
+		PeekHeaderTag(p, ht);
+		return ht.GetPG();
+	}
+
+	uint32_t
+		QbbNetDevice::GetSeq(Ptr<const Packet> p)
+	{
+		QbbHeaderTag ht;
+		PeekHeaderTag(p, ht);
+		return ht.GetSeq();
 	}
 
 	bool
@@ -850,25 +900,28 @@ namespace ns3 {
 			return false;
 		}
 
-		Ipv4Header h;
-		packet->PeekHeader(h);
+		QbbHeaderTag ht;
+		if (m_node->GetNodeType() == 0 || !packet->PeekPacketTag(ht))
+		{
+			//The packet enters the network here; any tag it carries is from an earlier trip
+			QbbHeaderTag old;
+			packet->RemovePacketTag(old);
+			ht.Parse(packet, false);
+			packet->AddPacketTag(ht);
+		}
 		unsigned qIndex;
-		if (h.GetProtocol() == 0xFF || h.GetProtocol() == 0xFE || h.GetProtocol() == 0xFD)  //QCN or PFC or NACK, go highest priority
+		if (ht.GetProtocol() == 0xFF || ht.GetProtocol() == 0xFE || ht.GetProtocol() == 0xFD)  //QCN or PFC or NACK, go highest priority
 		{
 			qIndex = qCnt - 1;
 		}
 		else
 		{
-			Ptr<Packet> p = packet->Copy();
-			p->RemoveHeader(h);
-
-			if (h.GetProtocol() == 17)
-				qIndex = GetPriority(p);
+			if (ht.GetProtocol() == 17)
+				qIndex = ht.GetPG();
 			else
 				qIndex = 1; //dctcp
 		}
 
-		Ptr<Packet> p = packet->Copy();
 		AddHeader(packet, protocolNumber);
 
 		if (m_node->GetNodeType() == 0)
@@ -879,34 +932,42 @@ namespace ns3 {
 			}
 			else
 			{
-				Ipv4Header ipv4h;
-				p->RemoveHeader(ipv4h);
-				UdpHeader udph;
-				p->RemoveHeader(udph);
-				uint32_t port = udph.GetSourcePort();
-				uint32_t i;
-				for (i = 1; i < fCnt; i++)
+				uint32_t port = ht.GetSourcePort();
+				uint32_t i = m_txFlows.Lookup(ht.GetSource(), port, qIndex);
+				if (i == QbbFlowTable::NOT_FOUND)	//new flow, take the next dense index
 				{
-					if (m_findex_udpport_map[i] == 0)
+					i = m_queue->AddFlow(qIndex);
+					AddTxFlow(i);
+					SetNextAvail(i, m_queue->GetNextAvail(i));	//start collecting credits
+					m_txFlows.Insert(ht.GetSource(), port, qIndex, i);
+					if (m_waitAck)
 					{
-						m_queue->m_fcount = i + 1;
-						m_findex_udpport_map[i] = port;
-						m_findex_qindex_map[i] = qIndex;
-						m_sendingBuffer[i] = CreateObject<DropTailQueue>();
-						if (m_waitAck)
-						{
-							m_milestone_tx[i] = m_chunk;
-						}
-						break;
+						m_milestone_tx[i] = m_chunk;
+					}
+					if (ht.GetProtocol() == 17)
+					{
+						TxFlowStats &stats = m_txStats[i];
+						stats.udp = true;
+						stats.src = ht.GetSource();
+						stats.dst = ht.GetDestination();
+						stats.sport = port;
+						stats.dport = ht.GetDestinationPort();
+						stats.pg = qIndex;
+						stats.start = Simulator::Now();
+						stats.lastTx = stats.start;
+						stats.pauseAtStart = GetPausedTime(qIndex);
+						stats.pauseAtLastTx = stats.pauseAtStart;
 					}
-					if (m_findex_udpport_map[i] == port && m_findex_qindex_map[i] == qIndex)
-						break;
 				}
-				if (m_sendingBuffer[i]->GetNPackets() == 8000)
+				if (ht.GetProtocol() == 17)	//only UdpClient flows are ever retransmitted
 				{
-					m_sendingBuffer[i]->Dequeue();
+					if (m_sendingBuffer[i].GetSize() == 8000)
+					{
+						m_sendingBuffer[i].PopFront();
+					}
+					m_sendingBuffer[i].Add(packet);
+					m_txBacklog[i] += packet->GetSize();
 				}
-				m_sendingBuffer[i]->Enqueue(packet->Copy());
 
 				if (m_qcnEnabled)
 				{
@@ -936,11 +997,11 @@ namespace ns3 {
 					m_macTxTrace(packet);
 					m_queue->Enqueue(packet, qIndex); // go into MMU and queues
 				}
-				DequeueAndTransmit();
-				if (m_node->GetNodeType() == 1)
+				else
 				{
-					CheckQueueFull(inDev, qIndex); //check queue full
+					m_node->m_broadcom->RecordDrop(inDev, qIndex);
 				}
+				DequeueAndTransmit();
 			}
 			else			//pause or cnp, doesn't need admission control, just go
 			{
@@ -953,57 +1014,49 @@ namespace ns3 {
 	}
 
 	void
-		QbbNetDevice::CheckQueueFull(uint32_t inDev, uint32_t qIndex)
+		QbbNetDevice::PfcStateChanged(uint32_t qIndex, bool pause)
 	{
-		NS_LOG_FUNCTION(this);
-		Ptr<Ipv4> m_ipv4 = m_node->GetObject<Ipv4>();
-		bool pClasses[qCnt] = { 0 };
-		m_node->m_broadcom->GetPauseClasses(inDev, qIndex, pClasses);
-		Ptr<NetDevice> device = m_ipv4->GetNetDevice(inDev);
-		for (uint32_t j = 0; j < qCnt; j++)
+		NS_LOG_FUNCTION(this << qIndex << pause);
+		Simulator::Cancel(m_pfcRefreshEvt[qIndex]);
+		if (pause)
 		{
-			if (pClasses[j])			// Create the PAUSE packet
-			{
-				Ptr<Packet> p = Create<Packet>(0);
-				PauseHeader pauseh(m_pausetime, m_queue->GetNBytes(j), j);
-				p->AddHeader(pauseh);
-				Ipv4Header ipv4h;  // Prepare IPv4 header
-				ipv4h.SetProtocol(0xFE);
-				ipv4h.SetSource(m_node->GetObject<Ipv4>()->GetAddress(m_ifIndex, 0).GetLocal());
-				ipv4h.SetDestination(Ipv4Address("255.255.255.255"));
-				ipv4h.SetPayloadSize(p->GetSize());
-				ipv4h.SetTtl(1);
-				ipv4h.SetIdentification(UniformVariable(0, 65536).GetValue());
-				p->AddHeader(ipv4h);
-				device->Send(p, Mac48Address("ff:ff:ff:ff:ff:ff"), 0x0800);
-				m_node->m_broadcom->m_pause_remote[inDev][qIndex] = true;
-				Simulator::Cancel(m_recheckEvt[inDev][qIndex]);
-				m_recheckEvt[inDev][qIndex] = Simulator::Schedule(MicroSeconds(m_pausetime / 2), &QbbNetDevice::CheckQueueFull, this, inDev, qIndex);
-			}
+			SendPauseFrame(qIndex, m_pausetime);
+			m_pfcRefreshEvt[qIndex] = Simulator::Schedule(MicroSeconds(m_pausetime / 2), &QbbNetDevice::PfcRefresh, this, qIndex);
 		}
+		else
+		{
+			SendPauseFrame(qIndex, 0); //resume
+		}
+	}
 
-		//ON-OFF
-		for (uint32_t j = 0; j < qCnt; j++)
+	void
+		QbbNetDevice::PfcRefresh(uint32_t qIndex)
+	{
+		if (m_node->m_broadcom->RefreshPause(m_ifIndex, qIndex))
 		{
-			if (!m_node->m_broadcom->m_pause_remote[inDev][qIndex])
-				continue;
-			if (m_node->m_broadcom->GetResumeClasses(inDev, qIndex))  // Create the PAUSE packet
-			{
-				Ptr<Packet> p = Create<Packet>(0);
-				PauseHeader pauseh(0, m_queue->GetNBytes(j), j); //resume
-				p->AddHeader(pauseh);
-				Ipv4Header ipv4h;  // Prepare IPv4 header
-				ipv4h.SetProtocol(0xFE);
-				ipv4h.SetSource(m_node->GetObject<Ipv4>()->GetAddress(m_ifIndex, 0).GetLocal());
-				ipv4h.SetDestination(Ipv4Address("255.255.255.255"));
-				ipv4h.SetPayloadSize(p->GetSize());
-				ipv4h.SetTtl(1);
-				ipv4h.SetIdentification(UniformVariable(0, 65536).GetValue());
-				p->AddHeader(ipv4h);
-				device->Send(p, Mac48Address("ff:ff:ff:ff:ff:ff"), 0x0800);
-				m_node->m_broadcom->m_pause_remote[inDev][qIndex] = false;
-				Simulator::Cancel(m_recheckEvt[inDev][qIndex]);
-			}
+			SendPauseFrame(qIndex, m_pausetime);
+			m_pfcRefreshEvt[qIndex] = Simulator::Schedule(MicroSeconds(m_pausetime / 2), &QbbNetDevice::PfcRefresh, this, qIndex);
+		}
+	}
+
+	void
+		QbbNetDevice::SendPauseFrame(uint32_t qIndex, uint32_t time)
+	{
+		Ptr<Packet> p = Create<Packet>(0);
+		PauseHeader pauseh(time, m_queue->GetNBytes(qIndex), qIndex);
+		p->AddHeader(pauseh);
+		Ipv4Header ipv4h;  // Prepare IPv4 header
+		ipv4h.SetProtocol(0xFE);
+		ipv4h.SetSource(m_node->GetObject<Ipv4>()->GetAddress(m_ifIndex, 0).GetLocal());
+		ipv4h.SetDestination(Ipv4Address("255.255.255.255"));
+		ipv4h.SetPayloadSize(p->GetSize());
+		ipv4h.SetTtl(1);
+		ipv4h.SetIdentification(m_uniform->GetValue(0, 65536));
+		p->AddHeader(ipv4h);
+		Send(p, Mac48Address("ff:ff:ff:ff:ff:ff"), 0x0800);
+		if (m_node->GetNodeType() == 1)
+		{
+			m_node->m_broadcom->RecordPfcSent(m_ifIndex, qIndex, time > 0);
 		}
 	}
 
@@ -1088,17 +1141,7 @@ namespace ns3 {
 	Address
 		QbbNetDevice::GetRemote(void) const
 	{
-		NS_ASSERT(m_channel->GetNDevices() == 2);
-		for (uint32_t i = 0; i < m_channel->GetNDevices(); ++i)
-		{
-			Ptr<NetDevice> tmp = m_channel->GetDevice(i);
-			if (tmp != this)
-			{
-				return tmp->GetAddress();
-			}
-		}
-		NS_ASSERT(false);
-		return Address();  // quiet compiler.
+		return m_channel->GetRemoteAddress(this);
 	}
 
 	bool
@@ -1108,59 +1151,100 @@ namespace ns3 {
 	}
 
 	void
-		QbbNetDevice::CheckandSendQCN(Ipv4Address source, uint32_t qIndex, uint32_t port) //port is udp port
+		QbbNetDevice::CheckandSendQCN(uint32_t key)
+	{
+		ECNAccount &info = (*m_ecn_source)[key];
+		if (info.ecnbits == 0x03)
+		{
+			Ptr<Packet> p = Create<Packet>(0);
+			CnHeader cn(info.port, info.qIndex, info.ecnbits, info.qfb, info.total);	// Prepare CN header
+			p->AddHeader(cn);
+			Ipv4Header head;	// Prepare IPv4 header
+			head.SetDestination(info.source);
+			Ipv4Address myAddr = m_node->GetObject<Ipv4>()->GetAddress(m_ifIndex, 0).GetLocal();
+			head.SetSource(myAddr);
+			head.SetProtocol(0xFF);
+			head.SetTtl(64);
+			head.SetPayloadSize(p->GetSize());
+			head.SetIdentification(m_uniform->GetValue(0, 65536));
+			p->AddHeader(head);
+			uint32_t protocolNumber = 2048;
+			AddHeader(p, protocolNumber);	// Attach PPP header
+			m_queue->Enqueue(p, 0);
+			info.ecnbits = 0;
+			info.qfb = 0;
+			info.total = 0;
+			DequeueAndTransmit();
+		}
+		else
+		{
+			info.ecnbits = 0;
+			info.qfb = 0;
+			info.total = 0;
+		}
+	}
+
+	void
+		QbbNetDevice::UpdateCnpClock(uint32_t key)
 	{
-		if (m_node->GetNodeType() > 0)
-			return;
 		if (!m_qcnEnabled)
 			return;
-		for (uint32_t i = 0; i < m_ecn_source->size(); ++i)
+		ECNAccount &info = (*m_ecn_source)[key];
+		int64_t now = Simulator::Now().GetTimeStep();
+		if (now < info.nextCnp)
+			return;
+		int64_t interval = MicroSeconds(m_qcn_interval).GetTimeStep();
+		if (info.cnpArmed)	//due at this very time step, CnpTimer has not run yet
 		{
-			ECNAccount info = (*m_ecn_source)[i];
-			if (info.source == source && info.qIndex == qIndex && info.port == port)
-			{
-				if (info.ecnbits == 0x03)
-				{
-					Ptr<Packet> p = Create<Packet>(0);
-					CnHeader cn(port, qIndex, info.ecnbits, info.qfb, info.total);	// Prepare CN header
-					p->AddHeader(cn);
-					Ipv4Header head;	// Prepare IPv4 header
-					head.SetDestination(source);
-					Ipv4Address myAddr = m_node->GetObject<Ipv4>()->GetAddress(m_ifIndex, 0).GetLocal();
-					head.SetSource(myAddr);
-					head.SetProtocol(0xFF);
-					head.SetTtl(64);
-					head.SetPayloadSize(p->GetSize());
-					head.SetIdentification(UniformVariable(0, 65536).GetValue());
-					p->AddHeader(head);
-					uint32_t protocolNumber = 2048;
-					AddHeader(p, protocolNumber);	// Attach PPP header
-					if (m_qcnEnabled)
-						m_queue->Enqueue(p, 0);
-					else
-						m_queue->Enqueue(p, qCnt - 1);
-					((*m_ecn_source)[i]).ecnbits = 0;
-					((*m_ecn_source)[i]).qfb = 0;
-					((*m_ecn_source)[i]).total = 0;
-					DequeueAndTransmit();
-					Simulator::Schedule(MicroSeconds(m_qcn_interval), &QbbNetDevice::CheckandSendQCN, this, source, qIndex, port);
+			info.cnpArmed = false;
+			CheckandSendQCN(key);
+			info.nextCnp += interval;
+		}
+		if (now >= info.nextCnp)	//opportunities without CE marks only restart the counters
+		{
+			info.ecnbits = 0;
+			info.qfb = 0;
+			info.total = 0;
+			info.nextCnp += ((now - info.nextCnp) / interval + 1) * interval;
+		}
+	}
 
-				}
-				else
-				{
-					((*m_ecn_source)[i]).ecnbits = 0;
-					((*m_ecn_source)[i]).qfb = 0;
-					((*m_ecn_source)[i]).total = 0;
-					Simulator::Schedule(MicroSeconds(m_qcn_interval), &QbbNetDevice::CheckandSendQCN, this, source, qIndex, port);
-				}
-				break;
-			}
-			else
+	void
+		QbbNetDevice::ArmCnp(uint32_t key)
+	{
+		ECNAccount &info = (*m_ecn_source)[key];
+		if (!m_qcnEnabled || info.cnpArmed)
+			return;
+		info.cnpArmed = true;
+		m_cnpWake.push(CnpWake(info.nextCnp, key));
+		if (m_cnpTimer.IsExpired() || (uint64_t)info.nextCnp < m_cnpTimer.GetTs())
+		{
+			Simulator::Cancel(m_cnpTimer);
+			m_cnpTimer = Simulator::Schedule(TimeStep(info.nextCnp) - Simulator::Now(), &QbbNetDevice::CnpTimer, this);
+		}
+	}
+
+	void
+		QbbNetDevice::CnpTimer()
+	{
+		int64_t now = Simulator::Now().GetTimeStep();
+		int64_t interval = MicroSeconds(m_qcn_interval).GetTimeStep();
+		while (!m_cnpWake.empty() && m_cnpWake.top().first <= now)
+		{
+			uint32_t key = m_cnpWake.top().second;
+			ECNAccount &info = (*m_ecn_source)[key];
+			if (info.cnpArmed && info.nextCnp == m_cnpWake.top().first)
 			{
-				continue;
+				info.cnpArmed = false;
+				CheckandSendQCN(key);
+				info.nextCnp += interval;
 			}
+			m_cnpWake.pop();
+		}
+		if (!m_cnpWake.empty())
+		{
+			m_cnpTimer = Simulator::Schedule(TimeStep(m_cnpWake.top().first) - Simulator::Now(), &QbbNetDevice::CnpTimer, this);
 		}
-		return;
 	}
 
 	void
@@ -1192,20 +1276,11 @@ namespace ns3 {
 	uint32_t
 		QbbNetDevice::GetUsedBuffer(uint32_t port, uint32_t qIndex)
 	{
-		uint32_t i;
-		if (m_qcnEnabled)
-		{
-			for (i = 1; i < m_queue->m_fcount; i++)
-			{
-				if (m_findex_qindex_map[i] == qIndex && m_findex_udpport_map[i] == port)
-					break;
-			}
-			return m_queue->GetNBytes(i);
-		}
-		else
-		{
-			return m_queue->GetNBytes(qIndex);
-		}
+		Ipv4Address myAddr = m_node->GetObject<Ipv4>()->GetAddress(m_ifIndex, 0).GetLocal();
+		uint32_t i = m_txFlows.Lookup(myAddr, port, qIndex);
+		if (i == QbbFlowTable::NOT_FOUND)
+			return 0;
+		return m_txBacklog[i];
 	}
 
 
@@ -1244,201 +1319,299 @@ namespace ns3 {
 
 
 	void
-		QbbNetDevice::rpr_adjust_rates(uint32_t fIndex, uint32_t hop)
+		QbbNetDevice::ConfigureCc(QbbDcqcn &cc)
 	{
-		AdjustRates(fIndex, hop, DataRate("0bps"));
-		rpr_fast_recovery(fIndex, hop);
-		return;
+		QbbDcqcn::Params params;
+		params.lineRate = m_bps;
+		params.minRate = m_minRate;
+		params.rai = m_rai;
+		params.rhai = m_rhai;
+		params.bc = m_bc;
+		params.threshold = m_rpgThreshold;
+		params.g = m_g;
+		params.timer = MicroSeconds(m_rpgTimeReset);
+		params.hyperTimer = MicroSeconds(m_rpgTimeReset / 2);
+		params.alphaInterval = MicroSeconds(m_alpha_resume_interval);
+		params.clampTgtRate = m_EcnClampTgtRate;
+		params.clampTgtRateAfterTimeInc = m_EcnClampTgtRateAfterTimeInc;
+		cc.SetParams(params);
 	}
 
 	void
-		QbbNetDevice::rpr_fast_recovery(uint32_t fIndex, uint32_t hop)
+		QbbNetDevice::ConfigureCc(QbbTimely &cc)
 	{
-		m_rpStage[fIndex][hop] = 1;
-		return;
+		QbbTimely::Params params;
+		params.lineRate = m_bps;
+		params.minRate = m_minRate;
+		params.delta = m_tmlyDelta;
+		params.tLow = MicroSeconds(m_tmlyTLow);
+		params.tHigh = MicroSeconds(m_tmlyTHigh);
+		params.minRtt = MicroSeconds(m_tmlyMinRtt);
+		params.alpha = m_tmlyAlpha;
+		params.beta = m_tmlyBeta;
+		cc.SetParams(params);
 	}
 
-
+	template <class CC>
 	void
-		QbbNetDevice::rpr_active_increase(uint32_t fIndex, uint32_t hop)
+		QbbNetDevice::StartCc(CC &cc, uint32_t fIndex)
 	{
-		AdjustRates(fIndex, hop, m_rai);
-		m_rpStage[fIndex][hop] = 2;
+		ConfigureCc(cc);
+		cc.Start(fIndex);
+		m_rate[fIndex] = cc.GetRate(fIndex);
 	}
 
-
+	template <class CC>
 	void
-		QbbNetDevice::rpr_active_byte(uint32_t fIndex, uint32_t hop)
+		QbbNetDevice::UpdateCc(CC &cc, uint32_t fIndex)
 	{
-		m_rpByteStage[fIndex][hop]++;
-		m_txBytes[fIndex][hop] = m_bc;
-		rpr_active_increase(fIndex, hop);
+		Time now = Simulator::Now();
+		while (cc.GetNextTimer(fIndex) <= now)
+		{
+			if (m_creditAccrue[fIndex])
+			{
+				//each rate change splits the credits, as the timer events did
+				UpdateCredits(fIndex);
+				cc.FireTimer(fIndex);
+			}
+			else
+			{
+				cc.Advance(fIndex, now);
+			}
+			m_rate[fIndex] = cc.GetRate(fIndex);
+		}
 	}
 
 	void
-		QbbNetDevice::rpr_active_time(uint32_t fIndex, uint32_t hop)
+		QbbNetDevice::UpdateCc(uint32_t fIndex)
 	{
-		m_rpTimeStage[fIndex][hop]++;
-		m_rpWhile[fIndex][hop] = m_rpgTimeReset;
-		Simulator::Cancel(m_rptimer[fIndex][hop]);
-		m_rptimer[fIndex][hop] = Simulator::Schedule(MicroSeconds(m_rpWhile[fIndex][hop]), &QbbNetDevice::rpr_timer_wrapper, this, fIndex, hop);
-		rpr_active_select(fIndex, hop);
+		if (m_ccMode == CC_TIMELY)
+			UpdateCc(m_timely, fIndex);
+		else
+			UpdateCc(m_dcqcn, fIndex);
 	}
 
-
+	template <class CC>
 	void
-		QbbNetDevice::rpr_fast_byte(uint32_t fIndex, uint32_t hop)
+		QbbNetDevice::ScheduleCc(CC &cc, uint32_t fIndex)
 	{
-		m_rpByteStage[fIndex][hop]++;
-		m_txBytes[fIndex][hop] = m_bc;
-		if (m_rpByteStage[fIndex][hop] < m_rpgThreshold)
-		{
-			rpr_adjust_rates(fIndex, hop);
-		}
-		else
+		if (!m_creditAccrue[fIndex])
+			return;
+		Time next = cc.GetNextTimer(fIndex);
+		if (next != Time::Max() && next.GetTimeStep() != m_rpWakeAt[fIndex])
 		{
-			rpr_active_select(fIndex, hop);
+			m_rpWakeAt[fIndex] = next.GetTimeStep();
+			m_rpWake.push(RpWake(next.GetTimeStep(), fIndex));
 		}
-			
-		return;
 	}
 
 	void
-		QbbNetDevice::rpr_fast_time(uint32_t fIndex, uint32_t hop)
-	{
-		m_rpTimeStage[fIndex][hop]++;
-		m_rpWhile[fIndex][hop] = m_rpgTimeReset;
-		Simulator::Cancel(m_rptimer[fIndex][hop]);
-		m_rptimer[fIndex][hop] = Simulator::Schedule(MicroSeconds(m_rpWhile[fIndex][hop]), &QbbNetDevice::rpr_timer_wrapper, this, fIndex, hop);
-		if (m_rpTimeStage[fIndex][hop] < m_rpgThreshold)
-			rpr_adjust_rates(fIndex, hop);
+		QbbNetDevice::ScheduleCc(uint32_t fIndex)
+	{
+		if (m_ccMode == CC_TIMELY)
+			ScheduleCc(m_timely, fIndex);
 		else
-			rpr_active_select(fIndex, hop);
-		return;
+			ScheduleCc(m_dcqcn, fIndex);
 	}
 
-
+	template <class CC>
 	void
-		QbbNetDevice::rpr_hyper_byte(uint32_t fIndex, uint32_t hop)
+		QbbNetDevice::RateLimit(CC &cc, uint32_t fIndex, Ptr<Packet> p)
 	{
-		m_rpByteStage[fIndex][hop]++;
-		m_txBytes[fIndex][hop] = m_bc / 2;
-		rpr_hyper_increase(fIndex, hop);
+		//rate timers that expired since the last transmission
+		while (!m_rpWake.empty() && m_rpWake.top().first <= Simulator::Now().GetTimeStep())
+		{
+			uint32_t i = m_rpWake.top().second;
+			if (m_rpWakeAt[i] == m_rpWake.top().first)
+			{
+				m_rpWakeAt[i] = -1;
+				if (m_creditAccrue[i])
+				{
+					UpdateCc(cc, i);
+					ScheduleCc(cc, i);
+				}
+			}
+			m_rpWake.pop();
+		}
+		UpdateCc(cc, fIndex);
+		UpdateCredits(fIndex);
+		if (m_rate[fIndex] == 0)			//late initialization	
+		{
+			StartCc(cc, fIndex);
+		}
+		double creditsDue = std::max(0.0, m_bps / m_rate[fIndex] * (p->GetSize() - m_credits[fIndex]));
+		Time nextSend = m_tInterframeGap + Seconds(m_bps.CalculateTxTime(creditsDue));
+		//flows whose next available time has come collect this packet's credits too
+		while (!m_creditWake.empty() && m_creditWake.top().first <= Simulator::Now().GetTimeStep())
+		{
+			uint32_t i = m_creditWake.top().second;
+			if (!m_creditAccrue[i] && m_queue->GetNextAvail(i).GetTimeStep() == m_creditWake.top().first)
+			{
+				UpdateCc(cc, i);
+				m_creditAccrue[i] = true;
+				m_creditBase[i] = m_creditClock;
+				ScheduleCc(cc, i);
+			}
+			m_creditWake.pop();
+		}
+		SetNextAvail(fIndex, Simulator::Now() + nextSend);
+		m_creditClock += creditsDue;	//distribute credits
+		m_credits[fIndex] = 0;	//reset credits
+		m_creditBase[fIndex] = m_creditClock;
+		cc.Transmitted(fIndex, p->GetSize());
+		m_rate[fIndex] = cc.GetRate(fIndex);
+		QbbHeaderTag ht;
+		if (CC::NeedsRtt() && p->PeekPacketTag(ht) && ht.GetProtocol() == 17)
+		{
+			m_sendingBuffer[fIndex].SetTxTime(ht.GetSeq(), Simulator::Now());
+		}
 	}
 
-
+	template <class CC>
 	void
-		QbbNetDevice::rpr_hyper_time(uint32_t fIndex, uint32_t hop)
+		QbbNetDevice::ReceiveCnp(CC &cc, uint32_t fIndex, bool congested)
 	{
-		m_rpTimeStage[fIndex][hop]++;
-		m_rpWhile[fIndex][hop] = m_rpgTimeReset / 2;
-		Simulator::Cancel(m_rptimer[fIndex][hop]);
-		m_rptimer[fIndex][hop] = Simulator::Schedule(MicroSeconds(m_rpWhile[fIndex][hop]), &QbbNetDevice::rpr_timer_wrapper, this, fIndex, hop);
-		rpr_hyper_increase(fIndex, hop);
+		UpdateCc(cc, fIndex);
+		UpdateCredits(fIndex);
+		if (m_rate[fIndex] == 0)			//lazy initialization	
+		{
+			StartCc(cc, fIndex);
+		}
+		if (congested)
+		{
+			cc.ReceiveCnp(fIndex, Simulator::Now());
+			ScheduleCc(cc, fIndex);
+		}
+		m_rate[fIndex] = cc.GetRate(fIndex);
 	}
 
-
+	template <class CC>
 	void
-		QbbNetDevice::rpr_active_select(uint32_t fIndex, uint32_t hop)
+		QbbNetDevice::ReceiveAck(CC &cc, uint32_t fIndex, uint32_t seq)
 	{
-		if (m_rpByteStage[fIndex][hop] < m_rpgThreshold || m_rpTimeStage[fIndex][hop] < m_rpgThreshold)
-			rpr_active_increase(fIndex, hop);
-		else
-			rpr_hyper_increase(fIndex, hop);
-		return;
+		Time txTime;
+		if (!CC::NeedsRtt() || m_rate[fIndex] == 0 || seq == 0
+			|| !m_sendingBuffer[fIndex].GetTxTime(seq - 1, txTime))	//the ACK is for seq - 1
+		{
+			return;
+		}
+		UpdateCc(cc, fIndex);
+		UpdateCredits(fIndex);
+		cc.ReceiveAck(fIndex, Simulator::Now() - txTime);
+		ScheduleCc(cc, fIndex);
+		m_rate[fIndex] = cc.GetRate(fIndex);
 	}
 
-
 	void
-		QbbNetDevice::rpr_hyper_increase(uint32_t fIndex, uint32_t hop)
+		QbbNetDevice::UpdateTxStats(const QbbHeaderTag &ht, uint32_t size)
 	{
-		AdjustRates(fIndex, hop, m_rhai*(std::min(m_rpByteStage[fIndex][hop], m_rpTimeStage[fIndex][hop]) - m_rpgThreshold + 1));
-		m_rpStage[fIndex][hop] = 3;
-		return;
+		uint32_t i = m_txFlows.Lookup(ht.GetSource(), ht.GetSourcePort(), ht.GetPG());
+		if (i == QbbFlowTable::NOT_FOUND)
+			return;
+		TxFlowStats &stats = m_txStats[i];
+		if (ht.GetSeq() < stats.nextSeq)
+		{
+			stats.retransmits++;
+		}
+		else
+		{
+			stats.nextSeq = ht.GetSeq() + 1;
+			stats.bytes += size - 2 - 20 - 8; //PPP, IPv4 and UDP headers
+			m_txBacklog[i] -= size;
+		}
+		stats.lastTx = Simulator::Now();
+		stats.pauseAtLastTx = GetPausedTime(stats.pg);
 	}
 
-	void
-		QbbNetDevice::AdjustRates(uint32_t fIndex, uint32_t hop, DataRate increase)
+	const std::vector<QbbNetDevice::TxFlowStats>&
+		QbbNetDevice::GetTxFlowStats(void) const
 	{
-		if (((m_rpByteStage[fIndex][hop] == 1) || (m_rpTimeStage[fIndex][hop] == 1)) && (m_targetRate[fIndex][hop] > 10 * m_rateAll[fIndex][hop]))
-			m_targetRate[fIndex][hop] /= 8;
-		else
-			m_targetRate[fIndex][hop] += increase;
+		return m_txStats;
+	}
 
-		m_rateAll[fIndex][hop] = (m_rateAll[fIndex][hop] / 2) + (m_targetRate[fIndex][hop] / 2);
+	const std::vector<QbbNetDevice::RxFlowStats>&
+		QbbNetDevice::GetRxFlowStats(void) const
+	{
+		return m_rxStats;
+	}
 
-		if (m_rateAll[fIndex][hop] > m_bps)
-			m_rateAll[fIndex][hop] = m_bps;
+	const std::vector<QbbNetDevice::TxFlowStats>&
+		QbbNetDevice::GetRemovedTxFlowStats(void) const
+	{
+		return m_txStatsRemoved;
+	}
 
-		m_rate[fIndex] = m_bps;
-		for (uint32_t j = 0; j < maxHop; j++)
-			m_rate[fIndex] = std::min(m_rate[fIndex], m_rateAll[fIndex][j]);
-		return;
+	const std::vector<QbbNetDevice::RxFlowStats>&
+		QbbNetDevice::GetRemovedRxFlowStats(void) const
+	{
+		return m_rxStatsRemoved;
 	}
 
-	void
-		QbbNetDevice::rpr_cnm_received(uint32_t findex, uint32_t hop, double fraction)
+	bool
+		QbbNetDevice::RemoveRxFlow(Ipv4Address src, uint16_t port, uint16_t pg)
 	{
-		if (!m_EcnClampTgtRateAfterTimeInc && !m_EcnClampTgtRate)
-		{
-			if (m_rpByteStage[findex][hop] != 0)
-			{
-				m_targetRate[findex][hop] = m_rateAll[findex][hop];
-				m_txBytes[findex][hop] = m_bc;
-			}
-		}
-		else if (m_EcnClampTgtRate)
-		{
-			m_targetRate[findex][hop] = m_rateAll[findex][hop];
-			m_txBytes[findex][hop] = m_bc; //for fluid model, QCN standard doesn't have this.
-		}
-		else
-		{
-			if (m_rpByteStage[findex][hop] != 0 || m_rpTimeStage[findex][hop] != 0)
-			{
-				m_targetRate[findex][hop] = m_rateAll[findex][hop];
-				m_txBytes[findex][hop] = m_bc;
-			}
-		}
-		m_rpByteStage[findex][hop] = 0;
-		m_rpTimeStage[findex][hop] = 0;
-		//m_alpha[findex][hop] = (1-m_g)*m_alpha[findex][hop] + m_g*fraction;
-		m_alpha[findex][hop] = (1 - m_g)*m_alpha[findex][hop] + m_g; 	//binary feedback
-		m_rateAll[findex][hop] = std::max(m_minRate, m_rateAll[findex][hop] * (1 - m_alpha[findex][hop] / 2));
-		Simulator::Cancel(m_resumeAlpha[findex][hop]);
-		m_resumeAlpha[findex][hop] = Simulator::Schedule(MicroSeconds(m_alpha_resume_interval), &QbbNetDevice::ResumeAlpha, this, findex, hop);
-		m_rpWhile[findex][hop] = m_rpgTimeReset;
-		Simulator::Cancel(m_rptimer[findex][hop]);
-		m_rptimer[findex][hop] = Simulator::Schedule(MicroSeconds(m_rpWhile[findex][hop]), &QbbNetDevice::rpr_timer_wrapper, this, findex, hop);
-		rpr_fast_recovery(findex, hop);
+		NS_LOG_FUNCTION(this << src << port << pg);
+		uint32_t key = m_rxFlows.Lookup(src, port, pg);
+		if (key == QbbFlowTable::NOT_FOUND)
+			return false;
+		m_rxFlows.Remove(src, port, pg);
+		//its entries left in m_cnpWake are skipped as stale, like those of a rescheduled flow
+		(*m_ecn_source)[key].cnpArmed = false;
+		m_rxStatsRemoved.push_back(m_rxStats[key]);
+		m_rxStats[key] = RxFlowStats();
+		m_rxFree.push_back(key);
+		return true;
 	}
 
-	void
-		QbbNetDevice::rpr_timer_wrapper(uint32_t fIndex, uint32_t hop)
+	bool
+		QbbNetDevice::RemoveTxFlow(Ipv4Address src, uint16_t port, uint16_t pg)
 	{
-		if (m_rpStage[fIndex][hop] == 1)
-		{
-			rpr_fast_time(fIndex, hop);
-		}
-		else if (m_rpStage[fIndex][hop] == 2)
+		NS_LOG_FUNCTION(this << src << port << pg);
+		uint32_t i = m_txFlows.Lookup(src, port, pg);
+		if (i == QbbFlowTable::NOT_FOUND)
+			return false;
+		m_txFlows.Remove(src, port, pg);
+		if (m_txStats[i].udp)
 		{
-			rpr_active_time(fIndex, hop);
+			m_txStatsRemoved.push_back(m_txStats[i]);
 		}
-		else if (m_rpStage[fIndex][hop] == 3)
+		//the slot as AddTxFlow creates it
+		if (m_qcnEnabled)	//without QCN, queue i and its rate are those of a priority, shared with other flows
 		{
-			rpr_hyper_time(fIndex, hop);
+			m_queue->ClearQueue(i);
+			//its entries left in m_rpWake and m_creditWake are stale
+			m_dcqcn.RemoveFlow(i);
+			m_timely.RemoveFlow(i);
+			m_rate[i] = DataRate();
+			m_rpWakeAt[i] = -1;
+			m_credits[i] = 0;
+			m_creditBase[i] = 0;
+			m_creditAccrue[i] = false;
 		}
-		return;
+		m_queue->RemoveFlow(i);
+		Simulator::Cancel(m_retransmit[i]);
+		m_sendingBuffer[i] = QbbSendBuffer();
+		m_milestone_tx[i] = 0;
+		m_waitingAck[i] = false;
+		m_txStats[i] = TxFlowStats();
+		m_txBacklog[i] = 0;
+		return true;
 	}
 
-	void
-		QbbNetDevice::ResumeAlpha(uint32_t fIndex, uint32_t hop)
+	Time
+		QbbNetDevice::GetPausedTime(uint32_t qIndex) const
 	{
-		m_alpha[fIndex][hop] = (1 - m_g)*m_alpha[fIndex][hop];
-		Simulator::Cancel(m_resumeAlpha[fIndex][hop]);
-		m_resumeAlpha[fIndex][hop] = Simulator::Schedule(MicroSeconds(m_alpha_resume_interval), &QbbNetDevice::ResumeAlpha, this, fIndex, hop);
+		if (m_paused[qIndex])
+			return m_pausedTime[qIndex] + (Simulator::Now() - m_pauseBegin[qIndex]);
+		return m_pausedTime[qIndex];
 	}
 
+	int64_t
+		QbbNetDevice::AssignStreams(int64_t stream)
+	{
+		m_uniform->SetStream(stream);
+		return 1;
+	}
 
 	int
 		QbbNetDevice::ReceiverCheckSeq(uint32_t seq, uint32_t key)
@@ -26,10 +26,18 @@
 //#include "ns3/fivetuple.h"
 #include "ns3/event-id.h"
 #include "ns3/broadcom-egress-queue.h"
+#include "ns3/qbb-flow-table.h"
+#include "ns3/qbb-header-tag.h"
+#include "ns3/qbb-send-buffer.h"
+#include "ns3/qbb-dcqcn.h"
+#include "ns3/qbb-timely.h"
 #include "ns3/ipv4.h"
 #include "ns3/ipv4-header.h"
 #include "ns3/udp-header.h"
+#include "ns3/random-variable-stream.h"
 #include <vector>
+#include <queue>
+#include <functional>
 #include<map>
 
 namespace ns3 {
@@ -43,8 +51,13 @@ class QbbNetDevice : public PointToPointNetDevice
 public:
   static const uint32_t qCnt = 8;	// Number of queues/priorities used
   static const uint32_t pCnt = 64;	// Number of ports used
-  static const uint32_t fCnt = 128; // Max number of flows on a NIC, for TX and RX respectively. TX+RX=fCnt*2
-  static const uint32_t maxHop = 1; // Max hop count in the network. should not exceed 16 
+
+  /// Congestion control policy of the flows sent by a NIC
+  enum CongestionControl
+  {
+    CC_DCQCN,
+    CC_TIMELY
+  };
 
   static TypeId GetTypeId (void);
 
@@ -81,7 +94,8 @@ public:
   //virtual uint32_t GetTxAvailable(unsigned) const;
 
   /**
-   * TracedCallback hooks
+   * TracedCallback hooks of the Tx buffer available notification,
+   * void (Ptr<NetDevice> device, uint32_t port)
    */
   void ConnectWithoutContext(const CallbackBase& callback);
   void DisconnectWithoutContext(const CallbackBase& callback);
@@ -90,8 +104,12 @@ public:
 
   bool Attach (Ptr<QbbChannel> ch);
   
-  uint32_t GetPriority(Ptr<Packet> p);
-  uint32_t GetSeq(Ptr<Packet> p);
+  /**
+   * Priority group and sequence number of a UDP data packet as queued on the
+   * device (i.e. with its PPP header). The packet is not modified.
+   */
+  uint32_t GetPriority(Ptr<const Packet> p);
+  uint32_t GetSeq(Ptr<const Packet> p);
   //uint16_t GetPort(Ptr<Packet> p);
   //uint32_t GetQbbPriority(Ptr<Packet> p);
 
@@ -107,11 +125,93 @@ public:
 
    virtual Ptr<Channel> GetChannel (void) const;
 
+   /**
+    * \return the bytes of the UDP flow sent from port with priority qIndex
+    * that wait in the NIC for their first transmission. The Tx buffer
+    * available callbacks (see ConnectWithoutContext) are called with the
+    * port of the flow each time one of them is put on the wire.
+    */
    virtual uint32_t GetUsedBuffer(uint32_t port, uint32_t qIndex);
 
    void SetQueue (Ptr<BEgressQueue> q);
    Ptr<BEgressQueue> GetQueue ();
 
+  /**
+   * Counters of a UDP flow sent by this NIC, identified like in m_txFlows.
+   * Updated once per packet handed to the device and once per packet put
+   * on the wire, for QbbFlowStats.
+   */
+  struct TxFlowStats
+  {
+	  bool udp;		//< false for flow slots that do not hold a UDP flow
+	  Ipv4Address src;
+	  Ipv4Address dst;
+	  uint16_t sport;
+	  uint16_t dport;
+	  uint16_t pg;
+	  Time start;		//< first packet handed to the device
+	  Time lastTx;		//< last packet put on the wire
+	  uint32_t nextSeq;	//< one past the highest sequence number sent
+	  uint64_t bytes;	//< UDP payload bytes sent for the first time
+	  uint32_t retransmits;	//< packets sent again after a NACK or timeout
+	  uint32_t cnps;	//< CNPs received for this flow
+	  Time pauseAtStart;	//< GetPausedTime(pg) at start
+	  Time pauseAtLastTx;	//< GetPausedTime(pg) at lastTx
+  };
+
+  /**
+   * Counters of a UDP flow received by this NIC, identified like in
+   * m_rxFlows, i.e. by the sender's address, port and priority group.
+   */
+  struct RxFlowStats
+  {
+	  Ipv4Address src;
+	  uint16_t sport;
+	  uint16_t pg;
+	  Time start;		//< first packet received
+	  Time finish;		//< last packet received in order
+	  uint32_t nextSeq;	//< next sequence number expected, seq + 1 of the last packet in order
+	  uint64_t bytes;	//< UDP payload bytes received in order
+  };
+
+  /// Indexed by TX flow index; slots without a UDP flow have udp == false
+  const std::vector<TxFlowStats>& GetTxFlowStats(void) const;
+  /// The UDP TX flows removed so far, in the order they were removed
+  const std::vector<TxFlowStats>& GetRemovedTxFlowStats(void) const;
+  /// Indexed by RX flow index; free indices, see RemoveRxFlow, have zero counters
+  const std::vector<RxFlowStats>& GetRxFlowStats(void) const;
+  /// The RX flows removed so far, in the order they were removed
+  const std::vector<RxFlowStats>& GetRemovedRxFlowStats(void) const;
+
+  /**
+   * Forget the RX flow (src, port, pg) once it is over: its CNP account and
+   * sequence state are dropped, and its index is taken by the next new RX
+   * flow. The NIC cannot tell a finished flow from a paused one, so the
+   * owner of the flow calls this.
+   * \return false if the NIC has no such RX flow
+   */
+  bool RemoveRxFlow(Ipv4Address src, uint16_t port, uint16_t pg);
+  /**
+   * Forget the TX flow (src, port, pg) once it is over, like RemoveRxFlow:
+   * packets of the flow still queued are dropped, and its queue, rate and
+   * retransmission state are reset for the next new TX flow.
+   * \return false if the NIC has no such TX flow
+   */
+  bool RemoveTxFlow(Ipv4Address src, uint16_t port, uint16_t pg);
+
+  /// Total time the priority has been paused by PFC so far
+  Time GetPausedTime(uint32_t qIndex) const;
+
+  /**
+   * Assign a fixed random variable stream number to the random variables
+   * used by this model.  Return the number of streams (possibly zero) that
+   * have been assigned.
+   *
+   * \param stream first stream index to use
+   * \return the number of stream indices assigned by this model
+   */
+  int64_t AssignStreams(int64_t stream);
+
 protected:
 
 	//Ptr<Node> m_node;
@@ -122,6 +222,13 @@ protected:
   
   void PointToPointReceive (Ptr<Packet> packet);
 
+  /// Read the header tag of a PPP framed packet, parsing the packet if it has none
+  void PeekHeaderTag (Ptr<const Packet> p, QbbHeaderTag &tag);
+
+  /// Copy of a PPP framed packet with PPP and IPv4 headers removed, for control frames
+  Ptr<Packet> StripHeaders (Ptr<const Packet> packet);
+
+  virtual void DoInitialize(void);
   virtual void DoDispose(void);
 
   /// Reset the channel into READY state and try transmit again
@@ -138,10 +245,12 @@ protected:
 
 
   /**
-   * Function to generate PAUSE message if necessary
-   *
+   * PFC callback of the switch MMU for the ingress PGs of this port: send
+   * XOFF (and renew it when it expires) or XON upstream
    */
-  void CheckQueueFull(uint32_t, uint32_t);
+  void PfcStateChanged(uint32_t qIndex, bool pause);
+  void PfcRefresh(uint32_t qIndex);
+  void SendPauseFrame(uint32_t qIndex, uint32_t time);
 
   /// Tell if an address is local to this node
   bool IsLocal(const Ipv4Address& addr) const;
@@ -166,8 +275,10 @@ protected:
   //uint32_t m_buffersize;//< Total size of Tx buffer
   //uint32_t m_bufferUsage;	//< Occupancy at the buffer
   bool m_paused[qCnt];	//< Whether a queue paused
+  Time m_pauseBegin[qCnt];	//< When the current pause of a queue began
+  Time m_pausedTime[qCnt];	//< Time a queue spent paused, up to its last resume
   EventId m_resumeEvt[qCnt];  //< Keeping the next resume event (PFC)
-  EventId m_recheckEvt[pCnt][qCnt]; //< Keeping the next recheck queue full event (PFC)
+  EventId m_pfcRefreshEvt[qCnt]; //< Renewal of the PAUSE sent upstream, at half its time so that it never expires (PFC)
 
   //qcn
 
@@ -183,26 +294,6 @@ protected:
   //void AveragingPrinciple(unsigned qIndex);
   
   //void RateIncrease(unsigned qIndex);
-  void ResumeAlpha(uint32_t fIndex, uint32_t hop);
-  EventId m_resumeAlpha[fCnt][maxHop];
-
-  void AdjustRates(uint32_t fIndex, uint32_t hop, DataRate increase);
-  void rpr_adjust_rates(uint32_t fIndex, uint32_t hop);
-  void rpr_fast_recovery(uint32_t fIndex, uint32_t hop);
-  void rpr_active_increase(uint32_t fIndex, uint32_t hop);
-  void rpr_active_byte(uint32_t findex, uint32_t hop);
-  void rpr_active_time(uint32_t findex, uint32_t hop);
-  void rpr_fast_byte(uint32_t findex, uint32_t hop);
-  void rpr_fast_time(uint32_t findex, uint32_t hop);
-  void rpr_hyper_byte(uint32_t findex, uint32_t hop);
-  void rpr_hyper_time(uint32_t findex, uint32_t hop);
-  void rpr_active_select(uint32_t findex, uint32_t hop);
-  void rpr_hyper_increase(uint32_t findex, uint32_t hop);
-  void rpr_cnm_received(uint32_t findex, uint32_t hop, double fraction);
-
-  void rpr_timer_wrapper(uint32_t fIndex, uint32_t hop);
-  EventId m_rptimer[fCnt][maxHop];
-
   bool m_EcnClampTgtRateAfterTimeInc;
   bool m_EcnClampTgtRate;
 
@@ -218,23 +309,37 @@ protected:
   uint32_t m_rpgThreshold;
   /* State variable for rate-limited queues */
 
-  DataRate m_rateAll[fCnt][maxHop];
-
-  DataRate m_targetRate[fCnt][maxHop];	//< Target rate
+  /* Per-flow TX state below is kept as parallel vectors indexed by flow
+   * index (the queue index in m_queue), grown by AddTxFlow on demand. */
   //DataRate m_lastRate[fCnt];	//< Target rate
-  DataRate m_rate[fCnt];	//< Current rate
-  int64_t  m_txBytes[fCnt][maxHop];	//< Tx byte counter
-  double  m_rpWhile[fCnt][maxHop];	//< Tx byte counter
-  uint32_t m_rpByteStage[fCnt][maxHop];	//< Count of Tx-based rate increments
-  uint32_t m_rpTimeStage[fCnt][maxHop];
-
-  uint32_t m_rpStage[fCnt][maxHop]; //1: fr; 2: ai; 3: hi
+  std::vector<DataRate> m_rate;	//< Current rate, as set by the congestion control
+  CongestionControl m_ccMode;	//< Policy of the flows, the other one stays idle
+  QbbDcqcn m_dcqcn;
+  QbbTimely m_timely;
+  /* The rate timers of the congestion control are not events. A flow that
+   * collects credits has its rate changes applied before the next
+   * transmission moves m_creditClock, so that the credits are split where
+   * they used to be: it waits in m_rpWake for its next timer, and
+   * m_rpWakeAt holds the time step of its live entry, -1 if none. The
+   * other flows catch up in one go when they are next looked at. */
+  typedef std::pair<int64_t, uint32_t> RpWake;	//< next timer time step, flow
+  std::priority_queue<RpWake, std::vector<RpWake>, std::greater<RpWake> > m_rpWake;
+  std::vector<int64_t> m_rpWakeAt;
 
   //uint32_t m_timeCount[fCnt][maxHop];	//< Count of timer-based rate increments
   //Time     m_timer[qCnt];	//< Time to next self-increment
-  Time     m_nextAvail[fCnt];	//< Soonest time of next send
-  double   m_credits[fCnt];	//< Credits accumulated
-  EventId m_rateIncrease[fCnt]; // rate increase event (QCN)
+  std::vector<double> m_credits;	//< Credits accumulated, up to m_creditBase
+  /* Every transmitted packet credits all the flows that are available
+   * (next available time reached) with its creditsDue, scaled by their rate.
+   * m_creditClock sums the creditsDue, so a flow adds up its credits only
+   * when they are read or its rate changes. Flows that become available
+   * later wait in m_creditWake until their time comes. */
+  double m_creditClock;
+  std::vector<double> m_creditBase;	//< m_creditClock when m_credits was last brought up to date
+  std::vector<bool> m_creditAccrue;	//< The flow is available and collects credits
+  typedef std::pair<int64_t, uint32_t> CreditWake;	//< next available time step, flow
+  std::priority_queue<CreditWake, std::vector<CreditWake>, std::greater<CreditWake> > m_creditWake;
+  std::vector<EventId> m_rateIncrease; // rate increase event (QCN)
 
   //bool m_extraFastRecovery[fCnt][maxHop]; //false means this is the first time receive CNP
   
@@ -250,23 +355,97 @@ protected:
 	  uint8_t ecnbits;
 	  uint16_t qfb;
 	  uint16_t total;
+	  int64_t nextCnp;	//< time step of the next CNP opportunity, every m_qcn_interval from the first packet
+	  bool cnpArmed;	//< CE seen since the last opportunity, queued in m_cnpWake
   };
 
   std::vector<ECNAccount> *m_ecn_source;
   //uint32_t m_ecn_count;
   double m_qcn_interval;
-  double m_alpha[fCnt][maxHop];
   double m_g; //feedback weight
   double m_rpgTimeReset;
   double m_alpha_resume_interval;
+
+  /* TIMELY parameters */
+  double m_tmlyTLow;
+  double m_tmlyTHigh;
+  double m_tmlyMinRtt;
+  double m_tmlyAlpha;
+  double m_tmlyBeta;
+  DataRate m_tmlyDelta;
   //uint32_t m_fastrecover_times;
 
   //Time m_lastpause[qCnt]; //For adding back credits..
 
-  uint32_t m_findex_udpport_map[fCnt];
-  uint32_t m_findex_qindex_map[fCnt];
+  /**
+   * Make room for TX flow index fIndex in all per-flow vectors, initializing
+   * any new entries the way the old fixed arrays were.
+   */
+  void AddTxFlow(uint32_t fIndex);
+  /**
+   * Add the credits collected by flow fIndex since they were last brought
+   * up to date; call before its rate changes.
+   */
+  void UpdateCredits(uint32_t fIndex);
+  /**
+   * Set the next available time of flow fIndex in m_queue and start or
+   * stop its credit collection accordingly.
+   */
+  void SetNextAvail(uint32_t fIndex, Time t);
+
+  /*
+   * Congestion control of the NIC. Each is a template over the policy
+   * class (QbbDcqcn or QbbTimely) and DequeueAndTransmit picks the
+   * instantiation of m_ccMode once per packet, so the policy calls under it
+   * are not virtual. The overloads without a policy argument dispatch on
+   * m_ccMode for the less frequent callers.
+   */
+  void ConfigureCc(QbbDcqcn &cc);
+  void ConfigureCc(QbbTimely &cc);
+  /**
+   * Start the congestion control of flow fIndex at the line rate.
+   */
+  template <class CC> void StartCc(CC &cc, uint32_t fIndex);
+  /**
+   * Apply the rate timers of flow fIndex that expired up to now.
+   */
+  template <class CC> void UpdateCc(CC &cc, uint32_t fIndex);
+  void UpdateCc(uint32_t fIndex);
+  /**
+   * Queue flow fIndex in m_rpWake if it collects credits.
+   */
+  template <class CC> void ScheduleCc(CC &cc, uint32_t fIndex);
+  void ScheduleCc(uint32_t fIndex);
+  /**
+   * Charge the credits of flow fIndex for packet p, which is put on the
+   * wire now, and set when the flow may send again.
+   */
+  template <class CC> void RateLimit(CC &cc, uint32_t fIndex, Ptr<Packet> p);
+  template <class CC> void ReceiveCnp(CC &cc, uint32_t fIndex, bool congested);
+  /**
+   * ACK up to seq, an RTT sample if the policy needs it.
+   */
+  template <class CC> void ReceiveAck(CC &cc, uint32_t fIndex, uint32_t seq);
 
-  void CheckandSendQCN(Ipv4Address source, uint32_t qIndex, uint32_t port);
+  QbbFlowTable m_txFlows;	//< (local IP, udp port, PG) -> flow index in m_queue
+  QbbFlowTable m_rxFlows;	//< (remote IP, udp port, PG) -> index in m_ecn_source
+
+  /**
+   * CNP generation of the notification point. Each RX flow has a CNP
+   * opportunity every m_qcn_interval: a CNP is sent if the flow saw CE
+   * marks since the previous one, and the ECN counters restart. Only the
+   * flows with CE marks wait in m_cnpWake for their next opportunity; the
+   * others just catch up in UpdateCnpClock when their next packet arrives,
+   * so idle flows cost no events. RemoveRxFlow frees the account of a flow
+   * that is over.
+   */
+  void CheckandSendQCN(uint32_t key);
+  void UpdateCnpClock(uint32_t key);
+  void ArmCnp(uint32_t key);
+  void CnpTimer();
+  typedef std::pair<int64_t, uint32_t> CnpWake;	//< CNP opportunity time step, RX flow
+  std::priority_queue<CnpWake, std::vector<CnpWake>, std::greater<CnpWake> > m_cnpWake;
+  EventId m_cnpTimer;
 
 
   void ResumeECNState(uint32_t inDev);
@@ -308,21 +487,34 @@ protected:
 
   int ReceiverCheckSeq(uint32_t seq, uint32_t key);
   void Retransmit(uint32_t findex);
+  void GoBackN(uint32_t findex); //replace the queue of the flow with its sending buffer
   double m_nack_interval;
   double m_waitAckTimer;
-  Ptr<DropTailQueue> m_sendingBuffer[fCnt];
+  std::vector<QbbSendBuffer> m_sendingBuffer;
   uint32_t m_chunk;
   uint32_t m_ack_interval;
-  uint32_t ReceiverNextExpectedSeq[fCnt];
-  Time m_nackTimer[fCnt];
-  uint32_t m_lastNACK[fCnt];
-  int32_t m_milestone_rx[fCnt];
+  //RX state, indexed like m_ecn_source
+  std::vector<uint32_t> ReceiverNextExpectedSeq;
+  std::vector<Time> m_nackTimer;
+  std::vector<uint32_t> m_lastNACK;
+  std::vector<int32_t> m_milestone_rx;
   bool m_waitAck;
   bool m_backto0;
   bool m_testRead;
-  int32_t m_milestone_tx[fCnt];
-  EventId m_retransmit[fCnt];
-  bool m_waitingAck[fCnt];
+  std::vector<int32_t> m_milestone_tx;
+  std::vector<EventId> m_retransmit;
+  std::vector<bool> m_waitingAck;
+
+  /// Account a UDP data packet put on the wire by the NIC
+  void UpdateTxStats(const QbbHeaderTag &ht, uint32_t size);
+  std::vector<TxFlowStats> m_txStats;	//< indexed like m_rate
+  std::vector<TxFlowStats> m_txStatsRemoved;	//< of the UDP flows removed by RemoveTxFlow
+  std::vector<uint32_t> m_txBacklog;	//< bytes of UDP flows not sent yet, see GetUsedBuffer
+  std::vector<RxFlowStats> m_rxStats;	//< indexed like m_ecn_source
+  std::vector<RxFlowStats> m_rxStatsRemoved;	//< of the flows removed by RemoveRxFlow
+  std::vector<uint32_t> m_rxFree;	//< indices of removed RX flows, reused before m_ecn_source grows
+
+  Ptr<UniformRandomVariable> m_uniform;	//< IPv4 identification of generated control packets
 
 };
 
@@ -0,0 +1,209 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+* This program is free software; you can redistribute it and/or modify
+* it under the terms of the GNU General Public License version 2 as
+* published by the Free Software Foundation;
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program; if not, write to the Free Software
+* Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+*/
+#include "ns3/assert.h"
+#include "ns3/node.h"
+#include "ns3/nstime.h"
+#include "ns3/ppp-header.h"
+#include "ns3/seq-ts-header.h"
+#include "ns3/qbb-header-tag.h"
+#include "qbb-send-buffer.h"
+
+namespace ns3 {
+
+	QbbSendBuffer::QbbSendBuffer()
+		: m_records(16),
+		m_head(0),
+		m_count(0),
+		m_hasTemplate(false),
+		m_pg(0)
+	{
+	}
+
+	void
+		QbbSendBuffer::Add(Ptr<const Packet> p)
+	{
+		//PPP (2) + IPv4 with options (60) + UDP (8) + SeqTsHeader (14)
+		uint8_t buf[2 + 60 + 8 + 14];
+		uint32_t len = p->CopyData(buf, sizeof(buf));
+		uint32_t ihl = (buf[2] & 0x0f) * 4;
+		uint32_t o = 2 + ihl + 8;
+		NS_ASSERT_MSG(len >= o + 14, "QbbSendBuffer::Add(): not a UdpClient packet");
+
+		if (!m_hasTemplate)
+		{
+			Ptr<Packet> copy = p->Copy();
+			PppHeader ppp;
+			copy->RemoveHeader(ppp);
+			copy->RemoveHeader(m_ipv4);
+			copy->RemoveHeader(m_udp);
+			SeqTsHeader seqTs;
+			copy->PeekHeader(seqTs);
+			m_pg = seqTs.GetPG();
+			m_hasTemplate = true;
+		}
+
+		if (m_count == m_records.size())
+		{
+			Grow();
+		}
+		Record &r = m_records[(m_head + m_count) & (m_records.size() - 1)];
+		r.seq = ((uint32_t)buf[o] << 24) | ((uint32_t)buf[o + 1] << 16) | ((uint32_t)buf[o + 2] << 8) | buf[o + 3];
+		r.ts = 0;
+		for (uint32_t i = 0; i < 8; i++)
+		{
+			r.ts = (r.ts << 8) | buf[o + 4 + i];
+		}
+		r.ipId = ((uint16_t)buf[2 + 4] << 8) | buf[2 + 5];
+		r.size = p->GetSize();
+		r.txTs = -1;
+		NS_ASSERT_MSG(m_count == 0 || r.seq == At(m_count - 1).seq + 1, "QbbSendBuffer::Add(): sequence numbers must be consecutive");
+		m_count++;
+	}
+
+	bool
+		QbbSendBuffer::IsEmpty() const
+	{
+		return m_count == 0;
+	}
+
+	uint32_t
+		QbbSendBuffer::GetSize() const
+	{
+		return m_count;
+	}
+
+	uint32_t
+		QbbSendBuffer::GetFrontSeq() const
+	{
+		NS_ASSERT(m_count > 0);
+		return m_records[m_head].seq;
+	}
+
+	void
+		QbbSendBuffer::PopFront()
+	{
+		NS_ASSERT(m_count > 0);
+		m_head = (m_head + 1) & (m_records.size() - 1);
+		m_count--;
+	}
+
+	void
+		QbbSendBuffer::Trim(uint32_t seq)
+	{
+		//by record rather than by seq - GetFrontSeq(), which would drop the wrong
+		//records if the sequence numbers had a gap
+		while (m_count > 0 && m_records[m_head].seq < seq)
+		{
+			m_head = (m_head + 1) & (m_records.size() - 1);
+			m_count--;
+		}
+	}
+
+	Ptr<Packet>
+		QbbSendBuffer::Get(uint32_t k) const
+	{
+		NS_ASSERT(k < m_count);
+		const Record &r = At(k);
+		Ptr<Packet> p = Create<Packet>(r.size - 2 - m_ipv4.GetSerializedSize() - 8 - 14);
+
+		SeqTsHeader seqTs;
+		seqTs.SetSeq(r.seq);
+		seqTs.SetPG(m_pg);
+		seqTs.SetTs(TimeStep(r.ts));
+		p->AddHeader(seqTs);
+
+		UdpHeader udp = m_udp;
+		if (Node::ChecksumEnabled())
+		{
+			udp.EnableChecksums();
+			udp.InitializeChecksum(m_ipv4.GetSource(), m_ipv4.GetDestination(), 17);
+		}
+		p->AddHeader(udp);
+
+		Ipv4Header ipv4 = m_ipv4;
+		ipv4.SetIdentification(r.ipId);
+		ipv4.SetPayloadSize(p->GetSize());
+		if (Node::ChecksumEnabled())
+		{
+			ipv4.EnableChecksum();
+		}
+		p->AddHeader(ipv4);
+
+		PppHeader ppp;
+		ppp.SetProtocol(0x0021);
+		p->AddHeader(ppp);
+
+		QbbHeaderTag ht;
+		ht.Parse(p, true);
+		p->AddPacketTag(ht);
+		return p;
+	}
+
+	void
+		QbbSendBuffer::SetTxTime(uint32_t seq, Time t)
+	{
+		if (m_count == 0 || seq < GetFrontSeq() || seq - GetFrontSeq() >= m_count)
+		{
+			return;
+		}
+		Record &r = At(seq - GetFrontSeq());
+		if (r.seq == seq)
+		{
+			r.txTs = t.GetTimeStep();
+		}
+	}
+
+	bool
+		QbbSendBuffer::GetTxTime(uint32_t seq, Time &t) const
+	{
+		if (m_count == 0 || seq < GetFrontSeq() || seq - GetFrontSeq() >= m_count)
+		{
+			return false;
+		}
+		const Record &r = At(seq - GetFrontSeq());
+		if (r.seq != seq || r.txTs < 0)
+		{
+			return false;
+		}
+		t = TimeStep(r.txTs);
+		return true;
+	}
+
+	const QbbSendBuffer::Record &
+		QbbSendBuffer::At(uint32_t k) const
+	{
+		return m_records[(m_head + k) & (m_records.size() - 1)];
+	}
+
+	QbbSendBuffer::Record &
+		QbbSendBuffer::At(uint32_t k)
+	{
+		return m_records[(m_head + k) & (m_records.size() - 1)];
+	}
+
+	void
+		QbbSendBuffer::Grow()
+	{
+		std::vector<Record> records(m_records.size() * 2);
+		for (uint32_t k = 0; k < m_count; k++)
+		{
+			records[k] = At(k);
+		}
+		m_records.swap(records);
+		m_head = 0;
+	}
+
+} // namespace ns3
@@ -0,0 +1,108 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+* This program is free software; you can redistribute it and/or modify
+* it under the terms of the GNU General Public License version 2 as
+* published by the Free Software Foundation;
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program; if not, write to the Free Software
+* Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+*/
+#ifndef QBB_SEND_BUFFER_H
+#define QBB_SEND_BUFFER_H
+
+#include <stdint.h>
+#include <vector>
+#include "ns3/packet.h"
+#include "ns3/nstime.h"
+#include "ns3/ipv4-header.h"
+#include "ns3/udp-header.h"
+
+namespace ns3 {
+
+/**
+ * \class QbbSendBuffer
+ * \brief Go-back-N retransmission buffer of one UDP flow of a qbb NIC.
+ *
+ * Only the fields that differ from one packet of the flow to the next are
+ * kept, in a ring ordered by sequence number: the sequence number, the size,
+ * the IPv4 identification and the SeqTsHeader time stamp. The IPv4 and UDP
+ * headers of the first packet serve as the template of the flow, and Get
+ * rebuilds a packet that is byte for byte the one that was sent.
+ *
+ * Packets must be added with consecutive sequence numbers, which is what
+ * UdpClient does; Trim then drops acknowledged packets in constant time
+ * per packet, and still drops only older packets if there is a gap.
+ */
+class QbbSendBuffer
+{
+public:
+	QbbSendBuffer();
+
+	/**
+	 * Record a UDP packet handed to the NIC, starting with its PPP header.
+	 */
+	void Add(Ptr<const Packet> p);
+
+	bool IsEmpty() const;
+	uint32_t GetSize() const;
+	/**
+	 * \return the sequence number of the oldest packet, the buffer must not
+	 * be empty
+	 */
+	uint32_t GetFrontSeq() const;
+	void PopFront();
+	/**
+	 * Drop the packets older than seq.
+	 */
+	void Trim(uint32_t seq);
+
+	/**
+	 * \return a copy of the k-th oldest packet, with its PPP header and
+	 * QbbHeaderTag
+	 */
+	Ptr<Packet> Get(uint32_t k) const;
+
+	/**
+	 * Remember when the packet with sequence number seq was put on the wire,
+	 * for RTT samples; ignored if it is not in the buffer.
+	 */
+	void SetTxTime(uint32_t seq, Time t);
+	/**
+	 * \return false if the packet with sequence number seq is not in the
+	 * buffer or was not put on the wire yet
+	 */
+	bool GetTxTime(uint32_t seq, Time &t) const;
+
+private:
+	struct Record
+	{
+		uint32_t seq;
+		uint32_t size;	//< with the PPP header
+		uint64_t ts;	//< SeqTsHeader time stamp, in time steps
+		uint16_t ipId;
+		int64_t txTs;	//< last put on the wire, in time steps, -1 if never
+	};
+
+	const Record &At(uint32_t k) const;
+	Record &At(uint32_t k);
+	void Grow();
+
+	std::vector<Record> m_records;	//< ring, the size is a power of two
+	uint32_t m_head;
+	uint32_t m_count;
+
+	bool m_hasTemplate;
+	Ipv4Header m_ipv4;
+	UdpHeader m_udp;
+	uint16_t m_pg;
+};
+
+} // namespace ns3
+
+#endif /* QBB_SEND_BUFFER_H */
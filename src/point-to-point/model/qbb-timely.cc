@@ -0,0 +1,94 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+* This program is free software; you can redistribute it and/or modify
+* it under the terms of the GNU General Public License version 2 as
+* published by the Free Software Foundation;
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program; if not, write to the Free Software
+* Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+*/
+#include <algorithm>
+#include "qbb-timely.h"
+
+namespace ns3 {
+
+	void
+		QbbTimely::SetParams(const Params &params)
+	{
+		m_params = params;
+	}
+
+	void
+		QbbTimely::AddFlows(uint32_t n)
+	{
+		if (m_flows.size() < n)
+			m_flows.resize(n);
+	}
+
+	void
+		QbbTimely::Start(uint32_t fIndex)
+	{
+		Flow &f = m_flows[fIndex];
+		f.rate = m_params.lineRate;
+		f.prevRtt = Time(0);
+		f.rttDiff = 0;
+		f.negGradients = 0;
+	}
+
+	void
+		QbbTimely::RemoveFlow(uint32_t fIndex)
+	{
+		m_flows[fIndex] = Flow();
+	}
+
+	DataRate
+		QbbTimely::GetRate(uint32_t fIndex) const
+	{
+		return m_flows[fIndex].rate;
+	}
+
+	void
+		QbbTimely::ReceiveAck(uint32_t fIndex, Time rtt)
+	{
+		Flow &f = m_flows[fIndex];
+		if (!f.prevRtt.IsZero())
+		{
+			double newRttDiff = (rtt - f.prevRtt).GetTimeStep();
+			f.rttDiff = (1 - m_params.alpha) * f.rttDiff + m_params.alpha * newRttDiff;
+		}
+		f.prevRtt = rtt;
+		double gradient = f.rttDiff / m_params.minRtt.GetTimeStep();
+
+		double factor = 1;
+		if (rtt < m_params.tLow)
+		{
+			f.rate += m_params.delta;
+		}
+		else if (rtt > m_params.tHigh)
+		{
+			f.negGradients = 0;
+			factor = 1 - m_params.beta * (1 - m_params.tHigh.GetSeconds() / rtt.GetSeconds());
+		}
+		else if (gradient <= 0)
+		{
+			f.negGradients++;
+			uint32_t n = f.negGradients >= haiCount ? haiCount : 1;
+			f.rate += DataRate(m_params.delta.GetBitRate() * n);
+		}
+		else
+		{
+			f.negGradients = 0;
+			factor = std::max(0.0, 1 - m_params.beta * gradient);
+		}
+		if (factor != 1)
+			f.rate = f.rate * factor;
+		f.rate = std::max(m_params.minRate, std::min(m_params.lineRate, f.rate));
+	}
+
+} // namespace ns3
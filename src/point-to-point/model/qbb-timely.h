@@ -0,0 +1,91 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+* This program is free software; you can redistribute it and/or modify
+* it under the terms of the GNU General Public License version 2 as
+* published by the Free Software Foundation;
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program; if not, write to the Free Software
+* Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+*/
+#ifndef QBB_TIMELY_H
+#define QBB_TIMELY_H
+
+#include <stdint.h>
+#include <vector>
+#include "ns3/nstime.h"
+#include "ns3/data-rate.h"
+
+namespace ns3 {
+
+/**
+ * \class QbbTimely
+ * \brief TIMELY congestion control of the flows of a qbb NIC.
+ *
+ * RTT-gradient rate control (Mittal et al., SIGCOMM 2015), with the same
+ * members as QbbDcqcn so that QbbNetDevice can use either. Every ACK gives
+ * an RTT sample, from the time the acknowledged packet was put on the
+ * wire. Below tLow the rate grows by delta, above tHigh it is cut in
+ * proportion to the excess. In between, the smoothed RTT difference,
+ * normalized by minRtt, is the gradient: the rate grows by delta while it
+ * is not positive (by haiCount*delta once that held for haiCount ACKs in a
+ * row), and is cut by beta*gradient otherwise. There are no timers and
+ * CNPs are ignored.
+ */
+class QbbTimely
+{
+public:
+	static const uint32_t haiCount = 5;	//< ACKs with a negative gradient before hyper increase
+
+	struct Params
+	{
+		DataRate lineRate;
+		DataRate minRate;	//< Min sending rate
+		DataRate delta;		//< Rate of additive increase
+		Time tLow;
+		Time tHigh;
+		Time minRtt;		//< Normalizes the gradient
+		double alpha;		//< EWMA weight of a new RTT difference
+		double beta;		//< Multiplicative decrease factor
+	};
+
+	void SetParams(const Params &params);
+	void AddFlows(uint32_t n);
+
+	void Start(uint32_t fIndex);
+	void RemoveFlow(uint32_t fIndex);
+	DataRate GetRate(uint32_t fIndex) const;
+
+	Time GetNextTimer(uint32_t fIndex) const { return Time::Max(); }
+	void FireTimer(uint32_t fIndex) {}
+	void Advance(uint32_t fIndex, Time now) {}
+
+	void Transmitted(uint32_t fIndex, uint32_t size) {}
+	void ReceiveCnp(uint32_t fIndex, Time now) {}
+	/**
+	 * Update the rate of flow fIndex with an RTT sample.
+	 */
+	void ReceiveAck(uint32_t fIndex, Time rtt);
+	static bool NeedsRtt() { return true; }
+
+private:
+	struct Flow
+	{
+		DataRate rate;
+		Time prevRtt;		//< Last RTT sample, zero before the first
+		double rttDiff;		//< Smoothed RTT difference, in time steps
+		uint32_t negGradients;	//< ACKs in a row with a gradient not above zero
+	};
+
+	Params m_params;
+	std::vector<Flow> m_flows;
+};
+
+} // namespace ns3
+
+#endif /* QBB_TIMELY_H */
@@ -0,0 +1,379 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#include <sstream>
+#include "ns3/test.h"
+#include "ns3/simulator.h"
+#include "ns3/default-simulator-impl.h"
+#include "ns3/multithreaded-simulator-impl.h"
+#include "ns3/node-container.h"
+#include "ns3/point-to-point-net-device.h"
+#include "ns3/point-to-point-channel.h"
+#include "ns3/qbb-helper.h"
+#include "ns3/qbb-net-device.h"
+#include "ns3/internet-stack-helper.h"
+#include "ns3/ipv4-address-helper.h"
+#include "ns3/ipv4-global-routing-helper.h"
+#include "ns3/udp-socket-factory.h"
+#include "ns3/inet-socket-address.h"
+#include "ns3/seq-ts-header.h"
+#include "ns3/socket.h"
+#include "ns3/packet.h"
+#include "ns3/string.h"
+#include "ns3/uinteger.h"
+
+namespace ns3 {
+
+/*
+ * Tokens hop around a ring of four nodes split in two partitions, linked by
+ * channels of 1us: every node logs the tokens it sees, which must be the
+ * same with the multithreaded simulator as with the default one. A global
+ * event samples the run, which is stopped once and then resumed.
+ */
+class MultithreadedSimulatorTestCase : public TestCase
+{
+public:
+  MultithreadedSimulatorTestCase ();
+
+  virtual void DoRun (void);
+
+private:
+  static const uint32_t NODES = 4;
+  static const uint32_t TOKENS = 5;
+  static const uint32_t HOPS = 40;
+  static const uint32_t SAMPLES = 10;
+
+  struct Result
+  {
+    std::vector<std::vector<uint64_t> > logs;
+    Time stopTime;
+    uint32_t stopSamples;
+    Time endTime;
+    uint32_t endSamples;
+    uint32_t errors;
+  };
+
+  void RunOnce (Ptr<SimulatorImpl> impl, bool partitioned, Result &result);
+  void Receive (uint32_t node, uint32_t token, uint32_t hops);
+  void Forward (uint32_t node, uint32_t token, uint32_t hops);
+  void Sample (void);
+
+  NodeContainer m_nodes;
+  bool m_partitioned;
+  // written by the thread of the node only
+  std::vector<std::vector<uint64_t> > m_logs;
+  std::vector<uint32_t> m_errors;
+  uint32_t m_samples;
+};
+
+MultithreadedSimulatorTestCase::MultithreadedSimulatorTestCase ()
+  : TestCase ("Check that a partitioned run processes the same events as a sequential one")
+{
+}
+
+void
+MultithreadedSimulatorTestCase::Receive (uint32_t node, uint32_t token, uint32_t hops)
+{
+  m_logs[node].push_back (Simulator::Now ().GetTimeStep ());
+  m_logs[node].push_back (token * 1000 + hops);
+  if (Simulator::GetContext () != node
+      || (m_partitioned && Simulator::GetSystemId () != m_nodes.Get (node)->GetSystemId ()))
+    {
+      m_errors[node]++;
+    }
+  if (hops > 0)
+    {
+      // a local event first, then the next node
+      Simulator::Schedule (NanoSeconds (300 + 100 * token), &MultithreadedSimulatorTestCase::Forward,
+                           this, node, token, hops);
+    }
+}
+
+void
+MultithreadedSimulatorTestCase::Forward (uint32_t node, uint32_t token, uint32_t hops)
+{
+  uint32_t next = (node + 1) % NODES;
+  Simulator::ScheduleWithContext (next, MicroSeconds (1), &MultithreadedSimulatorTestCase::Receive,
+                                  this, next, token, hops - 1);
+}
+
+void
+MultithreadedSimulatorTestCase::Sample (void)
+{
+  if (Simulator::GetContext () != 0xffffffff || Simulator::GetSystemId () != 0)
+    {
+      m_errors[0]++;
+    }
+  if (++m_samples < SAMPLES)
+    {
+      Simulator::Schedule (MicroSeconds (5), &MultithreadedSimulatorTestCase::Sample, this);
+    }
+}
+
+void
+MultithreadedSimulatorTestCase::RunOnce (Ptr<SimulatorImpl> impl, bool partitioned, Result &result)
+{
+  Simulator::Destroy ();
+  Simulator::SetImplementation (impl);
+  m_partitioned = partitioned;
+  m_logs.assign (NODES, std::vector<uint64_t> ());
+  m_errors.assign (NODES, 0);
+  m_samples = 0;
+
+  // partitions {0, 1} and {2, 3}
+  for (uint32_t i = 0; i < NODES; i++)
+    {
+      m_nodes.Create (1, i / 2);
+    }
+  for (uint32_t i = 0; i < NODES; i++)
+    {
+      Ptr<PointToPointChannel> channel = CreateObject<PointToPointChannel> ();
+      channel->SetAttribute ("Delay", TimeValue (MicroSeconds (1)));
+      for (uint32_t j = 0; j < 2; j++)
+        {
+          Ptr<PointToPointNetDevice> device = CreateObject<PointToPointNetDevice> ();
+          device->SetAddress (Mac48Address::Allocate ());
+          m_nodes.Get ((i + j) % NODES)->AddDevice (device);
+          device->Attach (channel);
+        }
+    }
+
+  for (uint32_t token = 0; token < TOKENS; token++)
+    {
+      uint32_t node = token % NODES;
+      Simulator::ScheduleWithContext (node, NanoSeconds (100 * token), &MultithreadedSimulatorTestCase::Receive,
+                                      this, node, token, HOPS);
+    }
+  Simulator::Schedule (MicroSeconds (5), &MultithreadedSimulatorTestCase::Sample, this);
+
+  // between two token events, which are on multiples of 100ns
+  Simulator::Stop (NanoSeconds (30050));
+  Simulator::Run ();
+  result.stopTime = Simulator::Now ();
+  result.stopSamples = m_samples;
+
+  Simulator::Run ();
+  result.endTime = Simulator::Now ();
+  result.endSamples = m_samples;
+  result.logs = m_logs;
+  result.errors = 0;
+  for (uint32_t i = 0; i < NODES; i++)
+    {
+      result.errors += m_errors[i];
+    }
+
+  m_nodes = NodeContainer ();
+  Simulator::Destroy ();
+}
+
+void
+MultithreadedSimulatorTestCase::DoRun (void)
+{
+  Result sequential;
+  RunOnce (CreateObject<DefaultSimulatorImpl> (), false, sequential);
+  Result multithreaded;
+  RunOnce (CreateObject<MultithreadedSimulatorImpl> (), true, multithreaded);
+
+  NS_TEST_ASSERT_MSG_EQ (sequential.errors, 0, "wrong context");
+  NS_TEST_ASSERT_MSG_EQ (multithreaded.errors, 0, "wrong context or partition");
+  NS_TEST_ASSERT_MSG_EQ (sequential.stopTime, NanoSeconds (30050), "not stopped at the stop time");
+  NS_TEST_ASSERT_MSG_EQ (multithreaded.stopTime, NanoSeconds (30050), "not stopped at the stop time");
+  NS_TEST_ASSERT_MSG_EQ (multithreaded.stopSamples, sequential.stopSamples, "global events differ at the stop");
+  NS_TEST_ASSERT_MSG_EQ (multithreaded.endSamples, SAMPLES, "global events lost");
+  NS_TEST_ASSERT_MSG_EQ (multithreaded.endTime, sequential.endTime, "the runs end at different times");
+  for (uint32_t i = 0; i < NODES; i++)
+    {
+      NS_TEST_ASSERT_MSG_EQ (multithreaded.logs[i].size (), sequential.logs[i].size (), "node " << i << " saw different tokens");
+      for (uint32_t k = 0; k < sequential.logs[i].size (); k++)
+        {
+          NS_TEST_ASSERT_MSG_EQ (multithreaded.logs[i][k], sequential.logs[i][k], "node " << i << " saw different tokens");
+        }
+    }
+}
+
+/*
+ * Hosts 1 and 2 are in the partition of the switch (node 0), hosts 3 and 4
+ * in the other one. Hosts 3 and 4 send to host 1 faster than its link
+ * drains, so that data and PAUSE frames cross the partitions both ways,
+ * while host 2 sends to host 4. Every flow must deliver all its bytes, at
+ * the same time as in a sequential run.
+ */
+class QbbMultithreadedTestCase : public TestCase
+{
+public:
+  QbbMultithreadedTestCase ();
+
+  virtual void DoRun (void);
+
+private:
+  static const uint32_t NODES = 5;
+  static const uint32_t FLOWS = 3;
+  static const uint32_t PACKETS = 200;
+  static const uint32_t SIZE = 1000;
+
+  struct Result
+  {
+    std::vector<uint64_t> bytes;
+    std::vector<Time> finish;
+    Time paused;
+  };
+
+  void RunOnce (Ptr<SimulatorImpl> impl, bool partitioned, Result &result);
+  void Send (uint32_t flow, uint32_t seq);
+  void Receive (Ptr<Socket> socket);
+
+  NodeContainer m_nodes;
+  std::vector<Ptr<Socket> > m_senders;
+  // written by the thread of the receiver only
+  std::vector<uint64_t> m_bytes;
+  std::vector<Time> m_finish;
+};
+
+QbbMultithreadedTestCase::QbbMultithreadedTestCase ()
+  : TestCase ("Check that qbb flows across partitions deliver the same bytes as in a sequential run")
+{
+}
+
+void
+QbbMultithreadedTestCase::Send (uint32_t flow, uint32_t seq)
+{
+  // the same layout as a UdpClient packet, which the NIC parses
+  SeqTsHeader seqTs;
+  seqTs.SetSeq (seq);
+  seqTs.SetPG (3);
+  Ptr<Packet> p = Create<Packet> (SIZE - 14 - 10);
+  p->AddHeader (seqTs);
+  m_senders[flow]->Send (p);
+  if (seq + 1 < PACKETS)
+    {
+      // a packet every 1us is 8Gbps, two such senders share the 10Gbps link of host 1
+      Simulator::Schedule (MicroSeconds (1), &QbbMultithreadedTestCase::Send, this, flow, seq + 1);
+    }
+}
+
+void
+QbbMultithreadedTestCase::Receive (Ptr<Socket> socket)
+{
+  Ptr<Packet> p;
+  Address from;
+  while ((p = socket->RecvFrom (from)))
+    {
+      uint16_t port = InetSocketAddress::ConvertFrom (from).GetPort ();
+      uint32_t flow = port - 1000;
+      m_bytes[flow] += p->GetSize ();
+      m_finish[flow] = Simulator::Now ();
+    }
+}
+
+void
+QbbMultithreadedTestCase::RunOnce (Ptr<SimulatorImpl> impl, bool partitioned, Result &result)
+{
+  Simulator::Destroy ();
+  Simulator::SetImplementation (impl);
+  m_bytes.assign (FLOWS, 0);
+  m_finish.assign (FLOWS, Time ());
+
+  for (uint32_t i = 0; i < NODES; i++)
+    {
+      m_nodes.Create (1, partitioned && i >= 3 ? 1 : 0);
+    }
+  m_nodes.Get (0)->SetNodeType (1, false);
+
+  InternetStackHelper internet;
+  internet.Install (m_nodes);
+  QbbHelper qbb;
+  qbb.SetDeviceAttribute ("DataRate", StringValue ("10Gbps"));
+  qbb.SetDeviceAttribute ("L2ChunkSize", UintegerValue (4000));
+  qbb.SetDeviceAttribute ("L2AckInterval", UintegerValue (256));
+  qbb.SetChannelAttribute ("Delay", StringValue ("1us"));
+  Ipv4AddressHelper ipv4;
+  std::vector<Ipv4Address> addresses (NODES);
+  for (uint32_t i = 1; i < NODES; i++)
+    {
+      NetDeviceContainer d = qbb.Install (m_nodes.Get (0), m_nodes.Get (i));
+      std::ostringstream base;
+      base << "10.1." << i << ".0";
+      ipv4.SetBase (base.str ().c_str (), "255.255.255.0");
+      addresses[i] = ipv4.Assign (d).GetAddress (1);
+    }
+  Ipv4GlobalRoutingHelper::PopulateRoutingTables ();
+
+  uint32_t src[FLOWS] = { 3, 4, 2 };
+  uint32_t dst[FLOWS] = { 1, 1, 4 };
+  m_senders.clear ();
+  for (uint32_t flow = 0; flow < FLOWS; flow++)
+    {
+      Ptr<Socket> receiver = Socket::CreateSocket (m_nodes.Get (dst[flow]), UdpSocketFactory::GetTypeId ());
+      receiver->Bind (InetSocketAddress (Ipv4Address::GetAny (), 2000 + flow));
+      receiver->SetRecvCallback (MakeCallback (&QbbMultithreadedTestCase::Receive, this));
+
+      Ptr<Socket> sender = Socket::CreateSocket (m_nodes.Get (src[flow]), UdpSocketFactory::GetTypeId ());
+      sender->Bind (InetSocketAddress (Ipv4Address::GetAny (), 1000 + flow));
+      sender->Connect (InetSocketAddress (addresses[dst[flow]], 2000 + flow));
+      m_senders.push_back (sender);
+      // staggered, so that no two packets reach the switch at the same time
+      Simulator::ScheduleWithContext (src[flow], MicroSeconds (10) + NanoSeconds (333 * flow),
+                                      &QbbMultithreadedTestCase::Send, this, flow, 0);
+    }
+
+  Simulator::Stop (MilliSeconds (2));
+  Simulator::Run ();
+  result.bytes = m_bytes;
+  result.finish = m_finish;
+  result.paused = DynamicCast<QbbNetDevice> (m_nodes.Get (3)->GetDevice (1))->GetPausedTime (3);
+
+  m_senders.clear ();
+  m_nodes = NodeContainer ();
+  Simulator::Destroy ();
+}
+
+void
+QbbMultithreadedTestCase::DoRun (void)
+{
+  Result sequential;
+  RunOnce (CreateObject<DefaultSimulatorImpl> (), false, sequential);
+  Result multithreaded;
+  RunOnce (CreateObject<MultithreadedSimulatorImpl> (), true, multithreaded);
+
+  NS_TEST_ASSERT_MSG_GT (sequential.paused, Time (), "host 3 was never paused by the switch");
+  NS_TEST_ASSERT_MSG_EQ (multithreaded.paused, sequential.paused, "host 3 was paused for a different time");
+  for (uint32_t flow = 0; flow < FLOWS; flow++)
+    {
+      NS_TEST_ASSERT_MSG_EQ (sequential.bytes[flow], PACKETS * (SIZE - 14 - 10 + 14),
+                             "flow " << flow << " lost bytes in the sequential run");
+      NS_TEST_ASSERT_MSG_EQ (multithreaded.bytes[flow], sequential.bytes[flow],
+                             "flow " << flow << " delivered different bytes");
+      NS_TEST_ASSERT_MSG_EQ (multithreaded.finish[flow], sequential.finish[flow],
+                             "flow " << flow << " finished at a different time");
+    }
+}
+
+class MultithreadedSimulatorTestSuite : public TestSuite
+{
+public:
+  MultithreadedSimulatorTestSuite ();
+};
+
+MultithreadedSimulatorTestSuite::MultithreadedSimulatorTestSuite ()
+  : TestSuite ("multithreaded-simulator", UNIT)
+{
+  AddTestCase (new MultithreadedSimulatorTestCase);
+  AddTestCase (new QbbMultithreadedTestCase);
+}
+
+static MultithreadedSimulatorTestSuite g_multithreadedSimulatorTestSuite;
+
+} // namespace ns3
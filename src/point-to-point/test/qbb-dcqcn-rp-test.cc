@@ -0,0 +1,464 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#include <algorithm>
+#include <vector>
+#include "ns3/test.h"
+#include "ns3/simulator.h"
+#include "ns3/event-id.h"
+#include "ns3/qbb-dcqcn-rp.h"
+
+namespace ns3 {
+
+namespace {
+
+/*
+ * The reaction point as QbbNetDevice ran it before QbbDcqcnRp, with a
+ * simulator event for the rate increase timer and one for alpha.
+ */
+class EventDrivenRp
+{
+public:
+  EventDrivenRp (const QbbDcqcnRp::Params *params, double rpgTimeReset, double alphaResumeInterval);
+  ~EventDrivenRp ();
+
+  void Transmitted (uint32_t size);
+  void ReceiveCnp (void);
+
+  DataRate GetRate (void) const { return m_rateAll; }
+  DataRate GetTargetRate (void) const { return m_targetRate; }
+
+  struct Sample
+  {
+    int64_t time;
+    uint64_t rate;
+    uint64_t targetRate;
+  };
+  std::vector<Sample> m_timerSamples;   // after every rate increase timer
+
+private:
+  void AdjustRates (DataRate increase);
+  void rpr_adjust_rates (void);
+  void rpr_fast_recovery (void);
+  void rpr_active_increase (void);
+  void rpr_active_byte (void);
+  void rpr_active_time (void);
+  void rpr_fast_byte (void);
+  void rpr_fast_time (void);
+  void rpr_hyper_byte (void);
+  void rpr_hyper_time (void);
+  void rpr_active_select (void);
+  void rpr_hyper_increase (void);
+  void rpr_timer_wrapper (void);
+  void ResumeAlpha (void);
+
+  const QbbDcqcnRp::Params *m_p;
+  double m_rpgTimeReset;
+  double m_alphaResumeInterval;
+  DataRate m_rateAll;
+  DataRate m_targetRate;
+  int64_t m_txBytes;
+  double m_rpWhile;
+  uint32_t m_rpByteStage;
+  uint32_t m_rpTimeStage;
+  uint32_t m_rpStage;
+  double m_alpha;
+  EventId m_rptimer;
+  EventId m_resumeAlpha;
+};
+
+EventDrivenRp::EventDrivenRp (const QbbDcqcnRp::Params *params, double rpgTimeReset, double alphaResumeInterval)
+  : m_p (params),
+    m_rpgTimeReset (rpgTimeReset),
+    m_alphaResumeInterval (alphaResumeInterval),
+    m_rateAll (params->lineRate),
+    m_targetRate (params->lineRate),
+    m_txBytes (params->bc),
+    m_rpWhile (rpgTimeReset),
+    m_rpByteStage (0),
+    m_rpTimeStage (0),
+    m_rpStage (0),
+    m_alpha (0.5)
+{
+}
+
+EventDrivenRp::~EventDrivenRp ()
+{
+  Simulator::Cancel (m_rptimer);
+  Simulator::Cancel (m_resumeAlpha);
+}
+
+void
+EventDrivenRp::Transmitted (uint32_t size)
+{
+  if (m_rpStage > 0)
+    m_txBytes -= size;
+  else
+    m_txBytes = m_p->bc;
+  if (m_txBytes < 0)
+    {
+      if (m_rpStage == 1)
+        rpr_fast_byte ();
+      else if (m_rpStage == 2)
+        rpr_active_byte ();
+      else if (m_rpStage == 3)
+        rpr_hyper_byte ();
+    }
+}
+
+void
+EventDrivenRp::ReceiveCnp (void)
+{
+  if (!m_p->clampTgtRateAfterTimeInc && !m_p->clampTgtRate)
+    {
+      if (m_rpByteStage != 0)
+        {
+          m_targetRate = m_rateAll;
+          m_txBytes = m_p->bc;
+        }
+    }
+  else if (m_p->clampTgtRate)
+    {
+      m_targetRate = m_rateAll;
+      m_txBytes = m_p->bc;
+    }
+  else
+    {
+      if (m_rpByteStage != 0 || m_rpTimeStage != 0)
+        {
+          m_targetRate = m_rateAll;
+          m_txBytes = m_p->bc;
+        }
+    }
+  m_rpByteStage = 0;
+  m_rpTimeStage = 0;
+  m_alpha = (1 - m_p->g) * m_alpha + m_p->g;
+  m_rateAll = std::max (m_p->minRate, m_rateAll * (1 - m_alpha / 2));
+  Simulator::Cancel (m_resumeAlpha);
+  m_resumeAlpha = Simulator::Schedule (MicroSeconds (m_alphaResumeInterval), &EventDrivenRp::ResumeAlpha, this);
+  m_rpWhile = m_rpgTimeReset;
+  Simulator::Cancel (m_rptimer);
+  m_rptimer = Simulator::Schedule (MicroSeconds (m_rpWhile), &EventDrivenRp::rpr_timer_wrapper, this);
+  rpr_fast_recovery ();
+}
+
+void
+EventDrivenRp::AdjustRates (DataRate increase)
+{
+  if (((m_rpByteStage == 1) || (m_rpTimeStage == 1)) && (m_targetRate > 10 * m_rateAll))
+    m_targetRate /= 8;
+  else
+    m_targetRate += increase;
+  m_rateAll = (m_rateAll / 2) + (m_targetRate / 2);
+  if (m_rateAll > m_p->lineRate)
+    m_rateAll = m_p->lineRate;
+}
+
+void
+EventDrivenRp::rpr_adjust_rates (void)
+{
+  AdjustRates (DataRate ("0bps"));
+  rpr_fast_recovery ();
+}
+
+void
+EventDrivenRp::rpr_fast_recovery (void)
+{
+  m_rpStage = 1;
+}
+
+void
+EventDrivenRp::rpr_active_increase (void)
+{
+  AdjustRates (m_p->rai);
+  m_rpStage = 2;
+}
+
+void
+EventDrivenRp::rpr_active_byte (void)
+{
+  m_rpByteStage++;
+  m_txBytes = m_p->bc;
+  rpr_active_increase ();
+}
+
+void
+EventDrivenRp::rpr_active_time (void)
+{
+  m_rpTimeStage++;
+  m_rpWhile = m_rpgTimeReset;
+  Simulator::Cancel (m_rptimer);
+  m_rptimer = Simulator::Schedule (MicroSeconds (m_rpWhile), &EventDrivenRp::rpr_timer_wrapper, this);
+  rpr_active_select ();
+}
+
+void
+EventDrivenRp::rpr_fast_byte (void)
+{
+  m_rpByteStage++;
+  m_txBytes = m_p->bc;
+  if (m_rpByteStage < m_p->threshold)
+    rpr_adjust_rates ();
+  else
+    rpr_active_select ();
+}
+
+void
+EventDrivenRp::rpr_fast_time (void)
+{
+  m_rpTimeStage++;
+  m_rpWhile = m_rpgTimeReset;
+  Simulator::Cancel (m_rptimer);
+  m_rptimer = Simulator::Schedule (MicroSeconds (m_rpWhile), &EventDrivenRp::rpr_timer_wrapper, this);
+  if (m_rpTimeStage < m_p->threshold)
+    rpr_adjust_rates ();
+  else
+    rpr_active_select ();
+}
+
+void
+EventDrivenRp::rpr_hyper_byte (void)
+{
+  m_rpByteStage++;
+  m_txBytes = m_p->bc / 2;
+  rpr_hyper_increase ();
+}
+
+void
+EventDrivenRp::rpr_hyper_time (void)
+{
+  m_rpTimeStage++;
+  m_rpWhile = m_rpgTimeReset / 2;
+  Simulator::Cancel (m_rptimer);
+  m_rptimer = Simulator::Schedule (MicroSeconds (m_rpWhile), &EventDrivenRp::rpr_timer_wrapper, this);
+  rpr_hyper_increase ();
+}
+
+void
+EventDrivenRp::rpr_active_select (void)
+{
+  if (m_rpByteStage < m_p->threshold || m_rpTimeStage < m_p->threshold)
+    rpr_active_increase ();
+  else
+    rpr_hyper_increase ();
+}
+
+void
+EventDrivenRp::rpr_hyper_increase (void)
+{
+  AdjustRates (m_p->rhai * (std::min (m_rpByteStage, m_rpTimeStage) - m_p->threshold + 1));
+  m_rpStage = 3;
+}
+
+void
+EventDrivenRp::rpr_timer_wrapper (void)
+{
+  if (m_rpStage == 1)
+    rpr_fast_time ();
+  else if (m_rpStage == 2)
+    rpr_active_time ();
+  else if (m_rpStage == 3)
+    rpr_hyper_time ();
+  Sample s = { Simulator::Now ().GetTimeStep (), m_rateAll.GetBitRate (), m_targetRate.GetBitRate () };
+  m_timerSamples.push_back (s);
+}
+
+void
+EventDrivenRp::ResumeAlpha (void)
+{
+  m_alpha = (1 - m_p->g) * m_alpha;
+  Simulator::Cancel (m_resumeAlpha);
+  m_resumeAlpha = Simulator::Schedule (MicroSeconds (m_alphaResumeInterval), &EventDrivenRp::ResumeAlpha, this);
+}
+
+} // anonymous namespace
+
+/*
+ * Drive the event-driven reaction point and two QbbDcqcnRp with the same
+ * transmissions and CNPs, separated by idle periods long enough for the
+ * rate to climb back to the line rate. One QbbDcqcnRp fires its timers one
+ * at a time, the other catches up with Advance; all three must agree bit
+ * for bit, and the first one at every timer expiry.
+ *
+ * The timers are multiples of 500ns after the last CNP, so transmissions
+ * are put 499ns into a 500ns slot and the i-th CNP i ns into its slot: no
+ * step ever falls on a timer expiry, where the order of the events would
+ * depend on when they were scheduled.
+ */
+class QbbDcqcnRpTestCase : public TestCase
+{
+public:
+  QbbDcqcnRpTestCase (std::string name, bool clampTgtRate, bool clampTgtRateAfterTimeInc,
+                      uint32_t bc, double rpgTimeReset, DataRate rhai);
+  virtual ~QbbDcqcnRpTestCase ();
+
+private:
+  virtual void DoRun (void);
+  void Step (void);
+  uint32_t Random (uint32_t n);
+  void Check (std::string what);
+
+  QbbDcqcnRp::Params m_params;
+  double m_rpgTimeReset;
+  double m_alphaResumeInterval;
+  EventDrivenRp *m_ref;
+  QbbDcqcnRp m_stepped;
+  QbbDcqcnRp m_lazy;
+  std::vector<EventDrivenRp::Sample> m_steppedSamples;
+  uint64_t m_slot;
+  uint32_t m_steps;
+  uint32_t m_cnps;
+  bool m_nextIsCnp;
+  uint32_t m_random;
+};
+
+QbbDcqcnRpTestCase::QbbDcqcnRpTestCase (std::string name, bool clampTgtRate, bool clampTgtRateAfterTimeInc,
+                                        uint32_t bc, double rpgTimeReset, DataRate rhai)
+  : TestCase ("Check QbbDcqcnRp against timer events, " + name),
+    m_rpgTimeReset (rpgTimeReset),
+    m_alphaResumeInterval (55),
+    m_ref (0)
+{
+  m_params.lineRate = DataRate ("40Gb/s");
+  m_params.minRate = DataRate ("100Mb/s");
+  m_params.rai = DataRate ("5Mb/s");
+  m_params.rhai = rhai;
+  m_params.bc = bc;
+  m_params.threshold = 5;
+  m_params.g = 1.0 / 16;
+  m_params.timer = MicroSeconds (m_rpgTimeReset);
+  m_params.hyperTimer = MicroSeconds (m_rpgTimeReset / 2);
+  m_params.alphaInterval = MicroSeconds (m_alphaResumeInterval);
+  m_params.clampTgtRate = clampTgtRate;
+  m_params.clampTgtRateAfterTimeInc = clampTgtRateAfterTimeInc;
+}
+
+QbbDcqcnRpTestCase::~QbbDcqcnRpTestCase ()
+{
+}
+
+uint32_t
+QbbDcqcnRpTestCase::Random (uint32_t n)
+{
+  m_random = m_random * 1103515245 + 12345;
+  return (m_random >> 8) % n;
+}
+
+void
+QbbDcqcnRpTestCase::Check (std::string what)
+{
+  NS_TEST_EXPECT_MSG_EQ (m_stepped.GetRate (), m_ref->GetRate (), what << " at " << Simulator::Now ().GetTimeStep () << ": timer by timer");
+  NS_TEST_EXPECT_MSG_EQ (m_stepped.GetTargetRate (), m_ref->GetTargetRate (), what << " at " << Simulator::Now ().GetTimeStep () << ": timer by timer");
+  NS_TEST_EXPECT_MSG_EQ (m_lazy.GetRate (), m_ref->GetRate (), what << " at " << Simulator::Now ().GetTimeStep () << ": Advance");
+  NS_TEST_EXPECT_MSG_EQ (m_lazy.GetTargetRate (), m_ref->GetTargetRate (), what << " at " << Simulator::Now ().GetTimeStep () << ": Advance");
+}
+
+void
+QbbDcqcnRpTestCase::Step (void)
+{
+  Time now = Simulator::Now ();
+  while (m_stepped.GetNextTimer () <= now)
+    {
+      Time t = m_stepped.GetNextTimer ();
+      m_stepped.FireTimer ();
+      EventDrivenRp::Sample s = { t.GetTimeStep (), m_stepped.GetRate ().GetBitRate (), m_stepped.GetTargetRate ().GetBitRate () };
+      m_steppedSamples.push_back (s);
+    }
+  m_lazy.Advance (now);
+  Check ("timers");
+
+  if (m_nextIsCnp)
+    {
+      m_ref->ReceiveCnp ();
+      m_stepped.ReceiveCnp (now);
+      m_lazy.ReceiveCnp (now);
+      Check ("CNP");
+      m_cnps++;
+    }
+  else
+    {
+      m_ref->Transmitted (1048);
+      m_stepped.Transmitted (1048);
+      m_lazy.Transmitted (1048);
+      Check ("transmission");
+    }
+
+  if (++m_steps == 10000)
+    {
+      Simulator::Stop ();
+      return;
+    }
+  uint32_t r = Random (1000);
+  if (r < 5)
+    {
+      m_slot += 2000 + Random (100000);    // 1ms to 51ms idle
+    }
+  else if (r < 50)
+    {
+      m_slot += 1 + Random (200);
+    }
+  else
+    {
+      m_slot += 1;
+    }
+  m_nextIsCnp = Random (1000) < 20 && m_cnps < 249;
+  uint32_t offset = m_nextIsCnp ? m_cnps + 1 : 499;
+  Simulator::Schedule (NanoSeconds (m_slot * 500 + offset) - now, &QbbDcqcnRpTestCase::Step, this);
+}
+
+void
+QbbDcqcnRpTestCase::DoRun (void)
+{
+  m_ref = new EventDrivenRp (&m_params, m_rpgTimeReset, m_alphaResumeInterval);
+  m_stepped.Start (&m_params);
+  m_lazy.Start (&m_params);
+  m_slot = 2;
+  m_steps = 0;
+  m_cnps = 0;
+  m_nextIsCnp = false;
+  m_random = 1;
+  Simulator::Schedule (NanoSeconds (m_slot * 500 + 499), &QbbDcqcnRpTestCase::Step, this);
+  Simulator::Run ();
+
+  NS_TEST_EXPECT_MSG_GT (m_cnps, 100, "too few CNPs to exercise the reaction point");
+  NS_TEST_ASSERT_MSG_EQ (m_steppedSamples.size (), m_ref->m_timerSamples.size (), "different number of timer expiries");
+  for (uint32_t i = 0; i < m_steppedSamples.size (); i++)
+    {
+      NS_TEST_ASSERT_MSG_EQ (m_steppedSamples[i].time, m_ref->m_timerSamples[i].time, "timer expiry " << i);
+      NS_TEST_ASSERT_MSG_EQ (m_steppedSamples[i].rate, m_ref->m_timerSamples[i].rate, "rate after timer expiry " << i);
+      NS_TEST_ASSERT_MSG_EQ (m_steppedSamples[i].targetRate, m_ref->m_timerSamples[i].targetRate, "target rate after timer expiry " << i);
+    }
+  delete m_ref;
+  Simulator::Destroy ();
+}
+
+class QbbDcqcnRpTestSuite : public TestSuite
+{
+public:
+  QbbDcqcnRpTestSuite ();
+};
+
+QbbDcqcnRpTestSuite::QbbDcqcnRpTestSuite ()
+  : TestSuite ("qbb-dcqcn-rp", UNIT)
+{
+  AddTestCase (new QbbDcqcnRpTestCase ("default", false, false, 10000, 55, DataRate ("50Mb/s")));
+  AddTestCase (new QbbDcqcnRpTestCase ("clamp target rate", true, false, 10000, 55, DataRate ("50Mb/s")));
+  AddTestCase (new QbbDcqcnRpTestCase ("clamp after timer increase", false, true, 150000, 300, DataRate ("200Mb/s")));
+}
+
+static QbbDcqcnRpTestSuite g_qbbDcqcnRpTestSuite;
+
+} // namespace ns3
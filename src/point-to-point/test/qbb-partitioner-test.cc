@@ -0,0 +1,124 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#include "ns3/test.h"
+#include "ns3/qbb-partitioner.h"
+
+namespace ns3 {
+
+/*
+ * Two racks of a switch and three hosts, linked by their switches: the
+ * only good cut of two parts is the link between the racks.
+ */
+class QbbPartitionerRacksTestCase : public TestCase
+{
+public:
+  QbbPartitionerRacksTestCase ();
+
+private:
+  virtual void DoRun (void);
+};
+
+QbbPartitionerRacksTestCase::QbbPartitionerRacksTestCase ()
+  : TestCase ("Cut between two racks")
+{
+}
+
+void
+QbbPartitionerRacksTestCase::DoRun (void)
+{
+  QbbPartitioner partitioner;
+  partitioner.SetNNodes (8);
+  for (uint32_t rack = 0; rack < 2; rack++)
+    {
+      for (uint32_t host = 1; host < 4; host++)
+        {
+          partitioner.AddLink (rack * 4, rack * 4 + host, MicroSeconds (1));
+        }
+    }
+  partitioner.AddLink (0, 4, MicroSeconds (2));
+  partitioner.AddFlow (1, 5, 100);
+  partitioner.AddFlow (6, 2, 100);
+  partitioner.Partition (2);
+
+  NS_TEST_ASSERT_MSG_EQ (partitioner.GetNCutLinks (), 1, "more than the link between the racks is cut");
+  NS_TEST_ASSERT_MSG_NE (partitioner.GetPartition (0), partitioner.GetPartition (4), "the racks are not split");
+  for (uint32_t host = 1; host < 4; host++)
+    {
+      NS_TEST_ASSERT_MSG_EQ (partitioner.GetPartition (host), partitioner.GetPartition (0), "host " << host << " away from its rack");
+      NS_TEST_ASSERT_MSG_EQ (partitioner.GetPartition (4 + host), partitioner.GetPartition (4), "host " << 4 + host << " away from its rack");
+    }
+  NS_TEST_ASSERT_MSG_EQ (partitioner.GetLookAhead (), MicroSeconds (2), "wrong lookahead");
+  NS_TEST_ASSERT_MSG_EQ_TOL (partitioner.GetImbalance (), 1, 1e-9, "the racks are not balanced");
+  // every packet crosses 3 links, one of them between the racks
+  NS_TEST_ASSERT_MSG_EQ_TOL (partitioner.GetCutTraffic (), 1.0 / 3, 1e-9, "wrong cut traffic");
+}
+
+/*
+ * A switch and four hosts, with flows between hosts 1 and 2 and between
+ * hosts 3 and 4: the switch carries as much traffic as two hosts, so the
+ * parts are balanced by three hosts against the switch and a host, and
+ * not by the number of nodes.
+ */
+class QbbPartitionerTrafficTestCase : public TestCase
+{
+public:
+  QbbPartitionerTrafficTestCase ();
+
+private:
+  virtual void DoRun (void);
+};
+
+QbbPartitionerTrafficTestCase::QbbPartitionerTrafficTestCase ()
+  : TestCase ("Nodes weighted by their traffic")
+{
+}
+
+void
+QbbPartitionerTrafficTestCase::DoRun (void)
+{
+  QbbPartitioner partitioner;
+  partitioner.SetNNodes (5);
+  for (uint32_t host = 1; host < 5; host++)
+    {
+      partitioner.AddLink (0, host, MicroSeconds (1));
+    }
+  partitioner.AddFlow (1, 2, 1000);
+  partitioner.AddFlow (3, 4, 1000);
+  partitioner.Partition (2);
+
+  NS_TEST_ASSERT_MSG_EQ (partitioner.GetNCutLinks (), 3, "not three hosts against the switch");
+  NS_TEST_ASSERT_MSG_EQ_TOL (partitioner.GetCutTraffic (), 0.75, 1e-9, "wrong cut traffic");
+  NS_TEST_ASSERT_MSG_EQ_TOL (partitioner.GetImbalance (), 1, 1e-3, "the parts are not balanced");
+  NS_TEST_ASSERT_MSG_EQ (partitioner.GetLookAhead (), MicroSeconds (1), "wrong lookahead");
+}
+
+class QbbPartitionerTestSuite : public TestSuite
+{
+public:
+  QbbPartitionerTestSuite ();
+};
+
+QbbPartitionerTestSuite::QbbPartitionerTestSuite ()
+  : TestSuite ("qbb-partitioner", UNIT)
+{
+  AddTestCase (new QbbPartitionerRacksTestCase);
+  AddTestCase (new QbbPartitionerTrafficTestCase);
+}
+
+static QbbPartitionerTestSuite g_qbbPartitionerTestSuite;
+
+} // namespace ns3
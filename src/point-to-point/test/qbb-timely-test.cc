@@ -0,0 +1,97 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#include "ns3/test.h"
+#include "ns3/qbb-timely.h"
+
+namespace ns3 {
+
+/*
+ * Walks one flow through the regions of the TIMELY rate law, with RTT
+ * samples chosen so that the expected rates are easy to work out by hand.
+ */
+class QbbTimelyTestCase : public TestCase
+{
+public:
+  QbbTimelyTestCase ();
+
+private:
+  virtual void DoRun (void);
+  void Ack (double rttUs, double expectedMbps, std::string what);
+
+  QbbTimely m_timely;
+};
+
+QbbTimelyTestCase::QbbTimelyTestCase ()
+  : TestCase ("TIMELY rate law")
+{
+}
+
+void
+QbbTimelyTestCase::Ack (double rttUs, double expectedMbps, std::string what)
+{
+  m_timely.ReceiveAck (0, NanoSeconds (rttUs * 1000));
+  NS_TEST_EXPECT_MSG_EQ_TOL (m_timely.GetRate (0).GetBitRate () / 1e6, expectedMbps, 1e-5, what);
+}
+
+void
+QbbTimelyTestCase::DoRun (void)
+{
+  QbbTimely::Params params;
+  params.lineRate = DataRate ("10Gb/s");
+  params.minRate = DataRate ("100Mb/s");
+  params.delta = DataRate ("10Mb/s");
+  params.tLow = MicroSeconds (50);
+  params.tHigh = MicroSeconds (500);
+  params.minRtt = MicroSeconds (20);
+  params.alpha = 0.875;
+  params.beta = 0.8;
+  m_timely.SetParams (params);
+  m_timely.AddFlows (1);
+  m_timely.Start (0);
+  NS_TEST_ASSERT_MSG_EQ (m_timely.GetRate (0), params.lineRate, "flows start at the line rate");
+  NS_TEST_ASSERT_MSG_EQ (m_timely.GetNextTimer (0), Time::Max (), "TIMELY has no timers");
+
+  Ack (30, 10000, "below tLow, capped at the line rate");
+  Ack (1000, 6000, "above tHigh, cut by beta * (1 - tHigh / rtt)");
+  // the RTT difference drops to -681us and then decays towards zero
+  Ack (100, 6010, "negative gradient, additive increase");
+  Ack (100, 6020, "second negative gradient");
+  Ack (100, 6030, "third negative gradient");
+  Ack (100, 6040, "fourth negative gradient");
+  Ack (100, 6090, "fifth negative gradient, hyper increase");
+  // the RTT difference jumps to about 87us, a gradient above 1 / beta
+  Ack (200, 100, "positive gradient, floored at the min rate");
+  Ack (40, 110, "below tLow again");
+  // the RTT difference is -129us, then 1.37us
+  Ack (60, 110 * (1 - 0.8 * 1.3668625801801682 / 20), "small positive gradient");
+}
+
+class QbbTimelyTestSuite : public TestSuite
+{
+public:
+  QbbTimelyTestSuite ();
+};
+
+QbbTimelyTestSuite::QbbTimelyTestSuite ()
+  : TestSuite ("qbb-timely", UNIT)
+{
+  AddTestCase (new QbbTimelyTestCase);
+}
+
+static QbbTimelyTestSuite g_qbbTimelyTestSuite;
+
+} // namespace ns3
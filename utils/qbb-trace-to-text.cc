@@ -0,0 +1,172 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+/*
+ * Converts a binary trace written by QbbHelper::EnableBinaryTrace into the
+ * ASCII format of QbbHelper::EnableAscii. The headers are rebuilt from the
+ * recorded fields and printed through Packet::Print, so the output is the
+ * same as what the ASCII trace sinks would have printed.
+ */
+
+#include <iomanip>
+#include <iostream>
+#include <fstream>
+#include "ns3/core-module.h"
+#include "ns3/packet.h"
+#include "ns3/ipv4-header.h"
+#include "ns3/udp-header.h"
+#include "ns3/tcp-header.h"
+#include "ns3/seq-ts-header.h"
+#include "ns3/ppp-header.h"
+#include "ns3/qbb-header.h"
+#include "ns3/cn-header.h"
+#include "ns3/pause-header.h"
+#include "ns3/qbb-trace-writer.h"
+
+using namespace ns3;
+
+static Ptr<Packet>
+RebuildPacket (const QbbTraceRecord &r)
+{
+  Ptr<Packet> p = Create<Packet> ((r.flags & QbbTraceRecord::PAYLOAD) ? 1 : 0);
+  if (!(r.flags & QbbTraceRecord::IPV4))
+    {
+      return p;
+    }
+  switch (r.protocol)
+    {
+    case 17:
+      {
+        SeqTsHeader seqTs;
+        seqTs.SetSeq (r.seq);
+        seqTs.SetPG (r.pg);
+        p->AddHeader (seqTs);
+        UdpHeader udp;
+        udp.SetSourcePort (r.sport);
+        udp.SetDestinationPort (r.dport);
+        p->AddHeader (udp);
+        break;
+      }
+    case 6:
+      {
+        TcpHeader tcp;
+        tcp.SetSourcePort (r.sport);
+        tcp.SetDestinationPort (r.dport);
+        tcp.SetSequenceNumber (SequenceNumber32 (r.seq));
+        p->AddHeader (tcp);
+        break;
+      }
+    case 0xFC:
+    case 0xFD:
+      {
+        qbbHeader qbb;
+        qbb.SetPG (r.pg);
+        qbb.SetSeq (r.seq);
+        qbb.SetPort (r.aux0);
+        p->AddHeader (qbb);
+        break;
+      }
+    case 0xFE:
+      {
+        PauseHeader pause (r.aux0, r.aux1, r.pg);
+        p->AddHeader (pause);
+        break;
+      }
+    case 0xFF:
+      {
+        CnHeader cn (r.seq >> 8, r.pg, r.seq & 0xff, r.aux0, r.aux1);
+        p->AddHeader (cn);
+        break;
+      }
+    default:
+      break;
+    }
+  Ipv4Header ipv4;
+  ipv4.SetSource (Ipv4Address (r.src));
+  ipv4.SetDestination (Ipv4Address (r.dst));
+  ipv4.SetProtocol (r.protocol);
+  p->AddHeader (ipv4);
+  if (r.flags & QbbTraceRecord::PPP)
+    {
+      PppHeader ppp;
+      ppp.SetProtocol (0x0021);
+      p->AddHeader (ppp);
+    }
+  return p;
+}
+
+int main (int argc, char *argv[])
+{
+  std::string input;
+  std::string output;
+
+  CommandLine cmd;
+  cmd.Usage ("Convert a binary qbb trace to the ASCII trace format.");
+  cmd.AddValue ("in",  "binary trace written by QbbHelper::EnableBinaryTrace", input);
+  cmd.AddValue ("out", "ASCII trace to write (default: standard output)", output);
+  cmd.Parse (argc, argv);
+
+  QbbTraceReader reader;
+  if (input.empty () || !reader.Open (input))
+    {
+      std::cerr << "cannot read a qbb trace from \"" << input << "\"" << std::endl;
+      return 1;
+    }
+  if (reader.GetResolution () != (uint32_t)Time::GetResolution ())
+    {
+      Time::SetResolution ((Time::Unit)reader.GetResolution ());
+    }
+  Packet::EnablePrinting ();
+
+  std::ofstream file;
+  if (!output.empty ())
+    {
+      file.open (output.c_str ());
+    }
+  std::ostream &os = output.empty () ? std::cout : file;
+
+  QbbTraceRecord r;
+  while (reader.Read (r))
+    {
+      Ptr<Packet> p = RebuildPacket (r);
+      double now = TimeStep (r.time).GetSeconds ();
+      if (r.type == 'r')
+        {
+          // AsciiTraceHelper::DefaultReceiveSinkWithContext
+          os << std::setprecision (7) << now << " /" << r.node << " " << *p << "\n";
+          continue;
+        }
+      os << r.type << " " << now << " /NodeList/" << r.node << "/DeviceList/" << r.ifIndex << "/$ns3::QbbNetDevice/";
+      if (!(r.flags & QbbTraceRecord::QUEUE))
+        {
+          os << "PhyRxDrop";
+        }
+      else if (r.type == '+')
+        {
+          os << "TxQueue/Enqueue";
+        }
+      else if (r.type == '-')
+        {
+          os << "TxQueue/Dequeue";
+        }
+      else
+        {
+          os << "TxQueue/Drop";
+        }
+      os << " " << *p << "\n";
+    }
+  return 0;
+}